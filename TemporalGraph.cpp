@@ -1,18 +1,31 @@
 // TemporalGraph.cpp - Implementation file for the TemporalGraph class
 #include "TemporalGraph.h"
 #include "utils.h"
+#include "radix_sort.h"
+#include "parallel_scan.h"
+#include "metrics.h"
+#include <iomanip>
+#include <limits>
 
 // Default constructor
-TemporalGraph::TemporalGraph(bool reverse)
-    : edge_idx(), src_list(), dst_list(), time_list(), idx_values(), time_values(), indices(), indptr(), max_node_id(-1), reverse(reverse) {
+template <typename Types>
+TemporalGraphT<Types>::TemporalGraphT(bool reverse)
+    : edge_idx(), src_list(), dst_list(), time_list(), idx_values(), time_values(), indices(), indptr(),
+      csr_idx_values(nullptr), csr_time_values(nullptr), csr_indices(nullptr), csr_indptr(nullptr),
+      csr_num_nodes(0), csr_num_edges(0), snapshot(), layout(CSR_LAYOUT_SEPARATE), max_node_id(-1), reverse(reverse),
+      random_seed(DEFAULT_RANDOM_SEED), batch_counter(0), sample_params() {
 }
 
 // Parameterized constructor
-TemporalGraph::TemporalGraph(const std::vector<GraphDataType>& edge_idx, const std::vector<GraphDataType>& src_list,
-                             const std::vector<GraphDataType>& dst_list, const std::vector<GraphDataType>& time_list,
-                             bool reverse)
+template <typename Types>
+TemporalGraphT<Types>::TemporalGraphT(const std::vector<EdgeType>& edge_idx, const std::vector<NodeType>& src_list,
+                                      const std::vector<NodeType>& dst_list, const std::vector<TimeType>& time_list,
+                                      bool reverse)
     : edge_idx(edge_idx), src_list(src_list), dst_list(dst_list), time_list(time_list),
-      idx_values(), time_values(), indices(), indptr(), reverse(reverse) {
+      idx_values(), time_values(), indices(), indptr(),
+      csr_idx_values(nullptr), csr_time_values(nullptr), csr_indices(nullptr), csr_indptr(nullptr),
+      csr_num_nodes(0), csr_num_edges(0), snapshot(), layout(CSR_LAYOUT_SEPARATE), reverse(reverse),
+      random_seed(DEFAULT_RANDOM_SEED), batch_counter(0), sample_params() {
     max_node_id = std::max(
         *std::max_element(src_list.begin(), src_list.end()),
         *std::max_element(dst_list.begin(), dst_list.end())
@@ -20,19 +33,37 @@ TemporalGraph::TemporalGraph(const std::vector<GraphDataType>& edge_idx, const s
 }
 
 // csr Constructor
-TemporalGraph::TemporalGraph(const std::vector<GraphDataType>& idx_values, const std::vector<GraphDataType>& time_values,
-                             const std::vector<GraphDataType>& indices, const std::vector<GraphDataType>& indptr)
+template <typename Types>
+TemporalGraphT<Types>::TemporalGraphT(const std::vector<EdgeType>& idx_values, const std::vector<TimeType>& time_values,
+                                      const std::vector<NodeType>& indices, const std::vector<EdgeType>& indptr)
     : edge_idx(), src_list(), dst_list(), time_list(),
-      idx_values(idx_values), time_values(time_values), indices(indices), indptr(indptr), max_node_id(-1), reverse(false) {
+      idx_values(idx_values), time_values(time_values), indices(indices), indptr(indptr),
+      snapshot(), layout(CSR_LAYOUT_SEPARATE), max_node_id(-1), reverse(false), random_seed(DEFAULT_RANDOM_SEED), batch_counter(0), sample_params() {
+    bind_csr_views();
 }
 
 // Destructor
-TemporalGraph::~TemporalGraph() {
+template <typename Types>
+TemporalGraphT<Types>::~TemporalGraphT() {
     // No explicit need to clear vectors here since they will be destroyed automatically
 }
 
+// Point the CSR views at the owned CSR vectors
+template <typename Types>
+void TemporalGraphT<Types>::bind_csr_views() {
+    snapshot.reset();
+    set_layout(CSR_LAYOUT_SEPARATE);
+    csr_idx_values = idx_values.data();
+    csr_time_values = time_values.data();
+    csr_indices = indices.data();
+    csr_indptr = indptr.data();
+    csr_num_nodes = indptr.empty() ? 0 : indptr.size() - 1;
+    csr_num_edges = indices.size();
+}
+
 // Add edge to the graph
-void TemporalGraph::add_edge(GraphDataType edge_idx, GraphDataType src, GraphDataType dst, GraphDataType time) {
+template <typename Types>
+void TemporalGraphT<Types>::add_edge(EdgeType edge_idx, NodeType src, NodeType dst, TimeType time) {
     this->edge_idx.push_back(edge_idx);
     this->src_list.push_back(src);
     this->dst_list.push_back(dst);
@@ -40,274 +71,583 @@ void TemporalGraph::add_edge(GraphDataType edge_idx, GraphDataType src, GraphDat
     this->max_node_id = max(this->max_node_id, max(src, dst));
 }
 
+template <typename Types>
+void TemporalGraphT<Types>::assign_edges(std::vector<EdgeType>&& edge_idx, std::vector<NodeType>&& src_list,
+                                         std::vector<NodeType>&& dst_list, std::vector<TimeType>&& time_list) {
+    this->edge_idx = std::move(edge_idx);
+    this->src_list = std::move(src_list);
+    this->dst_list = std::move(dst_list);
+    this->time_list = std::move(time_list);
+    NodeType max_id = -1;
+    #pragma omp parallel for reduction(max:max_id)
+    for (size_t i = 0; i < this->src_list.size(); ++i) {
+        max_id = max(max_id, max(this->src_list[i], this->dst_list[i]));
+    }
+    this->max_node_id = max_id;
+}
+
 // Get the maximum node ID
-GraphDataType TemporalGraph::get_max_node_id() const {
+template <typename Types>
+typename TemporalGraphT<Types>::NodeType TemporalGraphT<Types>::get_max_node_id() const {
     return this->max_node_id;
 }
 
+// Write the adjacency entries of time-sorted edges straight into their T-CSR slots: every node's
+// entries arrive in time order, so placing each at its node's running offset is a stable counting
+// sort. With several threads the entries are first grouped by power-of-two node range, each
+// thread's block in edge order, so a range's segments read in thread order are in edge order; every
+// range is then scattered by one thread from its own copy of the range's offsets in indptr.
+template <typename NodeType, typename EdgeType, typename TimeType>
+static void scatter_time_sorted_edges(const vector<EdgeType>& edge_idx, const vector<NodeType>& src_list,
+                                      const vector<NodeType>& dst_list, const vector<TimeType>& time_list, bool reverse,
+                                      const vector<EdgeType>& indptr, vector<EdgeType>& idx_values, vector<TimeType>& time_values,
+                                      vector<NodeType>& indices) {
+    size_t num_edges = src_list.size();
+    size_t num_nodes = indptr.size() - 1;
+    auto place = [&](uint64_t e, bool reversed, EdgeType slot) {
+        idx_values[slot] = edge_idx[e];
+        time_values[slot] = time_list[e];
+        indices[slot] = reversed ? src_list[e] : dst_list[e];
+    };
+
+    int num_threads = num_edges < PARALLEL_SCAN_MIN_SIZE ? 1 : omp_get_max_threads();
+    if (num_threads == 1) {
+        vector<EdgeType> cursor(indptr.begin(), indptr.end() - 1);
+        for (size_t e = 0; e < num_edges; ++e) {
+            place(e, false, cursor[src_list[e]]++);
+            if (reverse) {
+                place(e, true, cursor[dst_list[e]]++);
+            }
+        }
+        return;
+    }
+
+    int shift = DEGREE_RANGE_MIN_BITS;
+    while ((num_nodes >> shift) > static_cast<size_t>(num_threads) * DEGREE_RANGES_PER_THREAD) {
+        ++shift;
+    }
+    size_t num_ranges = ((max<size_t>(num_nodes, 1) - 1) >> shift) + 1;
+    vector<size_t> range_offsets(num_ranges * static_cast<size_t>(num_threads) + 1, 0);
+    vector<uint64_t> grouped(reverse ? 2 * num_edges : num_edges);
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int tid = omp_get_thread_num();
+        int nt = omp_get_num_threads();
+        size_t begin = num_edges * tid / nt;
+        size_t end = num_edges * (tid + 1) / nt;
+        vector<size_t> cursor(num_ranges, 0);
+        for (size_t e = begin; e < end; ++e) {
+            cursor[static_cast<size_t>(src_list[e]) >> shift]++;
+            if (reverse) {
+                cursor[static_cast<size_t>(dst_list[e]) >> shift]++;
+            }
+        }
+        for (size_t r = 0; r < num_ranges; ++r) {
+            range_offsets[r * nt + tid] = cursor[r];
+        }
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            size_t sum = 0;
+            for (size_t k = 0; k < num_ranges * static_cast<size_t>(nt); ++k) {
+                size_t count = range_offsets[k];
+                range_offsets[k] = sum;
+                sum += count;
+            }
+            range_offsets[num_ranges * static_cast<size_t>(nt)] = sum;
+        }
+
+        for (size_t r = 0; r < num_ranges; ++r) {
+            cursor[r] = range_offsets[r * nt + tid];
+        }
+        for (size_t e = begin; e < end; ++e) {
+            grouped[cursor[static_cast<size_t>(src_list[e]) >> shift]++] = static_cast<uint64_t>(e) << 1;
+            if (reverse) {
+                grouped[cursor[static_cast<size_t>(dst_list[e]) >> shift]++] = (static_cast<uint64_t>(e) << 1) | 1;
+            }
+        }
+
+        // Every segment of a range is complete before the range is scattered
+        #pragma omp barrier
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t r = 0; r < num_ranges; ++r) {
+            size_t first_node = r << shift;
+            size_t last_node = min(num_nodes, (r + 1) << shift);
+            vector<EdgeType> slots(indptr.begin() + first_node, indptr.begin() + last_node);
+            for (size_t i = range_offsets[r * nt]; i < range_offsets[(r + 1) * nt]; ++i) {
+                uint64_t e = grouped[i] >> 1;
+                bool reversed = grouped[i] & 1;
+                size_t node = static_cast<size_t>(reversed ? dst_list[e] : src_list[e]);
+                place(e, reversed, slots[node - first_node]++);
+            }
+        }
+    }
+}
+
 // Convert to CSR representation
-void TemporalGraph::to_csr() {
+template <typename Types>
+void TemporalGraphT<Types>::to_csr(CsrLayout layout) {
     double start_time = omp_get_wtime();
-    GraphDataType num_nodes = max_node_id + 1;
+    size_t num_nodes = static_cast<size_t>(max_node_id + 1);
+    TG_METRIC_START(phase_clock);
     indptr.assign(num_nodes + 1, 0);
 
+    // Count the edges of every node into indptr[node + 1], considering dst->src too for a
+    // reversed graph; no counter is shared between threads
+    parallel_count_degrees(src_list.data(), src_list.size(), indptr.data() + 1, num_nodes);
     if (reverse) {
-        // Count the number of edges for each source node considering both src->dst and dst->src
-        #pragma omp parallel for
-        for (GraphDataType i = 0; i < src_list.size(); ++i) {
-            #pragma omp atomic
-            indptr[src_list[i] + 1]++;
-            #pragma omp atomic
-            indptr[dst_list[i] + 1]++;
-        }
-    } else {
-        // Count the number of edges for each source node considering only src->dst
-        #pragma omp parallel for
-        for (GraphDataType i = 0; i < src_list.size(); ++i) {
-            #pragma omp atomic
-            indptr[src_list[i] + 1]++;
-        }
+        parallel_count_degrees(dst_list.data(), dst_list.size(), indptr.data() + 1, num_nodes);
     }
+    TG_METRIC_LAP(METRIC_TIMER_CSR_COUNT, phase_clock);
 
     // Compute the cumulative sum to get indptr
-    for (GraphDataType i = 1; i <= num_nodes; ++i) {
-        indptr[i] += indptr[i - 1];
-    }
+    parallel_inclusive_scan(indptr.data() + 1, num_nodes);
+    TG_METRIC_LAP(METRIC_TIMER_CSR_PREFIX_SUM, phase_clock);
 
     // Resize idx_values, time_values, and indices to the correct size
-    GraphDataType total_edges = reverse ? src_list.size() * 2 : src_list.size();
+    size_t num_edges = src_list.size();
+    size_t total_edges = reverse ? num_edges * 2 : num_edges;
     idx_values.resize(total_edges);
     time_values.resize(total_edges);
     indices.resize(total_edges);
 
-    // Temporary storage to keep track of the current position in idx_values, time_values, and indices
-    vector<GraphDataType> temp_indptr = indptr;
-
-    // Fill idx_values, time_values, and indices
-    #pragma omp parallel for
-    for (GraphDataType i = 0; i < src_list.size(); ++i) {
-        GraphDataType src = src_list[i];
-        GraphDataType dst = dst_list[i];
-        GraphDataType time = time_list[i];
-        GraphDataType idx = edge_idx[i];
-
-        GraphDataType pos_src;
-
-        #pragma omp atomic capture
-        pos_src = temp_indptr[src]++;
-
-        idx_values[pos_src] = idx;
-        time_values[pos_src] = time;
-        indices[pos_src] = dst;
-
-        if (reverse) {
-            GraphDataType pos_dst;
-
-            #pragma omp atomic capture
-            pos_dst = temp_indptr[dst]++;
-
-            idx_values[pos_dst] = idx;
-            time_values[pos_dst] = time;
-            indices[pos_dst] = src;
-        }
+    // Time-sorted input (the common case) needs no sort: scattering every edge to the running
+    // offset of its node keeps the time order inside every node
+    bool time_sorted = true;
+    #pragma omp parallel for reduction(&&:time_sorted)
+    for (size_t i = 1; i < num_edges; ++i) {
+        time_sorted = time_sorted && time_list[i - 1] <= time_list[i];
     }
-
-    // Sort time of each indptr by time in ascending order, and rearrange idx_values and indices
-    #pragma omp parallel for
-    for (GraphDataType i = 0; i < num_nodes; ++i) {
-        GraphDataType start = indptr[i];
-        GraphDataType end = indptr[i + 1];
-
-        // Skip empty ranges and ranges with only one element
-        if (start + 1 >= end) {
-            continue;
+    if (time_sorted) {
+        scatter_time_sorted_edges(edge_idx, src_list, dst_list, time_list, reverse, indptr, idx_values, time_values, indices);
+        TG_METRIC_LAP(METRIC_TIMER_CSR_SCATTER, phase_clock);
+    } else {
+        // Time keys are as wide as TimeType, node keys as wide as NodeType; one key array fits both
+        typedef typename make_unsigned<NodeType>::type NodeKey;
+        typedef decltype(radix_key(TimeType())) TimeKey;
+        typedef typename conditional<(sizeof(NodeKey) > sizeof(TimeKey)), NodeKey, TimeKey>::type KeyType;
+        vector<KeyType> keys(num_edges);
+        vector<uint64_t> entries;
+        vector<KeyType> key_scratch;
+        vector<uint64_t> entry_scratch;
+
+        // Edge order by time: a stable radix sort of the edge ids by time
+        vector<uint64_t> order(num_edges);
+        #pragma omp parallel for
+        for (size_t i = 0; i < num_edges; ++i) {
+            keys[i] = radix_key(time_list[i]);
+            order[i] = i;
         }
+        parallel_radix_sort(keys, order, key_scratch, entry_scratch);
 
-        // Create a vector of indices for sorting
-        vector<GraphDataType> indices_to_sort(end - start);
-        iota(indices_to_sort.begin(), indices_to_sort.end(), start);
-
-        // Sort indices based on time_values
-        sort(indices_to_sort.begin(), indices_to_sort.end(), [&](GraphDataType a, GraphDataType b) {
-            return time_values[a] < time_values[b];
-        });
-
-        // Create temporary vectors to hold sorted values
-        vector<GraphDataType> sorted_idx_values(end - start);
-        vector<GraphDataType> sorted_time_values(end - start);
-        vector<GraphDataType> sorted_indices(end - start);
-
-        // Fill the sorted vectors
+        // One entry per adjacency slot, in time order: (edge id << 1) | (1 for the reversed direction),
+        // keyed by the node that owns the slot
+        size_t fanout = reverse ? 2 : 1;
+        keys.resize(total_edges);
+        entries.resize(total_edges);
         #pragma omp parallel for
-        for (GraphDataType j = 0; j < end - start; ++j) {
-            sorted_idx_values[j] = idx_values[indices_to_sort[j]];
-            sorted_time_values[j] = time_values[indices_to_sort[j]];
-            sorted_indices[j] = indices[indices_to_sort[j]];
+        for (size_t i = 0; i < num_edges; ++i) {
+            uint64_t e = order[i];
+            keys[i * fanout] = static_cast<KeyType>(src_list[e]);
+            entries[i * fanout] = e << 1;
+            if (reverse) {
+                keys[i * fanout + 1] = static_cast<KeyType>(dst_list[e]);
+                entries[i * fanout + 1] = (e << 1) | 1;
+            }
         }
+        vector<uint64_t>().swap(order);
+
+        // A stable sort by node keeps the time order inside every node, so sorted position p is
+        // exactly CSR slot p and no per-node sorting is needed
+        parallel_radix_sort(keys, entries, key_scratch, entry_scratch);
+        vector<KeyType>().swap(key_scratch);
+        vector<uint64_t>().swap(entry_scratch);
+        TG_METRIC_LAP(METRIC_TIMER_CSR_SORT, phase_clock);
 
-        // Copy the sorted values back to the original vectors
+        // Fill idx_values, time_values, and indices
         #pragma omp parallel for
-        for (GraphDataType j = 0; j < end - start; ++j) {
-            idx_values[start + j] = sorted_idx_values[j];
-            time_values[start + j] = sorted_time_values[j];
-            indices[start + j] = sorted_indices[j];
+        for (size_t p = 0; p < total_edges; ++p) {
+            uint64_t e = entries[p] >> 1;
+            bool reversed = entries[p] & 1;
+            idx_values[p] = edge_idx[e];
+            time_values[p] = time_list[e];
+            indices[p] = reversed ? src_list[e] : dst_list[e];
         }
+        TG_METRIC_LAP(METRIC_TIMER_CSR_SCATTER, phase_clock);
     }
+    TG_METRIC_ADD(METRIC_CSR_EDGES, total_edges);
+    bind_csr_views();
+    set_layout(layout);
+
     double end_time = omp_get_wtime();
     cout << "The elapsed time for converting to T-CSR graph: " << end_time - start_time << " seconds" << endl;
 }
 
-void TemporalGraph::save_csr(const string& idx_values_file_path, const string& time_values_file_path, const string& indices_file_path, const string& indptr_file_path) const {
+template <typename Types>
+void TemporalGraphT<Types>::assign_csr(std::vector<EdgeType>&& idx_values, std::vector<TimeType>&& time_values,
+                                       std::vector<NodeType>&& indices, std::vector<EdgeType>&& indptr, bool reverse) {
+    this->idx_values = std::move(idx_values);
+    this->time_values = std::move(time_values);
+    this->indices = std::move(indices);
+    this->indptr = std::move(indptr);
+    this->reverse = reverse;
+    this->max_node_id = static_cast<NodeType>(this->indptr.size()) - 2;
+    bind_csr_views();
+}
+
+template <typename Types>
+void TemporalGraphT<Types>::save_csr(const string& idx_values_file_path, const string& time_values_file_path, const string& indices_file_path, const string& indptr_file_path) const {
     // Save idx_values
     ofstream idx_values_file(idx_values_file_path);
-    for (GraphDataType idx : idx_values) {
-        idx_values_file << idx << endl;
+    for (size_t i = 0; i < csr_num_edges; ++i) {
+        idx_values_file << csr_idx_values[i] << endl;
     }
     idx_values_file.close();
 
     // Save time_values
     ofstream time_values_file(time_values_file_path);
-    for (GraphDataType time : time_values) {
-        time_values_file << time << endl;
+    time_values_file << setprecision(numeric_limits<TimeType>::max_digits10);
+    for (size_t i = 0; i < csr_num_edges; ++i) {
+        time_values_file << csr_time_values[i] << endl;
     }
     time_values_file.close();
 
     // Save indices
     ofstream indices_file(indices_file_path);
-    for (GraphDataType index : indices) {
-        indices_file << index << endl;
+    for (size_t i = 0; i < csr_num_edges; ++i) {
+        indices_file << csr_indices[i] << endl;
     }
     indices_file.close();
 
     // Save indptr
     ofstream indptr_file(indptr_file_path);
-    for (GraphDataType ptr : indptr) {
-        indptr_file << ptr << endl;
+    for (size_t i = 0; csr_indptr != nullptr && i <= csr_num_nodes; ++i) {
+        indptr_file << csr_indptr[i] << endl;
     }
     indptr_file.close();
 }
 
-void TemporalGraph::read_csr(const string& idx_values_file_path, const string& time_values_file_path, const string& indices_file_path, const string& indptr_file_path) {
-    // Read idx_values
-    ifstream idx_values_file(idx_values_file_path);
-    idx_values.clear();
-    GraphDataType idx;
-    while (idx_values_file >> idx) {
-        idx_values.push_back(idx);
+// Read whitespace-separated values until the end of the file; false if it cannot be opened or
+// holds something else
+template <typename T>
+static bool read_text_values(const string& file_path, vector<T>& values) {
+    ifstream file(file_path);
+    values.clear();
+    T value;
+    while (file >> value) {
+        values.push_back(value);
     }
-    idx_values_file.close();
+    if (!file.eof()) {
+        cerr << "Failed to read " << file_path << (file.is_open() ? ": unexpected text after " + to_string(values.size()) + " values" : "")
+             << endl;
+        return false;
+    }
+    return true;
+}
 
-    // Read time_values
-    ifstream time_values_file(time_values_file_path);
-    time_values.clear();
-    GraphDataType time;
-    while (time_values_file >> time) {
-        time_values.push_back(time);
+template <typename Types>
+bool TemporalGraphT<Types>::read_csr(const string& idx_values_file_path, const string& time_values_file_path, const string& indices_file_path, const string& indptr_file_path) {
+    bool read = read_text_values(idx_values_file_path, idx_values) && read_text_values(time_values_file_path, time_values) &&
+                read_text_values(indices_file_path, indices) && read_text_values(indptr_file_path, indptr);
+    bool consistent = read && !indptr.empty() && time_values.size() == indices.size() && idx_values.size() == indices.size();
+    if (read && !consistent) {
+        cerr << "Inconsistent text CSR: " << idx_values.size() << " edge ids, " << time_values.size() << " times, " << indices.size()
+             << " neighbors and " << indptr.size() << " offsets" << endl;
     }
-    time_values_file.close();
+    if (!consistent) {
+        vector<EdgeType>().swap(idx_values);
+        vector<TimeType>().swap(time_values);
+        vector<NodeType>().swap(indices);
+        vector<EdgeType>().swap(indptr);
+    }
+    bind_csr_views();
+    return consistent;
+}
 
-    // Read indices
-    ifstream indices_file(indices_file_path);
-    indices.clear();
-    GraphDataType index;
-    while (indices_file >> index) {
-        indices.push_back(index);
+template <typename Types>
+bool TemporalGraphT<Types>::save_csr_binary(const string& file_path) const {
+    double start_time = omp_get_wtime();
+    if (csr_indptr == nullptr) {
+        cerr << "Failed to save " << file_path << ": the graph has no T-CSR, call to_csr() first" << endl;
+        return false;
     }
-    indices_file.close();
 
-    // Read indptr
-    ifstream indptr_file(indptr_file_path);
-    indptr.clear();
-    GraphDataType ptr;
-    while (indptr_file >> ptr) {
-        indptr.push_back(ptr);
+    CsrSnapshotHeader header;
+    init_csr_snapshot_header(header);
+    header.node_width = sizeof(NodeType);
+    header.edge_width = sizeof(EdgeType);
+    header.time_width = sizeof(TimeType);
+    header.flags = (reverse ? CSR_FLAG_REVERSE : 0) | (is_floating_point<TimeType>::value ? CSR_FLAG_FLOAT_TIME : 0);
+    header.num_nodes = csr_num_nodes;
+    header.num_edges = csr_num_edges;
+
+    const void* sections[CSR_NUM_SECTIONS] = {csr_indptr, csr_indices, csr_time_values, csr_idx_values};
+    const uint64_t entries[CSR_NUM_SECTIONS] = {csr_num_nodes + 1, csr_num_edges, csr_num_edges, csr_num_edges};
+    const uint64_t widths[CSR_NUM_SECTIONS] = {sizeof(EdgeType), sizeof(NodeType), sizeof(TimeType), sizeof(EdgeType)};
+    uint64_t offset = sizeof(CsrSnapshotHeader);
+    for (int s = 0; s < CSR_NUM_SECTIONS; ++s) {
+        header.section_offset[s] = csr_snapshot_section_offset(offset, 0);
+        header.section_bytes[s] = entries[s] * widths[s];
+        header.section_checksum[s] = snapshot_checksum(sections[s], header.section_bytes[s]);
+        offset = header.section_offset[s] + header.section_bytes[s];
     }
-    indptr_file.close();
+    header.header_checksum = snapshot_checksum(&header, offsetof(CsrSnapshotHeader, header_checksum));
+
+    ofstream file(file_path, ios::binary | ios::trunc);
+    if (!file) {
+        cerr << "Failed to open " << file_path << " for writing" << endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[CSR_SNAPSHOT_ALIGNMENT] = {0};
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < CSR_NUM_SECTIONS; ++s) {
+        file.write(padding, header.section_offset[s] - written);
+        file.write(static_cast<const char*>(sections[s]), header.section_bytes[s]);
+        written = header.section_offset[s] + header.section_bytes[s];
+    }
+    file.close();
+    if (!file) {
+        cerr << "Failed to write " << file_path << endl;
+        return false;
+    }
+
+    double end_time = omp_get_wtime();
+    cout << "The elapsed time for saving the binary T-CSR snapshot: " << end_time - start_time << " seconds" << endl;
+    return true;
 }
 
-// Get the neighbors of a node at a given time with sampling
-void TemporalGraph::get_neighbors(GraphDataType node, GraphDataType time, vector<GraphDataType>& neighbors, vector<GraphDataType>& neighbor_times, vector<GraphDataType>& neighbor_idx, GraphDataType sample_num, const string& sample_strategy) const {
-    neighbors.clear();
-    neighbor_times.clear();
-    neighbor_idx.clear();
-
-    GraphDataType start = indptr[node];
-    GraphDataType end = indptr[node + 1];
-
-    // Using binary search to find the first edge with time greater than the given time
-    GraphDataType left = start;
-    GraphDataType right = end - 1;
-    GraphDataType mid;
-    while (left <= right) {
-        mid = left + (right - left) / 2;
-        if (time_values[mid] >= time) {
-            right = mid - 1;
-        } else {
-            left = mid + 1;
+template <typename Types>
+bool TemporalGraphT<Types>::load_csr_binary(const string& file_path, bool verify_checksums) {
+    double start_time = omp_get_wtime();
+
+    shared_ptr<MappedFile> file = make_shared<MappedFile>();
+    if (!file->open(file_path)) {
+        return false;
+    }
+    if (file->size() < sizeof(CsrSnapshotHeader)) {
+        cerr << "Failed to load " << file_path << ": file is too small" << endl;
+        return false;
+    }
+
+    CsrSnapshotHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+    string error;
+    if (!check_csr_snapshot_header(header, file->size(), error)) {
+        cerr << "Failed to load " << file_path << ": " << error << endl;
+        return false;
+    }
+    if (!csr_snapshot_matches<Types>(header)) {
+        cerr << "Failed to load " << file_path << ": snapshot was written with a different type configuration" << endl;
+        return false;
+    }
+    if (verify_checksums) {
+        for (int s = 0; s < CSR_NUM_SECTIONS; ++s) {
+            const char* section = file->data() + header.section_offset[s];
+            if (snapshot_checksum(section, header.section_bytes[s]) != header.section_checksum[s]) {
+                cerr << "Failed to load " << file_path << ": checksum mismatch in section " << s << endl;
+                return false;
+            }
         }
     }
 
-    // If the first edge with time greater than the given time is the first edge of the node, then there is no neighbor
-    if (left == start) {
+    // Drop any owned CSR and switch the views to the mapping
+    vector<EdgeType>().swap(idx_values);
+    vector<TimeType>().swap(time_values);
+    vector<NodeType>().swap(indices);
+    vector<EdgeType>().swap(indptr);
+    set_layout(CSR_LAYOUT_SEPARATE);
+    const char* base = file->data();
+    csr_indptr = reinterpret_cast<const EdgeType*>(base + header.section_offset[CSR_SECTION_INDPTR]);
+    csr_indices = reinterpret_cast<const NodeType*>(base + header.section_offset[CSR_SECTION_INDICES]);
+    csr_time_values = reinterpret_cast<const TimeType*>(base + header.section_offset[CSR_SECTION_TIME_VALUES]);
+    csr_idx_values = reinterpret_cast<const EdgeType*>(base + header.section_offset[CSR_SECTION_IDX_VALUES]);
+    csr_num_nodes = header.num_nodes;
+    csr_num_edges = header.num_edges;
+    snapshot = file;
+    reverse = (header.flags & CSR_FLAG_REVERSE) != 0;
+    max_node_id = static_cast<NodeType>(header.num_nodes) - 1;
+
+    double end_time = omp_get_wtime();
+    cout << "The elapsed time for loading the binary T-CSR snapshot: " << end_time - start_time << " seconds" << endl;
+    return true;
+}
+
+SampleStrategy parse_sample_strategy(const string& sample_strategy) {
+    if (sample_strategy == "recent") {
+        return SAMPLE_RECENT;
+    } else if (sample_strategy == "random" || sample_strategy == "uniform") {
+        return SAMPLE_RANDOM;
+    } else if (sample_strategy == "window") {
+        return SAMPLE_WINDOW;
+    } else if (sample_strategy == "decay") {
+        return SAMPLE_DECAY;
+    } else if (sample_strategy == "inverse_degree") {
+        return SAMPLE_INVERSE_DEGREE;
+    }
+    return SAMPLE_NONE;
+}
+
+bool parse_csr_layout(const string& name, CsrLayout& layout) {
+    if (name == "separate") {
+        layout = CSR_LAYOUT_SEPARATE;
+    } else if (name == "packed") {
+        layout = CSR_LAYOUT_PACKED;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+template <typename Types>
+void TemporalGraphT<Types>::set_layout(CsrLayout layout) {
+    this->layout = layout;
+    if (layout == CSR_LAYOUT_SEPARATE) {
+        vector<PackedEdge<Types>>().swap(packed_edges);
+        vector<EdgeType>().swap(time_index_ptr);
+        vector<TimeType>().swap(time_index);
         return;
     }
 
-    // Get the neighbors and their times
-    vector<GraphDataType> temp_neighbors;
-    vector<GraphDataType> temp_neighbor_times;
-    vector<GraphDataType> temp_neighbor_idx;
-    for (GraphDataType i = start; i < left; ++i) {
-        temp_neighbors.push_back(indices[i]);
-        temp_neighbor_times.push_back(time_values[i]);
-        temp_neighbor_idx.push_back(idx_values[i]);
+    size_t num_nodes = csr_num_nodes;
+    size_t num_edges = csr_num_edges;
+    packed_edges.resize(num_edges);
+    #pragma omp parallel for
+    for (size_t p = 0; p < num_edges; ++p) {
+        PackedEdge<Types> entry = {csr_indices[p], csr_time_values[p], csr_idx_values[p]};
+        packed_edges[p] = entry;
     }
 
-    // Sample neighbors based on the strategy
-    if (sample_strategy == "recent") {
-        // Get the most recent neighbors
-        GraphDataType count = min(sample_num, static_cast<GraphDataType>(temp_neighbors.size()));
-        for (GraphDataType i = temp_neighbors.size() - count; i < temp_neighbors.size(); ++i) {
-            neighbors.push_back(temp_neighbors[i]);
-            neighbor_times.push_back(temp_neighbor_times[i]);
-            neighbor_idx.push_back(temp_neighbor_idx[i]);
-        }
-    } else if (sample_strategy == "random") {
-        // Randomly sample neighbors
-        random_device rd;
-        mt19937 gen(rd());
-        uniform_int_distribution<> dis(0, temp_neighbors.size() - 1);
-        unordered_set<GraphDataType> sampled_indices;
-        while (sampled_indices.size() < min(sample_num, static_cast<GraphDataType>(temp_neighbors.size()))) {
-            sampled_indices.insert(dis(gen));
-        }
-        for (GraphDataType index : sampled_indices) {
-            neighbors.push_back(temp_neighbors[index]);
-            neighbor_times.push_back(temp_neighbor_times[index]);
-            neighbor_idx.push_back(temp_neighbor_idx[index]);
+    // One index entry per started stride of every hub node
+    const EdgeType stride = time_index_stride<TimeType>();
+    time_index_ptr.assign(num_nodes + 1, 0);
+    #pragma omp parallel for
+    for (size_t v = 0; v < num_nodes; ++v) {
+        EdgeType length = csr_indptr[v + 1] - csr_indptr[v];
+        time_index_ptr[v + 1] = length >= TIME_INDEX_MIN_DEGREE ? (length + stride - 1) / stride : 0;
+    }
+    parallel_inclusive_scan(time_index_ptr.data() + 1, num_nodes);
+    time_index.resize(num_nodes == 0 ? 0 : time_index_ptr[num_nodes]);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t v = 0; v < num_nodes; ++v) {
+        const TimeType* times = csr_time_values + csr_indptr[v];
+        for (EdgeType j = time_index_ptr[v]; j < time_index_ptr[v + 1]; ++j) {
+            time_index[j] = times[(j - time_index_ptr[v]) * stride];
         }
     }
 }
 
+// Grow the buffers to hold batch_size rows of sample_num neighbors; never shrinks the storage
+template <typename Types>
+void SampleBuffers<Types>::resize(size_t batch_size, EdgeType sample_num) {
+    this->batch_size = batch_size;
+    this->sample_num = sample_num;
+    size_t total = batch_size * static_cast<size_t>(sample_num);
+    if (neighbors.size() < total) {
+        neighbors.resize(total);
+        neighbor_times.resize(total);
+        neighbor_idx.resize(total);
+    }
+    if (counts.size() < batch_size) {
+        counts.resize(batch_size);
+    }
+}
+
+// Seed the random strategies and restart the sequence of batch streams
+template <typename Types>
+void TemporalGraphT<Types>::set_random_seed(uint64_t seed) {
+    random_seed = seed;
+    batch_counter.store(0);
+}
+
+template <typename Types>
+void TemporalGraphT<Types>::set_sample_params(const SampleParams& params) {
+    sample_params = params;
+}
+
+// Every sampling call takes the next batch id; rows draw from stream (batch id, row)
+template <typename Types>
+uint64_t TemporalGraphT<Types>::next_batch_id() const {
+    return batch_counter.fetch_add(1);
+}
+
+// The T-CSR adjacency of node as a neighbor source for the sampler kernels; ids outside the T-CSR
+// (including every id before to_csr) have no neighbors
+template <typename Types>
+NeighborSlice<Types> TemporalGraphT<Types>::neighbor_slice(NodeType node) const {
+    if (node < 0 || static_cast<size_t>(node) >= csr_num_nodes) {
+        NeighborSlice<Types> empty = {nullptr, nullptr, nullptr, 0, nullptr, nullptr, 0};
+        return empty;
+    }
+    EdgeType start = csr_indptr[node];
+    NeighborSlice<Types> slice = {csr_indices + start, csr_time_values + start, csr_idx_values + start, csr_indptr[node + 1] - start,
+                                  nullptr, nullptr, 0};
+    if (layout == CSR_LAYOUT_PACKED) {
+        slice.packed = packed_edges.data() + start;
+        slice.time_index = time_index.data() + time_index_ptr[node];
+        slice.time_index_length = time_index_ptr[node + 1] - time_index_ptr[node];
+    }
+    return slice;
+}
+
+template <typename Types>
+typename TemporalGraphT<Types>::EdgeType TemporalGraphT<Types>::degree(NodeType node) const {
+    if (node < 0 || static_cast<size_t>(node) >= csr_num_nodes) {
+        return 0;
+    }
+    return csr_indptr[node + 1] - csr_indptr[node];
+}
+
+// Get the neighbors of a node at a given time with sampling
+template <typename Types>
+void TemporalGraphT<Types>::get_neighbors(NodeType node, TimeType time, vector<NodeType>& neighbors, vector<TimeType>& neighbor_times, vector<EdgeType>& neighbor_idx, EdgeType sample_num, const string& sample_strategy) const {
+    SampleStrategy strategy = parse_sample_strategy(sample_strategy);
+    size_t capacity = max(sample_num, static_cast<EdgeType>(0));
+    neighbors.resize(capacity);
+    neighbor_times.resize(capacity);
+    neighbor_idx.resize(capacity);
+
+    uint64_t stream = row_stream(next_batch_id(), 0);
+    EdgeType count = sample_row(strategy, *this, node, time, sample_num, sample_params, random_seed, stream,
+                                     neighbors.data(), neighbor_times.data(), neighbor_idx.data());
+
+    neighbors.resize(count);
+    neighbor_times.resize(count);
+    neighbor_idx.resize(count);
+}
+
 // based on get_neighbors() function, implement sampling(batch_node_id, batch_node_time) function in parallel for batch sampling
-double TemporalGraph::sampling(const vector<GraphDataType>& batch_node_id, const vector<GraphDataType>& batch_node_time,
-                            vector<vector<GraphDataType>>& batch_neighbors, vector<vector<GraphDataType>>& batch_neighbor_times,
-                            vector<vector<GraphDataType>>& batch_neighbor_idx, GraphDataType sample_num,
-                            const string& sample_strategy) {
+template <typename Types>
+double TemporalGraphT<Types>::sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                                      vector<vector<NodeType>>& batch_neighbors, vector<vector<TimeType>>& batch_neighbor_times,
+                                      vector<vector<EdgeType>>& batch_neighbor_idx, EdgeType sample_num,
+                                      const string& sample_strategy) {
     double start_time = omp_get_wtime();
     size_t batch_size = batch_node_id.size();
     batch_neighbors.resize(batch_size);
     batch_neighbor_times.resize(batch_size);
     batch_neighbor_idx.resize(batch_size);
+    SampleStrategy strategy = parse_sample_strategy(sample_strategy);
+    uint64_t batch_id = next_batch_id();
+    size_t capacity = max(sample_num, static_cast<EdgeType>(0));
 
     #pragma omp parallel for
     for (size_t b = 0; b < batch_size; ++b) {
-        GraphDataType node = batch_node_id[b];
-        GraphDataType time = batch_node_time[b];
+        NodeType node = batch_node_id[b];
+        TimeType time = batch_node_time[b];
         auto& neighbors = batch_neighbors[b];
         auto& neighbor_times = batch_neighbor_times[b];
         auto& neighbor_idx = batch_neighbor_idx[b];
 
-        get_neighbors(node, time, neighbors, neighbor_times, neighbor_idx, sample_num, sample_strategy);
+        neighbors.resize(capacity);
+        neighbor_times.resize(capacity);
+        neighbor_idx.resize(capacity);
+        EdgeType count = sample_row(strategy, *this, node, time, sample_num, sample_params, random_seed,
+                                         row_stream(batch_id, b), neighbors.data(), neighbor_times.data(), neighbor_idx.data());
+        neighbors.resize(count);
+        neighbor_times.resize(count);
+        neighbor_idx.resize(count);
     }
 
     double end_time = omp_get_wtime();
@@ -316,10 +656,58 @@ double TemporalGraph::sampling(const vector<GraphDataType>& batch_node_id, const
     return end_time - start_time;
 }
 
+// Flat-buffer batch sampling into caller-owned buffers; no heap allocation on the hot path.
+// The strategy is dispatched once per batch to a loop specialized for it.
+template <typename Types>
+double TemporalGraphT<Types>::sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                                             NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                                             EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                                             EdgeType sample_num, SampleStrategy sample_strategy) const {
+    double start_time = omp_get_wtime();
+    uint64_t batch_id = next_batch_id();
+
+    sample_batch(sample_strategy, *this, batch_node_id, batch_node_time, batch_size, sample_num, sample_params, random_seed,
+                 batch_id, batch_neighbors, batch_neighbor_times, batch_neighbor_idx, batch_counts);
+
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+double TemporalGraphT<Types>::sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                                             NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                                             EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                                             EdgeType sample_num, const string& sample_strategy) const {
+    return sampling_into(batch_node_id, batch_node_time, batch_size, batch_neighbors, batch_neighbor_times,
+                         batch_neighbor_idx, batch_counts, sample_num, parse_sample_strategy(sample_strategy));
+}
+
+template <typename Types>
+double TemporalGraphT<Types>::sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                                      SampleBuffers<Types>& buffers, EdgeType sample_num, SampleStrategy sample_strategy) const {
+    buffers.resize(batch_node_id.size(), sample_num);
+    return sampling_into(batch_node_id.data(), batch_node_time.data(), batch_node_id.size(),
+                         buffers.neighbors.data(), buffers.neighbor_times.data(), buffers.neighbor_idx.data(),
+                         buffers.counts.data(), sample_num, sample_strategy);
+}
+
+template <typename Types>
+double TemporalGraphT<Types>::sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                                      SampleBuffers<Types>& buffers, EdgeType sample_num, const string& sample_strategy) const {
+    return sampling(batch_node_id, batch_node_time, buffers, sample_num, parse_sample_strategy(sample_strategy));
+}
+
 // Function to print CSR representation sizes (for verification)
-void TemporalGraph::print_csr_sizes() const {
-    cout << "idx_values size: " << idx_values.size() << endl;
-    cout << "time_values size: " << time_values.size() << endl;
-    cout << "indices size: " << indices.size() << endl;
-    cout << "indptr size: " << indptr.size() << endl;
-}
\ No newline at end of file
+template <typename Types>
+void TemporalGraphT<Types>::print_csr_sizes() const {
+    cout << "idx_values size: " << csr_num_edges << endl;
+    cout << "time_values size: " << csr_num_edges << endl;
+    cout << "indices size: " << csr_num_edges << endl;
+    cout << "indptr size: " << (csr_indptr ? csr_num_nodes + 1 : 0) << endl;
+}
+
+// Both type configurations are compiled into every binary
+template struct SampleBuffers<TGNGraphTypes>;
+template struct SampleBuffers<TGLGraphTypes>;
+template class TemporalGraphT<TGNGraphTypes>;
+template class TemporalGraphT<TGLGraphTypes>;
@@ -5,63 +5,208 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
-#include <random>
-#include <unordered_set>
+#include <numeric>
+#include <atomic>
 #include <omp.h>
 #include <fstream>
+#include <memory>
+#include <type_traits>
 #include "utils.h"
+#include "csr_snapshot.h"
+#include "sampler_kernels.h"
 
 using namespace std;
 
-class TemporalGraph {
+const uint64_t DEFAULT_RANDOM_SEED = 0x5EED;
+
+/*
+Adjacency layouts of the T-CSR:
+  "separate" - the indices, time_values and idx_values arrays only
+  "packed"   - additionally the entries interleaved as PackedEdge records, so random strategies
+               gather each sampled neighbor from one cache line, and a time index over every
+               cache line of time_values for nodes with at least TIME_INDEX_MIN_DEGREE edges,
+               so the time search on hub nodes touches a small dense array instead of
+               log2(degree) lines spread over the whole adjacency
+The packed layout costs sizeof(PackedEdge) bytes per edge plus a few percent for the hub index.
+*/
+enum CsrLayout {
+    CSR_LAYOUT_SEPARATE,
+    CSR_LAYOUT_PACKED
+};
+
+bool parse_csr_layout(const string& name, CsrLayout& layout);
+
+/*
+Caller-owned flat output of a batch sampling call, laid out as dense batch_size x sample_num
+blocks: row b occupies [b * sample_num, (b + 1) * sample_num), its first counts[b] entries hold
+the sampled neighbors and the rest is SAMPLE_PADDING. Reusing one instance across minibatches
+keeps sampling free of heap allocation once the buffers have grown to the largest batch.
+*/
+template <typename Types>
+struct SampleBuffers {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+    size_t batch_size = 0;
+    EdgeType sample_num = 0;
+    vector<NodeType> neighbors;
+    vector<TimeType> neighbor_times;
+    vector<EdgeType> neighbor_idx;
+    vector<EdgeType> counts;
+
+    void resize(size_t batch_size, EdgeType sample_num);
+};
+
+/*
+Temporal graph in T-CSR form, templated on a GraphTypes configuration (see utils.h): node ids are
+NodeType, edge ids and indptr offsets EdgeType, timestamps TimeType. The implementation is
+instantiated for TGNGraphTypes and TGLGraphTypes in TemporalGraph.cpp.
+*/
+template <typename Types>
+class TemporalGraphT {
+public:
+    typedef Types TypeConfig;
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
 private:
     // Edge list representation
-    std::vector<GraphDataType> edge_idx;
-    std::vector<GraphDataType> src_list;
-    std::vector<GraphDataType> dst_list;
-    std::vector<GraphDataType> time_list;
+    std::vector<EdgeType> edge_idx;
+    std::vector<NodeType> src_list;
+    std::vector<NodeType> dst_list;
+    std::vector<TimeType> time_list;
 
     // CSR representation
-    std::vector<GraphDataType> idx_values;
-    std::vector<GraphDataType> time_values;
-    std::vector<GraphDataType> indices;
-    std::vector<GraphDataType> indptr;
+    std::vector<EdgeType> idx_values;
+    std::vector<TimeType> time_values;
+    std::vector<NodeType> indices;
+    std::vector<EdgeType> indptr;
+
+    // Read-only views of the CSR arrays used by the samplers. They point either into the
+    // vectors above or into a memory-mapped binary snapshot (see load_csr_binary).
+    const EdgeType* csr_idx_values;
+    const TimeType* csr_time_values;
+    const NodeType* csr_indices;
+    const EdgeType* csr_indptr;
+    size_t csr_num_nodes;
+    size_t csr_num_edges;
+    std::shared_ptr<MappedFile> snapshot;
+
+    // Packed layout (see CsrLayout): the interleaved entries and the hub time index, where
+    // time_index_ptr[v]..time_index_ptr[v + 1] is the (possibly empty) index of node v
+    CsrLayout layout;
+    std::vector<PackedEdge<Types>> packed_edges;
+    std::vector<EdgeType> time_index_ptr;
+    std::vector<TimeType> time_index;
 
     // Maximum node ID
-    GraphDataType max_node_id;
+    NodeType max_node_id;
     // Flag to consider reverse edges
     bool reverse;
 
+    // Seed of the random strategies and number of sampling calls issued so far
+    uint64_t random_seed;
+    mutable std::atomic<uint64_t> batch_counter;
+    SampleParams sample_params;
+
+    void bind_csr_views();
+    uint64_t next_batch_id() const;
+
+    // The CSR views alias member storage, so graphs are not copyable
+    TemporalGraphT(const TemporalGraphT&) = delete;
+    TemporalGraphT& operator=(const TemporalGraphT&) = delete;
+
 public:
     // Constructors
-    TemporalGraph(bool reverse = false);
+    TemporalGraphT(bool reverse = false);
     // edge list Constructors
-    TemporalGraph(const std::vector<GraphDataType>& edge_idx, const std::vector<GraphDataType>& src_list,
-                  const std::vector<GraphDataType>& dst_list, const std::vector<GraphDataType>& time_list,
-                  bool reverse = false);
+    TemporalGraphT(const std::vector<EdgeType>& edge_idx, const std::vector<NodeType>& src_list,
+                   const std::vector<NodeType>& dst_list, const std::vector<TimeType>& time_list,
+                   bool reverse = false);
     // csr Constructors
-    TemporalGraph(const std::vector<GraphDataType>& idx_values, const std::vector<GraphDataType>& time_values,
-                  const std::vector<GraphDataType>& indices, const std::vector<GraphDataType>& indptr);
+    TemporalGraphT(const std::vector<EdgeType>& idx_values, const std::vector<TimeType>& time_values,
+                   const std::vector<NodeType>& indices, const std::vector<EdgeType>& indptr);
 
 
     // Destructor
-    ~TemporalGraph();
+    ~TemporalGraphT();
 
     // Method declarations
-    void add_edge(GraphDataType edge_idx, GraphDataType src, GraphDataType dst, GraphDataType time);
-    GraphDataType get_max_node_id() const;
+    void add_edge(EdgeType edge_idx, NodeType src, NodeType dst, TimeType time);
+    // Take over whole edge lists without copying them (e.g. from the generator)
+    void assign_edges(std::vector<EdgeType>&& edge_idx, std::vector<NodeType>&& src_list,
+                      std::vector<NodeType>&& dst_list, std::vector<TimeType>&& time_list);
+    NodeType get_max_node_id() const;
+    bool is_reverse() const { return reverse; }
+    // Random strategies are reproducible for a given seed and sequence of sampling calls,
+    // independent of the number of threads
+    void set_random_seed(uint64_t seed);
+    void set_sample_params(const SampleParams& params);
 
-    void to_csr();
+    // Read-only access to the T-CSR arrays
+    const EdgeType* get_indptr() const { return csr_indptr; }
+    const NodeType* get_indices() const { return csr_indices; }
+    const TimeType* get_time_values() const { return csr_time_values; }
+    const EdgeType* get_idx_values() const { return csr_idx_values; }
+    size_t get_num_nodes() const { return csr_num_nodes; }
+    size_t get_num_edges() const { return csr_num_edges; }
+
+    // Neighbor source interface of the sampler kernels (see sampler_kernels.h). Node ids outside
+    // [0, get_num_nodes()) have no neighbors, so sampling and get_neighbors return empty rows for them.
+    NeighborSlice<Types> neighbor_slice(NodeType node) const;
+    EdgeType degree(NodeType node) const;
+
+    void to_csr(CsrLayout layout = CSR_LAYOUT_SEPARATE);
+    // Build or drop the packed layout of the current T-CSR. Loading or assigning a T-CSR resets
+    // the layout to separate.
+    void set_layout(CsrLayout layout);
+    CsrLayout get_layout() const { return layout; }
+    // Take over an already built T-CSR (e.g. from an incremental merge)
+    void assign_csr(std::vector<EdgeType>&& idx_values, std::vector<TimeType>&& time_values,
+                    std::vector<NodeType>&& indices, std::vector<EdgeType>&& indptr, bool reverse);
     void save_csr(const string& idx_values_file_path, const string& time_values_file_path, const string& indices_file_path, const string& indptr_file_path) const;
-    void read_csr(const string& idx_values_file_path, const string& time_values_file_path, const string& indices_file_path, const string& indptr_file_path);
+    // Text CSR: false (leaving no T-CSR) if a file cannot be read or parsed completely, or the array
+    // lengths do not fit together; see csr_validator.h for the checks of the contents
+    bool read_csr(const string& idx_values_file_path, const string& time_values_file_path, const string& indices_file_path, const string& indptr_file_path);
+    // Binary snapshot: one versioned file loaded via mmap without parsing or copying. A snapshot
+    // only loads into the type configuration it was written with (see csr_snapshot_matches).
+    bool save_csr_binary(const string& file_path) const;
+    bool load_csr_binary(const string& file_path, bool verify_checksums = false);
 
-    void get_neighbors(GraphDataType node, GraphDataType time, vector<GraphDataType>& neighbors, vector<GraphDataType>& neighbor_times, vector<GraphDataType>& neighbor_idx, GraphDataType sample_num, const string& sample_strategy) const;
-    double sampling(const vector<GraphDataType>& batch_node_id, const vector<GraphDataType>& batch_node_time,
-                            vector<vector<GraphDataType>>& batch_neighbors, vector<vector<GraphDataType>>& batch_neighbor_times,
-                            vector<vector<GraphDataType>>& batch_neighbor_idx, GraphDataType sample_num = 32,
+    void get_neighbors(NodeType node, TimeType time, vector<NodeType>& neighbors, vector<TimeType>& neighbor_times, vector<EdgeType>& neighbor_idx, EdgeType sample_num, const string& sample_strategy) const;
+    double sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                            vector<vector<NodeType>>& batch_neighbors, vector<vector<TimeType>>& batch_neighbor_times,
+                            vector<vector<EdgeType>>& batch_neighbor_idx, EdgeType sample_num = 32,
                             const string& sample_strategy = "recent");
+    // Flat-buffer batch sampling: each output points to batch_size * sample_num entries and
+    // batch_counts to batch_size entries, laid out as described for SampleBuffers
+    double sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                         NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                         EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                         EdgeType sample_num = 32, const string& sample_strategy = "recent") const;
+    double sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                         NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                         EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                         EdgeType sample_num, SampleStrategy sample_strategy) const;
+    double sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                    SampleBuffers<Types>& buffers, EdgeType sample_num = 32, const string& sample_strategy = "recent") const;
+    double sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                    SampleBuffers<Types>& buffers, EdgeType sample_num, SampleStrategy sample_strategy) const;
     void print_csr_sizes() const;
 
 };
 
+// The TGN configuration is the default graph type
+typedef TemporalGraphT<TGNGraphTypes> TemporalGraph;
+
+// Whether a binary snapshot was written with the type configuration Types
+template <typename Types>
+inline bool csr_snapshot_matches(const CsrSnapshotHeader& header) {
+    bool float_time = (header.flags & CSR_FLAG_FLOAT_TIME) != 0;
+    return header.node_width == sizeof(typename Types::NodeType) && header.edge_width == sizeof(typename Types::EdgeType) &&
+           header.time_width == sizeof(typename Types::TimeType) && float_time == is_floating_point<typename Types::TimeType>::value;
+}
+
 #endif // TemporalGraph_H
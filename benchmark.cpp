@@ -0,0 +1,1450 @@
+// benchmark.cpp - Sampling benchmarks
+// g++ -O3 -fopenmp -std=c++11 benchmark.cpp TemporalGraph.cpp readcsv.cpp utils.cpp csr_snapshot.cpp simd_kernels.cpp multihop.cpp streaming_graph.cpp generator.cpp prefetch_sampler.cpp compressed_csr.cpp numa_sampler.cpp feature_store.cpp sharded_graph.cpp negative_sampler.cpp metrics.cpp -o benchmark
+#include <random>
+#include <unordered_set>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <memory>
+#include <unistd.h>
+#include "radix_sort.h"
+#include "parallel_scan.h"
+#include "generator.h"
+#include "TemporalGraph.h"
+#include "readcsv.h"
+#include "utils.h"
+#include "simd_kernels.h"
+#include "prefetch_sampler.h"
+#include "compressed_csr.h"
+#include "numa_sampler.h"
+#include "feature_store.h"
+#include "sharded_graph.h"
+#include "negative_sampler.h"
+#include "multihop.h"
+#include "metrics.h"
+
+typedef TemporalGraph::NodeType NodeType;
+typedef TemporalGraph::EdgeType EdgeType;
+typedef TemporalGraph::TimeType TimeType;
+
+// The "random" strategy as it was implemented before the counter-based sampler: a fresh
+// random_device/mt19937 per query, a copy of the whole pre-time history and rejection sampling.
+static void legacy_random_neighbors(const TemporalGraph& tg, NodeType node, TimeType time, EdgeType sample_num,
+                                    vector<NodeType>& neighbors, vector<TimeType>& neighbor_times, vector<EdgeType>& neighbor_idx) {
+    neighbors.clear();
+    neighbor_times.clear();
+    neighbor_idx.clear();
+    const EdgeType* indptr = tg.get_indptr();
+    const TimeType* time_values = tg.get_time_values();
+    EdgeType start = indptr[node];
+    EdgeType left = start;
+    EdgeType right = indptr[node + 1] - 1;
+    while (left <= right) {
+        EdgeType mid = left + (right - left) / 2;
+        if (time_values[mid] >= time) {
+            right = mid - 1;
+        } else {
+            left = mid + 1;
+        }
+    }
+    if (left == start) {
+        return;
+    }
+
+    vector<NodeType> temp_neighbors(tg.get_indices() + start, tg.get_indices() + left);
+    vector<TimeType> temp_neighbor_times(time_values + start, time_values + left);
+    vector<EdgeType> temp_neighbor_idx(tg.get_idx_values() + start, tg.get_idx_values() + left);
+
+    random_device rd;
+    mt19937 gen(rd());
+    uniform_int_distribution<> dis(0, temp_neighbors.size() - 1);
+    unordered_set<EdgeType> sampled_indices;
+    while (sampled_indices.size() < static_cast<size_t>(min(sample_num, static_cast<EdgeType>(temp_neighbors.size())))) {
+        sampled_indices.insert(dis(gen));
+    }
+    for (EdgeType index : sampled_indices) {
+        neighbors.push_back(temp_neighbors[index]);
+        neighbor_times.push_back(temp_neighbor_times[index]);
+        neighbor_idx.push_back(temp_neighbor_idx[index]);
+    }
+}
+
+// Roots of a batch: sources of randomly chosen edges, queried at their edge time
+static void make_batch(const vector<NodeType>& src_list, const vector<TimeType>& time_list, size_t batch_size,
+                       mt19937_64& gen, vector<NodeType>& batch_node_id, vector<TimeType>& batch_node_time) {
+    uniform_int_distribution<size_t> dis(0, src_list.size() - 1);
+    batch_node_id.resize(batch_size);
+    batch_node_time.resize(batch_size);
+    for (size_t b = 0; b < batch_size; ++b) {
+        size_t e = dis(gen);
+        batch_node_id[b] = src_list[e];
+        batch_node_time[b] = time_list[e];
+    }
+}
+
+// Edge list and T-CSR graph of a dataset read with the TGN types, and the root batches the
+// comparison modes sample
+struct BenchSetup {
+    vector<EdgeType> edge_idx;
+    vector<NodeType> src_list, dst_list;
+    vector<TimeType> time_list;
+    unique_ptr<TemporalGraph> graph;
+    mt19937_64 gen;
+    vector<NodeType> batch_node_id;
+    vector<TimeType> batch_node_time;
+
+    BenchSetup() : gen(1) {}
+
+    // False if the file cannot be read with the TGN types or has no edges
+    bool load(const string& file_path, bool reverse = false) {
+        if (read_csv_file_parallel<TGNGraphTypes>(file_path, edge_idx, src_list, dst_list, time_list) != CSV_READ_OK || src_list.empty()) {
+            return false;
+        }
+        graph.reset(new TemporalGraph(edge_idx, src_list, dst_list, time_list, reverse));
+        graph->to_csr();
+        return true;
+    }
+
+    // Draw the next batch of roots into batch_node_id and batch_node_time
+    void next_batch(size_t batch_size) {
+        make_batch(src_list, time_list, batch_size, gen, batch_node_id, batch_node_time);
+    }
+};
+
+// Whether two samplers drew the same rows. The comparison modes reset both to the same seed and
+// run the same number of batches, so their last batches share a batch id and random streams.
+static bool same_samples(const SampleBuffers<TGNGraphTypes>& a, const SampleBuffers<TGNGraphTypes>& b) {
+    return a.neighbors == b.neighbors && a.neighbor_times == b.neighbor_times && a.neighbor_idx == b.neighbor_idx &&
+           a.counts == b.counts;
+}
+
+// Compare the counter-based "random" strategy with the legacy implementation
+static int bench_random(const string& file_path, EdgeType sample_num, size_t batch_size, int iterations) {
+    BenchSetup setup;
+    if (!setup.load(file_path)) {
+        return 1;
+    }
+    TemporalGraph& tg = *setup.graph;
+
+    setup.next_batch(batch_size);
+
+    // Legacy path
+    vector<vector<NodeType>> batch_neighbors(batch_size);
+    vector<vector<TimeType>> batch_neighbor_times(batch_size);
+    vector<vector<EdgeType>> batch_neighbor_idx(batch_size);
+    double legacy_time = 0;
+    for (int i = 0; i < iterations; ++i) {
+        double start_time = omp_get_wtime();
+        #pragma omp parallel for
+        for (size_t b = 0; b < batch_size; ++b) {
+            legacy_random_neighbors(tg, setup.batch_node_id[b], setup.batch_node_time[b], sample_num,
+                                    batch_neighbors[b], batch_neighbor_times[b], batch_neighbor_idx[b]);
+        }
+        legacy_time += omp_get_wtime() - start_time;
+    }
+
+    // Counter-based path, checked for reproducibility across thread counts
+    SampleBuffers<TGNGraphTypes> buffers;
+    double new_time = 0;
+    for (int i = 0; i < iterations; ++i) {
+        new_time += tg.sampling(setup.batch_node_id, setup.batch_node_time, buffers, sample_num, "random");
+    }
+    tg.set_random_seed(DEFAULT_RANDOM_SEED);
+    tg.sampling(setup.batch_node_id, setup.batch_node_time, buffers, sample_num, "random");
+    vector<EdgeType> reference = buffers.neighbor_idx;
+    int max_threads = omp_get_max_threads();
+    omp_set_num_threads(max(1, max_threads / 2));
+    tg.set_random_seed(DEFAULT_RANDOM_SEED);
+    tg.sampling(setup.batch_node_id, setup.batch_node_time, buffers, sample_num, "random");
+    omp_set_num_threads(max_threads);
+    bool reproducible = equal(reference.begin(), reference.end(), buffers.neighbor_idx.begin());
+
+    cout << "legacy random sampling: " << legacy_time / iterations << " s per batch" << endl;
+    cout << "counter-based random sampling: " << new_time / iterations << " s per batch" << endl;
+    cout << "speedup: " << (new_time > 0 ? legacy_time / new_time : 0) << "x" << endl;
+    cout << "reproducible across thread counts: " << (reproducible ? "yes" : "no") << endl;
+    return reproducible ? 0 : 1;
+}
+
+// Cutoff search as it was implemented before the SIMD kernels
+static EdgeType binary_search_cutoff(const NeighborSlice<TGNGraphTypes>& slice, TimeType time) {
+    EdgeType left = 0;
+    EdgeType right = slice.length - 1;
+    while (left <= right) {
+        EdgeType mid = left + (right - left) / 2;
+        if (slice.time_values[mid] >= time) {
+            right = mid - 1;
+        } else {
+            left = mid + 1;
+        }
+    }
+    return left;
+}
+
+// Compare the cutoff search and the gather of sampled entries at every supported SIMD level with
+// the scalar code they replaced, on single-threaded loops over the same batch
+static int bench_kernels(const string& file_path, EdgeType sample_num, size_t batch_size, int iterations) {
+    BenchSetup setup;
+    if (!setup.load(file_path, true)) {
+        return 1;
+    }
+    TemporalGraph& tg = *setup.graph;
+
+    setup.next_batch(batch_size);
+
+    // Uniform positions before the cutoff of every root, as the random strategy draws them
+    vector<NeighborSlice<TGNGraphTypes>> slices(batch_size);
+    vector<EdgeType> row_counts(batch_size);
+    vector<EdgeType> positions(batch_size * sample_num);
+    for (size_t b = 0; b < batch_size; ++b) {
+        slices[b] = tg.neighbor_slice(setup.batch_node_id[b]);
+        EdgeType cutoff = binary_search_cutoff(slices[b], setup.batch_node_time[b]);
+        row_counts[b] = min(sample_num, cutoff);
+        CounterRng rng(DEFAULT_RANDOM_SEED, b);
+        if (row_counts[b] > 0) {
+            sample_positions(rng, static_cast<EdgeType>(0), cutoff, row_counts[b], &positions[b * sample_num]);
+        }
+    }
+    vector<NodeType> neighbors(batch_size * sample_num);
+    vector<TimeType> neighbor_times(batch_size * sample_num);
+    vector<EdgeType> neighbor_idx(batch_size * sample_num);
+
+    double start_time = omp_get_wtime();
+    long long checksum = 0;
+    for (int i = 0; i < iterations; ++i) {
+        for (size_t b = 0; b < batch_size; ++b) {
+            checksum += binary_search_cutoff(slices[b], setup.batch_node_time[b]);
+        }
+    }
+    double search_baseline = omp_get_wtime() - start_time;
+    start_time = omp_get_wtime();
+    for (int i = 0; i < iterations; ++i) {
+        for (size_t b = 0; b < batch_size; ++b) {
+            const EdgeType* row = &positions[b * sample_num];
+            for (EdgeType k = 0; k < row_counts[b]; ++k) {
+                neighbors[b * sample_num + k] = slices[b].indices[row[k]];
+                neighbor_times[b * sample_num + k] = slices[b].time_values[row[k]];
+                neighbor_idx[b * sample_num + k] = slices[b].idx_values[row[k]];
+            }
+        }
+    }
+    double gather_baseline = omp_get_wtime() - start_time;
+    double queries = static_cast<double>(batch_size) * iterations;
+    cout << "baseline: search " << 1e9 * search_baseline / queries << " ns/root, gather "
+         << 1e9 * gather_baseline / queries << " ns/root" << endl;
+
+    SimdLevel detected = detected_simd_level();
+    int status = 0;
+    for (int level = SIMD_SCALAR; level <= detected; ++level) {
+        set_simd_level(static_cast<SimdLevel>(level));
+        long long level_checksum = 0;
+        start_time = omp_get_wtime();
+        for (int i = 0; i < iterations; ++i) {
+            for (size_t b = 0; b < batch_size; ++b) {
+                level_checksum += slice_cutoff(slices[b], setup.batch_node_time[b]);
+            }
+        }
+        double search_time = omp_get_wtime() - start_time;
+        start_time = omp_get_wtime();
+        for (int i = 0; i < iterations; ++i) {
+            for (size_t b = 0; b < batch_size; ++b) {
+                const EdgeType* row = &positions[b * sample_num];
+                simd_gather(slices[b].indices, row, row_counts[b], &neighbors[b * sample_num]);
+                simd_gather(slices[b].time_values, row, row_counts[b], &neighbor_times[b * sample_num]);
+                simd_gather(slices[b].idx_values, row, row_counts[b], &neighbor_idx[b * sample_num]);
+            }
+        }
+        double gather_time = omp_get_wtime() - start_time;
+        cout << simd_level_name(static_cast<SimdLevel>(level)) << ": search " << 1e9 * search_time / queries << " ns/root ("
+             << (search_time > 0 ? search_baseline / search_time : 0) << "x), gather " << 1e9 * gather_time / queries
+             << " ns/root (" << (gather_time > 0 ? gather_baseline / gather_time : 0) << "x)"
+             << (level_checksum == checksum ? "" : ", MISMATCH") << endl;
+        status = level_checksum == checksum ? status : 1;
+    }
+    set_simd_level(detected);
+    return status;
+}
+
+// Hash of the sampled edge ids, to check that both loops sampled the same neighbors
+static uint64_t buffers_checksum(const SampleBuffers<TGNGraphTypes>& buffers) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < buffers.neighbor_idx.size(); ++i) {
+        sum = sum * 31 + static_cast<uint64_t>(buffers.neighbor_idx[i]);
+    }
+    return sum;
+}
+
+/*
+Replay the last 30% of the edges as chronological minibatches, with compute_ms of simulated model
+compute (a sleep, as for a GPU step) per batch, once sampling synchronously and once through a
+PrefetchSampler of the given depth
+*/
+static int bench_prefetch(const string& file_path, EdgeType sample_num, size_t batch_size, double compute_ms, size_t depth) {
+    BenchSetup setup;
+    if (!setup.load(file_path)) {
+        return 1;
+    }
+    TemporalGraph& tg = *setup.graph;
+    const vector<NodeType>& src_list = setup.src_list;
+    const vector<NodeType>& dst_list = setup.dst_list;
+    const vector<TimeType>& time_list = setup.time_list;
+    size_t first_edge = src_list.size() * 7 / 10;
+    chrono::microseconds compute(static_cast<int64_t>(compute_ms * 1000));
+
+    tg.set_random_seed(DEFAULT_RANDOM_SEED);
+    PrefetchSampler::BatchSource source = chronological_edge_batches<TGNGraphTypes>(src_list, dst_list, time_list, batch_size, first_edge);
+    vector<NodeType> roots;
+    vector<TimeType> root_times;
+    SampleBuffers<TGNGraphTypes> buffers;
+    uint64_t sync_checksum = 0;
+    size_t num_batches = 0;
+    double sync_sample_time = 0;
+    double start_time = omp_get_wtime();
+    while (source(roots, root_times)) {
+        sync_sample_time += tg.sampling(roots, root_times, buffers, sample_num, SAMPLE_RECENT);
+        sync_checksum ^= buffers_checksum(buffers);
+        this_thread::sleep_for(compute);
+        num_batches++;
+    }
+    double sync_time = omp_get_wtime() - start_time;
+
+    tg.set_random_seed(DEFAULT_RANDOM_SEED);
+    uint64_t prefetch_checksum = 0;
+    PrefetchStats stats;
+    start_time = omp_get_wtime();
+    {
+        PrefetchSampler sampler(tg, chronological_edge_batches<TGNGraphTypes>(src_list, dst_list, time_list, batch_size, first_edge),
+                                sample_num, SAMPLE_RECENT, depth);
+        while (const PrefetchedBatch<TGNGraphTypes>* batch = sampler.next()) {
+            prefetch_checksum ^= buffers_checksum(batch->buffers);
+            this_thread::sleep_for(compute);
+        }
+        stats = sampler.stats();
+    }
+    double prefetch_time = omp_get_wtime() - start_time;
+
+    cout << "batches: " << num_batches << ", sampling " << sync_sample_time / max<size_t>(num_batches, 1) * 1e3
+         << " ms and compute " << compute_ms << " ms per batch" << endl;
+    cout << "synchronous: " << sync_time << " s" << endl;
+    cout << "prefetch depth " << depth << ": " << prefetch_time << " s (speedup " << (prefetch_time > 0 ? sync_time / prefetch_time : 0) << "x)" << endl;
+    cout << "  consumer waited " << stats.consumer_stalls << " times, " << stats.consumer_wait_seconds << " s" << endl;
+    cout << "  producer waited " << stats.producer_stalls << " times, " << stats.producer_wait_seconds << " s" << endl;
+    cout << "  max queue depth " << stats.max_queue_depth << endl;
+    bool same = sync_checksum == prefetch_checksum && stats.batches_consumed == num_batches;
+    cout << "same samples: " << (same ? "yes" : "no") << endl;
+    return same ? 0 : 1;
+}
+
+// Compare the compressed T-CSR with the uncompressed one: size, build time and sampling throughput
+static int bench_compressed(const string& file_path, EdgeType sample_num, size_t batch_size, int iterations) {
+    BenchSetup setup;
+    if (!setup.load(file_path)) {
+        return 1;
+    }
+    TemporalGraph& tg = *setup.graph;
+
+    CompressedTemporalGraph compressed;
+    double compress_time = compressed.compress(tg);
+    cout << "T-CSR: " << compressed.uncompressed_bytes() / 1e6 << " MB, compressed: " << compressed.compressed_bytes() / 1e6
+         << " MB (ratio " << static_cast<double>(compressed.uncompressed_bytes()) / compressed.compressed_bytes()
+         << "x), built in " << compress_time << " s" << endl;
+
+    setup.next_batch(batch_size);
+
+    const char* strategies[] = {"recent", "random", "inverse_degree"};
+    SampleBuffers<TGNGraphTypes> buffers, compressed_buffers;
+    int status = 0;
+    for (const char* strategy : strategies) {
+        tg.set_random_seed(DEFAULT_RANDOM_SEED);
+        compressed.set_random_seed(DEFAULT_RANDOM_SEED);
+        double uncompressed_time = 0;
+        double compressed_time = 0;
+        bool same = true;
+        for (int i = 0; i < iterations; ++i) {
+            uncompressed_time += tg.sampling(setup.batch_node_id, setup.batch_node_time, buffers, sample_num, strategy);
+            compressed_time += compressed.sampling(setup.batch_node_id, setup.batch_node_time, compressed_buffers, sample_num, strategy);
+            same = same && same_samples(buffers, compressed_buffers);
+        }
+        double roots = static_cast<double>(batch_size) * iterations;
+        cout << strategy << ": uncompressed " << roots / uncompressed_time << " roots/s, compressed " << roots / compressed_time
+             << " roots/s (" << (compressed_time > 0 ? uncompressed_time / compressed_time : 0) << "x)"
+             << (same ? "" : ", MISMATCH") << endl;
+        status = same ? status : 1;
+    }
+
+    // Round trip through a compressed T-CSR file: the mapped copy samples like the built one
+    char temp_template[] = "/tmp/tgcompressed_XXXXXX";
+    if (mkdtemp(temp_template) == nullptr) {
+        cerr << "Failed to create a temporary directory" << endl;
+        return 1;
+    }
+    string saved_path = string(temp_template) + "/graph.tcsrz";
+    CompressedTemporalGraph loaded;
+    bool same = compressed.save(saved_path) && loaded.load(saved_path, true);
+    if (same) {
+        for (const char* strategy : strategies) {
+            compressed.set_random_seed(DEFAULT_RANDOM_SEED);
+            loaded.set_random_seed(DEFAULT_RANDOM_SEED);
+            compressed.sampling(setup.batch_node_id, setup.batch_node_time, buffers, sample_num, strategy);
+            loaded.sampling(setup.batch_node_id, setup.batch_node_time, compressed_buffers, sample_num, strategy);
+            same = same && same_samples(buffers, compressed_buffers);
+        }
+    }
+    remove(saved_path.c_str());
+    rmdir(temp_template);
+    cout << "saved and loaded: " << (same ? "same samples" : "MISMATCH") << endl;
+    return same ? status : 1;
+}
+
+// Sampling throughput with the T-CSR placed by mode on 1, 2, ... sockets, checked against graph.sampling
+static int bench_numa(const string& file_path, EdgeType sample_num, size_t batch_size, int iterations, const string& mode_name) {
+    NumaOptions options;
+    if (!parse_numa_mode(mode_name, options.mode)) {
+        cerr << "Unknown NUMA mode " << mode_name << endl;
+        return 1;
+    }
+    BenchSetup setup;
+    if (!setup.load(file_path)) {
+        return 1;
+    }
+    TemporalGraph& tg = *setup.graph;
+
+    NumaTopology topology = detect_numa_topology();
+    for (size_t s = 0; s < topology.num_nodes(); ++s) {
+        cout << "NUMA node " << topology.nodes[s] << ": " << topology.cpus[s].size() << " CPUs" << endl;
+    }
+
+    setup.next_batch(batch_size);
+
+    const char* strategies[] = {"recent", "random"};
+    int status = 0;
+    for (const char* strategy : strategies) {
+        SampleBuffers<TGNGraphTypes> expected, buffers;
+        tg.set_random_seed(DEFAULT_RANDOM_SEED);
+        double graph_time = 0;
+        for (int i = 0; i < iterations; ++i) {
+            graph_time += tg.sampling(setup.batch_node_id, setup.batch_node_time, expected, sample_num, strategy);
+        }
+        double roots = static_cast<double>(batch_size) * iterations;
+        cout << strategy << ": TemporalGraph " << roots / graph_time << " roots/s" << endl;
+
+        double one_socket_rate = 0;
+        for (size_t sockets = 1; sockets <= topology.num_nodes(); ++sockets) {
+            options.sockets = sockets;
+            NumaSampler sampler(tg, options);
+            vector<size_t> pages = numa_page_counts(sampler.get_topology(), tg.get_indices(), tg.get_num_edges() * sizeof(NodeType));
+            double numa_time = 0;
+            for (int i = 0; i < iterations; ++i) {
+                numa_time += sampler.sampling(setup.batch_node_id, setup.batch_node_time, buffers, sample_num, strategy);
+            }
+            bool same = same_samples(buffers, expected);
+            double rate = roots / numa_time;
+            one_socket_rate = sockets == 1 ? rate : one_socket_rate;
+            NumaStats stats = sampler.stats();
+            cout << "  " << mode_name << " on " << sockets << " socket(s), " << sampler.num_threads() << " threads: " << rate
+                 << " roots/s (" << rate / one_socket_rate << "x of one socket), local rows " << stats.local_rows << ", remote rows "
+                 << stats.remote_rows << ", indices pages per socket";
+            for (size_t count : pages) {
+                cout << " " << count;
+            }
+            cout << (sampler.get_placement_failures() ? ", placement failed" : "") << (same ? "" : ", MISMATCH") << endl;
+            status = same ? status : 1;
+        }
+    }
+    return status;
+}
+
+// Sampling throughput of the graph split into 1, 2, 4, ... shards served by local processes,
+// checked against graph.sampling
+static int bench_shards(const string& file_path, EdgeType sample_num, size_t batch_size, int iterations, size_t max_shards,
+                        const string& mode_name) {
+    ShardMode mode;
+    if (!parse_shard_mode(mode_name, mode)) {
+        cerr << "Unknown shard mode " << mode_name << endl;
+        return 1;
+    }
+    BenchSetup setup;
+    if (!setup.load(file_path)) {
+        return 1;
+    }
+    TemporalGraph& tg = *setup.graph;
+
+    char temp_template[] = "/tmp/tgshards_XXXXXX";
+    if (mkdtemp(temp_template) == nullptr) {
+        cerr << "Failed to create a temporary directory" << endl;
+        return 1;
+    }
+    string temp_dir = temp_template;
+
+    setup.next_batch(batch_size);
+    double roots = static_cast<double>(batch_size) * iterations;
+
+    const char* strategies[] = {"recent", "random", "inverse_degree"};
+    vector<SampleBuffers<TGNGraphTypes>> expected(3);
+    for (size_t k = 0; k < 3; ++k) {
+        tg.set_random_seed(DEFAULT_RANDOM_SEED);
+        double graph_time = 0;
+        for (int i = 0; i < iterations; ++i) {
+            graph_time += tg.sampling(setup.batch_node_id, setup.batch_node_time, expected[k], sample_num, strategies[k]);
+        }
+        cout << strategies[k] << ": TemporalGraph " << roots / graph_time << " roots/s" << endl;
+    }
+
+    // status is 1 once a shard fails; a mismatch is reported and the remaining shard counts still run
+    int status = 0;
+    bool all_same = true;
+    for (size_t num_shards = 1; num_shards <= max_shards && status == 0; num_shards *= 2) {
+        string manifest_path = temp_dir + "/graph.shards";
+        LocalShardProcesses processes;
+        ShardedSampler sampler;
+        size_t threads_per_shard = max<size_t>(1, static_cast<size_t>(omp_get_max_threads()) / num_shards);
+        if (!partition_temporal_graph(tg, manifest_path, num_shards, mode) ||
+            !processes.launch(manifest_path, temp_dir, threads_per_shard) ||
+            !sampler.connect(manifest_path, processes.get_socket_paths())) {
+            status = 1;
+            break;
+        }
+        for (size_t k = 0; k < 3 && status == 0; ++k) {
+            SampleBuffers<TGNGraphTypes> buffers;
+            sampler.set_random_seed(DEFAULT_RANDOM_SEED);
+            sampler.reset_stats();
+            double sharded_time = 0;
+            for (int i = 0; i < iterations && status == 0; ++i) {
+                double time = sampler.sampling(setup.batch_node_id, setup.batch_node_time, buffers, sample_num, strategies[k]);
+                status = time < 0 ? 1 : 0;
+                sharded_time += time;
+            }
+            if (status != 0) {
+                break;
+            }
+            bool same = same_samples(buffers, expected[k]);
+            ShardedStats stats = sampler.stats();
+            cout << "  " << strategies[k] << " on " << num_shards << " " << mode_name << " shard(s), " << threads_per_shard
+                 << " threads each: " << roots / sharded_time << " roots/s, " << (stats.bytes_sent + stats.bytes_received) / roots
+                 << " bytes per root, rows per shard";
+            for (uint64_t count : stats.rows_per_shard) {
+                cout << " " << count;
+            }
+            cout << (same ? "" : ", MISMATCH") << endl;
+            all_same = all_same && same;
+        }
+        sampler.shutdown();
+        processes.stop();
+        const ShardManifest& manifest = sampler.get_manifest();
+        for (const ShardInfo& shard : manifest.shards) {
+            remove(shard_file_path(manifest_path, shard.file).c_str());
+        }
+        remove(shard_file_path(manifest_path, manifest.degrees_file).c_str());
+        remove(manifest_path.c_str());
+    }
+    rmdir(temp_dir.c_str());
+    return all_same ? status : 1;
+}
+
+// Negative sampling over chronological batches of positive edges: throughput, true edges among the
+// filtered negatives, independence of the thread count, and one-pass link batches against
+// sampling the same roots separately
+static int bench_negatives(const string& file_path, EdgeType sample_num, size_t batch_size, int iterations,
+                           const string& strategy_name) {
+    NegativeOptions options;
+    if (!parse_negative_strategy(strategy_name, options.strategy)) {
+        cerr << "Unknown negative strategy " << strategy_name << endl;
+        return 1;
+    }
+    BenchSetup setup;
+    if (!setup.load(file_path)) {
+        return 1;
+    }
+    TemporalGraph& tg = *setup.graph;
+    const vector<NodeType>& src_list = setup.src_list;
+    const vector<NodeType>& dst_list = setup.dst_list;
+    const vector<TimeType>& time_list = setup.time_list;
+
+    // Every true (src, dst, time) edge, to check the filter independently of the T-CSR
+    unordered_set<uint64_t> true_edges;
+    for (size_t e = 0; e < src_list.size(); ++e) {
+        true_edges.insert(mix64(static_cast<uint64_t>(src_list[e]) * 0x9E3779B97F4A7C15ULL ^ static_cast<uint64_t>(dst_list[e])) ^
+                          static_cast<uint64_t>(hash<TimeType>()(time_list[e])));
+    }
+    auto is_true_edge = [&](NodeType src, NodeType dst, TimeType time) {
+        return true_edges.count(mix64(static_cast<uint64_t>(src) * 0x9E3779B97F4A7C15ULL ^ static_cast<uint64_t>(dst)) ^
+                                static_cast<uint64_t>(hash<TimeType>()(time))) > 0;
+    };
+
+    // Consecutive batches of the edges from 70% of the stream on
+    size_t first_edge = src_list.size() * 7 / 10;
+    batch_size = min(batch_size, src_list.size() - first_edge);
+    size_t num_batches = max<size_t>(1, min<size_t>(static_cast<size_t>(iterations), (src_list.size() - first_edge) / max<size_t>(batch_size, 1)));
+    double positives = static_cast<double>(batch_size) * num_batches;
+
+    int status = 0;
+    for (int filter = 0; filter < 2; ++filter) {
+        options.filter_true_edges = filter == 1;
+        NegativeSampler sampler(tg, options);
+        vector<NodeType> negatives(batch_size), again(batch_size);
+        double time = 0;
+        size_t true_negatives = 0;
+        bool same = true;
+        for (size_t i = 0; i < num_batches; ++i) {
+            size_t begin = first_edge + i * batch_size;
+            time += sampler.sample_negatives(src_list.data() + begin, dst_list.data() + begin, time_list.data() + begin, batch_size,
+                                             negatives.data());
+            for (size_t k = 0; k < batch_size; ++k) {
+                true_negatives += negatives[k] == dst_list[begin + k] || is_true_edge(src_list[begin + k], negatives[k], time_list[begin + k]);
+            }
+            // The same batch with another thread count draws the same negatives
+            if (i == 0) {
+                int max_threads = omp_get_max_threads();
+                NegativeSampler other(tg, options);
+                omp_set_num_threads(max_threads + 2);
+                other.sample_negatives(src_list.data() + begin, dst_list.data() + begin, time_list.data() + begin, batch_size, again.data());
+                omp_set_num_threads(max_threads);
+                same = again == negatives;
+            }
+        }
+        NegativeStats stats = sampler.stats();
+        cout << strategy_name << (options.filter_true_edges ? ", filtered" : "") << ": " << positives / time << " negatives/s, "
+             << stats.rejected << " draws rejected, " << stats.fallbacks << " fallbacks, " << stats.unfiltered << " unfiltered, "
+             << true_negatives << " true edges among " << stats.negatives << " negatives"
+             << (same ? "" : ", MISMATCH across thread counts") << endl;
+        status = same ? status : 1;
+    }
+
+    // Link batches: sources, destinations and negatives sampled in one call, against drawing the
+    // negatives and sampling the assembled roots in a second step. The two run as separate passes,
+    // so neither reads adjacency the other just brought into cache.
+    options.filter_true_edges = true;
+    NegativeSampler sampler(tg, options);
+    LinkBatch<TGNGraphTypes> batch;
+    vector<NodeType> link_roots;
+    uint64_t link_checksum = 0;
+    tg.set_random_seed(DEFAULT_RANDOM_SEED);
+    double link_time = 0;
+    for (size_t i = 0; i < num_batches; ++i) {
+        size_t begin = first_edge + i * batch_size;
+        link_time += sampler.sample_link_batch(src_list.data() + begin, dst_list.data() + begin, time_list.data() + begin, batch_size,
+                                               batch, sample_num, SAMPLE_RECENT);
+        link_roots.insert(link_roots.end(), batch.roots.begin(), batch.roots.end());
+        link_checksum = link_checksum * 31 + buffers_checksum(batch.samples);
+    }
+
+    NegativeSampler separate_sampler(tg, options);
+    SampleBuffers<TGNGraphTypes> buffers;
+    vector<NodeType> negatives(batch_size), roots, separate_roots;
+    vector<TimeType> root_times;
+    uint64_t separate_checksum = 0;
+    tg.set_random_seed(DEFAULT_RANDOM_SEED);
+    double separate_time = 0;
+    for (size_t i = 0; i < num_batches; ++i) {
+        size_t begin = first_edge + i * batch_size;
+        double start_time = omp_get_wtime();
+        separate_sampler.sample_negatives(src_list.data() + begin, dst_list.data() + begin, time_list.data() + begin, batch_size,
+                                          negatives.data());
+        roots.assign(src_list.begin() + begin, src_list.begin() + begin + batch_size);
+        roots.insert(roots.end(), dst_list.begin() + begin, dst_list.begin() + begin + batch_size);
+        roots.insert(roots.end(), negatives.begin(), negatives.end());
+        root_times.assign(time_list.begin() + begin, time_list.begin() + begin + batch_size);
+        for (int part = 0; part < 2; ++part) {
+            root_times.insert(root_times.end(), time_list.begin() + begin, time_list.begin() + begin + batch_size);
+        }
+        tg.sampling(roots, root_times, buffers, sample_num, SAMPLE_RECENT);
+        separate_time += omp_get_wtime() - start_time;
+        separate_roots.insert(separate_roots.end(), roots.begin(), roots.end());
+        separate_checksum = separate_checksum * 31 + buffers_checksum(buffers);
+    }
+    bool same = link_roots == separate_roots && link_checksum == separate_checksum;
+    cout << "link batches of " << batch_size << " edges: one pass " << positives / link_time << " edges/s, separate "
+         << positives / separate_time << " edges/s" << (same ? "" : ", MISMATCH") << endl;
+    status = same ? status : 1;
+
+    // Independence of the source's sample: a historical negative of edge k should hit the first
+    // random neighbor sampled for its source row k no more often than under an unrelated seed.
+    // Graph and sampler start at the same seed and batch id, the setting where shared streams
+    // would correlate them.
+    options.strategy = NEGATIVE_HISTORICAL;
+    options.filter_true_edges = false;
+    size_t coincidences[2] = {0, 0};
+    for (int unrelated = 0; unrelated < 2; ++unrelated) {
+        NegativeSampler historical(tg, options);
+        historical.set_random_seed(unrelated ? DEFAULT_RANDOM_SEED ^ 0x5A5A5A5AULL : DEFAULT_RANDOM_SEED);
+        tg.set_random_seed(DEFAULT_RANDOM_SEED);
+        for (size_t i = 0; i < num_batches; ++i) {
+            size_t begin = first_edge + i * batch_size;
+            historical.sample_link_batch(src_list.data() + begin, dst_list.data() + begin, time_list.data() + begin, batch_size,
+                                         batch, sample_num, SAMPLE_RANDOM);
+            for (size_t k = 0; k < batch_size; ++k) {
+                coincidences[unrelated] += batch.samples.counts[k] > 0 &&
+                                           batch.negatives()[k * options.num_negatives] == batch.samples.neighbors[k * sample_num];
+            }
+        }
+    }
+    // Allow four standard deviations of the unrelated count
+    bool independent = coincidences[0] <= coincidences[1] + 4 * sqrt(static_cast<double>(coincidences[1]) + 1) + 8;
+    cout << "historical negatives equal to the source's first sampled neighbor: " << coincidences[0] << " (unrelated seed "
+         << coincidences[1] << ")" << (independent ? "" : ", CORRELATED") << endl;
+    return independent ? status : 1;
+}
+
+// Reference (node, time) table of a hop: rows in order of first occurrence, built serially
+static void reference_table(const NodeType* nodes, const TimeType* times, size_t n, vector<NodeType>& unique_nodes,
+                            vector<TimeType>& unique_times, EdgeType* rows) {
+    unordered_map<pair<NodeType, TimeType>, EdgeType, NodeTimeHash<NodeType, TimeType>> table;
+    unique_nodes.clear();
+    unique_times.clear();
+    for (size_t i = 0; i < n; ++i) {
+        auto inserted = table.emplace(make_pair(nodes[i], times[i]), static_cast<EdgeType>(unique_nodes.size()));
+        if (inserted.second) {
+            unique_nodes.push_back(nodes[i]);
+            unique_times.push_back(times[i]);
+        }
+        rows[i] = inserted.first->second;
+    }
+}
+
+static bool same_block(const TemporalBlock<TGNGraphTypes>& a, const TemporalBlock<TGNGraphTypes>& b) {
+    return a.dst_nodes == b.dst_nodes && a.dst_times == b.dst_times && a.src_nodes == b.src_nodes && a.src_times == b.src_times &&
+           a.edge_src == b.edge_src && a.edge_dst == b.edge_dst && a.edge_idx == b.edge_idx && a.edge_times == b.edge_times;
+}
+
+// Compare MultiHopSampler with the same hops run as one sampling call each and deduplicated serially
+static int bench_multihop(const string& file_path, const vector<int>& fanouts, size_t batch_size, int iterations,
+                          const string& strategy) {
+    if (parse_sample_strategy(strategy) == SAMPLE_NONE) {
+        cerr << "Unknown sampling strategy " << strategy << endl;
+        return 1;
+    }
+    BenchSetup setup;
+    if (!setup.load(file_path)) {
+        return 1;
+    }
+    TemporalGraph& tg = *setup.graph;
+
+    MultiHopSampler sampler(tg, fanouts, strategy);
+    vector<TemporalBlock<TGNGraphTypes>> blocks, reference(fanouts.size());
+    vector<EdgeType> root_rows, reference_rows;
+    SampleBuffers<TGNGraphTypes> buffers;
+    vector<NodeType> neighbor_nodes;
+    vector<size_t> frontier(fanouts.size(), 0);
+    double multihop_time = 0, reference_time = 0;
+    bool same = true;
+    for (int i = 0; i < iterations; ++i) {
+        setup.next_batch(batch_size);
+        tg.set_random_seed(DEFAULT_RANDOM_SEED + i);
+        multihop_time += sampler.sample(setup.batch_node_id, setup.batch_node_time, blocks, root_rows);
+
+        // The same hops with the same seed, one sampling call per hop
+        tg.set_random_seed(DEFAULT_RANDOM_SEED + i);
+        double start_time = omp_get_wtime();
+        reference_rows.resize(batch_size);
+        reference_table(setup.batch_node_id.data(), setup.batch_node_time.data(), batch_size,
+                        reference[0].dst_nodes, reference[0].dst_times, reference_rows.data());
+        for (size_t l = 0; l < fanouts.size(); ++l) {
+            TemporalBlock<TGNGraphTypes>& block = reference[l];
+            if (l > 0) {
+                block.dst_nodes = reference[l - 1].src_nodes;
+                block.dst_times = reference[l - 1].src_times;
+            }
+            tg.sampling(block.dst_nodes, block.dst_times, buffers, fanouts[l], strategy);
+            neighbor_nodes.clear();
+            block.edge_dst.clear();
+            block.edge_idx.clear();
+            block.edge_times.clear();
+            for (size_t r = 0; r < block.dst_nodes.size(); ++r) {
+                size_t row = r * static_cast<size_t>(fanouts[l]);
+                for (EdgeType k = 0; k < buffers.counts[r]; ++k) {
+                    neighbor_nodes.push_back(buffers.neighbors[row + k]);
+                    block.edge_dst.push_back(static_cast<EdgeType>(r));
+                    block.edge_idx.push_back(buffers.neighbor_idx[row + k]);
+                    block.edge_times.push_back(buffers.neighbor_times[row + k]);
+                }
+            }
+            block.edge_src.resize(neighbor_nodes.size());
+            reference_table(neighbor_nodes.data(), block.edge_times.data(), neighbor_nodes.size(),
+                            block.src_nodes, block.src_times, block.edge_src.data());
+        }
+        reference_time += omp_get_wtime() - start_time;
+
+        same = same && root_rows == reference_rows;
+        for (size_t l = 0; l < fanouts.size(); ++l) {
+            same = same && same_block(blocks[l], reference[l]);
+            frontier[l] += blocks[l].dst_nodes.size();
+        }
+    }
+
+    double roots = static_cast<double>(batch_size) * iterations;
+    cout << "multihop " << strategy << ": " << roots / multihop_time << " roots/s, hop-by-hop sampling calls "
+         << roots / reference_time << " roots/s (" << (multihop_time > 0 ? reference_time / multihop_time : 0) << "x)"
+         << (same ? "" : ", MISMATCH") << endl;
+    cout << "mean unique roots per hop:";
+    for (size_t l = 0; l < fanouts.size(); ++l) {
+        cout << " " << frontier[l] / static_cast<size_t>(max(iterations, 1));
+    }
+    cout << endl;
+    return same ? 0 : 1;
+}
+
+// Settings of the sweep benchmark; every list is swept as a full grid
+struct SweepOptions {
+    string input;
+    vector<int> fanouts = {10, 20};
+    vector<size_t> batch_sizes = {200, 600};
+    vector<int> threads = {omp_get_max_threads()};
+    vector<string> strategies = {"recent", "random"};
+    int batches = 50;
+    int warmup = 5;
+    // Fraction of the edge stream (in time order) where the replayed minibatches start
+    double start = 0.7;
+    bool reverse = false;
+    bool negatives = true;
+    uint64_t seed = DEFAULT_RANDOM_SEED;
+    SampleParams sample_params;
+    CsrLayout layout = CSR_LAYOUT_SEPARATE;
+    string output = "benchmark.json";
+    // Counters and phase timers of the whole run (needs a build with -DTG_METRICS)
+    string metrics_output;
+    // Used instead of a CSV file when the input is "synthetic"
+    GeneratorOptions generator;
+};
+
+// Measurements of one point of the sweep grid
+struct SweepResult {
+    string strategy;
+    int fanout;
+    size_t batch_size;
+    int threads;
+    int batches;
+    double roots_per_second;
+    double neighbors_per_second;
+    double latency_mean_ms;
+    double latency_p50_ms;
+    double latency_p99_ms;
+};
+
+template <typename T>
+static bool parse_list(const string& value, vector<T>& list) {
+    list.clear();
+    stringstream ss(value);
+    string item;
+    while (getline(ss, item, ',')) {
+        stringstream item_ss(item);
+        T parsed;
+        if (!(item_ss >> parsed)) {
+            return false;
+        }
+        list.push_back(parsed);
+    }
+    return !list.empty();
+}
+
+static bool parse_sweep_options(int argc, char* argv[], SweepOptions& options) {
+    if (argc < 3) {
+        return false;
+    }
+    options.input = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        string key = argv[i];
+        if (key == "--reverse") {
+            options.reverse = true;
+            continue;
+        }
+        if (key == "--no-negatives") {
+            options.negatives = false;
+            continue;
+        }
+        if (key == "--no-plan") {
+            options.sample_params.plan_batches = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << key << endl;
+            return false;
+        }
+        string value = argv[++i];
+        bool ok = true;
+        if (key == "--fanouts") {
+            ok = parse_list(value, options.fanouts);
+        } else if (key == "--batch-sizes") {
+            ok = parse_list(value, options.batch_sizes);
+        } else if (key == "--threads") {
+            ok = parse_list(value, options.threads);
+        } else if (key == "--strategies") {
+            ok = parse_list(value, options.strategies);
+        } else if (key == "--batches") {
+            options.batches = stoi(value);
+        } else if (key == "--warmup") {
+            options.warmup = stoi(value);
+        } else if (key == "--start") {
+            options.start = stod(value);
+        } else if (key == "--seed") {
+            options.seed = stoull(value);
+            options.generator.seed = options.seed;
+        } else if (key == "--time-window") {
+            options.sample_params.time_window = stod(value);
+        } else if (key == "--decay-rate") {
+            options.sample_params.decay_rate = stod(value);
+        } else if (key == "--layout") {
+            ok = parse_csr_layout(value, options.layout);
+        } else if (key == "--output") {
+            options.output = value;
+        } else if (key == "--metrics") {
+            options.metrics_output = value;
+        } else if (parse_generator_option(key, value, options.generator)) {
+            // Synthetic input settings
+        } else {
+            cerr << "Unknown option " << key << endl;
+            return false;
+        }
+        if (!ok) {
+            cerr << "Invalid value for " << key << ": " << value << endl;
+            return false;
+        }
+    }
+    return options.batches > 0 && options.warmup >= 0 && options.start >= 0 && options.start < 1;
+}
+
+// Value at quantile q of the sorted latencies (nearest rank)
+static double percentile(const vector<double>& sorted, double q) {
+    size_t rank = static_cast<size_t>(ceil(q * sorted.size()));
+    return sorted[min(sorted.size(), max(rank, static_cast<size_t>(1))) - 1];
+}
+
+/*
+Replay a chronological stream of minibatches like TGN training does: batch i covers the next
+batch_size edges in time order and its roots are their sources, their destinations and (with
+negatives) one random node per edge, all queried at the edge time. Negative nodes come from a
+counter-based stream keyed by the edge position, so every run sees the same workload.
+*/
+template <typename Types>
+static void make_stream_batch(const vector<typename Types::NodeType>& src_list, const vector<typename Types::NodeType>& dst_list,
+                              const vector<typename Types::TimeType>& time_list, const vector<uint64_t>& time_order,
+                              size_t first_edge, size_t batch_size, size_t num_nodes, const SweepOptions& options,
+                              vector<typename Types::NodeType>& roots, vector<typename Types::TimeType>& root_times) {
+    typedef typename Types::NodeType RootNode;
+    size_t per_edge = options.negatives ? 3 : 2;
+    roots.resize(batch_size * per_edge);
+    root_times.resize(batch_size * per_edge);
+    for (size_t k = 0; k < batch_size; ++k) {
+        size_t position = (first_edge + k) % time_order.size();
+        uint64_t e = time_order[position];
+        roots[k] = src_list[e];
+        roots[batch_size + k] = dst_list[e];
+        root_times[k] = root_times[batch_size + k] = time_list[e];
+        if (options.negatives) {
+            CounterRng rng(options.seed, position);
+            roots[2 * batch_size + k] = static_cast<RootNode>(rng.bounded(num_nodes));
+            root_times[2 * batch_size + k] = time_list[e];
+        }
+    }
+}
+
+static void write_sweep_json(ostream& out, const SweepOptions& options, const vector<SweepResult>& results,
+                             const string& graph_info) {
+    out << "{\n";
+    out << "  \"input\": \"" << options.input << "\",\n";
+    out << graph_info;
+    out << "  \"runs\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SweepResult& r = results[i];
+        out << "    {\"strategy\": \"" << r.strategy << "\", \"fanout\": " << r.fanout << ", \"batch_size\": " << r.batch_size
+            << ", \"threads\": " << r.threads << ", \"batches\": " << r.batches
+            << ", \"roots_per_second\": " << r.roots_per_second << ", \"neighbors_per_second\": " << r.neighbors_per_second
+            << ", \"latency_mean_ms\": " << r.latency_mean_ms << ", \"latency_p50_ms\": " << r.latency_p50_ms
+            << ", \"latency_p99_ms\": " << r.latency_p99_ms << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+// Load the dataset with Types, build the T-CSR and run every point of the sweep grid
+template <typename Types>
+static CsvReadResult bench_sweep(const SweepOptions& options) {
+    typedef typename Types::NodeType SweepNode;
+    typedef typename Types::EdgeType SweepEdge;
+    typedef typename Types::TimeType SweepTime;
+
+    double load_start = omp_get_wtime();
+    vector<SweepEdge> edge_idx;
+    vector<SweepNode> src_list, dst_list;
+    vector<SweepTime> time_list;
+    if (options.input == "synthetic") {
+        if (!generator_fits_types<Types>(options.generator)) {
+            return CSV_READ_DOES_NOT_FIT;
+        }
+        if (!generate_temporal_edges<Types>(options.generator, edge_idx, src_list, dst_list, time_list)) {
+            return CSV_READ_FAILED;
+        }
+    } else {
+        CsvReadResult read = read_csv_file_parallel<Types>(options.input, edge_idx, src_list, dst_list, time_list);
+        if (read != CSV_READ_OK) {
+            return read;
+        }
+    }
+    if (src_list.empty()) {
+        cerr << options.input << " has no edges" << endl;
+        return CSV_READ_FAILED;
+    }
+    double load_seconds = omp_get_wtime() - load_start;
+
+    TemporalGraphT<Types> tg(edge_idx, src_list, dst_list, time_list, options.reverse);
+    double build_start = omp_get_wtime();
+    tg.to_csr(options.layout);
+    double build_seconds = omp_get_wtime() - build_start;
+    size_t rss_after_build = get_peak_rss_bytes();
+    tg.set_sample_params(options.sample_params);
+
+    // Edge positions in time order (stable, so the file order breaks ties)
+    size_t num_edges = src_list.size();
+    vector<uint64_t> time_order(num_edges);
+    {
+        typedef decltype(radix_key(SweepTime())) TimeKey;
+        vector<TimeKey> keys(num_edges), key_scratch;
+        vector<uint64_t> order_scratch;
+        for (size_t i = 0; i < num_edges; ++i) {
+            keys[i] = radix_key(time_list[i]);
+            time_order[i] = i;
+        }
+        parallel_radix_sort(keys, time_order, key_scratch, order_scratch);
+    }
+
+    vector<SweepResult> results;
+    vector<SweepNode> roots;
+    vector<SweepTime> root_times;
+    SampleBuffers<Types> buffers;
+    int max_threads = omp_get_max_threads();
+    size_t first_edge = static_cast<size_t>(options.start * num_edges);
+
+    for (const string& strategy_name : options.strategies) {
+        SampleStrategy strategy = parse_sample_strategy(strategy_name);
+        if (strategy == SAMPLE_NONE) {
+            cerr << "Skipping unknown strategy " << strategy_name << endl;
+            continue;
+        }
+        for (size_t batch_size : options.batch_sizes) {
+            for (int fanout : options.fanouts) {
+                for (int threads : options.threads) {
+                    omp_set_num_threads(max(threads, 1));
+                    tg.set_random_seed(options.seed);
+                    vector<double> latencies;
+                    double total_seconds = 0;
+                    size_t total_roots = 0;
+                    size_t total_neighbors = 0;
+
+                    for (int b = 0; b < options.warmup + options.batches; ++b) {
+                        make_stream_batch<Types>(src_list, dst_list, time_list, time_order, first_edge + b * batch_size, batch_size,
+                                                 tg.get_num_nodes(), options, roots, root_times);
+                        double seconds = tg.sampling(roots, root_times, buffers, static_cast<SweepEdge>(fanout), strategy);
+                        if (b < options.warmup) {
+                            continue;
+                        }
+                        latencies.push_back(seconds);
+                        total_seconds += seconds;
+                        total_roots += roots.size();
+                        for (size_t r = 0; r < roots.size(); ++r) {
+                            total_neighbors += buffers.counts[r];
+                        }
+                    }
+
+                    sort(latencies.begin(), latencies.end());
+                    SweepResult result;
+                    result.strategy = strategy_name;
+                    result.fanout = fanout;
+                    result.batch_size = batch_size;
+                    result.threads = max(threads, 1);
+                    result.batches = options.batches;
+                    result.roots_per_second = total_seconds > 0 ? total_roots / total_seconds : 0;
+                    result.neighbors_per_second = total_seconds > 0 ? total_neighbors / total_seconds : 0;
+                    result.latency_mean_ms = 1e3 * total_seconds / options.batches;
+                    result.latency_p50_ms = 1e3 * percentile(latencies, 0.5);
+                    result.latency_p99_ms = 1e3 * percentile(latencies, 0.99);
+                    results.push_back(result);
+                    cout << strategy_name << " fanout " << fanout << " batch " << batch_size << " threads " << result.threads
+                         << ": " << result.roots_per_second << " roots/s, p50 " << result.latency_p50_ms << " ms, p99 "
+                         << result.latency_p99_ms << " ms" << endl;
+                }
+            }
+        }
+    }
+    omp_set_num_threads(max_threads);
+
+    stringstream graph_info;
+    graph_info << "  \"node_bits\": " << sizeof(SweepNode) * 8 << ",\n";
+    graph_info << "  \"edge_bits\": " << sizeof(SweepEdge) * 8 << ",\n";
+    graph_info << "  \"time_bits\": " << sizeof(SweepTime) * 8 << ",\n";
+    graph_info << "  \"reverse\": " << (options.reverse ? "true" : "false") << ",\n";
+    graph_info << "  \"plan_batches\": " << (options.sample_params.plan_batches ? "true" : "false") << ",\n";
+    graph_info << "  \"layout\": \"" << (options.layout == CSR_LAYOUT_PACKED ? "packed" : "separate") << "\",\n";
+    graph_info << "  \"num_nodes\": " << tg.get_num_nodes() << ",\n";
+    graph_info << "  \"num_edges\": " << tg.get_num_edges() << ",\n";
+    graph_info << "  \"load_seconds\": " << load_seconds << ",\n";
+    graph_info << "  \"csr_build_seconds\": " << build_seconds << ",\n";
+    graph_info << "  \"peak_rss_bytes_after_build\": " << rss_after_build << ",\n";
+    graph_info << "  \"peak_rss_bytes\": " << get_peak_rss_bytes() << ",\n";
+
+    ofstream file(options.output);
+    if (!file) {
+        cerr << "Failed to open " << options.output << " for writing" << endl;
+        return CSV_READ_FAILED;
+    }
+    write_sweep_json(file, options, results, graph_info.str());
+    cout << "Results written to " << options.output << endl;
+    if (!options.metrics_output.empty()) {
+        if (!TG_METRICS_ENABLED) {
+            cerr << "Built without -DTG_METRICS, the metrics are empty" << endl;
+        }
+        if (write_metrics_file(options.metrics_output)) {
+            cout << "Metrics written to " << options.metrics_output << endl;
+        }
+    }
+    return CSV_READ_OK;
+}
+
+// Sampling followed by FeatureStore::gather against FeatureStore::sample_and_gather, without and
+// with a node feature cache of 5% of the nodes
+static int bench_features(const string& file_path, EdgeType sample_num, size_t batch_size, int iterations, const string& dtype_name) {
+    FeatureDType dtype;
+    if (!parse_feature_dtype(dtype_name, dtype)) {
+        cerr << "Unknown feature type " << dtype_name << endl;
+        return 1;
+    }
+    BenchSetup setup;
+    if (!setup.load(file_path)) {
+        return 1;
+    }
+    TemporalGraph& tg = *setup.graph;
+
+    // Random features of the TGN dimensions: 172 per edge, 100 per node and 100 of node memory
+    const size_t edge_dim = 172;
+    const size_t node_dim = 100;
+    const size_t memory_dim = 100;
+    size_t edge_rows = static_cast<size_t>(*max_element(setup.edge_idx.begin(), setup.edge_idx.end())) + 1;
+    size_t node_rows = tg.get_num_nodes();
+    vector<float> edge_values(edge_rows * edge_dim), node_values(node_rows * node_dim), memory_values(node_rows * memory_dim);
+    normal_distribution<float> normal(0, 1);
+    for (float& value : edge_values) {
+        value = normal(setup.gen);
+    }
+    for (float& value : node_values) {
+        value = normal(setup.gen);
+    }
+    for (float& value : memory_values) {
+        value = normal(setup.gen);
+    }
+    vector<NodeType> all_nodes(node_rows);
+    iota(all_nodes.begin(), all_nodes.end(), 0);
+
+    FeatureStoreOptions cached_options;
+    cached_options.cache_rows = max<size_t>(node_rows / 20, 1);
+    cached_options.cache_refresh_batches = 8;
+    FeatureStore store(tg), cached_store(tg, cached_options);
+    for (FeatureStore* s : {&store, &cached_store}) {
+        s->set_edge_features(edge_values.data(), edge_rows, edge_dim, dtype);
+        s->set_node_features(node_values.data(), node_rows, node_dim, dtype);
+        s->init_node_memory(node_rows, memory_dim);
+        s->update_node_memory(all_nodes.data(), node_rows, memory_values.data());
+    }
+    cout << "Features: " << store.get_edge_features().bytes() / 1e6 << " MB per edge matrix, "
+         << store.get_node_features().bytes() / 1e6 << " MB per node matrix (" << dtype_name << ")" << endl;
+
+    vector<vector<NodeType>> batch_node_ids(iterations);
+    vector<vector<TimeType>> batch_node_times(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        make_batch(setup.src_list, setup.time_list, batch_size, setup.gen, batch_node_ids[i], batch_node_times[i]);
+    }
+
+    const char* strategies[] = {"recent", "random"};
+    int status = 0;
+    for (const char* strategy : strategies) {
+        tg.set_random_seed(DEFAULT_RANDOM_SEED);
+        store.set_random_seed(DEFAULT_RANDOM_SEED);
+        cached_store.set_random_seed(DEFAULT_RANDOM_SEED);
+        FeatureBuffers<TGNGraphTypes> separate, fused, cached;
+        double sample_time = 0;
+        double gather_time = 0;
+        double fused_time = 0;
+        double cached_time = 0;
+        for (int i = 0; i < iterations; ++i) {
+            sample_time += tg.sampling(batch_node_ids[i], batch_node_times[i], separate.samples, sample_num, strategy);
+            gather_time += store.gather(batch_node_ids[i].data(), batch_size, separate);
+            fused_time += store.sample_and_gather(batch_node_ids[i], batch_node_times[i], fused, sample_num, strategy);
+            cached_time += cached_store.sample_and_gather(batch_node_ids[i], batch_node_times[i], cached, sample_num, strategy);
+        }
+        bool same = fused.samples.neighbor_idx == separate.samples.neighbor_idx && fused.edge_features == separate.edge_features &&
+                    fused.neighbor_features == separate.neighbor_features && fused.neighbor_memory == separate.neighbor_memory &&
+                    cached.neighbor_features == separate.neighbor_features && cached.root_features == separate.root_features;
+        double roots = static_cast<double>(batch_size) * iterations;
+        FeatureStoreStats stats = cached_store.stats();
+        cout << strategy << ": sampling only " << roots / sample_time << " roots/s, sampling + gather "
+             << roots / (sample_time + gather_time) << " roots/s, sample_and_gather " << roots / fused_time << " roots/s ("
+             << (fused_time > 0 ? (sample_time + gather_time) / fused_time : 0) << "x), with cache " << roots / cached_time
+             << " roots/s (" << 100.0 * stats.cache_hits / max<uint64_t>(stats.node_rows, 1) << "% node rows from cache, built after the first batch)"
+             << (same ? "" : ", MISMATCH") << endl;
+        status = same ? status : 1;
+        cached_store.reset_stats();
+    }
+    return status;
+}
+
+// Options of the T-CSR build scaling benchmark
+struct CsrScalingOptions {
+    string input;
+    vector<int> threads = {1, 2, 4, 8, 16, 32, 64};
+    int repeats = 3;
+    bool reverse = false;
+    // Used instead of a CSV file when the input is "synthetic"
+    GeneratorOptions generator;
+};
+
+static bool parse_csr_scaling_options(int argc, char* argv[], CsrScalingOptions& options) {
+    if (argc < 3) {
+        return false;
+    }
+    options.input = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        string key = argv[i];
+        if (key == "--reverse") {
+            options.reverse = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << key << endl;
+            return false;
+        }
+        string value = argv[++i];
+        bool ok = true;
+        if (key == "--threads") {
+            ok = parse_list(value, options.threads);
+        } else if (key == "--repeats") {
+            options.repeats = stoi(value);
+        } else if (parse_generator_option(key, value, options.generator)) {
+            // Synthetic input settings
+        } else {
+            cerr << "Unknown option " << key << endl;
+            return false;
+        }
+        if (!ok) {
+            cerr << "Invalid value for " << key << ": " << value << endl;
+            return false;
+        }
+    }
+    return options.repeats > 0;
+}
+
+// Degree count and offsets the way to_csr computed them before parallel_scan.h: an atomic
+// increment per edge and a serial cumulative sum
+template <typename Types>
+static void legacy_csr_offsets(const vector<typename Types::NodeType>& src_list, const vector<typename Types::NodeType>& dst_list,
+                               bool reverse, size_t num_nodes, vector<typename Types::EdgeType>& indptr) {
+    indptr.assign(num_nodes + 1, 0);
+    #pragma omp parallel for
+    for (size_t i = 0; i < src_list.size(); ++i) {
+        #pragma omp atomic
+        indptr[src_list[i] + 1]++;
+        if (reverse) {
+            #pragma omp atomic
+            indptr[dst_list[i] + 1]++;
+        }
+    }
+    for (size_t i = 1; i <= num_nodes; ++i) {
+        indptr[i] += indptr[i - 1];
+    }
+}
+
+template <typename Types>
+static void csr_offsets(const vector<typename Types::NodeType>& src_list, const vector<typename Types::NodeType>& dst_list,
+                        bool reverse, size_t num_nodes, vector<typename Types::EdgeType>& indptr) {
+    indptr.assign(num_nodes + 1, 0);
+    parallel_count_degrees(src_list.data(), src_list.size(), indptr.data() + 1, num_nodes);
+    if (reverse) {
+        parallel_count_degrees(dst_list.data(), dst_list.size(), indptr.data() + 1, num_nodes);
+    }
+    parallel_inclusive_scan(indptr.data() + 1, num_nodes);
+}
+
+// Scan n ones with parallel_inclusive_scan from inside an active parallel region, where the
+// runtime runs the scan's own region with a single thread whatever it asks for
+template <typename T>
+static bool nested_scan_total(size_t n) {
+    vector<T> values(n, 1);
+    T total = 0;
+    int levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(1);
+    int requested = omp_get_max_threads();
+    #pragma omp parallel num_threads(2)
+    {
+        #pragma omp single
+        {
+            omp_set_num_threads(max(requested, 2));
+            total = parallel_inclusive_scan(values.data(), n);
+        }
+    }
+    omp_set_max_active_levels(levels);
+    return static_cast<size_t>(total) == n && static_cast<size_t>(values[n - 1]) == n;
+}
+
+// Best time of the offsets (count and scan) of both versions and of the whole to_csr per thread count;
+// all_same is cleared if the offsets of any thread count differ from the legacy ones
+template <typename Types>
+static CsvReadResult bench_csr_scaling(const CsrScalingOptions& options, bool& all_same) {
+    typedef typename Types::NodeType ScalingNode;
+    typedef typename Types::EdgeType ScalingEdge;
+    typedef typename Types::TimeType ScalingTime;
+
+    vector<ScalingEdge> edge_idx;
+    vector<ScalingNode> src_list, dst_list;
+    vector<ScalingTime> time_list;
+    if (options.input == "synthetic") {
+        if (!generator_fits_types<Types>(options.generator)) {
+            return CSV_READ_DOES_NOT_FIT;
+        }
+        if (!generate_temporal_edges<Types>(options.generator, edge_idx, src_list, dst_list, time_list)) {
+            return CSV_READ_FAILED;
+        }
+    } else {
+        CsvReadResult read = read_csv_file_parallel<Types>(options.input, edge_idx, src_list, dst_list, time_list);
+        if (read != CSV_READ_OK) {
+            return read;
+        }
+    }
+    if (src_list.empty()) {
+        cerr << options.input << " has no edges" << endl;
+        return CSV_READ_FAILED;
+    }
+
+    TemporalGraphT<Types> tg(edge_idx, src_list, dst_list, time_list, options.reverse);
+    size_t num_nodes = static_cast<size_t>(tg.get_max_node_id()) + 1;
+    cout << "Nodes: " << num_nodes << ", edges: " << src_list.size() << (options.reverse ? " (reversed)" : "") << endl;
+
+    int max_threads = omp_get_max_threads();
+    vector<ScalingEdge> legacy_indptr, indptr;
+    for (int threads : options.threads) {
+        omp_set_num_threads(max(threads, 1));
+        double legacy_seconds = 0;
+        double offsets_seconds = 0;
+        double build_seconds = 0;
+        for (int r = 0; r < options.repeats; ++r) {
+            double start = omp_get_wtime();
+            legacy_csr_offsets<Types>(src_list, dst_list, options.reverse, num_nodes, legacy_indptr);
+            double legacy_end = omp_get_wtime();
+            csr_offsets<Types>(src_list, dst_list, options.reverse, num_nodes, indptr);
+            double offsets_end = omp_get_wtime();
+            tg.to_csr();
+            double build_end = omp_get_wtime();
+            legacy_seconds = r == 0 ? legacy_end - start : min(legacy_seconds, legacy_end - start);
+            offsets_seconds = r == 0 ? offsets_end - legacy_end : min(offsets_seconds, offsets_end - legacy_end);
+            build_seconds = r == 0 ? build_end - offsets_end : min(build_seconds, build_end - offsets_end);
+        }
+        bool same = indptr == legacy_indptr && equal(indptr.begin(), indptr.end(), tg.get_indptr());
+        // A scan run with a smaller team than it requests (here nested in an active region, so the
+        // runtime gives it one thread) still returns the total
+        bool nested_same = nested_scan_total<ScalingEdge>(max<size_t>(num_nodes, PARALLEL_SCAN_MIN_SIZE));
+        cout << "threads " << max(threads, 1) << ": atomic count + serial sum " << 1e3 * legacy_seconds
+             << " ms, histogram count + parallel scan " << 1e3 * offsets_seconds << " ms ("
+             << (offsets_seconds > 0 ? legacy_seconds / offsets_seconds : 0) << "x), to_csr " << 1e3 * build_seconds << " ms"
+             << (same ? "" : ", MISMATCH") << (nested_same ? "" : ", nested scan MISMATCH") << endl;
+        all_same = all_same && same && nested_same;
+    }
+    omp_set_num_threads(max_threads);
+    return CSV_READ_OK;
+}
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " random <csv_file> <sample_num> <batch_size> [iterations]\n"
+              << "       " << program << " kernels <csv_file> <sample_num> <batch_size> [iterations]\n"
+              << "       " << program << " compressed <csv_file> <sample_num> <batch_size> [iterations]\n"
+              << "       " << program << " features <csv_file> <sample_num> <batch_size> [iterations] [float32|float16|bfloat16|int8]\n"
+              << "       " << program << " numa <csv_file> <sample_num> <batch_size> [iterations] [none|interleave|partition]\n"
+              << "       " << program << " shards <csv_file> <sample_num> <batch_size> [iterations] [max_shards] [range|modulo]\n"
+              << "       " << program << " negatives <csv_file> <sample_num> <batch_size> [iterations] [random|historical]\n"
+              << "       " << program << " multihop <csv_file> <fanouts e.g. 10,5> <batch_size> [iterations] [strategy]\n"
+              << "       " << program << " prefetch <csv_file> <sample_num> <batch_size> [compute_ms] [depth]\n"
+              << "       " << program << " sweep <csv_file> [--fanouts 10,20] [--batch-sizes 200,600] [--threads 1,8]\n"
+              << "              [--strategies recent,random] [--batches 50] [--warmup 5] [--start 0.7] [--seed n]\n"
+              << "              [--time-window w] [--decay-rate r] [--reverse] [--no-negatives] [--layout separate|packed]\n"
+              << "              [--no-plan] [--output benchmark.json] [--metrics metrics.json|.prom]\n"
+              << "       " << program << " sweep synthetic [generator options of tgtool generate] [sweep options]\n"
+              << "       " << program << " csr <csv_file|synthetic> [--threads 1,2,4,8,16,32,64] [--repeats 3] [--reverse]\n"
+              << "              [generator options of tgtool generate]\n";
+}
+
+int main(int argc, char* argv[]) {
+    string mode = argc > 1 ? argv[1] : "";
+    // Shard server started by the shards benchmark
+    if (mode == "serve-shard" && argc == 5) {
+        return serve_shard(argv[2], std::stoul(argv[3]), argv[4]);
+    }
+    if (mode == "sweep") {
+        SweepOptions options;
+        if (!parse_sweep_options(argc, argv, options)) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        // TGN types unless the dataset needs the TGL ones
+        CsvReadResult result = bench_sweep<TGNGraphTypes>(options);
+        if (result == CSV_READ_DOES_NOT_FIT) {
+            result = bench_sweep<TGLGraphTypes>(options);
+        }
+        return result == CSV_READ_OK ? 0 : 1;
+    }
+
+    if (mode == "csr") {
+        CsrScalingOptions options;
+        if (!parse_csr_scaling_options(argc, argv, options)) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        bool all_same = true;
+        CsvReadResult result = bench_csr_scaling<TGNGraphTypes>(options, all_same);
+        if (result == CSV_READ_DOES_NOT_FIT) {
+            result = bench_csr_scaling<TGLGraphTypes>(options, all_same);
+        }
+        return result == CSV_READ_OK && all_same ? 0 : 1;
+    }
+
+    if (argc < 5) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (mode == "multihop") {
+        vector<int> fanouts;
+        if (!parse_list(argv[3], fanouts)) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        return bench_multihop(argv[2], fanouts, std::stoul(argv[4]), argc > 5 ? std::stoi(argv[5]) : 10,
+                              argc > 6 ? argv[6] : "recent");
+    }
+    string file_path = argv[2];
+    EdgeType sample_num = std::stoi(argv[3]);
+    size_t batch_size = std::stoul(argv[4]);
+    int iterations = argc > 5 ? std::stoi(argv[5]) : 10;
+
+    if (mode == "prefetch") {
+        double compute_ms = argc > 5 ? std::stod(argv[5]) : 5;
+        size_t depth = argc > 6 ? std::stoul(argv[6]) : 2;
+        return bench_prefetch(file_path, sample_num, batch_size, compute_ms, depth);
+    }
+    if (mode == "random") {
+        return bench_random(file_path, sample_num, batch_size, iterations);
+    }
+    if (mode == "kernels") {
+        return bench_kernels(file_path, sample_num, batch_size, iterations);
+    }
+    if (mode == "compressed") {
+        return bench_compressed(file_path, sample_num, batch_size, iterations);
+    }
+    if (mode == "features") {
+        return bench_features(file_path, sample_num, batch_size, iterations, argc > 6 ? argv[6] : "float32");
+    }
+    if (mode == "numa") {
+        return bench_numa(file_path, sample_num, batch_size, iterations, argc > 6 ? argv[6] : "partition");
+    }
+    if (mode == "shards") {
+        return bench_shards(file_path, sample_num, batch_size, iterations, argc > 6 ? std::stoul(argv[6]) : 4,
+                            argc > 7 ? argv[7] : "range");
+    }
+    if (mode == "negatives") {
+        return bench_negatives(file_path, sample_num, batch_size, iterations, argc > 6 ? argv[6] : "random");
+    }
+    std::cerr << "Unknown benchmark: " << mode << "\n";
+    return 1;
+}
@@ -0,0 +1,722 @@
+// compressed_csr.cpp - Bit-packed T-CSR for graphs whose arrays do not fit in memory
+#include "compressed_csr.h"
+#include <cstdio>
+#include <cstddef>
+#include <fstream>
+#include <omp.h>
+
+// Bits needed to store every value in [0, range]
+static inline int bits_for(uint64_t range) {
+    return range == 0 ? 0 : 64 - __builtin_clzll(range);
+}
+
+// Bytes of a stream of n values of the given width
+static inline uint64_t stream_bytes(uint64_t n, int bits) {
+    return (n * static_cast<uint64_t>(bits) + 7) / 8;
+}
+
+// OR value into the zeroed stream at bit position bit
+static inline void write_bits(uint8_t* stream, uint64_t bit, int width, uint64_t value) {
+    while (width > 0) {
+        uint64_t byte = bit / 8;
+        int shift = static_cast<int>(bit % 8);
+        int take = min(8 - shift, width);
+        stream[byte] |= static_cast<uint8_t>((value & ((1u << take) - 1)) << shift);
+        value >>= take;
+        bit += take;
+        width -= take;
+    }
+}
+
+// Value of the given width at bit position bit. Reads up to 9 bytes, which the padding of the
+// data array covers.
+static inline uint64_t read_bits(const uint8_t* stream, uint64_t bit, int width) {
+    if (width == 0) {
+        return 0;
+    }
+    const uint8_t* p = stream + bit / 8;
+    int shift = static_cast<int>(bit % 8);
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    uint64_t value = word >> shift;
+    if (shift + width > 64) {
+        value |= static_cast<uint64_t>(p[8]) << (64 - shift);
+    }
+    return width == 64 ? value : value & ((1ULL << width) - 1);
+}
+
+// Padding behind the last stream so read_bits never reads past the array
+const size_t COMPRESSED_DATA_PADDING = 16;
+
+static const char COMPRESSED_CSR_MAGIC[8] = {'T', 'G', 'C', 'S', 'R', 'P', 'A', 'K'};
+
+template <typename Types>
+CompressedTemporalGraphT<Types>::CompressedTemporalGraphT()
+    : indptr_storage(), group_storage(), block_time_storage(), block_storage(), data_storage(), file(),
+      indptr(nullptr), groups(nullptr), block_times(nullptr), blocks(nullptr), data(nullptr), num_nodes(0), num_blocks(0),
+      data_bytes(0), reverse(false), random_seed(DEFAULT_RANDOM_SEED), batch_counter(0), sample_params() {
+}
+
+template <typename Types>
+void CompressedTemporalGraphT<Types>::bind_storage() {
+    file.reset();
+    indptr = indptr_storage.data();
+    groups = group_storage.data();
+    block_times = block_time_storage.data();
+    blocks = block_storage.data();
+    data = data_storage.data();
+    num_blocks = block_storage.size();
+    data_bytes = data_storage.size();
+}
+
+template <typename Types>
+double CompressedTemporalGraphT<Types>::compress(const TemporalGraphT<Types>& graph) {
+    double start_time = omp_get_wtime();
+    const size_t B = COMPRESSED_BLOCK_SIZE;
+    const size_t G = COMPRESSED_GROUP_SIZE;
+    const EdgeType* graph_indptr = graph.get_indptr();
+    const NodeType* graph_indices = graph.get_indices();
+    const TimeType* graph_time_values = graph.get_time_values();
+    const EdgeType* graph_idx_values = graph.get_idx_values();
+    num_nodes = graph_indptr ? graph.get_num_nodes() : 0;
+    reverse = graph.is_reverse();
+
+    indptr_storage.assign(1, 0);
+    if (graph_indptr) {
+        indptr_storage.assign(graph_indptr, graph_indptr + num_nodes + 1);
+    }
+    const EdgeType* offsets = indptr_storage.data();
+    size_t num_groups = (num_nodes + G - 1) / G;
+    group_storage.assign(num_groups, GroupHeader());
+    vector<uint64_t> group_entries(num_groups, 0);
+    vector<uint64_t> group_blocks(num_groups + 1, 0);
+
+    // Pass 1: long nodes, and the bases and widths of the short nodes of every group
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (size_t g = 0; g < num_groups; ++g) {
+        GroupHeader& group = group_storage[g];
+        uint64_t time_min = UINT64_MAX, time_max = 0, node_min = UINT64_MAX, node_max = 0, idx_min = UINT64_MAX, idx_max = 0;
+        for (size_t v = g * G; v < min(num_nodes, (g + 1) * G); ++v) {
+            size_t length = static_cast<size_t>(offsets[v + 1] - offsets[v]);
+            if (length > B) {
+                group.long_mask |= 1ULL << (v - g * G);
+                group_blocks[g + 1] += (length + B - 1) / B;
+                continue;
+            }
+            group_entries[g] += length;
+            for (size_t e = static_cast<size_t>(offsets[v]); e < static_cast<size_t>(offsets[v + 1]); ++e) {
+                uint64_t time_key = radix_key(graph_time_values[e]);
+                uint64_t node_key = radix_key(graph_indices[e]);
+                uint64_t idx_key = radix_key(graph_idx_values[e]);
+                time_min = min(time_min, time_key);
+                time_max = max(time_max, time_key);
+                node_min = min(node_min, node_key);
+                node_max = max(node_max, node_key);
+                idx_min = min(idx_min, idx_key);
+                idx_max = max(idx_max, idx_key);
+            }
+        }
+        if (group_entries[g] > 0) {
+            group.time_base = static_cast<TimeKey>(time_min);
+            group.node_base = static_cast<NodeKey>(node_min);
+            group.idx_base = static_cast<EdgeKey>(idx_min);
+            group.time_bits = static_cast<uint8_t>(bits_for(time_max - time_min));
+            group.node_bits = static_cast<uint8_t>(bits_for(node_max - node_min));
+            group.idx_bits = static_cast<uint8_t>(bits_for(idx_max - idx_min));
+        }
+    }
+    for (size_t g = 0; g < num_groups; ++g) {
+        group_blocks[g + 1] += group_blocks[g];
+        group_storage[g].first_block = group_blocks[g];
+    }
+    block_storage.assign(group_blocks[num_groups], BlockHeader());
+    block_time_storage.assign(group_blocks[num_groups], TimeType());
+    vector<uint32_t> block_entries(group_blocks[num_groups], 0);
+
+    // Pass 2: bases and widths of every block of the long nodes
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (size_t g = 0; g < num_groups; ++g) {
+        size_t b = group_blocks[g];
+        for (uint64_t mask = group_storage[g].long_mask; mask != 0; mask &= mask - 1) {
+            size_t v = g * G + static_cast<size_t>(__builtin_ctzll(mask));
+            for (size_t first = static_cast<size_t>(offsets[v]); first < static_cast<size_t>(offsets[v + 1]); first += B, ++b) {
+                size_t last = min(first + B, static_cast<size_t>(offsets[v + 1]));
+                uint64_t time_min = radix_key(graph_time_values[first]), time_max = time_min;
+                uint64_t node_min = radix_key(graph_indices[first]), node_max = node_min;
+                uint64_t idx_min = radix_key(graph_idx_values[first]), idx_max = idx_min;
+                for (size_t e = first + 1; e < last; ++e) {
+                    uint64_t time_key = radix_key(graph_time_values[e]);
+                    uint64_t node_key = radix_key(graph_indices[e]);
+                    uint64_t idx_key = radix_key(graph_idx_values[e]);
+                    time_min = min(time_min, time_key);
+                    time_max = max(time_max, time_key);
+                    node_min = min(node_min, node_key);
+                    node_max = max(node_max, node_key);
+                    idx_min = min(idx_min, idx_key);
+                    idx_max = max(idx_max, idx_key);
+                }
+                BlockHeader& header = block_storage[b];
+                header.time_base = static_cast<TimeKey>(time_min);
+                header.node_base = static_cast<NodeKey>(node_min);
+                header.idx_base = static_cast<EdgeKey>(idx_min);
+                header.time_bits = static_cast<uint8_t>(bits_for(time_max - time_min));
+                header.node_bits = static_cast<uint8_t>(bits_for(node_max - node_min));
+                header.idx_bits = static_cast<uint8_t>(bits_for(idx_max - idx_min));
+                block_time_storage[b] = graph_time_values[first];
+                block_entries[b] = static_cast<uint32_t>(last - first);
+            }
+        }
+    }
+
+    // Stream offsets, every group followed by the blocks of its long nodes, then pass 3: pack
+    uint64_t total_bytes = 0;
+    for (size_t g = 0; g < num_groups; ++g) {
+        GroupHeader& group = group_storage[g];
+        group.offset = total_bytes;
+        total_bytes += stream_bytes(group_entries[g], group.time_bits + group.node_bits + group.idx_bits);
+        for (size_t b = group_blocks[g]; b < group_blocks[g + 1]; ++b) {
+            BlockHeader& header = block_storage[b];
+            header.offset = total_bytes;
+            total_bytes += stream_bytes(block_entries[b], header.time_bits) + stream_bytes(block_entries[b], header.node_bits) +
+                           stream_bytes(block_entries[b], header.idx_bits);
+        }
+    }
+    data_storage.assign(total_bytes + COMPRESSED_DATA_PADDING, 0);
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (size_t g = 0; g < num_groups; ++g) {
+        const GroupHeader& group = group_storage[g];
+        int entry_bits = group.time_bits + group.node_bits + group.idx_bits;
+        uint8_t* stream = data_storage.data() + group.offset;
+        uint64_t bit = 0;
+        size_t b = group_blocks[g];
+        for (size_t v = g * G; v < min(num_nodes, (g + 1) * G); ++v) {
+            if ((group.long_mask >> (v - g * G) & 1) == 0) {
+                for (size_t e = static_cast<size_t>(offsets[v]); e < static_cast<size_t>(offsets[v + 1]); ++e, bit += entry_bits) {
+                    write_bits(stream, bit, group.time_bits, radix_key(graph_time_values[e]) - group.time_base);
+                    write_bits(stream, bit + group.time_bits, group.node_bits, radix_key(graph_indices[e]) - group.node_base);
+                    write_bits(stream, bit + group.time_bits + group.node_bits, group.idx_bits,
+                               radix_key(graph_idx_values[e]) - group.idx_base);
+                }
+                continue;
+            }
+            for (size_t first = static_cast<size_t>(offsets[v]); first < static_cast<size_t>(offsets[v + 1]); first += B, ++b) {
+                const BlockHeader& header = block_storage[b];
+                uint64_t n = block_entries[b];
+                uint8_t* time_stream = data_storage.data() + header.offset;
+                uint8_t* node_stream = time_stream + stream_bytes(n, header.time_bits);
+                uint8_t* idx_stream = node_stream + stream_bytes(n, header.node_bits);
+                for (uint64_t k = 0; k < n; ++k) {
+                    write_bits(time_stream, k * header.time_bits, header.time_bits, radix_key(graph_time_values[first + k]) - header.time_base);
+                    write_bits(node_stream, k * header.node_bits, header.node_bits, radix_key(graph_indices[first + k]) - header.node_base);
+                    write_bits(idx_stream, k * header.idx_bits, header.idx_bits, radix_key(graph_idx_values[first + k]) - header.idx_base);
+                }
+            }
+        }
+    }
+
+    bind_storage();
+    batch_counter.store(0);
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+bool CompressedTemporalGraphT<Types>::save(const string& file_path) const {
+    double start_time = omp_get_wtime();
+    if (indptr == nullptr) {
+        cerr << "Failed to save " << file_path << ": the graph is not compressed" << endl;
+        return false;
+    }
+
+    CompressedCsrHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPRESSED_CSR_MAGIC, sizeof(header.magic));
+    header.version = COMPRESSED_CSR_VERSION;
+    header.header_size = sizeof(CompressedCsrHeader);
+    header.node_width = sizeof(NodeType);
+    header.edge_width = sizeof(EdgeType);
+    header.time_width = sizeof(TimeType);
+    header.flags = (reverse ? CSR_FLAG_REVERSE : 0) | (is_floating_point<TimeType>::value ? CSR_FLAG_FLOAT_TIME : 0);
+    header.num_nodes = num_nodes;
+    header.num_edges = get_num_edges();
+    header.num_blocks = num_blocks;
+
+    size_t num_groups = (num_nodes + COMPRESSED_GROUP_SIZE - 1) / COMPRESSED_GROUP_SIZE;
+    const void* sections[COMPRESSED_NUM_SECTIONS] = {indptr, groups, block_times, blocks, data};
+    const uint64_t section_bytes[COMPRESSED_NUM_SECTIONS] = {
+        (num_nodes + 1) * sizeof(EdgeType), num_groups * sizeof(GroupHeader), num_blocks * sizeof(TimeType),
+        num_blocks * sizeof(BlockHeader), data_bytes};
+    uint64_t offset = sizeof(CompressedCsrHeader);
+    for (int s = 0; s < COMPRESSED_NUM_SECTIONS; ++s) {
+        header.section_offset[s] = csr_snapshot_section_offset(offset, 0);
+        header.section_bytes[s] = section_bytes[s];
+        header.section_checksum[s] = snapshot_checksum(sections[s], section_bytes[s]);
+        offset = header.section_offset[s] + section_bytes[s];
+    }
+    header.header_checksum = snapshot_checksum(&header, offsetof(CompressedCsrHeader, header_checksum));
+
+    string partial_path = file_path + ".partial";
+    ofstream out(partial_path, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Failed to open " << partial_path << " for writing" << endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[CSR_SNAPSHOT_ALIGNMENT] = {0};
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < COMPRESSED_NUM_SECTIONS; ++s) {
+        out.write(padding, header.section_offset[s] - written);
+        out.write(static_cast<const char*>(sections[s]), header.section_bytes[s]);
+        written = header.section_offset[s] + header.section_bytes[s];
+    }
+    out.close();
+    if (!out || rename(partial_path.c_str(), file_path.c_str()) != 0) {
+        cerr << "Failed to write " << file_path << endl;
+        remove(partial_path.c_str());
+        return false;
+    }
+
+    double end_time = omp_get_wtime();
+    cout << "The elapsed time for saving the compressed T-CSR: " << end_time - start_time << " seconds" << endl;
+    return true;
+}
+
+template <typename Types>
+bool CompressedTemporalGraphT<Types>::load(const string& file_path, bool verify_checksums) {
+    double start_time = omp_get_wtime();
+    shared_ptr<MappedFile> mapped = make_shared<MappedFile>();
+    if (!mapped->open(file_path)) {
+        return false;
+    }
+    if (mapped->size() < sizeof(CompressedCsrHeader)) {
+        cerr << "Failed to load " << file_path << ": file is too small" << endl;
+        return false;
+    }
+    CompressedCsrHeader header;
+    memcpy(&header, mapped->data(), sizeof(header));
+    string error;
+    size_t num_groups = (header.num_nodes + COMPRESSED_GROUP_SIZE - 1) / COMPRESSED_GROUP_SIZE;
+    if (memcmp(header.magic, COMPRESSED_CSR_MAGIC, sizeof(header.magic)) != 0) {
+        error = "not a compressed T-CSR";
+    } else if (header.version != COMPRESSED_CSR_VERSION || header.header_size != sizeof(CompressedCsrHeader)) {
+        error = "unsupported compressed T-CSR version " + to_string(header.version);
+    } else if (header.header_checksum != snapshot_checksum(&header, offsetof(CompressedCsrHeader, header_checksum))) {
+        error = "header checksum mismatch";
+    } else if (header.node_width != sizeof(NodeType) || header.edge_width != sizeof(EdgeType) || header.time_width != sizeof(TimeType) ||
+               ((header.flags & CSR_FLAG_FLOAT_TIME) != 0) != is_floating_point<TimeType>::value) {
+        error = "file was written with a different type configuration";
+    } else if (header.section_bytes[COMPRESSED_SECTION_INDPTR] != (header.num_nodes + 1) * sizeof(EdgeType) ||
+               header.section_bytes[COMPRESSED_SECTION_GROUPS] != num_groups * sizeof(GroupHeader) ||
+               header.section_bytes[COMPRESSED_SECTION_BLOCK_TIMES] != header.num_blocks * sizeof(TimeType) ||
+               header.section_bytes[COMPRESSED_SECTION_BLOCKS] != header.num_blocks * sizeof(BlockHeader) ||
+               header.section_bytes[COMPRESSED_SECTION_DATA] < COMPRESSED_DATA_PADDING) {
+        error = "sections have inconsistent sizes";
+    } else {
+        for (int s = 0; s < COMPRESSED_NUM_SECTIONS && error.empty(); ++s) {
+            if (header.section_offset[s] % CSR_SNAPSHOT_ALIGNMENT != 0 || header.section_offset[s] + header.section_bytes[s] > mapped->size()) {
+                error = "sections lie outside the file";
+            } else if (verify_checksums &&
+                       snapshot_checksum(mapped->data() + header.section_offset[s], header.section_bytes[s]) != header.section_checksum[s]) {
+                error = "checksum mismatch in section " + to_string(s);
+            }
+        }
+    }
+    const char* base = mapped->data();
+    if (error.empty() &&
+        static_cast<uint64_t>(reinterpret_cast<const EdgeType*>(base + header.section_offset[COMPRESSED_SECTION_INDPTR])[header.num_nodes]) !=
+            header.num_edges) {
+        error = "indptr does not end at the number of edges";
+    }
+    if (!error.empty()) {
+        cerr << "Failed to load " << file_path << ": " << error << endl;
+        return false;
+    }
+
+    // Drop any owned arrays and switch the views to the mapping
+    vector<EdgeType>().swap(indptr_storage);
+    vector<GroupHeader>().swap(group_storage);
+    vector<TimeType>().swap(block_time_storage);
+    vector<BlockHeader>().swap(block_storage);
+    vector<uint8_t>().swap(data_storage);
+    indptr = reinterpret_cast<const EdgeType*>(base + header.section_offset[COMPRESSED_SECTION_INDPTR]);
+    groups = reinterpret_cast<const GroupHeader*>(base + header.section_offset[COMPRESSED_SECTION_GROUPS]);
+    block_times = reinterpret_cast<const TimeType*>(base + header.section_offset[COMPRESSED_SECTION_BLOCK_TIMES]);
+    blocks = reinterpret_cast<const BlockHeader*>(base + header.section_offset[COMPRESSED_SECTION_BLOCKS]);
+    data = reinterpret_cast<const uint8_t*>(base + header.section_offset[COMPRESSED_SECTION_DATA]);
+    num_nodes = header.num_nodes;
+    num_blocks = header.num_blocks;
+    data_bytes = header.section_bytes[COMPRESSED_SECTION_DATA];
+    reverse = (header.flags & CSR_FLAG_REVERSE) != 0;
+    file = mapped;
+    batch_counter.store(0);
+
+    double end_time = omp_get_wtime();
+    cout << "The elapsed time for loading the compressed T-CSR: " << end_time - start_time << " seconds" << endl;
+    return true;
+}
+
+template <typename Types>
+size_t CompressedTemporalGraphT<Types>::compressed_bytes() const {
+    if (indptr == nullptr) {
+        return 0;
+    }
+    size_t num_groups = (num_nodes + COMPRESSED_GROUP_SIZE - 1) / COMPRESSED_GROUP_SIZE;
+    return (num_nodes + 1) * sizeof(EdgeType) + num_groups * sizeof(GroupHeader) + num_blocks * (sizeof(TimeType) + sizeof(BlockHeader)) +
+           data_bytes;
+}
+
+template <typename Types>
+size_t CompressedTemporalGraphT<Types>::uncompressed_bytes() const {
+    return (indptr == nullptr ? 0 : (num_nodes + 1) * sizeof(EdgeType)) +
+           get_num_edges() * (sizeof(NodeType) + sizeof(TimeType) + sizeof(EdgeType));
+}
+
+template <typename Types>
+void CompressedTemporalGraphT<Types>::set_random_seed(uint64_t seed) {
+    random_seed = seed;
+    batch_counter.store(0);
+}
+
+template <typename Types>
+void CompressedTemporalGraphT<Types>::set_sample_params(const SampleParams& params) {
+    sample_params = params;
+}
+
+template <typename Types>
+uint64_t CompressedTemporalGraphT<Types>::next_batch_id() const {
+    return batch_counter.fetch_add(1);
+}
+
+// The long nodes of a group before node decide where node starts: their entries are not in the
+// group stream, and their blocks precede node's. Ids outside the graph get an empty long-node
+// cursor, which has no blocks to search or decode.
+template <typename Types>
+typename CompressedTemporalGraphT<Types>::NodeCursor CompressedTemporalGraphT<Types>::locate(NodeType node) const {
+    if (node < 0 || static_cast<size_t>(node) >= num_nodes) {
+        NodeCursor empty = {0, nullptr, 0, 0};
+        return empty;
+    }
+    size_t v = static_cast<size_t>(node);
+    size_t first_node = v & ~(COMPRESSED_GROUP_SIZE - 1);
+    const GroupHeader& group = groups[v >> COMPRESSED_GROUP_BITS];
+    uint64_t bit = 1ULL << (v - first_node);
+    NodeCursor cursor;
+    cursor.length = indptr[v + 1] - indptr[v];
+    if (group.long_mask & bit) {
+        cursor.group = nullptr;
+        cursor.first_entry = 0;
+        cursor.first_block = group.first_block;
+        for (uint64_t mask = group.long_mask & (bit - 1); mask != 0; mask &= mask - 1) {
+            size_t u = first_node + static_cast<size_t>(__builtin_ctzll(mask));
+            cursor.first_block += (static_cast<uint64_t>(indptr[u + 1] - indptr[u]) + COMPRESSED_BLOCK_SIZE - 1) / COMPRESSED_BLOCK_SIZE;
+        }
+    } else {
+        cursor.group = &group;
+        cursor.first_entry = static_cast<uint64_t>(indptr[v] - indptr[first_node]);
+        cursor.first_block = 0;
+        for (uint64_t mask = group.long_mask & (bit - 1); mask != 0; mask &= mask - 1) {
+            size_t u = first_node + static_cast<size_t>(__builtin_ctzll(mask));
+            cursor.first_entry -= static_cast<uint64_t>(indptr[u + 1] - indptr[u]);
+        }
+    }
+    return cursor;
+}
+
+// Inline nodes: binary search of the stream. Long nodes: blocks before the first one starting at
+// or after time hold the cutoff, and only that block is read.
+template <typename Types>
+typename CompressedTemporalGraphT<Types>::EdgeType CompressedTemporalGraphT<Types>::cutoff(const NodeCursor& cursor, TimeType time) const {
+    uint64_t key = static_cast<uint64_t>(radix_key(time));
+    if (cursor.group != nullptr) {
+        const GroupHeader& group = *cursor.group;
+        if (cursor.length == 0 || key <= group.time_base) {
+            return 0;
+        }
+        uint64_t target = key - group.time_base;
+        int entry_bits = group.time_bits + group.node_bits + group.idx_bits;
+        const uint8_t* stream = data + group.offset;
+        EdgeType low = 0;
+        EdgeType high = cursor.length;
+        while (low < high) {
+            EdgeType mid = low + (high - low) / 2;
+            if (read_bits(stream, (cursor.first_entry + static_cast<uint64_t>(mid)) * entry_bits, group.time_bits) < target) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    EdgeType num_node_blocks = static_cast<EdgeType>((static_cast<uint64_t>(cursor.length) + COMPRESSED_BLOCK_SIZE - 1) / COMPRESSED_BLOCK_SIZE);
+    EdgeType skipped = simd_lower_bound(block_times + cursor.first_block, num_node_blocks, time);
+    if (skipped == 0) {
+        return 0;
+    }
+    // Entry 0 of the block is before time; count the others by binary search on the packed keys
+    const BlockHeader& header = blocks[cursor.first_block + skipped - 1];
+    EdgeType block_start = (skipped - 1) * COMPRESSED_BLOCK_SIZE;
+    EdgeType n = min(static_cast<EdgeType>(COMPRESSED_BLOCK_SIZE), cursor.length - block_start);
+    uint64_t target = key - header.time_base;
+    const uint8_t* time_stream = data + header.offset;
+    EdgeType low = 1;
+    EdgeType high = n;
+    while (low < high) {
+        EdgeType mid = low + (high - low) / 2;
+        if (read_bits(time_stream, static_cast<uint64_t>(mid) * header.time_bits, header.time_bits) < target) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return block_start + low;
+}
+
+template <typename Types>
+typename CompressedTemporalGraphT<Types>::TimeType CompressedTemporalGraphT<Types>::entry_time(const NodeCursor& cursor, EdgeType i) const {
+    uint64_t key;
+    if (cursor.group != nullptr) {
+        const GroupHeader& group = *cursor.group;
+        uint64_t bit = (cursor.first_entry + static_cast<uint64_t>(i)) * (group.time_bits + group.node_bits + group.idx_bits);
+        key = group.time_base + read_bits(data + group.offset, bit, group.time_bits);
+    } else {
+        const BlockHeader& header = blocks[cursor.first_block + i / COMPRESSED_BLOCK_SIZE];
+        uint64_t k = static_cast<uint64_t>(i % COMPRESSED_BLOCK_SIZE);
+        key = header.time_base + read_bits(data + header.offset, k * header.time_bits, header.time_bits);
+    }
+    return radix_value<TimeType>(static_cast<TimeKey>(key));
+}
+
+template <typename Types>
+typename CompressedTemporalGraphT<Types>::NodeType CompressedTemporalGraphT<Types>::entry_node(const NodeCursor& cursor, EdgeType i) const {
+    uint64_t key;
+    if (cursor.group != nullptr) {
+        const GroupHeader& group = *cursor.group;
+        uint64_t bit = (cursor.first_entry + static_cast<uint64_t>(i)) * (group.time_bits + group.node_bits + group.idx_bits);
+        key = group.node_base + read_bits(data + group.offset, bit + group.time_bits, group.node_bits);
+    } else {
+        EdgeType block_start = i - i % COMPRESSED_BLOCK_SIZE;
+        const BlockHeader& header = blocks[cursor.first_block + i / COMPRESSED_BLOCK_SIZE];
+        uint64_t n = static_cast<uint64_t>(min(static_cast<EdgeType>(COMPRESSED_BLOCK_SIZE), cursor.length - block_start));
+        const uint8_t* stream = data + header.offset + stream_bytes(n, header.time_bits);
+        key = header.node_base + read_bits(stream, static_cast<uint64_t>(i - block_start) * header.node_bits, header.node_bits);
+    }
+    return radix_value<NodeType>(static_cast<NodeKey>(key));
+}
+
+template <typename Types>
+typename CompressedTemporalGraphT<Types>::EdgeType CompressedTemporalGraphT<Types>::entry_idx(const NodeCursor& cursor, EdgeType i) const {
+    uint64_t key;
+    if (cursor.group != nullptr) {
+        const GroupHeader& group = *cursor.group;
+        uint64_t bit = (cursor.first_entry + static_cast<uint64_t>(i)) * (group.time_bits + group.node_bits + group.idx_bits);
+        key = group.idx_base + read_bits(data + group.offset, bit + group.time_bits + group.node_bits, group.idx_bits);
+    } else {
+        EdgeType block_start = i - i % COMPRESSED_BLOCK_SIZE;
+        const BlockHeader& header = blocks[cursor.first_block + i / COMPRESSED_BLOCK_SIZE];
+        uint64_t n = static_cast<uint64_t>(min(static_cast<EdgeType>(COMPRESSED_BLOCK_SIZE), cursor.length - block_start));
+        const uint8_t* stream = data + header.offset + stream_bytes(n, header.time_bits) + stream_bytes(n, header.node_bits);
+        key = header.idx_base + read_bits(stream, static_cast<uint64_t>(i - block_start) * header.idx_bits, header.idx_bits);
+    }
+    return radix_value<EdgeType>(static_cast<EdgeKey>(key));
+}
+
+// Decode a range entry by entry from the group stream, or block by block, so the headers and
+// stream offsets are looked up once per block
+template <typename Types>
+void CompressedTemporalGraphT<Types>::decode(const NodeCursor& cursor, EdgeType first, EdgeType last, NodeType* neighbors,
+                                             TimeType* neighbor_times, EdgeType* neighbor_idx) const {
+    if (cursor.group != nullptr) {
+        const GroupHeader& group = *cursor.group;
+        int entry_bits = group.time_bits + group.node_bits + group.idx_bits;
+        const uint8_t* stream = data + group.offset;
+        uint64_t bit = (cursor.first_entry + static_cast<uint64_t>(first)) * entry_bits;
+        for (EdgeType i = first; i < last; ++i, bit += entry_bits) {
+            size_t out = static_cast<size_t>(i - first);
+            neighbor_times[out] = radix_value<TimeType>(static_cast<TimeKey>(group.time_base + read_bits(stream, bit, group.time_bits)));
+            neighbors[out] = radix_value<NodeType>(static_cast<NodeKey>(
+                group.node_base + read_bits(stream, bit + group.time_bits, group.node_bits)));
+            neighbor_idx[out] = radix_value<EdgeType>(static_cast<EdgeKey>(
+                group.idx_base + read_bits(stream, bit + group.time_bits + group.node_bits, group.idx_bits)));
+        }
+        return;
+    }
+
+    EdgeType i = first;
+    while (i < last) {
+        EdgeType block_start = i - i % COMPRESSED_BLOCK_SIZE;
+        const BlockHeader& header = blocks[cursor.first_block + i / COMPRESSED_BLOCK_SIZE];
+        uint64_t n = static_cast<uint64_t>(min(static_cast<EdgeType>(COMPRESSED_BLOCK_SIZE), cursor.length - block_start));
+        const uint8_t* time_stream = data + header.offset;
+        const uint8_t* node_stream = time_stream + stream_bytes(n, header.time_bits);
+        const uint8_t* idx_stream = node_stream + stream_bytes(n, header.node_bits);
+        EdgeType block_end = min(last, static_cast<EdgeType>(block_start + COMPRESSED_BLOCK_SIZE));
+        for (; i < block_end; ++i) {
+            uint64_t k = static_cast<uint64_t>(i - block_start);
+            size_t out = static_cast<size_t>(i - first);
+            neighbor_times[out] = radix_value<TimeType>(static_cast<TimeKey>(
+                header.time_base + read_bits(time_stream, k * header.time_bits, header.time_bits)));
+            neighbors[out] = radix_value<NodeType>(static_cast<NodeKey>(
+                header.node_base + read_bits(node_stream, k * header.node_bits, header.node_bits)));
+            neighbor_idx[out] = radix_value<EdgeType>(static_cast<EdgeKey>(
+                header.idx_base + read_bits(idx_stream, k * header.idx_bits, header.idx_bits)));
+        }
+    }
+}
+
+template <typename Types>
+typename CompressedTemporalGraphT<Types>::EdgeType CompressedTemporalGraphT<Types>::cutoff(NodeType node, TimeType time) const {
+    return cutoff(locate(node), time);
+}
+
+template <typename Types>
+typename CompressedTemporalGraphT<Types>::TimeType CompressedTemporalGraphT<Types>::entry_time(NodeType node, EdgeType i) const {
+    return entry_time(locate(node), i);
+}
+
+template <typename Types>
+typename CompressedTemporalGraphT<Types>::NodeType CompressedTemporalGraphT<Types>::entry_node(NodeType node, EdgeType i) const {
+    return entry_node(locate(node), i);
+}
+
+template <typename Types>
+typename CompressedTemporalGraphT<Types>::EdgeType CompressedTemporalGraphT<Types>::entry_idx(NodeType node, EdgeType i) const {
+    return entry_idx(locate(node), i);
+}
+
+template <typename Types>
+void CompressedTemporalGraphT<Types>::decode(NodeType node, EdgeType first, EdgeType last, NodeType* neighbors,
+                                             TimeType* neighbor_times, EdgeType* neighbor_idx) const {
+    decode(locate(node), first, last, neighbors, neighbor_times, neighbor_idx);
+}
+
+// sample_slice_before on the compressed adjacency: the same positions, decoded where they are used
+template <typename Types>
+template <SampleStrategy S>
+typename CompressedTemporalGraphT<Types>::EdgeType CompressedTemporalGraphT<Types>::sample_node(
+        NodeType node, TimeType time, EdgeType sample_num, CounterRng& rng,
+        NodeType* neighbors, TimeType* neighbor_times, EdgeType* neighbor_idx) const {
+    NodeCursor cursor = locate(node);
+    EdgeType end = cutoff(cursor, time);
+    EdgeType start = 0;
+
+    if (S == SAMPLE_WINDOW) {
+        // First edge in [time - time_window, time)
+        double window_start = time - sample_params.time_window;
+        EdgeType high = end;
+        while (start < high) {
+            EdgeType mid = start + (high - start) / 2;
+            if (entry_time(cursor, mid) < window_start) {
+                start = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+    }
+
+    EdgeType available = end - start;
+    if (S == SAMPLE_NONE || available <= 0 || sample_num <= 0) {
+        return 0;
+    }
+    EdgeType count = min(sample_num, available);
+
+    if (S == SAMPLE_RECENT || count == available) {
+        decode(cursor, end - count, end, neighbors, neighbor_times, neighbor_idx);
+        return count;
+    }
+
+    EdgeType* positions = neighbor_idx;
+    if (S == SAMPLE_RANDOM || S == SAMPLE_WINDOW) {
+        sample_positions(rng, start, available, count, positions);
+    } else if (S == SAMPLE_DECAY) {
+        double decay_rate = sample_params.decay_rate;
+        TimeType latest = entry_time(cursor, end - 1);
+        sample_weighted_positions<true>(rng, start, end, count, [&](EdgeType i) {
+            return exp(-decay_rate * static_cast<double>(latest - entry_time(cursor, i)));
+        }, positions);
+    } else if (S == SAMPLE_INVERSE_DEGREE) {
+        sample_weighted_positions<false>(rng, start, end, count, [&](EdgeType i) {
+            return 1.0 / max(degree(entry_node(cursor, i)), static_cast<EdgeType>(1));
+        }, positions);
+    }
+
+    // positions alias neighbor_idx, so read each position before writing its row entry
+    for (EdgeType i = 0; i < count; ++i) {
+        EdgeType position = positions[i];
+        neighbors[i] = entry_node(cursor, position);
+        neighbor_times[i] = entry_time(cursor, position);
+        neighbor_idx[i] = entry_idx(cursor, position);
+    }
+    return count;
+}
+
+template <typename Types>
+typename CompressedTemporalGraphT<Types>::EdgeType CompressedTemporalGraphT<Types>::sample_node(
+        SampleStrategy strategy, NodeType node, TimeType time, EdgeType sample_num, uint64_t stream,
+        NodeType* neighbors, TimeType* neighbor_times, EdgeType* neighbor_idx) const {
+    CounterRng rng(random_seed, stream);
+    switch (strategy) {
+        case SAMPLE_RECENT:
+            return sample_node<SAMPLE_RECENT>(node, time, sample_num, rng, neighbors, neighbor_times, neighbor_idx);
+        case SAMPLE_RANDOM:
+            return sample_node<SAMPLE_RANDOM>(node, time, sample_num, rng, neighbors, neighbor_times, neighbor_idx);
+        case SAMPLE_WINDOW:
+            return sample_node<SAMPLE_WINDOW>(node, time, sample_num, rng, neighbors, neighbor_times, neighbor_idx);
+        case SAMPLE_DECAY:
+            return sample_node<SAMPLE_DECAY>(node, time, sample_num, rng, neighbors, neighbor_times, neighbor_idx);
+        case SAMPLE_INVERSE_DEGREE:
+            return sample_node<SAMPLE_INVERSE_DEGREE>(node, time, sample_num, rng, neighbors, neighbor_times, neighbor_idx);
+        default:
+            return 0;
+    }
+}
+
+template <typename Types>
+void CompressedTemporalGraphT<Types>::get_neighbors(NodeType node, TimeType time, vector<NodeType>& neighbors,
+                                                    vector<TimeType>& neighbor_times, vector<EdgeType>& neighbor_idx,
+                                                    EdgeType sample_num, const string& sample_strategy) const {
+    size_t capacity = max(sample_num, static_cast<EdgeType>(0));
+    neighbors.resize(capacity);
+    neighbor_times.resize(capacity);
+    neighbor_idx.resize(capacity);
+    EdgeType count = sample_node(parse_sample_strategy(sample_strategy), node, time, sample_num, row_stream(next_batch_id(), 0),
+                                 neighbors.data(), neighbor_times.data(), neighbor_idx.data());
+    neighbors.resize(count);
+    neighbor_times.resize(count);
+    neighbor_idx.resize(count);
+}
+
+// Rows are independent and cost about the same after the block skip, so a plain parallel loop
+template <typename Types>
+double CompressedTemporalGraphT<Types>::sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                                                      NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                                                      EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                                                      EdgeType sample_num, SampleStrategy sample_strategy) const {
+    double start_time = omp_get_wtime();
+    uint64_t batch_id = next_batch_id();
+
+    #pragma omp parallel for
+    for (size_t b = 0; b < batch_size; ++b) {
+        size_t row = b * sample_num;
+        EdgeType count = sample_node(sample_strategy, batch_node_id[b], batch_node_time[b], sample_num, row_stream(batch_id, b),
+                                     batch_neighbors + row, batch_neighbor_times + row, batch_neighbor_idx + row);
+        batch_counts[b] = count;
+        pad_row(count, sample_num, batch_neighbors + row, batch_neighbor_times + row, batch_neighbor_idx + row);
+    }
+
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+double CompressedTemporalGraphT<Types>::sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                                                 SampleBuffers<Types>& buffers, EdgeType sample_num, const string& sample_strategy) const {
+    buffers.resize(batch_node_id.size(), sample_num);
+    return sampling_into(batch_node_id.data(), batch_node_time.data(), batch_node_id.size(),
+                         buffers.neighbors.data(), buffers.neighbor_times.data(), buffers.neighbor_idx.data(),
+                         buffers.counts.data(), sample_num, parse_sample_strategy(sample_strategy));
+}
+
+template class CompressedTemporalGraphT<TGNGraphTypes>;
+template class CompressedTemporalGraphT<TGLGraphTypes>;
@@ -0,0 +1,221 @@
+// compressed_csr.h - Bit-packed T-CSR for graphs whose arrays do not fit in memory
+#ifndef COMPRESSED_CSR_H
+#define COMPRESSED_CSR_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <memory>
+#include "utils.h"
+#include "radix_sort.h"
+#include "sampler_kernels.h"
+#include "csr_snapshot.h"
+#include "TemporalGraph.h"
+
+using namespace std;
+
+// Entries per compressed block; the cutoff search skips whole blocks by their first time. Nodes
+// with more entries are stored in blocks, the others inline in their node group.
+const int COMPRESSED_BLOCK_SIZE = 128;
+// Consecutive nodes whose short adjacencies share one bit-packed stream and frame of reference
+const int COMPRESSED_GROUP_BITS = 6;
+const size_t COMPRESSED_GROUP_SIZE = static_cast<size_t>(1) << COMPRESSED_GROUP_BITS;
+
+/*
+Layout of a compressed T-CSR file (native byte order):
+  CompressedCsrHeader
+  indptr      [num_nodes + 1]
+  groups      [num_groups] group headers
+  block_times [num_blocks]
+  blocks      [num_blocks] block headers
+  data        bit-packed streams, padded
+Sections start at multiples of CSR_SNAPSHOT_ALIGNMENT and are used in place after mmap, like a
+binary T-CSR snapshot.
+*/
+const uint32_t COMPRESSED_CSR_VERSION = 1;
+
+enum CompressedCsrSection {
+    COMPRESSED_SECTION_INDPTR = 0,
+    COMPRESSED_SECTION_GROUPS = 1,
+    COMPRESSED_SECTION_BLOCK_TIMES = 2,
+    COMPRESSED_SECTION_BLOCKS = 3,
+    COMPRESSED_SECTION_DATA = 4,
+    COMPRESSED_NUM_SECTIONS = 5
+};
+
+struct CompressedCsrHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    // Entry widths and flags as in CsrSnapshotHeader
+    uint32_t node_width;
+    uint32_t edge_width;
+    uint32_t time_width;
+    uint32_t flags;
+    uint64_t num_nodes;
+    uint64_t num_edges;
+    uint64_t num_blocks;
+    uint64_t section_offset[COMPRESSED_NUM_SECTIONS];
+    uint64_t section_bytes[COMPRESSED_NUM_SECTIONS];
+    uint64_t section_checksum[COMPRESSED_NUM_SECTIONS];
+    // Checksum over all preceding header bytes
+    uint64_t header_checksum;
+};
+
+/*
+Compressed copy of a T-CSR. Values are stored as bit-packed offsets from a base (frame of
+reference), each with the fewest bits that hold its range. Time values are packed through their
+order-preserving radix_key, so float and double times are stored exactly.
+  - Nodes with up to COMPRESSED_BLOCK_SIZE entries are stored inline: the entries of the short
+    nodes of each group of COMPRESSED_GROUP_SIZE consecutive nodes form one stream of interleaved
+    (time, neighbor, edge id) fields under one group header, so a short node costs no header, no
+    block index and no offset of its own; its place in the stream follows from indptr. The cutoff
+    search is a binary search in the stream.
+  - Longer nodes are cut into blocks of COMPRESSED_BLOCK_SIZE entries with their own bases and
+    widths, where sorted times become small offsets from the block's first time. The cutoff
+    search finds the block by a dense array of first times and then searches inside the block.
+Fixed widths keep every entry addressable without decoding its neighbors, so the random
+strategies decode only the entries they pick. The ratio depends on the graph: hubs compress
+well in blocks, while sparse graphs gain mostly from the narrower neighbor and edge ids.
+
+Sampling gives the same results as TemporalGraphT (same seed, strategies and batch sequence,
+batches in input order). The source graph can be dropped once compressed, and an mmap-loaded
+snapshot (load_csr_binary) is compressed without reading it into memory first. save/load write
+and map the compressed arrays, so a compressed graph is built once.
+*/
+template <typename Types>
+class CompressedTemporalGraphT {
+public:
+    typedef Types TypeConfig;
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+    typedef decltype(radix_key(TimeType())) TimeKey;
+
+private:
+    typedef typename make_unsigned<NodeType>::type NodeKey;
+    typedef typename make_unsigned<EdgeType>::type EdgeKey;
+
+    // Stream of the short nodes of a group at offset in data, and the first block of its long
+    // nodes (long_mask: bit i for node i of the group)
+    struct GroupHeader {
+        uint64_t offset;
+        uint64_t long_mask;
+        uint64_t first_block;
+        TimeKey time_base;
+        NodeKey node_base;
+        EdgeKey idx_base;
+        uint8_t time_bits;
+        uint8_t node_bits;
+        uint8_t idx_bits;
+    };
+
+    // Bases (as radix keys) and bit widths of one block; its streams start at offset in data
+    struct BlockHeader {
+        uint64_t offset;
+        TimeKey time_base;
+        NodeKey node_base;
+        EdgeKey idx_base;
+        uint8_t time_bits;
+        uint8_t node_bits;
+        uint8_t idx_bits;
+    };
+
+    // Where the entries of one node are: a run of its group's stream, or blocks of its own
+    struct NodeCursor {
+        EdgeType length;
+        const GroupHeader* group;  // inline nodes
+        uint64_t first_entry;      // inline: position in the group stream
+        uint64_t first_block;      // long nodes
+    };
+
+    // Owned arrays after compress(); load() maps the file instead
+    vector<EdgeType> indptr_storage;
+    vector<GroupHeader> group_storage;
+    vector<TimeType> block_time_storage;
+    vector<BlockHeader> block_storage;
+    vector<uint8_t> data_storage;
+    shared_ptr<MappedFile> file;
+
+    // Entries of node v are [indptr[v], indptr[v + 1])
+    const EdgeType* indptr;
+    const GroupHeader* groups;
+    const TimeType* block_times;
+    const BlockHeader* blocks;
+    const uint8_t* data;
+    size_t num_nodes;
+    size_t num_blocks;
+    size_t data_bytes;
+    bool reverse;
+
+    uint64_t random_seed;
+    mutable atomic<uint64_t> batch_counter;
+    SampleParams sample_params;
+
+    uint64_t next_batch_id() const;
+    void bind_storage();
+    NodeCursor locate(NodeType node) const;
+    EdgeType cutoff(const NodeCursor& cursor, TimeType time) const;
+    TimeType entry_time(const NodeCursor& cursor, EdgeType i) const;
+    NodeType entry_node(const NodeCursor& cursor, EdgeType i) const;
+    EdgeType entry_idx(const NodeCursor& cursor, EdgeType i) const;
+    void decode(const NodeCursor& cursor, EdgeType first, EdgeType last, NodeType* neighbors, TimeType* neighbor_times,
+                EdgeType* neighbor_idx) const;
+    template <SampleStrategy S>
+    EdgeType sample_node(NodeType node, TimeType time, EdgeType sample_num, CounterRng& rng,
+                         NodeType* neighbors, TimeType* neighbor_times, EdgeType* neighbor_idx) const;
+    EdgeType sample_node(SampleStrategy strategy, NodeType node, TimeType time, EdgeType sample_num, uint64_t stream,
+                         NodeType* neighbors, TimeType* neighbor_times, EdgeType* neighbor_idx) const;
+
+    CompressedTemporalGraphT(const CompressedTemporalGraphT&) = delete;
+    CompressedTemporalGraphT& operator=(const CompressedTemporalGraphT&) = delete;
+
+public:
+    CompressedTemporalGraphT();
+    // Encode the T-CSR of graph, which must be converted (or loaded). Returns the elapsed time in seconds.
+    double compress(const TemporalGraphT<Types>& graph);
+    // Write the compressed arrays to file_path (through a .partial file), or map a file written by
+    // save; load fails for files of another type configuration
+    bool save(const string& file_path) const;
+    bool load(const string& file_path, bool verify_checksums = false);
+
+    size_t get_num_nodes() const { return num_nodes; }
+    size_t get_num_edges() const { return indptr == nullptr ? 0 : static_cast<size_t>(indptr[num_nodes]); }
+    bool is_reverse() const { return reverse; }
+    // Bytes of the compressed representation, and of the four T-CSR arrays it replaces
+    size_t compressed_bytes() const;
+    size_t uncompressed_bytes() const;
+
+    void set_random_seed(uint64_t seed);
+    void set_sample_params(const SampleParams& params);
+
+    // Node ids outside [0, get_num_nodes()) have no neighbors: degree 0 and empty sampled rows
+    EdgeType degree(NodeType node) const {
+        if (node < 0 || static_cast<size_t>(node) >= num_nodes) {
+            return 0;
+        }
+        return indptr[node + 1] - indptr[node];
+    }
+    // Number of edges of node before time
+    EdgeType cutoff(NodeType node, TimeType time) const;
+    // Entry i of the time-ordered adjacency of node
+    TimeType entry_time(NodeType node, EdgeType i) const;
+    NodeType entry_node(NodeType node, EdgeType i) const;
+    EdgeType entry_idx(NodeType node, EdgeType i) const;
+    // Decode entries [first, last) of node
+    void decode(NodeType node, EdgeType first, EdgeType last, NodeType* neighbors, TimeType* neighbor_times, EdgeType* neighbor_idx) const;
+
+    // Same semantics as the TemporalGraphT functions of the same names
+    void get_neighbors(NodeType node, TimeType time, vector<NodeType>& neighbors, vector<TimeType>& neighbor_times,
+                       vector<EdgeType>& neighbor_idx, EdgeType sample_num, const string& sample_strategy) const;
+    double sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                         NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                         EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                         EdgeType sample_num, SampleStrategy sample_strategy) const;
+    double sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                    SampleBuffers<Types>& buffers, EdgeType sample_num = 32, const string& sample_strategy = "recent") const;
+};
+
+typedef CompressedTemporalGraphT<TGNGraphTypes> CompressedTemporalGraph;
+
+#endif // COMPRESSED_CSR_H
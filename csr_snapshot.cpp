@@ -0,0 +1,234 @@
+// csr_snapshot.cpp - Binary T-CSR snapshot format and read-only memory-mapped files
+#include "csr_snapshot.h"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <omp.h>
+
+static const char CSR_SNAPSHOT_MAGIC[8] = {'T', 'G', 'C', 'S', 'R', 'B', 'I', 'N'};
+
+// Blocks are hashed independently (in parallel) and the block hashes are hashed again
+static const size_t CHECKSUM_BLOCK_BYTES = 1 << 20;
+static const uint64_t FNV_OFFSET_BASIS = 1469598103934665603ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+MappedFile::MappedFile() : data_(nullptr), size_(0) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const string& file_path, bool populate) {
+    close();
+
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "Failed to open " << file_path << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        cerr << "Failed to stat " << file_path << ": " << strerror(errno) << endl;
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        // mmap rejects empty ranges; an empty file is represented by a null mapping
+        ::close(fd);
+        return true;
+    }
+
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (populate) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        cerr << "Failed to mmap " << file_path << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    data_ = addr;
+    size_ = st.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) {
+        munmap(data_, size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+void MappedFile::release(size_t offset, size_t bytes) const {
+    if (data_ == nullptr || bytes == 0) {
+        return;
+    }
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = min(offset + bytes, size_) / page * page;
+    if (begin < end) {
+        madvise(static_cast<char*>(data_) + begin, end - begin, MADV_DONTNEED);
+    }
+}
+
+void init_csr_snapshot_header(CsrSnapshotHeader& header) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CSR_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = CSR_SNAPSHOT_VERSION;
+    header.header_size = sizeof(CsrSnapshotHeader);
+}
+
+uint64_t csr_snapshot_section_offset(uint64_t previous_offset, uint64_t previous_bytes) {
+    uint64_t end = previous_offset + previous_bytes;
+    return (end + CSR_SNAPSHOT_ALIGNMENT - 1) / CSR_SNAPSHOT_ALIGNMENT * CSR_SNAPSHOT_ALIGNMENT;
+}
+
+bool check_csr_snapshot_header(const CsrSnapshotHeader& header, size_t file_size, string& error) {
+    if (memcmp(header.magic, CSR_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        error = "not a binary T-CSR snapshot";
+        return false;
+    }
+    if (header.version != CSR_SNAPSHOT_VERSION || header.header_size != sizeof(CsrSnapshotHeader)) {
+        error = "unsupported snapshot version " + to_string(header.version);
+        return false;
+    }
+    if (header.header_checksum != snapshot_checksum(&header, offsetof(CsrSnapshotHeader, header_checksum))) {
+        error = "header checksum mismatch";
+        return false;
+    }
+
+    // Bound every count by the bytes after its offset before multiplying, so a corrupt header cannot
+    // wrap num_nodes + 1, count * width or offset + bytes around to a size that fits the file
+    if (header.num_nodes >= file_size) {
+        error = "section 0 lies outside the file";
+        return false;
+    }
+    const uint64_t entries[CSR_NUM_SECTIONS] = {header.num_nodes + 1, header.num_edges, header.num_edges, header.num_edges};
+    const uint64_t widths[CSR_NUM_SECTIONS] = {header.edge_width, header.node_width, header.time_width, header.edge_width};
+    for (int s = 0; s < CSR_NUM_SECTIONS; ++s) {
+        uint64_t offset = header.section_offset[s];
+        if (offset % CSR_SNAPSHOT_ALIGNMENT != 0 || offset > file_size ||
+            (widths[s] != 0 && entries[s] > (file_size - offset) / widths[s]) || header.section_bytes[s] > file_size - offset) {
+            error = "section " + to_string(s) + " lies outside the file";
+            return false;
+        }
+        if (header.section_bytes[s] != entries[s] * widths[s]) {
+            error = "section " + to_string(s) + " has an inconsistent size";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool read_csr_snapshot_header(const string& file_path, CsrSnapshotHeader& header) {
+    ifstream file(file_path, ios::binary | ios::ate);
+    if (!file) {
+        cerr << "Failed to open " << file_path << ": " << strerror(errno) << endl;
+        return false;
+    }
+    size_t file_size = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+    if (file_size < sizeof(CsrSnapshotHeader) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        cerr << "Failed to load " << file_path << ": file is too small" << endl;
+        return false;
+    }
+    string error;
+    if (!check_csr_snapshot_header(header, file_size, error)) {
+        cerr << "Failed to load " << file_path << ": " << error << endl;
+        return false;
+    }
+    return true;
+}
+
+static inline uint64_t fnv1a_mix(uint64_t hash, uint64_t word) {
+    return (hash ^ word) * FNV_PRIME;
+}
+
+static uint64_t fnv1a_block(const char* data, size_t bytes) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    size_t words = bytes / sizeof(uint64_t);
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t word;
+        memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+        hash = fnv1a_mix(hash, word);
+    }
+    for (size_t i = words * sizeof(uint64_t); i < bytes; ++i) {
+        hash = fnv1a_mix(hash, static_cast<unsigned char>(data[i]));
+    }
+    return hash;
+}
+
+uint64_t snapshot_checksum(const void* data, size_t bytes) {
+    const char* bytes_ptr = static_cast<const char*>(data);
+    size_t num_blocks = (bytes + CHECKSUM_BLOCK_BYTES - 1) / CHECKSUM_BLOCK_BYTES;
+    if (num_blocks <= 1) {
+        return fnv1a_mix(fnv1a_block(bytes_ptr, bytes), bytes);
+    }
+
+    vector<uint64_t> block_hashes(num_blocks);
+    #pragma omp parallel for schedule(static)
+    for (long long b = 0; b < static_cast<long long>(num_blocks); ++b) {
+        size_t begin = b * CHECKSUM_BLOCK_BYTES;
+        size_t len = min(CHECKSUM_BLOCK_BYTES, bytes - begin);
+        block_hashes[b] = fnv1a_block(bytes_ptr + begin, len);
+    }
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (uint64_t h : block_hashes) {
+        hash = fnv1a_mix(hash, h);
+    }
+    return fnv1a_mix(hash, bytes);
+}
+
+SnapshotChecksum::SnapshotChecksum() : pending(), block_hashes(), bytes(0) {
+    pending.reserve(CHECKSUM_BLOCK_BYTES);
+}
+
+void SnapshotChecksum::update(const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    bytes += size;
+    while (size > 0) {
+        size_t n = min(size, CHECKSUM_BLOCK_BYTES - pending.size());
+        if (pending.empty() && n == CHECKSUM_BLOCK_BYTES) {
+            // Whole blocks are hashed in place
+            block_hashes.push_back(fnv1a_block(p, n));
+        } else {
+            pending.insert(pending.end(), p, p + n);
+            if (pending.size() == CHECKSUM_BLOCK_BYTES) {
+                block_hashes.push_back(fnv1a_block(pending.data(), pending.size()));
+                pending.clear();
+            }
+        }
+        p += n;
+        size -= n;
+    }
+}
+
+uint64_t SnapshotChecksum::finish() const {
+    size_t num_blocks = block_hashes.size() + (pending.empty() ? 0 : 1);
+    if (num_blocks <= 1) {
+        uint64_t hash = block_hashes.empty() ? fnv1a_block(pending.data(), pending.size()) : block_hashes[0];
+        return fnv1a_mix(hash, bytes);
+    }
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (uint64_t h : block_hashes) {
+        hash = fnv1a_mix(hash, h);
+    }
+    if (!pending.empty()) {
+        hash = fnv1a_mix(hash, fnv1a_block(pending.data(), pending.size()));
+    }
+    return fnv1a_mix(hash, bytes);
+}
@@ -0,0 +1,107 @@
+// csr_snapshot.h - Binary T-CSR snapshot format and read-only memory-mapped files
+#ifndef CSR_SNAPSHOT_H
+#define CSR_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "utils.h"
+
+using namespace std;
+
+/*
+Layout of a binary T-CSR snapshot file (native byte order):
+  CsrSnapshotHeader
+  indptr      [num_nodes + 1]
+  indices     [num_edges]
+  time_values [num_edges]
+  idx_values  [num_edges]
+Every section starts at a multiple of CSR_SNAPSHOT_ALIGNMENT, so the arrays can be used
+in place after mmap without any parsing or copying.
+*/
+
+const uint32_t CSR_SNAPSHOT_VERSION = 1;
+const uint64_t CSR_SNAPSHOT_ALIGNMENT = 64;
+
+// Header flags
+const uint32_t CSR_FLAG_REVERSE = 1u << 0;
+// time_values holds IEEE floating point numbers rather than integers
+const uint32_t CSR_FLAG_FLOAT_TIME = 1u << 1;
+
+enum CsrSection {
+    CSR_SECTION_INDPTR = 0,
+    CSR_SECTION_INDICES = 1,
+    CSR_SECTION_TIME_VALUES = 2,
+    CSR_SECTION_IDX_VALUES = 3,
+    CSR_NUM_SECTIONS = 4
+};
+
+struct CsrSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    // Width in bytes of one entry of indices, of indptr/idx_values, and of time_values; together
+    // with CSR_FLAG_FLOAT_TIME they identify the type configuration the snapshot was written with
+    uint32_t node_width;
+    uint32_t edge_width;
+    uint32_t time_width;
+    uint32_t flags;
+    uint64_t num_nodes;
+    uint64_t num_edges;
+    uint64_t section_offset[CSR_NUM_SECTIONS];
+    uint64_t section_bytes[CSR_NUM_SECTIONS];
+    uint64_t section_checksum[CSR_NUM_SECTIONS];
+    // Checksum over all preceding header bytes
+    uint64_t header_checksum;
+};
+
+// Read-only, shared memory mapping of a whole file; all processes mapping the same
+// snapshot share one page-cache copy of it.
+class MappedFile {
+private:
+    void* data_;
+    size_t size_;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const string& file_path, bool populate = false);
+    void close();
+    // Drop the resident pages of [offset, offset + bytes) that are not shared with the rest of the
+    // file; they are read in again if touched
+    void release(size_t offset, size_t bytes) const;
+
+    const char* data() const { return static_cast<const char*>(data_); }
+    size_t size() const { return size_; }
+    bool is_open() const { return data_ != nullptr; }
+};
+
+void init_csr_snapshot_header(CsrSnapshotHeader& header);
+bool check_csr_snapshot_header(const CsrSnapshotHeader& header, size_t file_size, string& error);
+// Read and check only the header of a snapshot file, e.g. to pick the type configuration to load it with
+bool read_csr_snapshot_header(const string& file_path, CsrSnapshotHeader& header);
+uint64_t csr_snapshot_section_offset(uint64_t previous_offset, uint64_t previous_bytes);
+
+// Block-wise 64-bit FNV-1a checksum; the result does not depend on the number of threads.
+uint64_t snapshot_checksum(const void* data, size_t bytes);
+
+// snapshot_checksum of data that arrives in pieces, e.g. a section written out while it is built.
+// Holds at most one checksum block of pending bytes.
+class SnapshotChecksum {
+private:
+    vector<char> pending;
+    vector<uint64_t> block_hashes;
+    uint64_t bytes;
+
+public:
+    SnapshotChecksum();
+    void update(const void* data, size_t size);
+    uint64_t finish() const;
+};
+
+#endif // CSR_SNAPSHOT_H
@@ -0,0 +1,340 @@
+// csr_validator.cpp - Consistency checks and statistics of a T-CSR
+#include "csr_validator.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <omp.h>
+
+// Describe a violation in report.errors while fewer than max_errors were described
+static void add_error(CsrReport& report, atomic<size_t>& error_slots, size_t max_errors, const string& message) {
+    if (error_slots.fetch_add(1, memory_order_relaxed) >= max_errors) {
+        return;
+    }
+    #pragma omp critical(csr_validator_errors)
+    report.errors.push_back(message);
+}
+
+// Bucket of the inter-event time histogram for a gap > 0
+static int gap_bucket(double gap) {
+    if (!(gap > 0)) {
+        return 0;
+    }
+    if (std::isinf(gap)) {
+        return GAP_BUCKETS - 1;
+    }
+    int bucket = ilogb(gap) - GAP_MIN_EXPONENT + 1;
+    return min(max(bucket, 1), GAP_BUCKETS - 1);
+}
+
+static int degree_bucket(uint64_t degree) {
+    return degree == 0 ? 0 : 64 - __builtin_clzll(degree);
+}
+
+template <typename Types>
+bool validate_temporal_graph(const TemporalGraphT<Types>& graph, const ValidateOptions& options, CsrReport& report) {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+    double start_time = omp_get_wtime();
+    report = CsrReport();
+    const EdgeType* indptr = graph.get_indptr();
+    const NodeType* indices = graph.get_indices();
+    const TimeType* time_values = graph.get_time_values();
+    const EdgeType* idx_values = graph.get_idx_values();
+    uint64_t n = graph.get_num_nodes();
+    uint64_t m = graph.get_num_edges();
+    report.num_nodes = n;
+    report.num_edges = m;
+    report.reverse = graph.is_reverse();
+    if (indptr == nullptr) {
+        report.errors.push_back("the graph has no T-CSR");
+        report.seconds = omp_get_wtime() - start_time;
+        return false;
+    }
+    atomic<size_t> error_slots(0);
+    size_t max_errors = options.max_errors;
+
+    // Offsets first: the row checks below index the arrays through them
+    uint64_t bad_offsets = 0;
+    if (indptr[0] != 0) {
+        ++bad_offsets;
+        add_error(report, error_slots, max_errors, "indptr[0] = " + to_string(indptr[0]) + ", not 0");
+    }
+    #pragma omp parallel for reduction(+ : bad_offsets)
+    for (uint64_t v = 0; v < n; ++v) {
+        if (indptr[v + 1] < indptr[v] || indptr[v + 1] < 0 || static_cast<uint64_t>(indptr[v + 1]) > m) {
+            ++bad_offsets;
+            add_error(report, error_slots, max_errors,
+                      "indptr[" + to_string(v + 1) + "] = " + to_string(indptr[v + 1]) + " after " + to_string(indptr[v]) +
+                      " (num_edges " + to_string(m) + ")");
+        }
+    }
+    if (bad_offsets == 0 && static_cast<uint64_t>(indptr[n]) != m) {
+        ++bad_offsets;
+        add_error(report, error_slots, max_errors,
+                  "indptr[" + to_string(n) + "] = " + to_string(indptr[n]) + ", not num_edges " + to_string(m));
+    }
+    report.bad_offsets = bad_offsets;
+    if (bad_offsets > 0) {
+        report.seconds = omp_get_wtime() - start_time;
+        return false;
+    }
+
+    // Rows: neighbor ids, time order and the statistics
+    vector<EdgeType> degrees(n);
+    uint64_t bad_indices = 0;
+    uint64_t unsorted_times = 0;
+    uint64_t isolated_nodes = 0;
+    double min_time = numeric_limits<double>::infinity();
+    double max_time = -numeric_limits<double>::infinity();
+    double gap_sum = 0;
+    uint64_t gap_count = 0;
+    report.degree_histogram.assign(65, 0);
+    report.gap_histogram.assign(GAP_BUCKETS, 0);
+    vector<pair<uint64_t, uint64_t>> hubs;  // (degree, node) candidates of all threads
+    size_t num_hubs = options.num_hubs;
+    #pragma omp parallel reduction(+ : bad_indices, unsorted_times, isolated_nodes, gap_sum, gap_count) \
+        reduction(min : min_time) reduction(max : max_time)
+    {
+        vector<uint64_t> degree_histogram(65, 0);
+        vector<uint64_t> gap_histogram(GAP_BUCKETS, 0);
+        // Min-heap of the thread's highest degrees
+        vector<pair<uint64_t, uint64_t>> heap;
+        greater<pair<uint64_t, uint64_t>> heap_order;
+        #pragma omp for schedule(dynamic, 1024)
+        for (uint64_t v = 0; v < n; ++v) {
+            EdgeType begin = indptr[v];
+            EdgeType end = indptr[v + 1];
+            uint64_t degree = static_cast<uint64_t>(end - begin);
+            degrees[v] = end - begin;
+            isolated_nodes += degree == 0 ? 1 : 0;
+            ++degree_histogram[degree_bucket(degree)];
+            if (num_hubs > 0 && (heap.size() < num_hubs || degree > heap.front().first)) {
+                if (heap.size() == num_hubs) {
+                    pop_heap(heap.begin(), heap.end(), heap_order);
+                    heap.pop_back();
+                }
+                heap.push_back(make_pair(degree, v));
+                push_heap(heap.begin(), heap.end(), heap_order);
+            }
+
+            for (EdgeType i = begin; i < end; ++i) {
+                NodeType u = indices[i];
+                if (u < 0 || static_cast<uint64_t>(u) >= n) {
+                    ++bad_indices;
+                    add_error(report, error_slots, max_errors,
+                              "node " + to_string(v) + " entry " + to_string(i) + ": neighbor " + to_string(u) + " out of range");
+                }
+                double t = static_cast<double>(time_values[i]);
+                if (std::isnan(t) || (i > begin && !(t >= static_cast<double>(time_values[i - 1])))) {
+                    ++unsorted_times;
+                    add_error(report, error_slots, max_errors,
+                              "node " + to_string(v) + " entry " + to_string(i) + ": time " + to_string(t) + " out of order");
+                    continue;
+                }
+                min_time = min(min_time, t);
+                max_time = max(max_time, t);
+                if (i > begin) {
+                    double gap = t - static_cast<double>(time_values[i - 1]);
+                    gap_sum += gap;
+                    ++gap_count;
+                    ++gap_histogram[gap_bucket(gap)];
+                }
+            }
+        }
+        #pragma omp critical(csr_validator_merge)
+        {
+            for (int b = 0; b < 65; ++b) {
+                report.degree_histogram[b] += degree_histogram[b];
+            }
+            for (int b = 0; b < GAP_BUCKETS; ++b) {
+                report.gap_histogram[b] += gap_histogram[b];
+            }
+            hubs.insert(hubs.end(), heap.begin(), heap.end());
+        }
+    }
+    report.bad_indices = bad_indices;
+    report.unsorted_times = unsorted_times;
+    report.isolated_nodes = isolated_nodes;
+    report.min_time = m > 0 && min_time <= max_time ? min_time : 0;
+    report.max_time = m > 0 && min_time <= max_time ? max_time : 0;
+    report.mean_gap = gap_count > 0 ? gap_sum / gap_count : 0;
+    while (report.degree_histogram.size() > 1 && report.degree_histogram.back() == 0) {
+        report.degree_histogram.pop_back();
+    }
+
+    sort(hubs.begin(), hubs.end(), [](const pair<uint64_t, uint64_t>& a, const pair<uint64_t, uint64_t>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    for (size_t h = 0; h < hubs.size() && h < num_hubs; ++h) {
+        report.hubs.push_back(make_pair(hubs[h].second, hubs[h].first));
+    }
+    report.mean_degree = n > 0 ? static_cast<double>(m) / n : 0;
+    const double quantiles[3] = {0.5, 0.9, 0.99};
+    uint64_t* percentiles[3] = {&report.degree_p50, &report.degree_p90, &report.degree_p99};
+    for (int q = 0; q < 3 && n > 0; ++q) {
+        size_t rank = min(static_cast<size_t>(quantiles[q] * n), static_cast<size_t>(n - 1));
+        nth_element(degrees.begin(), degrees.begin() + rank, degrees.end());
+        *percentiles[q] = static_cast<uint64_t>(degrees[rank]);
+    }
+    report.max_degree = n > 0 ? static_cast<uint64_t>(*max_element(degrees.begin(), degrees.end())) : 0;
+    vector<EdgeType>().swap(degrees);
+
+    // Edge ids: each appears once per direction. One byte per id counts the appearances, saturating
+    // at fanout + 1 so ids repeated hundreds of times neither wrap to "unseen" nor report again.
+    uint64_t fanout = report.reverse ? 2 : 1;
+    EdgeType max_id = -1;
+    #pragma omp parallel for reduction(max : max_id)
+    for (uint64_t i = 0; i < m; ++i) {
+        max_id = max(max_id, idx_values[i]);
+    }
+    if (options.check_edge_ids && static_cast<uint64_t>(max_id) + 1 <= 4 * max<uint64_t>(m, 1)) {
+        vector<uint8_t> seen(static_cast<size_t>(max_id) + 1, 0);
+        uint64_t bad_edge_ids = 0;
+        #pragma omp parallel for reduction(+ : bad_edge_ids)
+        for (uint64_t i = 0; i < m; ++i) {
+            EdgeType id = idx_values[i];
+            if (id < 0) {
+                ++bad_edge_ids;
+                add_error(report, error_slots, max_errors, "entry " + to_string(i) + ": negative edge id " + to_string(id));
+                continue;
+            }
+            uint8_t count = __atomic_load_n(&seen[id], __ATOMIC_RELAXED);
+            while (count <= fanout &&
+                   !__atomic_compare_exchange_n(&seen[id], &count, static_cast<uint8_t>(count + 1), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            }
+            // Only the thread that moves the count past fanout reports the id
+            if (count == fanout) {
+                ++bad_edge_ids;
+                add_error(report, error_slots, max_errors,
+                          "edge id " + to_string(id) + " appears more than " + to_string(fanout) + " time(s)");
+            }
+        }
+        uint64_t distinct = 0;
+        #pragma omp parallel for reduction(+ : distinct)
+        for (size_t id = 0; id < seen.size(); ++id) {
+            distinct += seen[id] > 0 ? 1 : 0;
+        }
+        report.bad_edge_ids = bad_edge_ids;
+        report.distinct_edge_ids = distinct;
+        report.edge_ids_checked = true;
+    }
+
+    // Mirrors of a reverse graph: the entries (v, u, time, id) and the mirrored (u, v, time, id) are
+    // the same multiset, compared as sums of entry hashes. Only if the sums differ is every entry's
+    // mirror searched for in the neighbor's row, to count and describe the missing ones; that
+    // needs valid neighbor ids and sorted rows.
+    if (report.reverse && options.check_symmetry && bad_indices == 0 && unsorted_times == 0) {
+        uint64_t entry_sum = 0;
+        uint64_t mirror_sum = 0;
+        #pragma omp parallel for schedule(dynamic, 1024) reduction(+ : entry_sum, mirror_sum)
+        for (uint64_t v = 0; v < n; ++v) {
+            for (EdgeType i = indptr[v]; i < indptr[v + 1]; ++i) {
+                uint64_t u = static_cast<uint64_t>(indices[i]);
+                uint64_t edge = mix64(static_cast<uint64_t>(hash<TimeType>()(time_values[i])) ^ mix64(static_cast<uint64_t>(idx_values[i])));
+                entry_sum += mix64(edge ^ mix64(v * 0x9E3779B97F4A7C15ULL ^ u));
+                mirror_sum += mix64(edge ^ mix64(u * 0x9E3779B97F4A7C15ULL ^ v));
+            }
+        }
+
+        uint64_t missing_mirrors = 0;
+        if (entry_sum != mirror_sum) {
+            #pragma omp parallel for schedule(dynamic, 1024) reduction(+ : missing_mirrors)
+            for (uint64_t v = 0; v < n; ++v) {
+                for (EdgeType i = indptr[v]; i < indptr[v + 1]; ++i) {
+                    NodeType u = indices[i];
+                    const TimeType* row_end = time_values + indptr[u + 1];
+                    const TimeType* first = lower_bound(time_values + indptr[u], row_end, time_values[i]);
+                    bool found = false;
+                    for (const TimeType* t = first; t != row_end && *t == time_values[i] && !found; ++t) {
+                        EdgeType j = static_cast<EdgeType>(t - time_values);
+                        found = static_cast<uint64_t>(indices[j]) == v && idx_values[j] == idx_values[i] && (j != i || u != static_cast<NodeType>(v));
+                    }
+                    if (!found) {
+                        ++missing_mirrors;
+                        add_error(report, error_slots, max_errors,
+                                  "node " + to_string(v) + " entry " + to_string(i) + ": no mirror entry at node " + to_string(u));
+                    }
+                }
+            }
+        }
+        report.missing_mirrors = missing_mirrors;
+        report.symmetry_checked = true;
+    }
+
+    report.valid = report.bad_indices == 0 && report.unsorted_times == 0 && report.bad_edge_ids == 0 && report.missing_mirrors == 0;
+    report.seconds = omp_get_wtime() - start_time;
+    return report.valid;
+}
+
+// Lower bound of gap bucket b > 0
+static double gap_bucket_start(int b) {
+    return ldexp(1.0, b - 1 + GAP_MIN_EXPONENT);
+}
+
+void print_csr_report(ostream& out, const CsrReport& report) {
+    out << "T-CSR: " << report.num_nodes << " nodes, " << report.num_edges << " edges, " << (report.reverse ? "reverse" : "forward")
+        << ", " << (report.valid ? "valid" : "INVALID") << " (checked in " << report.seconds << " s)" << endl;
+    for (const string& error : report.errors) {
+        out << "  error: " << error << endl;
+    }
+    out << "  violations: offsets " << report.bad_offsets << ", neighbor ids " << report.bad_indices << ", time order "
+        << report.unsorted_times << ", edge ids ";
+    if (report.edge_ids_checked) {
+        out << report.bad_edge_ids;
+    } else {
+        out << "not checked";
+    }
+    out << ", mirrors ";
+    if (report.symmetry_checked) {
+        out << report.missing_mirrors;
+    } else {
+        out << "not checked";
+    }
+    out << endl;
+    if (report.bad_offsets > 0) {
+        return;
+    }
+
+    out << "  degree: mean " << report.mean_degree << ", p50 " << report.degree_p50 << ", p90 " << report.degree_p90 << ", p99 "
+        << report.degree_p99 << ", max " << report.max_degree << ", isolated nodes " << report.isolated_nodes << endl;
+    if (report.edge_ids_checked) {
+        out << "  distinct edge ids: " << report.distinct_edge_ids << endl;
+    }
+    out << "  degree histogram:";
+    for (size_t b = 0; b < report.degree_histogram.size(); ++b) {
+        if (report.degree_histogram[b] == 0) {
+            continue;
+        }
+        if (b == 0) {
+            out << " 0: ";
+        } else {
+            out << " [" << (1ULL << (b - 1)) << "," << (1ULL << b) << "): ";
+        }
+        out << report.degree_histogram[b];
+    }
+    out << endl;
+    out << "  hubs:";
+    for (const pair<uint64_t, uint64_t>& hub : report.hubs) {
+        out << " " << hub.first << " (" << hub.second << ")";
+    }
+    out << endl;
+    out << "  time: " << report.min_time << " to " << report.max_time << " (span " << report.max_time - report.min_time << ")" << endl;
+    out << "  inter-event time: mean " << report.mean_gap << ", histogram:";
+    for (int b = 0; b < GAP_BUCKETS; ++b) {
+        if (report.gap_histogram[b] == 0) {
+            continue;
+        }
+        if (b == 0) {
+            out << " 0: ";
+        } else {
+            out << " [" << gap_bucket_start(b) << "," << gap_bucket_start(b + 1) << "): ";
+        }
+        out << report.gap_histogram[b];
+    }
+    out << endl;
+}
+
+template bool validate_temporal_graph<TGNGraphTypes>(const TemporalGraphT<TGNGraphTypes>&, const ValidateOptions&, CsrReport&);
+template bool validate_temporal_graph<TGLGraphTypes>(const TemporalGraphT<TGLGraphTypes>&, const ValidateOptions&, CsrReport&);
@@ -0,0 +1,78 @@
+// csr_validator.h - Consistency checks and statistics of a T-CSR
+#ifndef CSR_VALIDATOR_H
+#define CSR_VALIDATOR_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include "utils.h"
+#include "TemporalGraph.h"
+
+using namespace std;
+
+struct ValidateOptions {
+    // Check that the edge ids appear once per direction (skipped if they span more than
+    // 4 * num_edges ids, as the check keeps a one-byte counter per id). Counters saturate once an
+    // id is over its limit, so every repeated id is counted once however often it repeats.
+    bool check_edge_ids = true;
+    // For reverse graphs, check that every entry u -> v has its mirror v -> u with the same time
+    // and edge id
+    bool check_symmetry = true;
+    // Number of highest-degree nodes to report
+    size_t num_hubs = 10;
+    // Problems described in errors; the rest are only counted
+    size_t max_errors = 20;
+};
+
+// log2 buckets of the inter-event time histogram: bucket 0 counts gaps of 0, bucket b > 0 gaps in
+// [2^(b - 1 + GAP_MIN_EXPONENT), 2^(b + GAP_MIN_EXPONENT)); smaller and larger gaps are clamped
+const int GAP_MIN_EXPONENT = -16;
+const int GAP_BUCKETS = 80;
+
+/*
+Result of validate_temporal_graph. A T-CSR that passes has indptr[0] = 0, non-decreasing offsets
+ending at num_edges, neighbor ids in [0, num_nodes), time-ordered rows without NaN times, every
+edge id once per direction, and (reverse graphs) the mirror of every entry. In such a graph every
+sampled neighbor is a valid root of the next hop; roots outside [0, num_nodes) get empty rows.
+*/
+struct CsrReport {
+    bool valid = false;
+    bool reverse = false;
+    vector<string> errors;
+
+    // Violations
+    uint64_t bad_offsets = 0;          // indptr entries that decrease or leave [0, num_edges]
+    uint64_t bad_indices = 0;          // neighbor ids outside [0, num_nodes)
+    uint64_t unsorted_times = 0;       // entries earlier than the previous one of their row, or NaN
+    uint64_t bad_edge_ids = 0;         // negative ids and ids seen more than once per direction
+    uint64_t missing_mirrors = 0;      // entries of a reverse graph without their mirror
+    bool edge_ids_checked = false;
+    bool symmetry_checked = false;
+
+    // Statistics
+    uint64_t num_nodes = 0;
+    uint64_t num_edges = 0;
+    uint64_t isolated_nodes = 0;
+    uint64_t distinct_edge_ids = 0;
+    uint64_t max_degree = 0;
+    double mean_degree = 0;
+    uint64_t degree_p50 = 0;
+    uint64_t degree_p90 = 0;
+    uint64_t degree_p99 = 0;
+    vector<uint64_t> degree_histogram;             // bucket 0: degree 0, bucket b: [2^(b-1), 2^b)
+    vector<pair<uint64_t, uint64_t>> hubs;         // (node, degree), highest degree first
+    double min_time = 0;
+    double max_time = 0;
+    double mean_gap = 0;                           // between consecutive entries of a row
+    vector<uint64_t> gap_histogram;                // see GAP_MIN_EXPONENT
+    double seconds = 0;
+};
+
+// Check the T-CSR of graph and collect its statistics in one parallel pass over the rows (plus
+// one over the entries per enabled edge id or symmetry check). Returns report.valid.
+template <typename Types>
+bool validate_temporal_graph(const TemporalGraphT<Types>& graph, const ValidateOptions& options, CsrReport& report);
+
+void print_csr_report(ostream& out, const CsrReport& report);
+
+#endif // CSR_VALIDATOR_H
@@ -0,0 +1,410 @@
+// external_csr.cpp - Out-of-core construction of binary T-CSR snapshots from CSV edge lists
+#include "external_csr.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+#include "csr_snapshot.h"
+#include "radix_sort.h"
+#include "parallel_scan.h"
+
+// Records gathered per write of a run file
+static const size_t RUN_WRITE_RECORDS = 1 << 16;
+// Smallest read buffer of a run during the merge, whatever the budget
+static const size_t MIN_MERGE_BUFFER_BYTES = 1 << 16;
+// Largest buffer of an output section
+static const size_t MAX_SECTION_BUFFER_BYTES = 4 << 20;
+
+// One adjacency slot of a run file: the slot's owner, its neighbor, time and edge id
+template <typename Types>
+struct RunRecord {
+    typename Types::NodeType node;
+    typename Types::NodeType neighbor;
+    typename Types::TimeType time;
+    typename Types::EdgeType idx;
+};
+
+// Sequential reader of a run file through a buffer of at most buffer_records records. The buffer
+// is filled only with records the run still has, so a small run costs its own size, not the budget.
+template <typename Types>
+class RunReader {
+private:
+    ifstream file;
+    vector<RunRecord<Types>> buffer;
+    size_t position;
+    size_t count;
+    size_t remaining;  // records of the run not read yet
+
+public:
+    RunReader() : file(), buffer(), position(0), count(0), remaining(0) {}
+
+    bool open(const string& path, size_t buffer_records) {
+        file.open(path, ios::binary | ios::ate);
+        streamoff bytes = file.tellg();
+        if (!file || bytes < 0) {
+            return false;
+        }
+        remaining = static_cast<size_t>(bytes) / sizeof(RunRecord<Types>);
+        file.seekg(0);
+        buffer.reserve(max(min(buffer_records, remaining), static_cast<size_t>(1)));
+        return refill();
+    }
+
+    bool refill() {
+        buffer.resize(min(buffer.capacity(), remaining));
+        file.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(RunRecord<Types>));
+        count = static_cast<size_t>(file.gcount()) / sizeof(RunRecord<Types>);
+        remaining -= count;
+        position = 0;
+        return count == buffer.size();
+    }
+
+    bool empty() const { return position == count; }
+    const RunRecord<Types>& front() const { return buffer[position]; }
+
+    // Step to the next record; false on a read error
+    bool advance() {
+        ++position;
+        return position < count || refill();
+    }
+};
+
+// Buffered writer of one section of the output file, checksumming what it writes
+class SectionWriter {
+private:
+    int fd;
+    uint64_t offset;
+    vector<char> buffer;
+    size_t used;
+    SnapshotChecksum checksum;
+    bool failed;
+
+public:
+    SectionWriter(int fd, uint64_t offset, size_t buffer_bytes)
+        : fd(fd), offset(offset), buffer(max(buffer_bytes, static_cast<size_t>(64))), used(0), checksum(), failed(false) {}
+
+    template <typename T>
+    void put(const T& value) {
+        if (used + sizeof(T) > buffer.size()) {
+            flush();
+        }
+        memcpy(buffer.data() + used, &value, sizeof(T));
+        used += sizeof(T);
+    }
+
+    bool flush() {
+        checksum.update(buffer.data(), used);
+        size_t done = 0;
+        while (done < used && !failed) {
+            ssize_t n = pwrite(fd, buffer.data() + done, used - done, static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            failed = n <= 0;
+            done += failed ? 0 : static_cast<size_t>(n);
+        }
+        offset += used;
+        used = 0;
+        return !failed;
+    }
+
+    uint64_t finish_checksum() const { return checksum.finish(); }
+};
+
+static string run_file_path(const string& temp_dir, size_t run) {
+    return temp_dir + "/tgcsr_run_" + to_string(static_cast<long long>(getpid())) + "_" + to_string(run) + ".bin";
+}
+
+static void remove_files(const vector<string>& paths) {
+    for (const string& path : paths) {
+        remove(path.c_str());
+    }
+}
+
+/*
+Sort the edges of one chunk into adjacency slots exactly like to_csr and write them to a run
+file. Chunks are consecutive row ranges, so slots that tie across runs are ordered by run.
+*/
+template <typename Types>
+static bool write_run(const string& path, bool reverse, const vector<typename Types::EdgeType>& edge_idx,
+                      const vector<typename Types::NodeType>& src_list, const vector<typename Types::NodeType>& dst_list,
+                      const vector<typename Types::TimeType>& time_list) {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::TimeType TimeType;
+    typedef typename make_unsigned<NodeType>::type NodeKey;
+    typedef decltype(radix_key(TimeType())) TimeKey;
+    typedef typename conditional<(sizeof(NodeKey) > sizeof(TimeKey)), NodeKey, TimeKey>::type KeyType;
+
+    size_t num_edges = src_list.size();
+    vector<KeyType> keys;
+    vector<uint64_t> entries;
+    vector<KeyType> key_scratch;
+    vector<uint64_t> entry_scratch;
+
+    bool time_sorted = true;
+    #pragma omp parallel for reduction(&&:time_sorted)
+    for (size_t i = 1; i < num_edges; ++i) {
+        time_sorted = time_sorted && time_list[i - 1] <= time_list[i];
+    }
+    vector<uint64_t> order;
+    if (!time_sorted) {
+        keys.resize(num_edges);
+        order.resize(num_edges);
+        #pragma omp parallel for
+        for (size_t i = 0; i < num_edges; ++i) {
+            keys[i] = radix_key(time_list[i]);
+            order[i] = i;
+        }
+        parallel_radix_sort(keys, order, key_scratch, entry_scratch);
+    }
+
+    size_t fanout = reverse ? 2 : 1;
+    size_t total_edges = num_edges * fanout;
+    keys.resize(total_edges);
+    entries.resize(total_edges);
+    #pragma omp parallel for
+    for (size_t i = 0; i < num_edges; ++i) {
+        uint64_t e = time_sorted ? i : order[i];
+        keys[i * fanout] = static_cast<KeyType>(src_list[e]);
+        entries[i * fanout] = e << 1;
+        if (reverse) {
+            keys[i * fanout + 1] = static_cast<KeyType>(dst_list[e]);
+            entries[i * fanout + 1] = (e << 1) | 1;
+        }
+    }
+    vector<uint64_t>().swap(order);
+    parallel_radix_sort(keys, entries, key_scratch, entry_scratch);
+    vector<KeyType>().swap(key_scratch);
+    vector<uint64_t>().swap(entry_scratch);
+
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file) {
+        cerr << "Failed to open " << path << " for writing" << endl;
+        return false;
+    }
+    vector<RunRecord<Types>> records(min(total_edges, RUN_WRITE_RECORDS));
+    for (size_t begin = 0; begin < total_edges; begin += records.size()) {
+        size_t n = min(records.size(), total_edges - begin);
+        #pragma omp parallel for
+        for (size_t k = 0; k < n; ++k) {
+            uint64_t e = entries[begin + k] >> 1;
+            bool reversed = entries[begin + k] & 1;
+            RunRecord<Types>& record = records[k];
+            record.node = static_cast<NodeType>(keys[begin + k]);
+            record.neighbor = reversed ? src_list[e] : dst_list[e];
+            record.time = time_list[e];
+            record.idx = edge_idx[e];
+        }
+        file.write(reinterpret_cast<const char*>(records.data()), n * sizeof(RunRecord<Types>));
+    }
+    file.close();
+    if (!file) {
+        cerr << "Failed to write " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+template <typename Types>
+CsvReadResult build_csr_snapshot_external(const string& csv_path, const string& snapshot_path, const ExternalBuildOptions& options) {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+    typedef decltype(radix_key(TimeType())) TimeKey;
+    double start_time = omp_get_wtime();
+
+    CsvChunkReader<Types> reader;
+    if (!reader.open(csv_path)) {
+        return CSV_READ_FAILED;
+    }
+
+    // Bytes per CSV row while a run is built: the parsed row plus, per slot, the radix keys and
+    // entries and their scratch copies
+    size_t fanout = options.reverse ? 2 : 1;
+    size_t key_bytes = max(sizeof(NodeType), sizeof(TimeType));
+    size_t row_bytes = sizeof(EdgeType) + 2 * sizeof(NodeType) + sizeof(TimeType) + fanout * 2 * (key_bytes + sizeof(uint64_t));
+    size_t rows_per_run = max(options.memory_budget / row_bytes, static_cast<size_t>(1));
+
+    // Phase 1: sorted runs and node degrees
+    vector<string> run_paths;
+    vector<EdgeType> degrees;
+    size_t num_rows = 0;
+    {
+        vector<EdgeType> edge_idx;
+        vector<NodeType> src_list;
+        vector<NodeType> dst_list;
+        vector<TimeType> time_list;
+        while (true) {
+            CsvReadResult result = reader.next(rows_per_run, edge_idx, src_list, dst_list, time_list);
+            if (result != CSV_READ_OK) {
+                remove_files(run_paths);
+                return result;
+            }
+            size_t n = src_list.size();
+            if (n == 0) {
+                break;
+            }
+            num_rows += n;
+            if (num_rows > static_cast<size_t>(numeric_limits<EdgeType>::max() / 2)) {
+                cerr << csv_path << " has too many edges for " << sizeof(EdgeType) * 8 << "-bit edge ids" << endl;
+                remove_files(run_paths);
+                return CSV_READ_DOES_NOT_FIT;
+            }
+
+            NodeType min_id = 0;
+            NodeType max_id = 0;
+            #pragma omp parallel for reduction(min:min_id) reduction(max:max_id)
+            for (size_t i = 0; i < n; ++i) {
+                min_id = min(min_id, min(src_list[i], dst_list[i]));
+                max_id = max(max_id, max(src_list[i], dst_list[i]));
+            }
+            if (min_id < 0) {
+                cerr << csv_path << " has negative node ids" << endl;
+                remove_files(run_paths);
+                return CSV_READ_FAILED;
+            }
+            if (static_cast<size_t>(max_id) >= degrees.size()) {
+                degrees.resize(static_cast<size_t>(max_id) + 1, 0);
+            }
+            parallel_count_degrees(src_list.data(), n, degrees.data(), degrees.size());
+            if (options.reverse) {
+                parallel_count_degrees(dst_list.data(), n, degrees.data(), degrees.size());
+            }
+
+            run_paths.push_back(run_file_path(options.temp_dir, run_paths.size()));
+            if (!write_run<Types>(run_paths.back(), options.reverse, edge_idx, src_list, dst_list, time_list)) {
+                remove_files(run_paths);
+                return CSV_READ_FAILED;
+            }
+        }
+    }
+    double runs_time = omp_get_wtime();
+    cout << "edge_nums: " << num_rows << endl;
+    cout << "Wrote " << run_paths.size() << " sorted runs of up to " << rows_per_run << " rows in "
+         << runs_time - start_time << " s" << endl;
+
+    // Output layout, identical to save_csr_binary
+    uint64_t num_nodes = degrees.size();
+    uint64_t num_edges = static_cast<uint64_t>(num_rows) * fanout;
+    CsrSnapshotHeader header;
+    init_csr_snapshot_header(header);
+    header.node_width = sizeof(NodeType);
+    header.edge_width = sizeof(EdgeType);
+    header.time_width = sizeof(TimeType);
+    header.flags = (options.reverse ? CSR_FLAG_REVERSE : 0) | (is_floating_point<TimeType>::value ? CSR_FLAG_FLOAT_TIME : 0);
+    header.num_nodes = num_nodes;
+    header.num_edges = num_edges;
+    const uint64_t entries[CSR_NUM_SECTIONS] = {num_nodes + 1, num_edges, num_edges, num_edges};
+    const uint64_t widths[CSR_NUM_SECTIONS] = {sizeof(EdgeType), sizeof(NodeType), sizeof(TimeType), sizeof(EdgeType)};
+    uint64_t offset = sizeof(CsrSnapshotHeader);
+    for (int s = 0; s < CSR_NUM_SECTIONS; ++s) {
+        header.section_offset[s] = csr_snapshot_section_offset(offset, 0);
+        header.section_bytes[s] = entries[s] * widths[s];
+        offset = header.section_offset[s] + header.section_bytes[s];
+    }
+
+    // The snapshot appears under its name only once it is complete
+    string partial_path = snapshot_path + ".partial";
+    int fd = ::open(partial_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(offset)) != 0) {
+        cerr << "Failed to create " << partial_path << ": " << strerror(errno) << endl;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        remove_files(run_paths);
+        return CSV_READ_FAILED;
+    }
+
+    // Phase 2: indptr from the degrees, then one merge of all runs into the three edge sections
+    size_t section_buffer = min(options.memory_budget / 8, MAX_SECTION_BUFFER_BYTES);
+    SectionWriter indptr_writer(fd, header.section_offset[CSR_SECTION_INDPTR], section_buffer);
+    EdgeType total = 0;
+    indptr_writer.put(total);
+    for (size_t v = 0; v < num_nodes; ++v) {
+        total += degrees[v];
+        indptr_writer.put(total);
+    }
+    vector<EdgeType>().swap(degrees);
+    bool ok = indptr_writer.flush();
+    header.section_checksum[CSR_SECTION_INDPTR] = indptr_writer.finish_checksum();
+
+    SectionWriter indices_writer(fd, header.section_offset[CSR_SECTION_INDICES], section_buffer);
+    SectionWriter time_writer(fd, header.section_offset[CSR_SECTION_TIME_VALUES], section_buffer);
+    SectionWriter idx_writer(fd, header.section_offset[CSR_SECTION_IDX_VALUES], section_buffer);
+
+    size_t num_runs = run_paths.size();
+    size_t merge_budget = options.memory_budget > 3 * section_buffer ? options.memory_budget - 3 * section_buffer : 0;
+    size_t run_buffer_bytes = max(merge_budget / max(num_runs, static_cast<size_t>(1)), MIN_MERGE_BUFFER_BYTES);
+    vector<RunReader<Types>> runs(num_runs);
+
+    // Heap of the next slot of every run, smallest (node, time, run) first
+    struct HeapItem {
+        NodeType node;
+        TimeKey time;
+        size_t run;
+        bool operator>(const HeapItem& other) const {
+            if (node != other.node) {
+                return node > other.node;
+            }
+            if (time != other.time) {
+                return time > other.time;
+            }
+            return run > other.run;
+        }
+    };
+    priority_queue<HeapItem, vector<HeapItem>, greater<HeapItem>> heap;
+    for (size_t r = 0; r < num_runs && ok; ++r) {
+        ok = runs[r].open(run_paths[r], run_buffer_bytes / sizeof(RunRecord<Types>));
+        if (ok && !runs[r].empty()) {
+            heap.push(HeapItem{runs[r].front().node, radix_key(runs[r].front().time), r});
+        }
+    }
+
+    while (!heap.empty() && ok) {
+        size_t r = heap.top().run;
+        heap.pop();
+        const RunRecord<Types>& record = runs[r].front();
+        indices_writer.put(record.neighbor);
+        time_writer.put(record.time);
+        idx_writer.put(record.idx);
+        ok = runs[r].advance();
+        if (ok && !runs[r].empty()) {
+            heap.push(HeapItem{runs[r].front().node, radix_key(runs[r].front().time), r});
+        }
+    }
+    if (!ok) {
+        cerr << "Failed to read the sorted runs in " << options.temp_dir << endl;
+    }
+    ok = indices_writer.flush() && time_writer.flush() && idx_writer.flush() && ok;
+    runs.clear();
+    remove_files(run_paths);
+
+    header.section_checksum[CSR_SECTION_INDICES] = indices_writer.finish_checksum();
+    header.section_checksum[CSR_SECTION_TIME_VALUES] = time_writer.finish_checksum();
+    header.section_checksum[CSR_SECTION_IDX_VALUES] = idx_writer.finish_checksum();
+    header.header_checksum = snapshot_checksum(&header, offsetof(CsrSnapshotHeader, header_checksum));
+    ok = ok && pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || rename(partial_path.c_str(), snapshot_path.c_str()) != 0) {
+        cerr << "Failed to write " << snapshot_path << endl;
+        remove(partial_path.c_str());
+        return CSV_READ_FAILED;
+    }
+
+    double end_time = omp_get_wtime();
+    cout << "Merged " << num_runs << " runs in " << end_time - runs_time << " s" << endl;
+    cout << "The elapsed time for the external T-CSR build: " << end_time - start_time << " seconds" << endl;
+    return CSV_READ_OK;
+}
+
+template CsvReadResult build_csr_snapshot_external<TGNGraphTypes>(const string&, const string&, const ExternalBuildOptions&);
+template CsvReadResult build_csr_snapshot_external<TGLGraphTypes>(const string&, const string&, const ExternalBuildOptions&);
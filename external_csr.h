@@ -0,0 +1,36 @@
+// external_csr.h - Out-of-core construction of binary T-CSR snapshots from CSV edge lists
+#ifndef EXTERNAL_CSR_H
+#define EXTERNAL_CSR_H
+
+#include <string>
+#include <cstddef>
+#include "utils.h"
+#include "readcsv.h"
+
+using namespace std;
+
+struct ExternalBuildOptions {
+    bool reverse = false;
+    // Bytes of working memory for sorting runs and merge buffers; the per-node degree array
+    // (num_nodes * sizeof(EdgeType)) comes on top
+    size_t memory_budget = static_cast<size_t>(1) << 30;
+    // Directory of the temporary run files, removed when the build ends
+    string temp_dir = ".";
+};
+
+/*
+Build the binary T-CSR snapshot of a CSV edge list (the file save_csr_binary writes for the same
+edges and reverse flag, byte for byte) without holding the edge list or the T-CSR in memory. The
+CSV is read in chunks that fit the memory budget; every chunk is sorted like to_csr (by node, then
+time, then input order) and spilled to a run file while the node degrees are counted. One k-way
+merge of the runs then streams the indices, time and edge id sections into their offsets of the
+pre-sized output file, with their checksums computed on the way, and the header is written last.
+Ties between runs go to the earlier run, which keeps the input order of to_csr.
+
+Returns CSV_READ_DOES_NOT_FIT when the ids, timestamps or edge count need wider Types, like
+read_csv_file_parallel; the caller retries with the TGL types.
+*/
+template <typename Types>
+CsvReadResult build_csr_snapshot_external(const string& csv_path, const string& snapshot_path, const ExternalBuildOptions& options);
+
+#endif // EXTERNAL_CSR_H
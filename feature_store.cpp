@@ -0,0 +1,819 @@
+// feature_store.cpp - Edge features and node memory gathered together with the sampled neighbors
+#include "feature_store.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <immintrin.h>
+#include <omp.h>
+#include "simd_kernels.h"
+
+static const char FEATURE_FILE_MAGIC[8] = {'T', 'G', 'F', 'E', 'A', 'T', 'U', 'R'};
+
+bool parse_feature_dtype(const string& name, FeatureDType& dtype) {
+    if (name == "float32" || name == "fp32") {
+        dtype = FEATURE_FLOAT32;
+    } else if (name == "float16" || name == "fp16") {
+        dtype = FEATURE_FLOAT16;
+    } else if (name == "bfloat16" || name == "bf16") {
+        dtype = FEATURE_BFLOAT16;
+    } else if (name == "int8") {
+        dtype = FEATURE_INT8;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* feature_dtype_name(FeatureDType dtype) {
+    switch (dtype) {
+        case FEATURE_FLOAT16:
+            return "float16";
+        case FEATURE_BFLOAT16:
+            return "bfloat16";
+        case FEATURE_INT8:
+            return "int8";
+        default:
+            return "float32";
+    }
+}
+
+size_t feature_dtype_bytes(FeatureDType dtype) {
+    switch (dtype) {
+        case FEATURE_FLOAT16:
+        case FEATURE_BFLOAT16:
+            return 2;
+        case FEATURE_INT8:
+            return 1;
+        default:
+            return 4;
+    }
+}
+
+FeatureMatrix::FeatureMatrix()
+    : file(), storage(), scale_storage(), data(nullptr), scales(nullptr), dtype(FEATURE_FLOAT32), rows(0), dim(0), row_bytes(0) {
+}
+
+void FeatureMatrix::bind_storage() {
+    file.reset();
+    data = storage.data();
+    scales = dtype == FEATURE_INT8 ? scale_storage.data() : nullptr;
+}
+
+void FeatureMatrix::clear() {
+    file.reset();
+    vector<char>().swap(storage);
+    vector<float>().swap(scale_storage);
+    data = nullptr;
+    scales = nullptr;
+    dtype = FEATURE_FLOAT32;
+    rows = 0;
+    dim = 0;
+    row_bytes = 0;
+}
+
+void FeatureMatrix::assign_zeros(size_t rows, size_t dim, FeatureDType dtype) {
+    clear();
+    this->rows = rows;
+    this->dim = dim;
+    this->dtype = dtype;
+    row_bytes = dim * feature_dtype_bytes(dtype);
+    storage.assign(rows * row_bytes, 0);
+    scale_storage.assign(dtype == FEATURE_INT8 ? rows : 0, 0.0f);
+    bind_storage();
+}
+
+void FeatureMatrix::assign(const float* values, size_t rows, size_t dim, FeatureDType dtype) {
+    assign_zeros(rows, dim, dtype);
+    #pragma omp parallel for schedule(static)
+    for (size_t r = 0; r < rows; ++r) {
+        write_row(r, values + r * dim);
+    }
+}
+
+// Half to float conversion of a row: hardware conversions (exact, like half_to_float) when the
+// dispatched SIMD level allows them, the integer rebias of half_to_float otherwise
+
+static void half_row_to_float_scalar(const uint16_t* halves, size_t n, float* out) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = half_to_float(halves[i]);
+    }
+}
+
+__attribute__((target("avx2,f16c"))) static void half_row_to_float_f16c(const uint16_t* halves, size_t n, float* out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(halves + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(packed));
+    }
+    half_row_to_float_scalar(halves + i, n - i, out + i);
+}
+
+__attribute__((target("avx512f"))) static void half_row_to_float_avx512(const uint16_t* halves, size_t n, float* out) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(halves + i));
+        _mm512_storeu_ps(out + i, _mm512_maskz_cvtph_ps(0xFFFF, packed));
+    }
+    half_row_to_float_scalar(halves + i, n - i, out + i);
+}
+
+static bool cpu_has_f16c() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("f16c");
+}
+
+static void half_row_to_float(const uint16_t* halves, size_t n, float* out) {
+    static const bool f16c = cpu_has_f16c();
+    SimdLevel level = get_simd_level();
+    if (level == SIMD_AVX512) {
+        half_row_to_float_avx512(halves, n, out);
+    } else if (level == SIMD_AVX2 && f16c) {
+        half_row_to_float_f16c(halves, n, out);
+    } else {
+        half_row_to_float_scalar(halves, n, out);
+    }
+}
+
+void FeatureMatrix::read_row(size_t row, float* out) const {
+    const char* source = row_data(row);
+    switch (dtype) {
+        case FEATURE_FLOAT16:
+            half_row_to_float(reinterpret_cast<const uint16_t*>(source), dim, out);
+            break;
+        case FEATURE_BFLOAT16: {
+            const uint16_t* halves = reinterpret_cast<const uint16_t*>(source);
+            for (size_t i = 0; i < dim; ++i) {
+                out[i] = bfloat16_to_float(halves[i]);
+            }
+            break;
+        }
+        case FEATURE_INT8: {
+            const int8_t* quantized = reinterpret_cast<const int8_t*>(source);
+            float scale = scales[row];
+            for (size_t i = 0; i < dim; ++i) {
+                out[i] = quantized[i] * scale;
+            }
+            break;
+        }
+        default:
+            memcpy(out, source, row_bytes);
+            break;
+    }
+}
+
+void FeatureMatrix::write_row(size_t row, const float* values) {
+    char* target = storage.data() + row * row_bytes;
+    switch (dtype) {
+        case FEATURE_FLOAT16: {
+            uint16_t* halves = reinterpret_cast<uint16_t*>(target);
+            for (size_t i = 0; i < dim; ++i) {
+                halves[i] = float_to_half(values[i]);
+            }
+            break;
+        }
+        case FEATURE_BFLOAT16: {
+            uint16_t* halves = reinterpret_cast<uint16_t*>(target);
+            for (size_t i = 0; i < dim; ++i) {
+                halves[i] = float_to_bfloat16(values[i]);
+            }
+            break;
+        }
+        case FEATURE_INT8: {
+            int8_t* quantized = reinterpret_cast<int8_t*>(target);
+            float max_abs = 0;
+            for (size_t i = 0; i < dim; ++i) {
+                max_abs = max(max_abs, fabs(values[i]));
+            }
+            float scale = max_abs / 127;
+            float inverse = scale > 0 ? 1 / scale : 0;
+            for (size_t i = 0; i < dim; ++i) {
+                float q = nearbyintf(values[i] * inverse);
+                quantized[i] = static_cast<int8_t>(min(max(q, -127.0f), 127.0f));
+            }
+            scale_storage[row] = scale;
+            break;
+        }
+        default:
+            memcpy(target, values, row_bytes);
+            break;
+    }
+}
+
+bool FeatureMatrix::save(const string& file_path) const {
+    FeatureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FEATURE_FILE_MAGIC, sizeof(header.magic));
+    header.version = FEATURE_FILE_VERSION;
+    header.header_size = sizeof(FeatureFileHeader);
+    header.dtype = dtype;
+    header.dim = static_cast<uint32_t>(dim);
+    header.rows = rows;
+    header.data_offset = csr_snapshot_section_offset(sizeof(FeatureFileHeader), 0);
+    header.data_bytes = rows * row_bytes;
+    header.scale_offset = csr_snapshot_section_offset(header.data_offset, header.data_bytes);
+    header.scale_bytes = scales ? rows * sizeof(float) : 0;
+    header.data_checksum = snapshot_checksum(data, header.data_bytes);
+    header.scale_checksum = snapshot_checksum(scales, header.scale_bytes);
+    header.header_checksum = snapshot_checksum(&header, offsetof(FeatureFileHeader, header_checksum));
+
+    ofstream out(file_path, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Failed to open " << file_path << " for writing" << endl;
+        return false;
+    }
+    const char padding[CSR_SNAPSHOT_ALIGNMENT] = {0};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(padding, header.data_offset - sizeof(header));
+    out.write(data, header.data_bytes);
+    if (header.scale_bytes > 0) {
+        out.write(padding, header.scale_offset - header.data_offset - header.data_bytes);
+        out.write(reinterpret_cast<const char*>(scales), header.scale_bytes);
+    }
+    out.close();
+    if (!out) {
+        cerr << "Failed to write " << file_path << endl;
+        return false;
+    }
+    return true;
+}
+
+static bool check_feature_header(const FeatureFileHeader& header, size_t file_size, string& error) {
+    if (memcmp(header.magic, FEATURE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        error = "not a feature file";
+        return false;
+    }
+    if (header.version != FEATURE_FILE_VERSION || header.header_size != sizeof(FeatureFileHeader)) {
+        error = "unsupported feature file version " + to_string(header.version);
+        return false;
+    }
+    if (header.header_checksum != snapshot_checksum(&header, offsetof(FeatureFileHeader, header_checksum))) {
+        error = "header checksum mismatch";
+        return false;
+    }
+    if (header.dtype > FEATURE_INT8) {
+        error = "unknown feature type " + to_string(header.dtype);
+        return false;
+    }
+    FeatureDType dtype = static_cast<FeatureDType>(header.dtype);
+    if (header.data_bytes != header.rows * header.dim * feature_dtype_bytes(dtype) ||
+        header.scale_bytes != (dtype == FEATURE_INT8 ? header.rows * sizeof(float) : 0)) {
+        error = "sections have inconsistent sizes";
+        return false;
+    }
+    if (header.data_offset % CSR_SNAPSHOT_ALIGNMENT != 0 || header.scale_offset % CSR_SNAPSHOT_ALIGNMENT != 0 ||
+        header.data_offset + header.data_bytes > file_size ||
+        (header.scale_bytes > 0 && header.scale_offset + header.scale_bytes > file_size)) {
+        error = "sections lie outside the file";
+        return false;
+    }
+    return true;
+}
+
+bool FeatureMatrix::load(const string& file_path, bool verify_checksums) {
+    double start_time = omp_get_wtime();
+    shared_ptr<MappedFile> mapped = make_shared<MappedFile>();
+    if (!mapped->open(file_path)) {
+        return false;
+    }
+    if (mapped->size() < sizeof(FeatureFileHeader)) {
+        cerr << "Failed to load " << file_path << ": file is too small" << endl;
+        return false;
+    }
+    FeatureFileHeader header;
+    memcpy(&header, mapped->data(), sizeof(header));
+    string error;
+    if (!check_feature_header(header, mapped->size(), error)) {
+        cerr << "Failed to load " << file_path << ": " << error << endl;
+        return false;
+    }
+    const char* base = mapped->data();
+    if (verify_checksums && (snapshot_checksum(base + header.data_offset, header.data_bytes) != header.data_checksum ||
+                             snapshot_checksum(base + header.scale_offset, header.scale_bytes) != header.scale_checksum)) {
+        cerr << "Failed to load " << file_path << ": section checksum mismatch" << endl;
+        return false;
+    }
+
+    clear();
+    file = mapped;
+    dtype = static_cast<FeatureDType>(header.dtype);
+    rows = header.rows;
+    dim = header.dim;
+    row_bytes = dim * feature_dtype_bytes(dtype);
+    data = base + header.data_offset;
+    scales = header.scale_bytes > 0 ? reinterpret_cast<const float*>(base + header.scale_offset) : nullptr;
+
+    double end_time = omp_get_wtime();
+    cout << "The elapsed time for mapping " << rows << " x " << dim << " " << feature_dtype_name(dtype)
+         << " features: " << end_time - start_time << " seconds" << endl;
+    return true;
+}
+
+// Value of key in the header dictionary of a .npy file, e.g. "'<f4'" or "(1000, 172)"
+static string npy_header_value(const string& header, const string& key) {
+    size_t position = header.find("'" + key + "'");
+    if (position == string::npos) {
+        return "";
+    }
+    position = header.find(':', position);
+    if (position == string::npos) {
+        return "";
+    }
+    ++position;
+    while (position < header.size() && header[position] == ' ') {
+        ++position;
+    }
+    size_t end = header[position] == '(' ? header.find(')', position) + 1 : header.find_first_of(",}", position);
+    return header.substr(position, end - position);
+}
+
+bool read_npy_matrix(const string& file_path, vector<float>& values, size_t& rows, size_t& dim) {
+    MappedFile file;
+    if (!file.open(file_path)) {
+        return false;
+    }
+    const char* base = file.data();
+    if (file.size() < 10 || memcmp(base, "\x93NUMPY", 6) != 0) {
+        cerr << "Failed to read " << file_path << ": not a .npy file" << endl;
+        return false;
+    }
+    unsigned char major = static_cast<unsigned char>(base[6]);
+    size_t header_length = 0;
+    size_t prefix = 0;
+    if (major == 1) {
+        header_length = static_cast<unsigned char>(base[8]) | (static_cast<unsigned char>(base[9]) << 8);
+        prefix = 10;
+    } else if (file.size() >= 12) {
+        for (int i = 3; i >= 0; --i) {
+            header_length = (header_length << 8) | static_cast<unsigned char>(base[8 + i]);
+        }
+        prefix = 12;
+    }
+    if (prefix == 0 || prefix + header_length > file.size()) {
+        cerr << "Failed to read " << file_path << ": truncated .npy header" << endl;
+        return false;
+    }
+    string header(base + prefix, header_length);
+    string descr = npy_header_value(header, "descr");
+    string fortran_order = npy_header_value(header, "fortran_order");
+    string shape = npy_header_value(header, "shape");
+    size_t width = descr == "'<f4'" || descr == "'=f4'" ? 4 : descr == "'<f8'" || descr == "'=f8'" ? 8 : 0;
+    if (width == 0 || fortran_order != "False" || shape.size() < 2) {
+        cerr << "Failed to read " << file_path << ": expected a C-order float32 or float64 array, got " << header << endl;
+        return false;
+    }
+
+    vector<size_t> extents;
+    const char* cursor = shape.c_str() + 1;
+    while (*cursor != '\0' && *cursor != ')') {
+        char* next = nullptr;
+        unsigned long long extent = strtoull(cursor, &next, 10);
+        if (next == cursor) {
+            ++cursor;
+            continue;
+        }
+        extents.push_back(static_cast<size_t>(extent));
+        cursor = next;
+    }
+    if (extents.empty() || extents.size() > 2) {
+        cerr << "Failed to read " << file_path << ": expected a 1-D or 2-D array, got shape " << shape << endl;
+        return false;
+    }
+    rows = extents[0];
+    dim = extents.size() == 2 ? extents[1] : 1;
+    size_t count = rows * dim;
+    if (prefix + header_length + count * width > file.size()) {
+        cerr << "Failed to read " << file_path << ": the data is truncated" << endl;
+        return false;
+    }
+
+    const char* payload = base + prefix + header_length;
+    values.resize(count);
+    if (width == 4) {
+        memcpy(values.data(), payload, count * sizeof(float));
+    } else {
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < count; ++i) {
+            double value;
+            memcpy(&value, payload + i * sizeof(double), sizeof(double));
+            values[i] = static_cast<float>(value);
+        }
+    }
+    return true;
+}
+
+template <typename Types>
+void FeatureBuffers<Types>::resize(size_t batch_size, EdgeType sample_num, size_t edge_dim, size_t node_dim, size_t memory_dim) {
+    samples.resize(batch_size, sample_num);
+    this->edge_dim = edge_dim;
+    this->node_dim = node_dim;
+    this->memory_dim = memory_dim;
+    size_t slots = batch_size * static_cast<size_t>(sample_num);
+    if (edge_features.size() < slots * edge_dim) {
+        edge_features.resize(slots * edge_dim);
+    }
+    if (root_features.size() < batch_size * node_dim) {
+        root_features.resize(batch_size * node_dim);
+    }
+    if (neighbor_features.size() < slots * node_dim) {
+        neighbor_features.resize(slots * node_dim);
+    }
+    if (root_memory.size() < batch_size * memory_dim) {
+        root_memory.resize(batch_size * memory_dim);
+    }
+    if (neighbor_memory.size() < slots * memory_dim) {
+        neighbor_memory.resize(slots * memory_dim);
+    }
+}
+
+template <typename Types>
+FeatureStoreT<Types>::FeatureStoreT(const TemporalGraphT<Types>& graph, const FeatureStoreOptions& options)
+    : graph(graph), options(options), edge_features(), node_features(), node_memory(), cache_entries(), cache_values(),
+      cached_nodes(), batches_since_refresh(0), cache_warm(false), random_seed(DEFAULT_RANDOM_SEED), batch_counter(0),
+      sample_params(), batches(0), edge_rows(0), node_rows(0), cache_hits(0), missing_rows(0) {
+}
+
+template <typename Types>
+bool FeatureStoreT<Types>::load_edge_features(const string& file_path, bool verify_checksums) {
+    return edge_features.load(file_path, verify_checksums);
+}
+
+template <typename Types>
+bool FeatureStoreT<Types>::load_node_features(const string& file_path, bool verify_checksums) {
+    bool ok = node_features.load(file_path, verify_checksums);
+    reset_cache();
+    return ok;
+}
+
+template <typename Types>
+void FeatureStoreT<Types>::set_edge_features(const float* values, size_t rows, size_t dim, FeatureDType dtype) {
+    edge_features.assign(values, rows, dim, dtype);
+}
+
+template <typename Types>
+void FeatureStoreT<Types>::set_node_features(const float* values, size_t rows, size_t dim, FeatureDType dtype) {
+    node_features.assign(values, rows, dim, dtype);
+    reset_cache();
+}
+
+template <typename Types>
+void FeatureStoreT<Types>::init_node_memory(size_t rows, size_t dim, FeatureDType dtype) {
+    node_memory.assign_zeros(rows, dim, dtype);
+}
+
+// The nodes of one update must be distinct
+template <typename Types>
+void FeatureStoreT<Types>::update_node_memory(const NodeType* nodes, size_t n, const float* values) {
+    size_t dim = node_memory.get_dim();
+    size_t rows = node_memory.num_rows();
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; ++i) {
+        if (nodes[i] >= 0 && static_cast<size_t>(nodes[i]) < rows) {
+            node_memory.write_row(static_cast<size_t>(nodes[i]), values + i * dim);
+        }
+    }
+}
+
+template <typename Types>
+void FeatureStoreT<Types>::set_random_seed(uint64_t seed) {
+    random_seed = seed;
+    batch_counter.store(0);
+}
+
+template <typename Types>
+void FeatureStoreT<Types>::set_sample_params(const SampleParams& params) {
+    sample_params = params;
+}
+
+template <typename Types>
+void FeatureStoreT<Types>::reset_cache() {
+    vector<NodeType>().swap(cached_nodes);
+    vector<float>().swap(cache_values);
+    batches_since_refresh = 0;
+    cache_warm = false;
+    size_t rows = node_features.num_rows();
+    if (options.cache_rows == 0 || rows == 0) {
+        cache_entries.reset();
+        return;
+    }
+    cache_entries.reset(new CacheEntry[rows]);
+    for (size_t v = 0; v < rows; ++v) {
+        cache_entries[v].slot = -1;
+        cache_entries[v].count.store(0, memory_order_relaxed);
+    }
+}
+
+// Keep the cache_rows most accessed nodes dequantized in cache_values, then age the counts. One
+// parallel pass collects the accessed nodes with their counts and halves the counts; every thread
+// scans a contiguous range, so the candidates are listed in node order whatever the thread count.
+template <typename Types>
+void FeatureStoreT<Types>::refresh_cache() {
+    size_t rows = node_features.num_rows();
+    size_t dim = node_features.get_dim();
+    vector<pair<uint32_t, NodeType>> candidates;
+    vector<size_t> thread_offsets;
+    #pragma omp parallel
+    {
+        size_t tid = static_cast<size_t>(omp_get_thread_num());
+        size_t nt = static_cast<size_t>(omp_get_num_threads());
+        #pragma omp single
+        thread_offsets.assign(nt + 1, 0);
+        size_t begin = rows * tid / nt;
+        size_t end = rows * (tid + 1) / nt;
+        vector<pair<uint32_t, NodeType>> local;
+        for (size_t v = begin; v < end; ++v) {
+            atomic<uint32_t>& count = cache_entries[v].count;
+            uint32_t accesses = count.load(memory_order_relaxed);
+            if (accesses > 0) {
+                local.push_back(make_pair(accesses, static_cast<NodeType>(v)));
+                count.store(accesses / 2, memory_order_relaxed);
+            }
+        }
+        thread_offsets[tid + 1] = local.size();
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (size_t t = 1; t <= nt; ++t) {
+                thread_offsets[t] += thread_offsets[t - 1];
+            }
+            candidates.resize(thread_offsets[nt]);
+        }
+        copy(local.begin(), local.end(), candidates.begin() + thread_offsets[tid]);
+    }
+
+    size_t capacity = min(min(options.cache_rows, candidates.size()), static_cast<size_t>(INT32_MAX));
+    nth_element(candidates.begin(), candidates.begin() + capacity, candidates.end(),
+                [](const pair<uint32_t, NodeType>& a, const pair<uint32_t, NodeType>& b) { return a.first > b.first; });
+
+    for (NodeType node : cached_nodes) {
+        cache_entries[node].slot = -1;
+    }
+    cached_nodes.resize(capacity);
+    for (size_t i = 0; i < capacity; ++i) {
+        cached_nodes[i] = candidates[i].second;
+    }
+    cache_values.resize(capacity * dim);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < capacity; ++i) {
+        node_features.read_row(static_cast<size_t>(cached_nodes[i]), cache_values.data() + i * dim);
+        cache_entries[cached_nodes[i]].slot = static_cast<int32_t>(i);
+    }
+}
+
+// Node features (through the cache) and memory of one node; either output may be null
+template <typename Types>
+void FeatureStoreT<Types>::gather_node(NodeType node, bool count_access, float* features, float* memory, uint64_t& hits,
+                                       uint64_t& missing) const {
+    if (features != nullptr) {
+        size_t dim = node_features.get_dim();
+        if (node < 0 || static_cast<size_t>(node) >= node_features.num_rows()) {
+            fill(features, features + dim, 0.0f);
+            ++missing;
+        } else if (cache_entries) {
+            CacheEntry& entry = cache_entries[node];
+            if (count_access) {
+                entry.count.store(entry.count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+            }
+            int32_t slot = entry.slot;
+            if (slot >= 0) {
+                memcpy(features, cache_values.data() + static_cast<size_t>(slot) * dim, dim * sizeof(float));
+                ++hits;
+            } else {
+                node_features.read_row(static_cast<size_t>(node), features);
+            }
+        } else {
+            node_features.read_row(static_cast<size_t>(node), features);
+        }
+    }
+    if (memory != nullptr) {
+        if (node < 0 || static_cast<size_t>(node) >= node_memory.num_rows()) {
+            fill(memory, memory + node_memory.get_dim(), 0.0f);
+            ++missing;
+        } else {
+            node_memory.read_row(static_cast<size_t>(node), memory);
+        }
+    }
+}
+
+// Request every cache line of a matrix row
+static inline void prefetch_row(const FeatureMatrix& matrix, size_t row) {
+    const char* begin = matrix.row_data(row);
+    const char* end = matrix.row_data(row + 1);
+    for (const char* line = begin; line < end; line += 64) {
+        __builtin_prefetch(line);
+    }
+}
+
+// Start every miss of the gather of a row (skipping cached node rows) before copying any of it
+template <typename Types>
+void FeatureStoreT<Types>::prefetch_gather_row(const NodeType* neighbors, const EdgeType* neighbor_idx, EdgeType count,
+                                               const FeatureBuffers<Types>& out) const {
+    size_t edge_rows = edge_features.num_rows();
+    for (EdgeType j = 0; j < count; ++j) {
+        if (out.edge_dim > 0 && neighbor_idx[j] >= 0 && static_cast<size_t>(neighbor_idx[j]) < edge_rows) {
+            prefetch_row(edge_features, static_cast<size_t>(neighbor_idx[j]));
+        }
+        if (out.node_dim > 0 && neighbors[j] >= 0 && static_cast<size_t>(neighbors[j]) < node_features.num_rows()) {
+            if (!cache_entries) {
+                prefetch_row(node_features, static_cast<size_t>(neighbors[j]));
+            } else if (cache_entries[neighbors[j]].slot < 0) {
+                prefetch_row(node_features, static_cast<size_t>(neighbors[j]));
+            }
+        }
+        if (out.memory_dim > 0 && neighbors[j] >= 0 && static_cast<size_t>(neighbors[j]) < node_memory.num_rows()) {
+            prefetch_row(node_memory, static_cast<size_t>(neighbors[j]));
+        }
+    }
+}
+
+// Features of row b: its root, and the edges and nodes of its count sampled neighbors, padded
+template <typename Types>
+void FeatureStoreT<Types>::gather_row(NodeType root, const NodeType* neighbors, const EdgeType* neighbor_idx, EdgeType count,
+                                      EdgeType sample_num, size_t b, FeatureBuffers<Types>& out, uint64_t& hits,
+                                      uint64_t& missing) const {
+    size_t edge_dim = out.edge_dim;
+    size_t node_dim = out.node_dim;
+    size_t memory_dim = out.memory_dim;
+    size_t row = b * static_cast<size_t>(sample_num);
+    size_t edge_rows = edge_features.num_rows();
+
+    gather_node(root, true, node_dim ? out.root_features.data() + b * node_dim : nullptr,
+                memory_dim ? out.root_memory.data() + b * memory_dim : nullptr, hits, missing);
+    for (EdgeType j = 0; j < count; ++j) {
+        size_t slot = row + static_cast<size_t>(j);
+        if (edge_dim > 0) {
+            float* target = out.edge_features.data() + slot * edge_dim;
+            if (neighbor_idx[j] >= 0 && static_cast<size_t>(neighbor_idx[j]) < edge_rows) {
+                edge_features.read_row(static_cast<size_t>(neighbor_idx[j]), target);
+            } else {
+                fill(target, target + edge_dim, 0.0f);
+                ++missing;
+            }
+        }
+        gather_node(neighbors[j], true, node_dim ? out.neighbor_features.data() + slot * node_dim : nullptr,
+                    memory_dim ? out.neighbor_memory.data() + slot * memory_dim : nullptr, hits, missing);
+    }
+
+    size_t first_pad = row + static_cast<size_t>(max(count, static_cast<EdgeType>(0)));
+    size_t end = row + static_cast<size_t>(sample_num);
+    fill(out.edge_features.begin() + first_pad * edge_dim, out.edge_features.begin() + end * edge_dim, 0.0f);
+    fill(out.neighbor_features.begin() + first_pad * node_dim, out.neighbor_features.begin() + end * node_dim, 0.0f);
+    fill(out.neighbor_memory.begin() + first_pad * memory_dim, out.neighbor_memory.begin() + end * memory_dim, 0.0f);
+}
+
+// Gather rows [begin, end) of a sampled batch, prefetching the feature rows of the next row while
+// copying the current one
+template <typename Types>
+void FeatureStoreT<Types>::gather_rows(const NodeType* batch_node_id, size_t begin, size_t end, FeatureBuffers<Types>& out,
+                                       uint64_t& hits, uint64_t& missing) const {
+    EdgeType sample_num = out.samples.sample_num;
+    const NodeType* batch_neighbors = out.samples.neighbors.data();
+    const EdgeType* batch_neighbor_idx = out.samples.neighbor_idx.data();
+    const EdgeType* batch_counts = out.samples.counts.data();
+    if (begin < end) {
+        size_t row = begin * static_cast<size_t>(sample_num);
+        prefetch_gather_row(batch_neighbors + row, batch_neighbor_idx + row, batch_counts[begin], out);
+    }
+    for (size_t b = begin; b < end; ++b) {
+        if (b + 1 < end) {
+            size_t next = (b + 1) * static_cast<size_t>(sample_num);
+            prefetch_gather_row(batch_neighbors + next, batch_neighbor_idx + next, batch_counts[b + 1], out);
+        }
+        size_t row = b * static_cast<size_t>(sample_num);
+        gather_row(batch_node_id[b], batch_neighbors + row, batch_neighbor_idx + row, batch_counts[b], sample_num, b, out,
+                   hits, missing);
+    }
+}
+
+// Every thread gathers one contiguous range of rows, so the output is written in order
+template <typename Types>
+void FeatureStoreT<Types>::gather_batch(const NodeType* batch_node_id, size_t batch_size, FeatureBuffers<Types>& out,
+                                        uint64_t& hits, uint64_t& missing) const {
+    uint64_t total_hits = 0;
+    uint64_t total_missing = 0;
+    #pragma omp parallel reduction(+:total_hits, total_missing)
+    {
+        size_t tid = static_cast<size_t>(omp_get_thread_num());
+        size_t nt = static_cast<size_t>(omp_get_num_threads());
+        gather_rows(batch_node_id, batch_size * tid / nt, batch_size * (tid + 1) / nt, out, total_hits, total_missing);
+    }
+    hits += total_hits;
+    missing += total_missing;
+}
+
+template <typename Types>
+template <SampleStrategy S>
+void FeatureStoreT<Types>::sample_and_gather_batch(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                                                   EdgeType sample_num, uint64_t batch_id, FeatureBuffers<Types>& out) {
+    // Sampled by the shared batch loop (planned for large batches), then gathered in input order.
+    // Copying every row as the planned loop finishes it writes the output out of order and evicts
+    // the adjacency the planning keeps hot; it measured slower than the second pass.
+    sample_batch<S>(graph, batch_node_id, batch_node_time, batch_size, sample_num, sample_params, random_seed, batch_id,
+                    out.samples.neighbors.data(), out.samples.neighbor_times.data(), out.samples.neighbor_idx.data(),
+                    out.samples.counts.data());
+    uint64_t hits = 0;
+    uint64_t missing = 0;
+    gather_batch(batch_node_id, batch_size, out, hits, missing);
+    finish_batch(batch_size, out, hits, missing);
+}
+
+template <typename Types>
+void FeatureStoreT<Types>::finish_batch(size_t batch_size, const FeatureBuffers<Types>& out, uint64_t hits, uint64_t missing) {
+    uint64_t sampled = 0;
+    for (size_t b = 0; b < batch_size; ++b) {
+        sampled += static_cast<uint64_t>(out.samples.counts[b]);
+    }
+    batches.fetch_add(1, memory_order_relaxed);
+    edge_rows.fetch_add(out.edge_dim > 0 ? sampled : 0, memory_order_relaxed);
+    node_rows.fetch_add(out.node_dim + out.memory_dim > 0 ? batch_size + sampled : 0, memory_order_relaxed);
+    cache_hits.fetch_add(hits, memory_order_relaxed);
+    missing_rows.fetch_add(missing, memory_order_relaxed);
+
+    // The first refresh follows the first batch, so the cache serves from the second batch on
+    ++batches_since_refresh;
+    if (cache_entries && (!cache_warm || batches_since_refresh >= static_cast<size_t>(max(options.cache_refresh_batches, 1)))) {
+        refresh_cache();
+        batches_since_refresh = 0;
+        cache_warm = true;
+    }
+}
+
+template <typename Types>
+double FeatureStoreT<Types>::sample_and_gather(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                                               FeatureBuffers<Types>& out, EdgeType sample_num, SampleStrategy sample_strategy) {
+    double start_time = omp_get_wtime();
+    uint64_t batch_id = batch_counter.fetch_add(1);
+    out.resize(batch_size, sample_num, edge_features.get_dim(), node_features.get_dim(), node_memory.get_dim());
+
+    switch (sample_strategy) {
+        case SAMPLE_RECENT:
+            sample_and_gather_batch<SAMPLE_RECENT>(batch_node_id, batch_node_time, batch_size, sample_num, batch_id, out);
+            break;
+        case SAMPLE_RANDOM:
+            sample_and_gather_batch<SAMPLE_RANDOM>(batch_node_id, batch_node_time, batch_size, sample_num, batch_id, out);
+            break;
+        case SAMPLE_WINDOW:
+            sample_and_gather_batch<SAMPLE_WINDOW>(batch_node_id, batch_node_time, batch_size, sample_num, batch_id, out);
+            break;
+        case SAMPLE_DECAY:
+            sample_and_gather_batch<SAMPLE_DECAY>(batch_node_id, batch_node_time, batch_size, sample_num, batch_id, out);
+            break;
+        case SAMPLE_INVERSE_DEGREE:
+            sample_and_gather_batch<SAMPLE_INVERSE_DEGREE>(batch_node_id, batch_node_time, batch_size, sample_num, batch_id, out);
+            break;
+        default:
+            sample_and_gather_batch<SAMPLE_NONE>(batch_node_id, batch_node_time, batch_size, sample_num, batch_id, out);
+            break;
+    }
+
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+double FeatureStoreT<Types>::sample_and_gather(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                                               FeatureBuffers<Types>& out, EdgeType sample_num, const string& sample_strategy) {
+    return sample_and_gather(batch_node_id.data(), batch_node_time.data(), batch_node_id.size(), out, sample_num,
+                             parse_sample_strategy(sample_strategy));
+}
+
+template <typename Types>
+double FeatureStoreT<Types>::gather(const NodeType* batch_node_id, size_t batch_size, FeatureBuffers<Types>& out) {
+    double start_time = omp_get_wtime();
+    EdgeType sample_num = out.samples.sample_num;
+    out.resize(batch_size, sample_num, edge_features.get_dim(), node_features.get_dim(), node_memory.get_dim());
+    uint64_t hits = 0;
+    uint64_t missing = 0;
+    gather_batch(batch_node_id, batch_size, out, hits, missing);
+    finish_batch(batch_size, out, hits, missing);
+
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+FeatureStoreStats FeatureStoreT<Types>::stats() const {
+    FeatureStoreStats result;
+    result.batches = batches.load(memory_order_relaxed);
+    result.edge_rows = edge_rows.load(memory_order_relaxed);
+    result.node_rows = node_rows.load(memory_order_relaxed);
+    result.cache_hits = cache_hits.load(memory_order_relaxed);
+    result.missing_rows = missing_rows.load(memory_order_relaxed);
+    return result;
+}
+
+template <typename Types>
+void FeatureStoreT<Types>::reset_stats() {
+    batches.store(0);
+    edge_rows.store(0);
+    node_rows.store(0);
+    cache_hits.store(0);
+    missing_rows.store(0);
+}
+
+template struct FeatureBuffers<TGNGraphTypes>;
+template struct FeatureBuffers<TGLGraphTypes>;
+template class FeatureStoreT<TGNGraphTypes>;
+template class FeatureStoreT<TGLGraphTypes>;
@@ -0,0 +1,324 @@
+// feature_store.h - Edge features and node memory gathered together with the sampled neighbors
+#ifndef FEATURE_STORE_H
+#define FEATURE_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include "utils.h"
+#include "csr_snapshot.h"
+#include "sampler_kernels.h"
+#include "TemporalGraph.h"
+
+using namespace std;
+
+/*
+Storage types of a feature matrix. Rows are always handed out as float; the narrower types trade
+precision for memory and bandwidth:
+  "float32"  - as is
+  "float16"  - IEEE half precision, round to nearest even
+  "bfloat16" - the upper half of a float32, round to nearest even
+  "int8"     - symmetric per-row quantization, value = q * scale[row] with scale = max |x| / 127
+*/
+enum FeatureDType {
+    FEATURE_FLOAT32,
+    FEATURE_FLOAT16,
+    FEATURE_BFLOAT16,
+    FEATURE_INT8
+};
+
+bool parse_feature_dtype(const string& name, FeatureDType& dtype);
+const char* feature_dtype_name(FeatureDType dtype);
+size_t feature_dtype_bytes(FeatureDType dtype);
+
+inline uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float bits_float(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline float half_to_float(uint16_t half) {
+    // Move exponent and mantissa into place and rebias the exponent; infinities and NaNs get an
+    // all-ones exponent, subnormals are renormalized by one float subtraction
+    const uint32_t shifted_exponent = 0x7C00u << 13;
+    uint32_t bits = static_cast<uint32_t>(half & 0x7FFF) << 13;
+    uint32_t exponent = bits & shifted_exponent;
+    bits += (127 - 15) << 23;
+    if (exponent == shifted_exponent) {
+        bits += (128 - 16) << 23;
+    } else if (exponent == 0) {
+        bits += 1 << 23;
+        bits = float_bits(bits_float(bits) - bits_float(113u << 23));
+    }
+    return bits_float(bits | (static_cast<uint32_t>(half & 0x8000) << 16));
+}
+
+inline uint16_t float_to_half(float value) {
+    uint32_t bits = float_bits(value);
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t magnitude = bits & 0x7FFFFFFFu;
+    if (magnitude >= 0x7F800000u) {
+        // Infinity stays infinity, NaN becomes a quiet NaN
+        return sign | (magnitude > 0x7F800000u ? 0x7E00 : 0x7C00);
+    }
+    if (magnitude >= 0x47800000u) {
+        return sign | 0x7C00;  // beyond the half range
+    }
+    if (magnitude < 0x38800000u) {
+        // Subnormal half: the addition rounds the mantissa at the right position
+        float rounded = bits_float(magnitude) + 0.5f;
+        return sign | static_cast<uint16_t>(float_bits(rounded) - float_bits(0.5f));
+    }
+    uint32_t odd = (magnitude >> 13) & 1;
+    magnitude += 0xC8000FFFu + odd;  // rebias the exponent (-112 << 23) and round to nearest even
+    return sign | static_cast<uint16_t>(magnitude >> 13);
+}
+
+inline float bfloat16_to_float(uint16_t value) {
+    return bits_float(static_cast<uint32_t>(value) << 16);
+}
+
+inline uint16_t float_to_bfloat16(float value) {
+    uint32_t bits = float_bits(value);
+    if ((bits & 0x7FFFFFFFu) > 0x7F800000u) {
+        return static_cast<uint16_t>((bits >> 16) | 0x40);  // quiet NaN
+    }
+    return static_cast<uint16_t>((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+}
+
+/*
+Layout of a binary feature matrix file (native byte order):
+  FeatureFileHeader
+  data   [rows * dim] of dtype
+  scales [rows] of float, int8 only
+Both sections start at a multiple of CSR_SNAPSHOT_ALIGNMENT and are used in place after mmap.
+*/
+const uint32_t FEATURE_FILE_VERSION = 1;
+
+struct FeatureFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t dtype;
+    uint32_t dim;
+    uint64_t rows;
+    uint64_t data_offset;
+    uint64_t data_bytes;
+    uint64_t scale_offset;
+    uint64_t scale_bytes;
+    uint64_t data_checksum;
+    uint64_t scale_checksum;
+    // Checksum over all preceding header bytes
+    uint64_t header_checksum;
+};
+
+/*
+A rows x dim matrix of features, either memory-mapped from a feature file (read-only, shared with
+every process mapping it) or held in memory (e.g. node memory written back by the trainer).
+*/
+class FeatureMatrix {
+private:
+    shared_ptr<MappedFile> file;
+    vector<char> storage;
+    vector<float> scale_storage;
+    const char* data;
+    const float* scales;
+    FeatureDType dtype;
+    size_t rows;
+    size_t dim;
+    size_t row_bytes;
+
+    void bind_storage();
+
+public:
+    FeatureMatrix();
+
+    // Map a feature file; verify_checksums reads it all once to check the sections
+    bool load(const string& file_path, bool verify_checksums = false);
+    // Store rows x dim floats (row-major) as dtype in memory
+    void assign(const float* values, size_t rows, size_t dim, FeatureDType dtype = FEATURE_FLOAT32);
+    // rows x dim zeros stored as dtype in memory
+    void assign_zeros(size_t rows, size_t dim, FeatureDType dtype = FEATURE_FLOAT32);
+    bool save(const string& file_path) const;
+    void clear();
+
+    bool empty() const { return rows == 0; }
+    size_t num_rows() const { return rows; }
+    size_t get_dim() const { return dim; }
+    FeatureDType get_dtype() const { return dtype; }
+    bool is_mapped() const { return file != nullptr; }
+    size_t bytes() const { return rows * row_bytes + (scales ? rows * sizeof(float) : 0); }
+
+    const char* row_data(size_t row) const { return data + row * row_bytes; }
+    // Dequantize one row into dim floats
+    void read_row(size_t row, float* out) const;
+    // Quantize values into one row; only for matrices held in memory, and not concurrently with
+    // reads of the same row
+    void write_row(size_t row, const float* values);
+};
+
+/*
+Read a 2-D C-order .npy array of float32 or float64 (e.g. the edge and node feature files of the
+TGN datasets) as float rows.
+*/
+bool read_npy_matrix(const string& file_path, vector<float>& values, size_t& rows, size_t& dim);
+
+/*
+Output of one sample-and-gather call, every block row-major and ready to hand over as a tensor:
+  samples           - the sampled neighbors, laid out as in SampleBuffers
+  edge_features     - batch_size x sample_num x edge_dim, features of the sampled edges
+  root_features     - batch_size x node_dim
+  neighbor_features - batch_size x sample_num x node_dim
+  root_memory       - batch_size x memory_dim
+  neighbor_memory   - batch_size x sample_num x memory_dim
+Padding slots, rows the store has no matrix for and ids outside a matrix are zero. Like
+SampleBuffers, the vectors only grow.
+*/
+template <typename Types>
+struct FeatureBuffers {
+    typedef typename Types::EdgeType EdgeType;
+
+    SampleBuffers<Types> samples;
+    size_t edge_dim = 0;
+    size_t node_dim = 0;
+    size_t memory_dim = 0;
+    vector<float> edge_features;
+    vector<float> root_features;
+    vector<float> neighbor_features;
+    vector<float> root_memory;
+    vector<float> neighbor_memory;
+
+    void resize(size_t batch_size, EdgeType sample_num, size_t edge_dim, size_t node_dim, size_t memory_dim);
+};
+
+struct FeatureStoreOptions {
+    // Hot node feature rows kept dequantized in a dense cache (0: no cache)
+    size_t cache_rows = 0;
+    // Rebuild the cache from the access counts after the first batch and then every this many
+    // batches; the counts then halve, so the cache follows the recently hot nodes
+    int cache_refresh_batches = 64;
+};
+
+// Rows gathered since the last reset
+struct FeatureStoreStats {
+    uint64_t batches;
+    uint64_t edge_rows;
+    uint64_t node_rows;
+    uint64_t cache_hits;
+    uint64_t missing_rows;  // ids outside a matrix, returned as zeros
+};
+
+/*
+Edge features, node features and node memory of a TemporalGraphT, gathered for a sampled batch
+into the contiguous tensors of FeatureBuffers by the same call that samples it. Sampling uses
+the shared batch loop (planned for large batches); the gather then runs over the rows in input
+order, every thread on one contiguous range, prefetching all feature rows of the next row while
+copying the current one. Edge features are indexed by edge id (idx_values), node features and
+memory by node id.
+
+Rows draw from the same streams as TemporalGraphT::sampling, so with the same seed and sequence
+of calls the samples are identical. The graph must outlive the store, and one store serves one
+sampling call at a time; node memory may only be updated between calls.
+*/
+template <typename Types>
+class FeatureStoreT {
+public:
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+private:
+    const TemporalGraphT<Types>& graph;
+    FeatureStoreOptions options;
+    FeatureMatrix edge_features;
+    FeatureMatrix node_features;
+    FeatureMatrix node_memory;
+
+    // Hot node feature cache: cache_entries[node] holds the row of node in cache_values (or -1)
+    // next to its access count, so a lookup costs one random access. Counts are approximate
+    // (racing increments may be lost), which is all ranking needs.
+    struct CacheEntry {
+        int32_t slot;
+        atomic<uint32_t> count;
+    };
+    unique_ptr<CacheEntry[]> cache_entries;
+    vector<float> cache_values;
+    vector<NodeType> cached_nodes;
+    size_t batches_since_refresh;
+    bool cache_warm;  // built from the counts of at least one batch
+
+    uint64_t random_seed;
+    atomic<uint64_t> batch_counter;
+    SampleParams sample_params;
+
+    atomic<uint64_t> batches;
+    atomic<uint64_t> edge_rows;
+    atomic<uint64_t> node_rows;
+    atomic<uint64_t> cache_hits;
+    atomic<uint64_t> missing_rows;
+
+    void reset_cache();
+    void refresh_cache();
+    void gather_node(NodeType node, bool count_access, float* features, float* memory, uint64_t& hits, uint64_t& missing) const;
+    void prefetch_gather_row(const NodeType* neighbors, const EdgeType* neighbor_idx, EdgeType count,
+                             const FeatureBuffers<Types>& out) const;
+    void gather_row(NodeType root, const NodeType* neighbors, const EdgeType* neighbor_idx, EdgeType count, EdgeType sample_num,
+                    size_t b, FeatureBuffers<Types>& out, uint64_t& hits, uint64_t& missing) const;
+    void gather_rows(const NodeType* batch_node_id, size_t begin, size_t end, FeatureBuffers<Types>& out, uint64_t& hits,
+                     uint64_t& missing) const;
+    void gather_batch(const NodeType* batch_node_id, size_t batch_size, FeatureBuffers<Types>& out, uint64_t& hits,
+                      uint64_t& missing) const;
+    template <SampleStrategy S>
+    void sample_and_gather_batch(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                                 EdgeType sample_num, uint64_t batch_id, FeatureBuffers<Types>& out);
+    void finish_batch(size_t batch_size, const FeatureBuffers<Types>& out, uint64_t hits, uint64_t missing);
+
+    FeatureStoreT(const FeatureStoreT&) = delete;
+    FeatureStoreT& operator=(const FeatureStoreT&) = delete;
+
+public:
+    FeatureStoreT(const TemporalGraphT<Types>& graph, const FeatureStoreOptions& options = FeatureStoreOptions());
+
+    // Feature files written by save_feature_file (or FeatureMatrix::save), mapped in place
+    bool load_edge_features(const string& file_path, bool verify_checksums = false);
+    bool load_node_features(const string& file_path, bool verify_checksums = false);
+    // In-memory matrices, rows x dim floats stored as dtype
+    void set_edge_features(const float* values, size_t rows, size_t dim, FeatureDType dtype = FEATURE_FLOAT32);
+    void set_node_features(const float* values, size_t rows, size_t dim, FeatureDType dtype = FEATURE_FLOAT32);
+    // Zero node memory of rows x dim, updated by the trainer with update_node_memory
+    void init_node_memory(size_t rows, size_t dim, FeatureDType dtype = FEATURE_FLOAT32);
+    // Overwrite the memory of n nodes with n rows of values
+    void update_node_memory(const NodeType* nodes, size_t n, const float* values);
+
+    const FeatureMatrix& get_edge_features() const { return edge_features; }
+    const FeatureMatrix& get_node_features() const { return node_features; }
+    const FeatureMatrix& get_node_memory() const { return node_memory; }
+
+    void set_random_seed(uint64_t seed);
+    void set_sample_params(const SampleParams& params);
+
+    // Sample like TemporalGraphT::sampling_into and gather the features of the batch into out
+    double sample_and_gather(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                             FeatureBuffers<Types>& out, EdgeType sample_num, SampleStrategy sample_strategy);
+    double sample_and_gather(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                             FeatureBuffers<Types>& out, EdgeType sample_num = 32, const string& sample_strategy = "recent");
+    // Gather the features of a batch sampled elsewhere (out.samples already holds it)
+    double gather(const NodeType* batch_node_id, size_t batch_size, FeatureBuffers<Types>& out);
+
+    FeatureStoreStats stats() const;
+    void reset_stats();
+};
+
+typedef FeatureStoreT<TGNGraphTypes> FeatureStore;
+
+#endif // FEATURE_STORE_H
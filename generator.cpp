@@ -0,0 +1,309 @@
+// generator.cpp - Synthetic temporal edge streams for scale testing
+#include "generator.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <omp.h>
+
+// Blocks formatted in parallel per CSV write round, per thread
+static const size_t CSV_BLOCKS_PER_THREAD = 2;
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Bijection of [0, n) that spreads the popular (low) ranks over the whole id range
+struct NodePermutation {
+    uint64_t n;
+    uint64_t multiplier;
+    uint64_t offset;
+
+    NodePermutation(uint64_t n, uint64_t seed) : n(n), multiplier(1), offset(0) {
+        if (n > 1) {
+            multiplier = mix64(seed) % n;
+            while (multiplier == 0 || gcd(multiplier, n) != 1) {
+                multiplier = (multiplier + 1) % n;
+            }
+            offset = mix64(seed + 1) % n;
+        }
+    }
+
+    uint64_t operator()(uint64_t rank) const {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(rank) * multiplier + offset) % n);
+    }
+};
+
+// Rank in [0, n) with probability roughly proportional to (rank + 1)^-skew (inverse CDF of the
+// continuous power law on [1, n + 1))
+static inline uint64_t zipf_rank(double u, uint64_t n, double skew) {
+    double x;
+    if (skew == 0) {
+        x = 1 + u * n;
+    } else if (fabs(skew - 1) < 1e-9) {
+        x = exp(u * log(static_cast<double>(n) + 1));
+    } else {
+        double a = 1 - skew;
+        x = pow(1 + u * (pow(static_cast<double>(n) + 1, a) - 1), 1 / a);
+    }
+    uint64_t rank = static_cast<uint64_t>(x) - 1;
+    return min(rank, n - 1);
+}
+
+static inline double standard_normal(CounterRng& rng) {
+    // Box-Muller
+    double u1 = 1.0 - rng.uniform();
+    double u2 = rng.uniform();
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+bool check_generator_options(const GeneratorOptions& options) {
+    if (options.num_nodes == 0) {
+        cerr << "The generator needs at least one node" << endl;
+        return false;
+    }
+    if (options.skew < 0 || options.burstiness < 0 || !(options.time_span > 0)) {
+        cerr << "skew and burstiness must be non-negative and time_span positive" << endl;
+        return false;
+    }
+    if (options.time_distribution != "uniform" && options.time_distribution != "growth") {
+        cerr << "Unknown time distribution " << options.time_distribution << " (uniform or growth)" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool parse_generator_option(const string& key, const string& value, GeneratorOptions& options) {
+    if (key == "--edges") {
+        options.num_edges = stoull(value);
+    } else if (key == "--nodes") {
+        options.num_nodes = stoull(value);
+    } else if (key == "--skew") {
+        options.skew = stod(value);
+    } else if (key == "--burstiness") {
+        options.burstiness = stod(value);
+    } else if (key == "--time-distribution") {
+        options.time_distribution = value;
+    } else if (key == "--time-span") {
+        options.time_span = stod(value);
+    } else if (key == "--seed") {
+        options.seed = stoull(value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+Time layout of the blocks: block b gets a share of [0, 1) proportional to its number of edges
+times exp(burstiness * z_b), z_b standard normal, so bursty blocks pack their edges into a short
+interval. block_start[b] is where block b starts, block_start[num_blocks] == 1.
+*/
+static void layout_blocks(const GeneratorOptions& options, vector<double>& block_start) {
+    uint64_t num_blocks = (options.num_edges + GENERATOR_BLOCK_EDGES - 1) / GENERATOR_BLOCK_EDGES;
+    block_start.assign(num_blocks + 1, 0);
+    for (uint64_t b = 0; b < num_blocks; ++b) {
+        uint64_t count = min(GENERATOR_BLOCK_EDGES, options.num_edges - b * GENERATOR_BLOCK_EDGES);
+        CounterRng rng(options.seed, 3 * b);
+        block_start[b + 1] = block_start[b] + count * exp(options.burstiness * standard_normal(rng));
+    }
+    double total = block_start[num_blocks];
+    for (uint64_t b = 1; b <= num_blocks; ++b) {
+        block_start[b] = total > 0 ? block_start[b] / total : 1;
+    }
+}
+
+/*
+Generate block b, calling emit(k, src, dst, time) for its edges k = 0, 1, ... in time order.
+Times inside the block are sorted uniforms built from normalized exponential spacings; the
+spacings stream is replayed twice (sum, then emit) instead of being stored.
+*/
+template <typename Emit>
+static void generate_block(const GeneratorOptions& options, const vector<double>& block_start, const NodePermutation& permutation,
+                           uint64_t b, Emit emit) {
+    uint64_t count = min(GENERATOR_BLOCK_EDGES, options.num_edges - b * GENERATOR_BLOCK_EDGES);
+    double begin = block_start[b];
+    double width = block_start[b + 1] - begin;
+
+    double total = 0;
+    CounterRng spacing_rng(options.seed, 3 * b + 1);
+    for (uint64_t k = 0; k <= count; ++k) {
+        total -= log(1.0 - spacing_rng.uniform());
+    }
+
+    bool growth = options.time_distribution == "growth";
+    double sum = 0;
+    spacing_rng = CounterRng(options.seed, 3 * b + 1);
+    CounterRng node_rng(options.seed, 3 * b + 2);
+    for (uint64_t k = 0; k < count; ++k) {
+        sum -= log(1.0 - spacing_rng.uniform());
+        double fraction = min(begin + width * (sum / total), 1.0);
+        // growth: the rate rises linearly, i.e. the CDF of time is (t / time_span)^2
+        double time = min(options.time_span * (growth ? sqrt(fraction) : fraction), nextafter(options.time_span, 0.0));
+        if (options.integer_times) {
+            time = floor(time);
+        }
+        uint64_t src = permutation(zipf_rank(node_rng.uniform(), options.num_nodes, options.skew));
+        uint64_t dst = permutation(zipf_rank(node_rng.uniform(), options.num_nodes, options.skew));
+        emit(k, src, dst, time);
+    }
+}
+
+template <typename Types>
+bool generate_temporal_edges(const GeneratorOptions& options, vector<typename Types::EdgeType>& edge_idx,
+                             vector<typename Types::NodeType>& src_list, vector<typename Types::NodeType>& dst_list,
+                             vector<typename Types::TimeType>& time_list) {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+    double start_time = omp_get_wtime();
+    if (!check_generator_options(options)) {
+        return false;
+    }
+    if (!generator_fits_types<Types>(options)) {
+        cerr << "The generated graph does not fit " << sizeof(NodeType) * 8 << "-bit node ids, " << sizeof(EdgeType) * 8
+             << "-bit edge ids and " << sizeof(TimeType) * 8 << "-bit timestamps" << endl;
+        return false;
+    }
+
+    vector<double> block_start;
+    layout_blocks(options, block_start);
+    NodePermutation permutation(options.num_nodes, options.seed);
+    size_t num_edges = options.num_edges;
+    edge_idx.resize(num_edges);
+    src_list.resize(num_edges);
+    dst_list.resize(num_edges);
+    time_list.resize(num_edges);
+
+    long long num_blocks = static_cast<long long>(block_start.size()) - 1;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long long b = 0; b < num_blocks; ++b) {
+        size_t first = b * GENERATOR_BLOCK_EDGES;
+        generate_block(options, block_start, permutation, b, [&](uint64_t k, uint64_t src, uint64_t dst, double time) {
+            edge_idx[first + k] = static_cast<EdgeType>(first + k + 1);
+            src_list[first + k] = static_cast<NodeType>(src);
+            dst_list[first + k] = static_cast<NodeType>(dst);
+            time_list[first + k] = static_cast<TimeType>(time);
+        });
+    }
+
+    double end_time = omp_get_wtime();
+    cout << "Generated " << num_edges << " edges in " << end_time - start_time << " s" << endl;
+    return true;
+}
+
+template <typename Types>
+bool generate_temporal_graph(const GeneratorOptions& options, TemporalGraphT<Types>& graph) {
+    vector<typename Types::EdgeType> edge_idx;
+    vector<typename Types::NodeType> src_list;
+    vector<typename Types::NodeType> dst_list;
+    vector<typename Types::TimeType> time_list;
+    if (!generate_temporal_edges<Types>(options, edge_idx, src_list, dst_list, time_list)) {
+        return false;
+    }
+    graph.assign_edges(std::move(edge_idx), std::move(src_list), std::move(dst_list), std::move(time_list));
+    return true;
+}
+
+static inline void append_uint(string& out, uint64_t value) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n > 0) {
+        out.push_back(digits[--n]);
+    }
+}
+
+static inline void append_time(string& out, double time, bool integer_times) {
+    if (integer_times) {
+        append_uint(out, static_cast<uint64_t>(time));
+        return;
+    }
+    char buffer[32];
+    int n = snprintf(buffer, sizeof(buffer), "%.17g", time);
+    out.append(buffer, n);
+}
+
+bool write_temporal_edges_csv(const GeneratorOptions& options, const string& file_path, const string& format) {
+    double start_time = omp_get_wtime();
+    if (!check_generator_options(options)) {
+        return false;
+    }
+    if (format != "tgn" && format != "tgl") {
+        cerr << "Unknown CSV format " << format << " (tgn or tgl)" << endl;
+        return false;
+    }
+    bool tgl = format == "tgl";
+
+    ofstream file(file_path, ios::binary | ios::trunc);
+    if (!file) {
+        cerr << "Failed to open " << file_path << " for writing" << endl;
+        return false;
+    }
+    file << (tgl ? ",src,dst,time,int_roll,ext_roll\n" : ",u,i,ts,label,idx\n");
+
+    vector<double> block_start;
+    layout_blocks(options, block_start);
+    NodePermutation permutation(options.num_nodes, options.seed);
+    uint64_t num_blocks = block_start.size() - 1;
+    uint64_t train_end = options.num_edges * 7 / 10;
+    uint64_t validation_end = options.num_edges * 85 / 100;
+
+    size_t round_blocks = static_cast<size_t>(omp_get_max_threads()) * CSV_BLOCKS_PER_THREAD;
+    vector<string> texts(round_blocks);
+    for (uint64_t first_block = 0; first_block < num_blocks; first_block += round_blocks) {
+        long long blocks = static_cast<long long>(min<uint64_t>(round_blocks, num_blocks - first_block));
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (long long r = 0; r < blocks; ++r) {
+            uint64_t b = first_block + r;
+            uint64_t first = b * GENERATOR_BLOCK_EDGES;
+            string& text = texts[r];
+            text.clear();
+            text.reserve(GENERATOR_BLOCK_EDGES * 40);
+            generate_block(options, block_start, permutation, b, [&](uint64_t k, uint64_t src, uint64_t dst, double time) {
+                uint64_t row = first + k;
+                append_uint(text, row);
+                text.push_back(',');
+                append_uint(text, src);
+                text.push_back(',');
+                append_uint(text, dst);
+                text.push_back(',');
+                append_time(text, time, options.integer_times);
+                if (tgl) {
+                    text.append(",0,");
+                    text.push_back(row < train_end ? '0' : (row < validation_end ? '1' : '2'));
+                } else {
+                    text.append(",0,");
+                    append_uint(text, row + 1);
+                }
+                text.push_back('\n');
+            });
+        }
+        for (long long r = 0; r < blocks; ++r) {
+            file.write(texts[r].data(), texts[r].size());
+        }
+    }
+    file.close();
+    if (!file) {
+        cerr << "Failed to write " << file_path << endl;
+        return false;
+    }
+
+    double end_time = omp_get_wtime();
+    cout << "Wrote " << options.num_edges << " edges to " << file_path << " in " << end_time - start_time << " s" << endl;
+    return true;
+}
+
+template bool generate_temporal_edges<TGNGraphTypes>(const GeneratorOptions&, vector<TGNGraphTypes::EdgeType>&, vector<TGNGraphTypes::NodeType>&,
+                                                     vector<TGNGraphTypes::NodeType>&, vector<TGNGraphTypes::TimeType>&);
+template bool generate_temporal_edges<TGLGraphTypes>(const GeneratorOptions&, vector<TGLGraphTypes::EdgeType>&, vector<TGLGraphTypes::NodeType>&,
+                                                     vector<TGLGraphTypes::NodeType>&, vector<TGLGraphTypes::TimeType>&);
+template bool generate_temporal_graph<TGNGraphTypes>(const GeneratorOptions&, TemporalGraphT<TGNGraphTypes>&);
+template bool generate_temporal_graph<TGLGraphTypes>(const GeneratorOptions&, TemporalGraphT<TGLGraphTypes>&);
@@ -0,0 +1,76 @@
+// generator.h - Synthetic temporal edge streams for scale testing
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <type_traits>
+#include "utils.h"
+#include "TemporalGraph.h"
+
+using namespace std;
+
+/*
+Parameters of a synthetic temporal edge stream:
+  num_edges, num_nodes - size of the stream and of the node id range [0, num_nodes)
+  skew              - Zipf exponent of node popularity for sources and destinations (0 = uniform)
+  burstiness        - log-normal sigma of the edge rate of every block of edges (0 = steady rate)
+  time_distribution - "uniform" for a constant base rate, "growth" for a rate that grows linearly with time
+  time_span         - timestamps lie in [0, time_span)
+  integer_times     - round timestamps down to whole numbers, like the TGN datasets
+The stream is generated in fixed blocks of GENERATOR_BLOCK_EDGES edges, each from its own counter-based
+random stream, so the output only depends on the options and seed, never on the number of threads.
+Edges come out in time order with edge ids 1..num_edges (the ids read_csv_file_* produce).
+*/
+struct GeneratorOptions {
+    uint64_t num_edges = 1000000;
+    uint64_t num_nodes = 10000;
+    double skew = 1.0;
+    double burstiness = 0.0;
+    string time_distribution = "uniform";
+    double time_span = 1e7;
+    bool integer_times = true;
+    uint64_t seed = DEFAULT_RANDOM_SEED;
+};
+
+const uint64_t GENERATOR_BLOCK_EDGES = 1 << 16;
+
+// Check the options, printing the reason when they are unusable
+bool check_generator_options(const GeneratorOptions& options);
+// Apply one command line option (--edges, --nodes, --skew, --burstiness, --time-distribution,
+// --time-span, --seed). Returns false if key is not a generator option.
+bool parse_generator_option(const string& key, const string& value, GeneratorOptions& options);
+
+// Whether the generated ids, edge count (reversed T-CSR included) and timestamps fit Types exactly,
+// by the rule of the CSV reader: a floating-point TimeType narrower than double holds whole
+// timestamps up to 2^digits, and fractional ones (generated as doubles) only fit double
+template <typename Types>
+inline bool generator_fits_types(const GeneratorOptions& options) {
+    typedef typename Types::TimeType TimeType;
+    bool exact_times = !is_floating_point<TimeType>::value ||
+                       numeric_limits<TimeType>::digits >= numeric_limits<double>::digits ||
+                       (options.integer_times && options.time_span <= static_cast<double>(1ULL << numeric_limits<TimeType>::digits));
+    return options.num_nodes - 1 <= static_cast<uint64_t>(numeric_limits<typename Types::NodeType>::max()) &&
+           options.num_edges <= static_cast<uint64_t>(numeric_limits<typename Types::EdgeType>::max() / 2) && exact_times;
+}
+
+// Generate the whole stream into edge lists (TGN or TGL types)
+template <typename Types>
+bool generate_temporal_edges(const GeneratorOptions& options, vector<typename Types::EdgeType>& edge_idx,
+                             vector<typename Types::NodeType>& src_list, vector<typename Types::NodeType>& dst_list,
+                             vector<typename Types::TimeType>& time_list);
+
+// Generate the stream straight into the edge lists of graph (ready for to_csr)
+template <typename Types>
+bool generate_temporal_graph(const GeneratorOptions& options, TemporalGraphT<Types>& graph);
+
+/*
+Write the stream as CSV in the TGN layout (",u,i,ts,label,idx") or the TGL layout
+(",src,dst,time,int_roll,ext_roll", with ext_roll splitting the stream 70/15/15 into
+train/validation/test). Blocks are formatted in parallel and written in order, so memory
+stays bounded for billion-edge streams.
+*/
+bool write_temporal_edges_csv(const GeneratorOptions& options, const string& file_path, const string& format = "tgn");
+
+#endif // GENERATOR_H
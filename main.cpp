@@ -1,31 +1,27 @@
-// g++ -fopenmp -std=c++11 main.cpp TemporalGraph.cpp readcsv.cpp  utils.cpp -o main
+// g++ -fopenmp -std=c++11 main.cpp TemporalGraph.cpp readcsv.cpp  utils.cpp csr_snapshot.cpp simd_kernels.cpp metrics.cpp -o main
 #include "TemporalGraph.h"
 #include "readcsv.h"
 #include "utils.h"
 
-int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <integer1> <integer2>\n";
-        return 1;
-    }
-    int sample_num_argv = std::stoi(argv[1]);
-    int mini_batch_argv = std::stoi(argv[2]);
-    cout << "start coverting..." << endl;
+template <typename Types>
+static CsvReadResult run(const string& file_path, int sample_num_argv, int mini_batch_argv) {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
     // Initialize vectors
-    vector<GraphDataType> edge_idx;
-    vector<GraphDataType> src_list;
-    vector<GraphDataType> dst_list;
-    vector<GraphDataType> time_list;
-    string file_path = "./reddit.csv";
+    vector<EdgeType> edge_idx;
+    vector<NodeType> src_list;
+    vector<NodeType> dst_list;
+    vector<TimeType> time_list;
 
-    /*
-    read_csv_file_tgn_format - for the tgn graph data type with million-scale edges;
-    read_csv_file_tgl_format - for the tgl graph data type with billion-scale edges.
-    */
-    read_csv_file_tgn_format(file_path, edge_idx, src_list, dst_list, time_list);
+    CsvReadResult result = read_csv_file_parallel<Types>(file_path, edge_idx, src_list, dst_list, time_list);
+    if (result != CSV_READ_OK) {
+        return result;
+    }
 
     bool reverse = false;
-    TemporalGraph tg(edge_idx, src_list, dst_list, time_list, reverse);
+    TemporalGraphT<Types> tg(edge_idx, src_list, dst_list, time_list, reverse);
 
     tg.to_csr();
 
@@ -42,20 +38,25 @@ int main(int argc, char* argv[]) {
         if (createDirectory(root_path)) {
             cout << "Folder created or already exists." << endl;
         }
-        tg.save_csr(root_path + "idx_values.csv", root_path + "time_values.csv", root_path + "indices.csv", root_path + "indptr.csv");
-        cout << "CSR saved at " << root_path << endl;
+        if (tg.save_csr_binary(root_path + "tcsr.bin")) {
+            cout << "CSR saved at " << root_path << "tcsr.bin" << endl;
+        }
     }
-    
-    exit(0);
 
-    // test sampling
-    int batch_size = mini_batch_argv * 3;
-    vector<GraphDataType> batch_node_id(edge_idx.begin(), edge_idx.begin() + batch_size);
-    vector<GraphDataType> batch_node_time(time_list.begin(), time_list.begin() + batch_size);
-    vector<vector<GraphDataType>> batch_neighbors;
-    vector<vector<GraphDataType>> batch_neighbor_times;
-    vector<vector<GraphDataType>> batch_neighbor_idx;
-    GraphDataType sample_num = sample_num_argv;
+    // test sampling: the sources, destinations and (stand-in) negatives of the first mini_batch
+    // edges, each at its edge time, as in one TGN training step
+    size_t mini_batch = min(static_cast<size_t>(max(mini_batch_argv, 0)), src_list.size());
+    vector<NodeType> batch_node_id;
+    vector<TimeType> batch_node_time;
+    for (int part = 0; part < 3; ++part) {
+        const vector<NodeType>& nodes = part == 1 ? dst_list : src_list;
+        batch_node_id.insert(batch_node_id.end(), nodes.begin(), nodes.begin() + mini_batch);
+        batch_node_time.insert(batch_node_time.end(), time_list.begin(), time_list.begin() + mini_batch);
+    }
+    vector<vector<NodeType>> batch_neighbors;
+    vector<vector<TimeType>> batch_neighbor_times;
+    vector<vector<EdgeType>> batch_neighbor_idx;
+    EdgeType sample_num = sample_num_argv;
     string sample_strategy = "recent";
 
     double elapsed_time = 0;
@@ -64,9 +65,10 @@ int main(int argc, char* argv[]) {
         elapsed_time += tg.sampling(batch_node_id, batch_node_time, batch_neighbors, batch_neighbor_times, batch_neighbor_idx, sample_num, sample_strategy);
     }
     cout << "Elapsed sampling time: " << elapsed_time / 5 << " s" << endl;
-    exit(0);
+
     // Print results
-    for (size_t i = 0; i < batch_neighbors.size(); ++i) {
+    bool print = false;
+    for (size_t i = 0; print && i < batch_neighbors.size(); ++i) {
         if (batch_neighbors[i].empty()) {
             cout << "Node " << batch_node_id[i] << " at time " << batch_node_time[i] << " has no neighbors." << endl;
             continue;
@@ -79,5 +81,28 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    return 0;
+    return CSV_READ_OK;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3 && argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " <sample_num> <mini_batch> [csv_file]\n";
+        return 1;
+    }
+    int sample_num_argv = std::stoi(argv[1]);
+    int mini_batch_argv = std::stoi(argv[2]);
+    cout << "start coverting..." << endl;
+    string file_path = argc > 3 ? argv[3] : "./reddit.csv";
+
+    /*
+    TGNGraphTypes - for the tgn graph data type with million-scale edges;
+    TGLGraphTypes - for the tgl graph data type with billion-scale edges.
+    The dataset is loaded with the TGN types unless its ids, timestamps or size need the TGL ones.
+    */
+    CsvReadResult result = run<TGNGraphTypes>(file_path, sample_num_argv, mini_batch_argv);
+    if (result == CSV_READ_DOES_NOT_FIT) {
+        cout << "Loading " << file_path << " with the TGL graph types" << endl;
+        result = run<TGLGraphTypes>(file_path, sample_num_argv, mini_batch_argv);
+    }
+    return result == CSV_READ_OK ? 0 : 1;
 }
\ No newline at end of file
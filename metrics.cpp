@@ -0,0 +1,216 @@
+// metrics.cpp - Compile-time switchable counters and phase timers of the hot paths
+#include "metrics.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <thread>
+
+static const char* const COUNTER_NAMES[METRIC_NUM_COUNTERS] = {
+    "csv_rows", "csv_bytes", "csr_edges", "sample_batches", "sample_rows", "sample_empty_rows", "sample_neighbors",
+    "sample_degree_sum"
+};
+
+static const char* const TIMER_NAMES[METRIC_NUM_TIMERS] = {
+    "csv_parse", "csr_count", "csr_prefix_sum", "csr_sort", "csr_scatter", "sample_batch", "sample_search", "sample_gather"
+};
+
+const char* metric_counter_name(MetricCounter counter) {
+    return COUNTER_NAMES[counter];
+}
+
+const char* metric_timer_name(MetricTimer timer) {
+    return TIMER_NAMES[timer];
+}
+
+// Every slot ever handed out, and a (steady clock, ticks) reference point to convert ticks to seconds
+struct MetricsRegistry {
+    mutex lock;
+    vector<ThreadMetrics*> slots;
+    chrono::steady_clock::time_point clock_start;
+    uint64_t ticks_start;
+
+    MetricsRegistry() : lock(), slots(), clock_start(chrono::steady_clock::now()), ticks_start(metrics_ticks()) {}
+};
+
+static MetricsRegistry& registry() {
+    // Never destroyed, so threads that outlive main can still count
+    static MetricsRegistry* instance = new MetricsRegistry();
+    return *instance;
+}
+
+ThreadMetrics* register_thread_metrics() {
+    void* memory = nullptr;
+    if (posix_memalign(&memory, 64, sizeof(ThreadMetrics)) != 0) {
+        throw bad_alloc();
+    }
+    memset(memory, 0, sizeof(ThreadMetrics));
+    ThreadMetrics* metrics = new (memory) ThreadMetrics();
+    MetricsRegistry& r = registry();
+    lock_guard<mutex> guard(r.lock);
+    metrics->thread_index = static_cast<int>(r.slots.size());
+    r.slots.push_back(metrics);
+    return metrics;
+}
+
+static double seconds_per_tick() {
+#if defined(__x86_64__) || defined(__i386__)
+    MetricsRegistry& r = registry();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - r.clock_start;
+    if (elapsed.count() < 0.01) {
+        this_thread::sleep_for(chrono::milliseconds(20));
+        elapsed = chrono::steady_clock::now() - r.clock_start;
+    }
+    uint64_t ticks = metrics_ticks() - r.ticks_start;
+    return ticks > 0 ? elapsed.count() / ticks : 0;
+#else
+    return 1e-9;
+#endif
+}
+
+MetricsSnapshot metrics_snapshot() {
+    MetricsSnapshot snapshot;
+    snapshot.enabled = TG_METRICS_ENABLED != 0;
+    snapshot.counters.assign(METRIC_NUM_COUNTERS, 0);
+    snapshot.timer_seconds.assign(METRIC_NUM_TIMERS, 0);
+    snapshot.timer_calls.assign(METRIC_NUM_TIMERS, 0);
+    snapshot.degree_histogram.assign(METRIC_DEGREE_BUCKETS, 0);
+    if (!snapshot.enabled) {
+        return snapshot;
+    }
+
+    double tick_seconds = seconds_per_tick();
+    MetricsRegistry& r = registry();
+    lock_guard<mutex> guard(r.lock);
+    for (ThreadMetrics* slot : r.slots) {
+        for (int c = 0; c < METRIC_NUM_COUNTERS; ++c) {
+            snapshot.counters[c] += slot->counters[c].load(memory_order_relaxed);
+        }
+        for (int t = 0; t < METRIC_NUM_TIMERS; ++t) {
+            snapshot.timer_seconds[t] += slot->timer_ticks[t].load(memory_order_relaxed) * tick_seconds;
+            snapshot.timer_calls[t] += slot->timer_calls[t].load(memory_order_relaxed);
+        }
+        for (int b = 0; b < METRIC_DEGREE_BUCKETS; ++b) {
+            snapshot.degree_histogram[b] += slot->degree_histogram[b].load(memory_order_relaxed);
+        }
+        MetricsSnapshot::ThreadLoad load;
+        load.thread_index = slot->thread_index;
+        load.rows = slot->counters[METRIC_SAMPLE_ROWS].load(memory_order_relaxed);
+        load.search_seconds = slot->timer_ticks[METRIC_TIMER_SAMPLE_SEARCH].load(memory_order_relaxed) * tick_seconds;
+        load.gather_seconds = slot->timer_ticks[METRIC_TIMER_SAMPLE_GATHER].load(memory_order_relaxed) * tick_seconds;
+        snapshot.threads.push_back(load);
+    }
+    return snapshot;
+}
+
+// Zeroes every slot; counts made concurrently with the reset may survive it
+void reset_metrics() {
+    MetricsRegistry& r = registry();
+    lock_guard<mutex> guard(r.lock);
+    for (ThreadMetrics* slot : r.slots) {
+        for (int c = 0; c < METRIC_NUM_COUNTERS; ++c) {
+            slot->counters[c].store(0, memory_order_relaxed);
+        }
+        for (int t = 0; t < METRIC_NUM_TIMERS; ++t) {
+            slot->timer_ticks[t].store(0, memory_order_relaxed);
+            slot->timer_calls[t].store(0, memory_order_relaxed);
+        }
+        for (int b = 0; b < METRIC_DEGREE_BUCKETS; ++b) {
+            slot->degree_histogram[b].store(0, memory_order_relaxed);
+        }
+    }
+}
+
+// Upper bound of degree bucket b
+static uint64_t degree_bucket_bound(int b) {
+    return b == 0 ? 0 : (1ULL << b) - 1;
+}
+
+void write_metrics_json(ostream& out, const MetricsSnapshot& snapshot) {
+    out << "{\n  \"enabled\": " << (snapshot.enabled ? "true" : "false") << ",\n  \"counters\": {";
+    for (int c = 0; c < METRIC_NUM_COUNTERS; ++c) {
+        out << (c ? ", " : "") << "\"" << COUNTER_NAMES[c] << "\": " << snapshot.counters[c];
+    }
+    uint64_t rows = snapshot.counters[METRIC_SAMPLE_ROWS];
+    out << "},\n  \"empty_row_rate\": " << (rows ? static_cast<double>(snapshot.counters[METRIC_SAMPLE_EMPTY_ROWS]) / rows : 0)
+        << ",\n  \"timers\": {";
+    for (int t = 0; t < METRIC_NUM_TIMERS; ++t) {
+        out << (t ? "," : "") << "\n    \"" << TIMER_NAMES[t] << "\": {\"seconds\": " << snapshot.timer_seconds[t]
+            << ", \"calls\": " << snapshot.timer_calls[t] << "}";
+    }
+    out << "\n  },\n  \"degree_histogram\": [";
+    bool first = true;
+    for (int b = 0; b < METRIC_DEGREE_BUCKETS; ++b) {
+        if (snapshot.degree_histogram[b] == 0) {
+            continue;
+        }
+        out << (first ? "" : ", ") << "{\"max_degree\": " << degree_bucket_bound(b) << ", \"rows\": " << snapshot.degree_histogram[b] << "}";
+        first = false;
+    }
+    out << "],\n  \"threads\": [";
+    for (size_t i = 0; i < snapshot.threads.size(); ++i) {
+        const MetricsSnapshot::ThreadLoad& load = snapshot.threads[i];
+        out << (i ? "," : "") << "\n    {\"thread\": " << load.thread_index << ", \"rows\": " << load.rows
+            << ", \"search_seconds\": " << load.search_seconds << ", \"gather_seconds\": " << load.gather_seconds << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void write_metrics_prometheus(ostream& out, const MetricsSnapshot& snapshot) {
+    out << "# HELP tg_metrics_enabled Whether the binary was built with TG_METRICS\n# TYPE tg_metrics_enabled gauge\n"
+        << "tg_metrics_enabled " << (snapshot.enabled ? 1 : 0) << "\n";
+    for (int c = 0; c < METRIC_NUM_COUNTERS; ++c) {
+        out << "# TYPE tg_" << COUNTER_NAMES[c] << "_total counter\n"
+            << "tg_" << COUNTER_NAMES[c] << "_total " << snapshot.counters[c] << "\n";
+    }
+    out << "# HELP tg_phase_seconds_total Time spent in each instrumented phase\n# TYPE tg_phase_seconds_total counter\n";
+    for (int t = 0; t < METRIC_NUM_TIMERS; ++t) {
+        out << "tg_phase_seconds_total{phase=\"" << TIMER_NAMES[t] << "\"} " << snapshot.timer_seconds[t] << "\n";
+    }
+    out << "# TYPE tg_phase_calls_total counter\n";
+    for (int t = 0; t < METRIC_NUM_TIMERS; ++t) {
+        out << "tg_phase_calls_total{phase=\"" << TIMER_NAMES[t] << "\"} " << snapshot.timer_calls[t] << "\n";
+    }
+
+    out << "# HELP tg_queried_degree Degree of the nodes queried by sampling\n# TYPE tg_queried_degree histogram\n";
+    uint64_t cumulative = 0;
+    int last_bucket = 0;
+    for (int b = 0; b < METRIC_DEGREE_BUCKETS; ++b) {
+        last_bucket = snapshot.degree_histogram[b] ? b : last_bucket;
+    }
+    for (int b = 0; b <= last_bucket; ++b) {
+        cumulative += snapshot.degree_histogram[b];
+        out << "tg_queried_degree_bucket{le=\"" << degree_bucket_bound(b) << "\"} " << cumulative << "\n";
+    }
+    out << "tg_queried_degree_bucket{le=\"+Inf\"} " << snapshot.counters[METRIC_SAMPLE_ROWS] << "\n"
+        << "tg_queried_degree_sum " << snapshot.counters[METRIC_SAMPLE_DEGREE_SUM] << "\n"
+        << "tg_queried_degree_count " << snapshot.counters[METRIC_SAMPLE_ROWS] << "\n";
+
+    out << "# HELP tg_thread_sample_rows_total Rows sampled by each thread\n# TYPE tg_thread_sample_rows_total counter\n";
+    for (const MetricsSnapshot::ThreadLoad& load : snapshot.threads) {
+        out << "tg_thread_sample_rows_total{thread=\"" << load.thread_index << "\"} " << load.rows << "\n";
+    }
+    out << "# TYPE tg_thread_sample_seconds_total counter\n";
+    for (const MetricsSnapshot::ThreadLoad& load : snapshot.threads) {
+        out << "tg_thread_sample_seconds_total{thread=\"" << load.thread_index << "\",phase=\"search\"} " << load.search_seconds << "\n"
+            << "tg_thread_sample_seconds_total{thread=\"" << load.thread_index << "\",phase=\"gather\"} " << load.gather_seconds << "\n";
+    }
+}
+
+bool write_metrics_file(const string& file_path) {
+    ofstream file(file_path);
+    if (!file) {
+        cerr << "Failed to open " << file_path << " for writing" << endl;
+        return false;
+    }
+    MetricsSnapshot snapshot = metrics_snapshot();
+    bool prometheus = file_path.size() >= 5 && file_path.compare(file_path.size() - 5, 5, ".prom") == 0;
+    if (prometheus) {
+        write_metrics_prometheus(file, snapshot);
+    } else {
+        write_metrics_json(file, snapshot);
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,197 @@
+// metrics.h - Compile-time switchable counters and phase timers of the hot paths
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+/*
+Instrumentation of ingestion, T-CSR construction and sampling. Built with -DTG_METRICS, every
+thread counts into its own cache-line aligned slot (plain relaxed loads and stores, no atomic
+read-modify-write and no sharing), and timers read the TSC. Search and gather time one row in
+METRIC_ROW_TIMING_PERIOD, so the sampling hot path pays a few cycles per row. Without TG_METRICS
+the TG_METRIC_* macros expand to nothing and the functions below report an empty, disabled
+snapshot.
+*/
+
+enum MetricCounter {
+    METRIC_CSV_ROWS,
+    METRIC_CSV_BYTES,
+    METRIC_CSR_EDGES,
+    METRIC_SAMPLE_BATCHES,
+    METRIC_SAMPLE_ROWS,
+    METRIC_SAMPLE_EMPTY_ROWS,
+    METRIC_SAMPLE_NEIGHBORS,
+    METRIC_SAMPLE_DEGREE_SUM,
+    METRIC_NUM_COUNTERS
+};
+
+// Phases of ingestion and to_csr are timed on the calling thread (wall time of the phase);
+// search and gather are summed over the rows each thread samples
+enum MetricTimer {
+    METRIC_TIMER_CSV_PARSE,
+    METRIC_TIMER_CSR_COUNT,
+    METRIC_TIMER_CSR_PREFIX_SUM,
+    METRIC_TIMER_CSR_SORT,
+    METRIC_TIMER_CSR_SCATTER,
+    METRIC_TIMER_SAMPLE_BATCH,
+    METRIC_TIMER_SAMPLE_SEARCH,
+    METRIC_TIMER_SAMPLE_GATHER,
+    METRIC_NUM_TIMERS
+};
+
+// Queried node degrees: bucket 0 holds degree 0, bucket b degrees in [2^(b-1), 2^b)
+const int METRIC_DEGREE_BUCKETS = 40;
+// Per-row timers time one row in this many per thread and scale it up; reading the clock costs
+// about as much as a short row
+const uint32_t METRIC_ROW_TIMING_PERIOD = 16;
+
+const char* metric_counter_name(MetricCounter counter);
+const char* metric_timer_name(MetricTimer timer);
+
+inline uint64_t metrics_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Counters of one thread; only the owning thread writes them
+struct alignas(64) ThreadMetrics {
+    int thread_index;
+    uint32_t rows_seen;  // drives the sampling of row timers
+    atomic<uint64_t> counters[METRIC_NUM_COUNTERS];
+    atomic<uint64_t> timer_ticks[METRIC_NUM_TIMERS];
+    atomic<uint64_t> timer_calls[METRIC_NUM_TIMERS];
+    atomic<uint64_t> degree_histogram[METRIC_DEGREE_BUCKETS];
+};
+
+// Slot of a new thread, kept (and still aggregated) after the thread exits
+ThreadMetrics* register_thread_metrics();
+
+inline ThreadMetrics& local_metrics() {
+    // Constant-initialized, so an access is a TLS load and a branch rather than a guarded call
+    static thread_local ThreadMetrics* metrics = nullptr;
+    if (metrics == nullptr) {
+        metrics = register_thread_metrics();
+    }
+    return *metrics;
+}
+
+inline void metrics_bump(atomic<uint64_t>& value, uint64_t n) {
+    value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+inline void metrics_add(MetricCounter counter, uint64_t n) {
+    metrics_bump(local_metrics().counters[counter], n);
+}
+
+// Record the ticks since start under timer and restart the clock
+inline void metrics_lap(MetricTimer timer, uint64_t& start) {
+    uint64_t now = metrics_ticks();
+    ThreadMetrics& metrics = local_metrics();
+    metrics_bump(metrics.timer_ticks[timer], now - start);
+    metrics_bump(metrics.timer_calls[timer], 1);
+    start = now;
+}
+
+// Start of a row: its ticks if this row is timed, 0 otherwise
+inline uint64_t metrics_row_start() {
+    ThreadMetrics& metrics = local_metrics();
+    return ++metrics.rows_seen % METRIC_ROW_TIMING_PERIOD == 0 ? metrics_ticks() : 0;
+}
+
+// metrics_lap for a row started with metrics_row_start, counted for the rows it stands for
+inline void metrics_row_lap(MetricTimer timer, uint64_t& start) {
+    if (start == 0) {
+        return;
+    }
+    uint64_t now = metrics_ticks();
+    ThreadMetrics& metrics = local_metrics();
+    metrics_bump(metrics.timer_ticks[timer], (now - start) * METRIC_ROW_TIMING_PERIOD);
+    metrics_bump(metrics.timer_calls[timer], METRIC_ROW_TIMING_PERIOD);
+    start = now;
+}
+
+inline void metrics_sampled_row(uint64_t degree, uint64_t count) {
+    ThreadMetrics& metrics = local_metrics();
+    int bucket = degree == 0 ? 0 : 64 - __builtin_clzll(degree);
+    metrics_bump(metrics.degree_histogram[bucket < METRIC_DEGREE_BUCKETS ? bucket : METRIC_DEGREE_BUCKETS - 1], 1);
+    metrics_bump(metrics.counters[METRIC_SAMPLE_ROWS], 1);
+    metrics_bump(metrics.counters[METRIC_SAMPLE_EMPTY_ROWS], count == 0);
+    metrics_bump(metrics.counters[METRIC_SAMPLE_NEIGHBORS], count);
+    metrics_bump(metrics.counters[METRIC_SAMPLE_DEGREE_SUM], degree);
+}
+
+// Times the enclosing scope
+class MetricsScope {
+private:
+    MetricTimer timer;
+    uint64_t start;
+
+public:
+    explicit MetricsScope(MetricTimer timer) : timer(timer), start(metrics_ticks()) {}
+    ~MetricsScope() { metrics_lap(timer, start); }
+};
+
+#define TG_METRIC_CONCAT_(a, b) a##b
+#define TG_METRIC_CONCAT(a, b) TG_METRIC_CONCAT_(a, b)
+
+#ifdef TG_METRICS
+#define TG_METRICS_ENABLED 1
+#define TG_METRIC_ADD(counter, n) metrics_add(counter, static_cast<uint64_t>(n))
+#define TG_METRIC_SCOPE(timer) MetricsScope TG_METRIC_CONCAT(tg_metric_scope_, __LINE__)(timer)
+// Start a named clock, and record the time since it under a timer (restarting it)
+#define TG_METRIC_START(clock) uint64_t clock = metrics_ticks()
+#define TG_METRIC_LAP(timer, clock) metrics_lap(timer, clock)
+// The same for the rows of sampling, timing one in METRIC_ROW_TIMING_PERIOD
+#define TG_METRIC_ROW_START(clock) uint64_t clock = metrics_row_start()
+#define TG_METRIC_ROW_LAP(timer, clock) metrics_row_lap(timer, clock)
+#define TG_METRIC_SAMPLED_ROW(degree, count) metrics_sampled_row(static_cast<uint64_t>(degree), static_cast<uint64_t>(count))
+#else
+#define TG_METRICS_ENABLED 0
+#define TG_METRIC_ADD(counter, n) ((void)0)
+#define TG_METRIC_SCOPE(timer) ((void)0)
+#define TG_METRIC_START(clock) ((void)0)
+#define TG_METRIC_LAP(timer, clock) ((void)0)
+#define TG_METRIC_ROW_START(clock) ((void)0)
+#define TG_METRIC_ROW_LAP(timer, clock) ((void)0)
+#define TG_METRIC_SAMPLED_ROW(degree, count) ((void)0)
+#endif
+
+// Counters summed over all threads, plus the per-thread ones
+struct MetricsSnapshot {
+    bool enabled;
+    vector<uint64_t> counters;
+    vector<double> timer_seconds;
+    vector<uint64_t> timer_calls;
+    vector<uint64_t> degree_histogram;
+    struct ThreadLoad {
+        int thread_index;
+        uint64_t rows;
+        double search_seconds;
+        double gather_seconds;
+    };
+    vector<ThreadLoad> threads;
+};
+
+MetricsSnapshot metrics_snapshot();
+void reset_metrics();
+void write_metrics_json(ostream& out, const MetricsSnapshot& snapshot);
+// Prometheus text exposition format; metric names start with tg_
+void write_metrics_prometheus(ostream& out, const MetricsSnapshot& snapshot);
+// Write to file_path as Prometheus text if it ends in .prom, as JSON otherwise
+bool write_metrics_file(const string& file_path);
+
+#endif // METRICS_H
@@ -0,0 +1,192 @@
+// multihop.cpp - Multi-hop temporal neighborhood sampling built on TemporalGraph::sampling
+#include "multihop.h"
+#include "parallel_scan.h"
+#include <omp.h>
+
+template <typename Types>
+MultiHopSamplerT<Types>::MultiHopSamplerT(const TemporalGraphT<Types>& graph, const vector<int>& fanouts,
+                                          const string& sample_strategy, bool deduplicate)
+    : graph(graph), fanouts(fanouts), sample_strategy(sample_strategy), deduplicate(deduplicate) {
+}
+
+/*
+Map (node, time) pairs to rows of a table; with deduplication repeated pairs share one row and
+rows are numbered in order of first occurrence. Large tables are deduplicated in parallel: the
+pairs are split into hash partitions, every partition is scanned in index order by one thread
+against its own table (so the first occurrence of every pair is found without sharing a table),
+and a prefix sum over the first occurrences numbers the rows. The result is the same as the
+serial scan for any number of threads.
+*/
+template <typename Types>
+void MultiHopSamplerT<Types>::build_table(const NodeType* nodes, const TimeType* times, size_t n,
+                                          vector<NodeType>& unique_nodes, vector<TimeType>& unique_times, EdgeType* local_rows) {
+    if (!deduplicate) {
+        unique_nodes.assign(nodes, nodes + n);
+        unique_times.assign(times, times + n);
+        for (size_t i = 0; i < n; ++i) {
+            local_rows[i] = static_cast<EdgeType>(i);
+        }
+        return;
+    }
+
+    int num_threads = n < MULTIHOP_PARALLEL_DEDUP_MIN ? 1 : omp_get_max_threads();
+    if (num_threads == 1) {
+        unique_nodes.clear();
+        unique_times.clear();
+        node_table.clear();
+        node_table.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            auto inserted = node_table.emplace(make_pair(nodes[i], times[i]), static_cast<EdgeType>(unique_nodes.size()));
+            if (inserted.second) {
+                unique_nodes.push_back(nodes[i]);
+                unique_times.push_back(times[i]);
+            }
+            local_rows[i] = inserted.first->second;
+        }
+        return;
+    }
+
+    int bits = 1;
+    while ((static_cast<size_t>(1) << bits) < static_cast<size_t>(num_threads) * MULTIHOP_DEDUP_PARTITIONS_PER_THREAD) {
+        ++bits;
+    }
+    size_t num_partitions = static_cast<size_t>(1) << bits;
+    partitions.resize(n);
+    grouped.resize(n);
+    first_rows.resize(n);
+    row_ranks.resize(n);
+    partition_offsets.assign(num_partitions * static_cast<size_t>(num_threads) + 1, 0);
+    if (thread_tables.size() < static_cast<size_t>(num_threads)) {
+        thread_tables.resize(num_threads);
+    }
+
+    // partition_offsets[p * nt + t] is where the pairs of partition p from the block of thread t
+    // start in grouped, so every partition segment lists its pairs in index order
+    NodeTimeHash<NodeType, TimeType> hasher;
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int tid = omp_get_thread_num();
+        int nt = omp_get_num_threads();
+        size_t begin = n * tid / nt;
+        size_t end = n * (tid + 1) / nt;
+        vector<size_t> cursor(num_partitions, 0);
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t p = static_cast<uint32_t>(mix64(hasher(make_pair(nodes[i], times[i]))) >> (64 - bits));
+            partitions[i] = p;
+            cursor[p]++;
+        }
+        for (size_t p = 0; p < num_partitions; ++p) {
+            partition_offsets[p * nt + tid] = cursor[p];
+        }
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            size_t sum = 0;
+            for (size_t k = 0; k < num_partitions * static_cast<size_t>(nt); ++k) {
+                size_t count = partition_offsets[k];
+                partition_offsets[k] = sum;
+                sum += count;
+            }
+            partition_offsets[num_partitions * static_cast<size_t>(nt)] = sum;
+        }
+
+        for (size_t p = 0; p < num_partitions; ++p) {
+            cursor[p] = partition_offsets[p * nt + tid];
+        }
+        for (size_t i = begin; i < end; ++i) {
+            grouped[cursor[partitions[i]]++] = static_cast<EdgeType>(i);
+        }
+
+        // Every segment of a partition is complete before the partition is deduplicated
+        #pragma omp barrier
+        NodeTable& table = thread_tables[tid];
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t p = 0; p < num_partitions; ++p) {
+            table.clear();
+            for (size_t k = partition_offsets[p * nt]; k < partition_offsets[(p + 1) * nt]; ++k) {
+                EdgeType i = grouped[k];
+                auto inserted = table.emplace(make_pair(nodes[i], times[i]), i);
+                first_rows[i] = inserted.first->second;
+                row_ranks[i] = inserted.second ? 1 : 0;
+            }
+        }
+    }
+
+    // The count of rows is read from the scanned ranks themselves
+    parallel_inclusive_scan(row_ranks.data(), n);
+    EdgeType num_unique = n ? row_ranks[n - 1] : 0;
+    unique_nodes.resize(num_unique);
+    unique_times.resize(num_unique);
+    #pragma omp parallel for num_threads(num_threads) schedule(static)
+    for (size_t i = 0; i < n; ++i) {
+        EdgeType first = first_rows[i];
+        EdgeType row = row_ranks[first] - 1;
+        local_rows[i] = row;
+        if (static_cast<size_t>(first) == i) {
+            unique_nodes[row] = nodes[i];
+            unique_times[row] = times[i];
+        }
+    }
+}
+
+template <typename Types>
+double MultiHopSamplerT<Types>::sample(const vector<NodeType>& root_nodes, const vector<TimeType>& root_times,
+                                       vector<TemporalBlock<Types>>& blocks, vector<EdgeType>& root_rows) {
+    double start_time = omp_get_wtime();
+    size_t num_layers = fanouts.size();
+    blocks.resize(num_layers);
+    if (num_layers == 0) {
+        root_rows.clear();
+        return 0;
+    }
+
+    root_rows.resize(root_nodes.size());
+    build_table(root_nodes.data(), root_times.data(), root_nodes.size(),
+                blocks[0].dst_nodes, blocks[0].dst_times, root_rows.data());
+
+    for (size_t l = 0; l < num_layers; ++l) {
+        TemporalBlock<Types>& block = blocks[l];
+        if (l > 0) {
+            // The neighbors of the previous hop are the roots of this one
+            block.dst_nodes = blocks[l - 1].src_nodes;
+            block.dst_times = blocks[l - 1].src_times;
+        }
+        size_t num_dst = block.dst_nodes.size();
+        EdgeType fanout = fanouts[l];
+
+        graph.sampling(block.dst_nodes, block.dst_times, buffers, fanout, sample_strategy);
+
+        // Compact the padded rows into edge lists
+        row_offsets.resize(num_dst + 1);
+        row_offsets[0] = 0;
+        for (size_t r = 0; r < num_dst; ++r) {
+            row_offsets[r + 1] = row_offsets[r] + buffers.counts[r];
+        }
+        size_t num_edges = row_offsets[num_dst];
+        neighbor_nodes.resize(num_edges);
+        block.edge_src.resize(num_edges);
+        block.edge_dst.resize(num_edges);
+        block.edge_idx.resize(num_edges);
+        block.edge_times.resize(num_edges);
+        #pragma omp parallel for schedule(static)
+        for (size_t r = 0; r < num_dst; ++r) {
+            size_t row = r * static_cast<size_t>(fanout);
+            for (size_t k = 0, e = row_offsets[r]; e < row_offsets[r + 1]; ++k, ++e) {
+                neighbor_nodes[e] = buffers.neighbors[row + k];
+                block.edge_dst[e] = static_cast<EdgeType>(r);
+                block.edge_idx[e] = buffers.neighbor_idx[row + k];
+                block.edge_times[e] = buffers.neighbor_times[row + k];
+            }
+        }
+
+        build_table(neighbor_nodes.data(), block.edge_times.data(), num_edges,
+                    block.src_nodes, block.src_times, block.edge_src.data());
+    }
+
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template class MultiHopSamplerT<TGNGraphTypes>;
+template class MultiHopSamplerT<TGLGraphTypes>;
@@ -0,0 +1,97 @@
+// multihop.h - Multi-hop temporal neighborhood sampling built on TemporalGraph::sampling
+#ifndef MULTIHOP_H
+#define MULTIHOP_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "utils.h"
+#include "TemporalGraph.h"
+
+using namespace std;
+
+// Below this many (node, time) pairs a table is deduplicated on the calling thread
+const size_t MULTIHOP_PARALLEL_DEDUP_MIN = 1 << 14;
+// Hash partitions per thread of the parallel deduplication
+const size_t MULTIHOP_DEDUP_PARTITIONS_PER_THREAD = 4;
+
+/*
+One hop of a multi-hop temporal sample (a message-flow graph block).
+The destination table holds the roots of the hop, the source table the sampled neighbors,
+each timed at its edge time. Block l + 1 is rooted at the source table of block l.
+Every sampled edge is stored as a pair of local rows into the two tables.
+*/
+template <typename Types>
+struct TemporalBlock {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+    vector<NodeType> dst_nodes;
+    vector<TimeType> dst_times;
+    vector<NodeType> src_nodes;
+    vector<TimeType> src_times;
+
+    vector<EdgeType> edge_src;
+    vector<EdgeType> edge_dst;
+    vector<EdgeType> edge_idx;
+    vector<TimeType> edge_times;
+
+    size_t num_edges() const { return edge_src.size(); }
+};
+
+template <typename NodeType, typename TimeType>
+struct NodeTimeHash {
+    size_t operator()(const pair<NodeType, TimeType>& key) const {
+        uint64_t h = static_cast<uint64_t>(key.first) * 0x9E3779B97F4A7C15ULL;
+        h ^= static_cast<uint64_t>(hash<TimeType>()(key.second)) + 0x7F4A7C159E3779B9ULL + (h << 6) + (h >> 2);
+        return static_cast<size_t>(h);
+    }
+};
+
+template <typename Types>
+class MultiHopSamplerT {
+public:
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+private:
+    typedef unordered_map<pair<NodeType, TimeType>, EdgeType, NodeTimeHash<NodeType, TimeType>> NodeTable;
+
+    const TemporalGraphT<Types>& graph;
+    vector<int> fanouts;
+    string sample_strategy;
+    bool deduplicate;
+
+    // Scratch state reused across calls
+    SampleBuffers<Types> buffers;
+    vector<size_t> row_offsets;
+    vector<NodeType> neighbor_nodes;
+    NodeTable node_table;
+    // Scratch state of the parallel deduplication: the hash partition of every pair, the pairs
+    // grouped by partition, the first occurrence of every pair and the running count of new pairs
+    vector<uint32_t> partitions;
+    vector<size_t> partition_offsets;
+    vector<EdgeType> grouped;
+    vector<EdgeType> first_rows;
+    vector<EdgeType> row_ranks;
+    vector<NodeTable> thread_tables;
+
+    void build_table(const NodeType* nodes, const TimeType* times, size_t n,
+                     vector<NodeType>& unique_nodes, vector<TimeType>& unique_times, EdgeType* local_rows);
+
+public:
+    // fanouts[l] is the number of neighbors sampled per root at hop l + 1
+    MultiHopSamplerT(const TemporalGraphT<Types>& graph, const vector<int>& fanouts,
+                     const string& sample_strategy = "recent", bool deduplicate = true);
+
+    // Sample len(fanouts) hops around the roots. blocks[l] describes hop l + 1; root_rows[b]
+    // is the row of root b in blocks[0].dst_nodes. Returns the elapsed time in seconds.
+    double sample(const vector<NodeType>& root_nodes, const vector<TimeType>& root_times,
+                  vector<TemporalBlock<Types>>& blocks, vector<EdgeType>& root_rows);
+};
+
+typedef MultiHopSamplerT<TGNGraphTypes> MultiHopSampler;
+
+#endif // MULTIHOP_H
@@ -0,0 +1,203 @@
+// negative_sampler.cpp - Negative destinations for link-prediction training
+#include "negative_sampler.h"
+#include <algorithm>
+#include <omp.h>
+
+bool parse_negative_strategy(const string& name, NegativeStrategy& strategy) {
+    if (name == "random") {
+        strategy = NEGATIVE_RANDOM;
+    } else if (name == "historical") {
+        strategy = NEGATIVE_HISTORICAL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* negative_strategy_name(NegativeStrategy strategy) {
+    return strategy == NEGATIVE_HISTORICAL ? "historical" : "random";
+}
+
+// Mixed into the seed of every negative stream, so negatives never share random numbers with the
+// sampling row of the same index, even under the graph's seed and batch id (e.g. edge k and its
+// source row k in sample_link_batch)
+static const uint64_t NEGATIVE_STREAM_DOMAIN = 0x4E45474154495645ULL;  // "NEGATIVE"
+
+template <typename Types>
+NegativeSamplerT<Types>::NegativeSamplerT(const TemporalGraphT<Types>& graph, const NegativeOptions& options)
+    : graph(graph), options(options), node_begin(0), node_end(0), random_seed(DEFAULT_RANDOM_SEED), batch_counter(0),
+      total_negatives(0), total_rejected(0), total_fallbacks(0), total_unfiltered(0) {
+    uint64_t num_nodes = graph.get_num_nodes();
+    node_end = options.node_end == 0 ? num_nodes : min<uint64_t>(options.node_end, num_nodes);
+    node_begin = min(options.node_begin, node_end);
+    if (node_begin == node_end) {
+        node_begin = 0;
+        node_end = num_nodes;
+    }
+}
+
+template <typename Types>
+void NegativeSamplerT<Types>::set_random_seed(uint64_t seed) {
+    random_seed = seed;
+    batch_counter.store(0);
+}
+
+template <typename Types>
+void NegativeSamplerT<Types>::sample_edge(NodeType src, NodeType dst, TimeType time, uint64_t batch_id, size_t k, NodeType* out,
+                                          NegativeStats& counts) const {
+    CounterRng rng(random_seed ^ NEGATIVE_STREAM_DOMAIN, row_stream(batch_id, k));
+
+    // src's neighbors before time are [0, history), those at time [history, at_end)
+    const NodeType* neighbors = nullptr;
+    EdgeType history = 0;
+    EdgeType at_end = 0;
+    if (src >= 0 && static_cast<uint64_t>(src) < graph.get_num_nodes()) {
+        NeighborSlice<Types> slice = graph.neighbor_slice(src);
+        neighbors = slice.indices;
+        history = slice_cutoff(slice, time);
+        at_end = static_cast<EdgeType>(upper_bound(slice.time_values + history, slice.time_values + slice.length, time) - slice.time_values);
+    }
+    auto is_true_edge = [&](NodeType v) {
+        if (v == dst) {
+            return true;
+        }
+        for (EdgeType i = history; i < at_end; ++i) {
+            if (neighbors[i] == v) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    int max_attempts = max(options.max_attempts, 1);
+    uint64_t range = node_end - node_begin;
+    for (size_t j = 0; j < options.num_negatives; ++j) {
+        NodeType v = 0;
+        bool found = false;
+        if (options.strategy == NEGATIVE_HISTORICAL) {
+            for (int attempt = 0; attempt < max_attempts && history > 0; ++attempt) {
+                v = neighbors[rng.bounded(static_cast<uint64_t>(history))];
+                if (!is_true_edge(v)) {
+                    found = true;
+                    break;
+                }
+                ++counts.rejected;
+            }
+            counts.fallbacks += found ? 0 : 1;
+        }
+        for (int attempt = 0; !found; ++attempt) {
+            v = static_cast<NodeType>(node_begin + rng.bounded(range));
+            found = !options.filter_true_edges || !is_true_edge(v);
+            if (!found) {
+                ++counts.rejected;
+                if (attempt + 1 == max_attempts) {
+                    ++counts.unfiltered;
+                    found = true;
+                }
+            }
+        }
+        out[j] = v;
+    }
+    counts.negatives += options.num_negatives;
+}
+
+template <typename Types>
+void NegativeSamplerT<Types>::sample_edges(const NodeType* src, const NodeType* dst, const TimeType* times, size_t num_edges,
+                                           NodeType* negatives, LinkBatch<Types>* batch) {
+    uint64_t batch_id = batch_counter.fetch_add(1);
+    size_t num_negatives = options.num_negatives;
+    uint64_t drawn = 0;
+    uint64_t rejected = 0;
+    uint64_t fallbacks = 0;
+    uint64_t unfiltered = 0;
+
+    // Historical rows cost a search of the source's adjacency, so threads take small chunks
+    #pragma omp parallel reduction(+ : drawn, rejected, fallbacks, unfiltered)
+    {
+        NegativeStats counts = {0, 0, 0, 0};
+        #pragma omp for schedule(dynamic, 256)
+        for (size_t k = 0; k < num_edges; ++k) {
+            sample_edge(src[k], dst[k], times[k], batch_id, k, negatives + k * num_negatives, counts);
+            if (batch != nullptr) {
+                batch->roots[k] = src[k];
+                batch->roots[num_edges + k] = dst[k];
+                batch->root_times[k] = times[k];
+                batch->root_times[num_edges + k] = times[k];
+                fill(batch->root_times.begin() + 2 * num_edges + k * num_negatives,
+                     batch->root_times.begin() + 2 * num_edges + (k + 1) * num_negatives, times[k]);
+            }
+        }
+        drawn += counts.negatives;
+        rejected += counts.rejected;
+        fallbacks += counts.fallbacks;
+        unfiltered += counts.unfiltered;
+    }
+    total_negatives.fetch_add(drawn, memory_order_relaxed);
+    total_rejected.fetch_add(rejected, memory_order_relaxed);
+    total_fallbacks.fetch_add(fallbacks, memory_order_relaxed);
+    total_unfiltered.fetch_add(unfiltered, memory_order_relaxed);
+}
+
+template <typename Types>
+double NegativeSamplerT<Types>::sample_negatives(const NodeType* src, const NodeType* dst, const TimeType* times, size_t num_edges,
+                                                 NodeType* negatives) {
+    double start_time = omp_get_wtime();
+    sample_edges(src, dst, times, num_edges, negatives, nullptr);
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+double NegativeSamplerT<Types>::sample_negatives(const vector<NodeType>& src, const vector<NodeType>& dst,
+                                                 const vector<TimeType>& times, vector<NodeType>& negatives) {
+    negatives.resize(src.size() * options.num_negatives);
+    return sample_negatives(src.data(), dst.data(), times.data(), src.size(), negatives.data());
+}
+
+template <typename Types>
+double NegativeSamplerT<Types>::sample_link_batch(const NodeType* src, const NodeType* dst, const TimeType* times, size_t num_edges,
+                                                  LinkBatch<Types>& batch, EdgeType sample_num, SampleStrategy sample_strategy) {
+    double start_time = omp_get_wtime();
+    batch.num_edges = num_edges;
+    batch.num_negatives = options.num_negatives;
+    size_t num_roots = batch.num_roots();
+    batch.roots.resize(num_roots);
+    batch.root_times.resize(num_roots);
+    sample_edges(src, dst, times, num_edges, batch.roots.data() + 2 * num_edges, &batch);
+
+    batch.samples.resize(num_roots, sample_num);
+    graph.sampling_into(batch.roots.data(), batch.root_times.data(), num_roots, batch.samples.neighbors.data(),
+                        batch.samples.neighbor_times.data(), batch.samples.neighbor_idx.data(), batch.samples.counts.data(),
+                        sample_num, sample_strategy);
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+double NegativeSamplerT<Types>::sample_link_batch(const vector<NodeType>& src, const vector<NodeType>& dst,
+                                                  const vector<TimeType>& times, LinkBatch<Types>& batch, EdgeType sample_num,
+                                                  const string& sample_strategy) {
+    return sample_link_batch(src.data(), dst.data(), times.data(), src.size(), batch, sample_num,
+                             parse_sample_strategy(sample_strategy));
+}
+
+template <typename Types>
+NegativeStats NegativeSamplerT<Types>::stats() const {
+    NegativeStats result;
+    result.negatives = total_negatives.load(memory_order_relaxed);
+    result.rejected = total_rejected.load(memory_order_relaxed);
+    result.fallbacks = total_fallbacks.load(memory_order_relaxed);
+    result.unfiltered = total_unfiltered.load(memory_order_relaxed);
+    return result;
+}
+
+template <typename Types>
+void NegativeSamplerT<Types>::reset_stats() {
+    total_negatives.store(0);
+    total_rejected.store(0);
+    total_fallbacks.store(0);
+    total_unfiltered.store(0);
+}
+
+template class NegativeSamplerT<TGNGraphTypes>;
+template class NegativeSamplerT<TGLGraphTypes>;
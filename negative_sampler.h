@@ -0,0 +1,140 @@
+// negative_sampler.h - Negative destinations for link-prediction training
+#ifndef NEGATIVE_SAMPLER_H
+#define NEGATIVE_SAMPLER_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include "utils.h"
+#include "sampler_kernels.h"
+#include "TemporalGraph.h"
+
+using namespace std;
+
+/*
+How a negative destination is drawn for a positive edge (src, dst, time):
+  "random"     - uniformly from the destination range of the options
+  "historical" - from the past neighbors of src, i.e. the T-CSR entries of src before time
+                 (weighted by how often src met them), never one src also meets at time;
+                 sources without such a neighbor fall back to random
+*/
+enum NegativeStrategy {
+    NEGATIVE_RANDOM,
+    NEGATIVE_HISTORICAL
+};
+
+bool parse_negative_strategy(const string& name, NegativeStrategy& strategy);
+const char* negative_strategy_name(NegativeStrategy strategy);
+
+struct NegativeOptions {
+    NegativeStrategy strategy = NEGATIVE_RANDOM;
+    size_t num_negatives = 1;
+    // Random negatives come from [node_begin, node_end) (node_end 0: every node of the graph), e.g.
+    // the item range of a bipartite graph
+    uint64_t node_begin = 0;
+    uint64_t node_end = 0;
+    // Redraw random negatives that are the positive destination or a true edge of src at time
+    bool filter_true_edges = false;
+    // Draws per negative before historical falls back to random and random keeps an unfiltered draw
+    int max_attempts = 16;
+};
+
+// Draws since the last reset
+struct NegativeStats {
+    uint64_t negatives;
+    uint64_t rejected;     // draws thrown away as true edges
+    uint64_t fallbacks;    // historical negatives drawn at random instead
+    uint64_t unfiltered;   // random negatives kept after max_attempts true edges
+};
+
+/*
+Roots of a link-prediction batch of num_edges positive edges and their sampled neighbors, in the
+order of a TGN training step: rows [0, num_edges) are the sources, [num_edges, 2 * num_edges) the
+destinations, and row 2 * num_edges + k * num_negatives + j negative j of edge k, each at its
+edge time. samples holds the rows as laid out by SampleBuffers.
+*/
+template <typename Types>
+struct LinkBatch {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::TimeType TimeType;
+
+    size_t num_edges = 0;
+    size_t num_negatives = 0;
+    vector<NodeType> roots;
+    vector<TimeType> root_times;
+    SampleBuffers<Types> samples;
+
+    size_t num_roots() const { return num_edges * (2 + num_negatives); }
+    const NodeType* negatives() const { return roots.data() + 2 * num_edges; }
+};
+
+/*
+Parallel negative sampler over the time-sorted T-CSR of a TemporalGraphT. Every positive edge
+draws from its own counter-based stream (seed, batch id, edge), like the rows of the sampling
+calls, so the negatives are the same for any number of threads. The streams live in a separate
+domain of the seed, so the negatives of edge k do not follow the sampled neighbors of row k (its
+source in a link batch) even under the graph's seed. True edges of src at time are found by a
+binary search of src's adjacency; in a reverse graph they include edges into src.
+Sources beyond the graph have no history, but every root of a link batch must be a node id of
+the graph, and the random range is clamped to the graph's node ids.
+
+The graph must outlive the sampler, and one sampler serves one call at a time.
+*/
+template <typename Types>
+class NegativeSamplerT {
+public:
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+private:
+    const TemporalGraphT<Types>& graph;
+    NegativeOptions options;
+    // Random range after clamping
+    uint64_t node_begin;
+    uint64_t node_end;
+    uint64_t random_seed;
+    atomic<uint64_t> batch_counter;
+
+    atomic<uint64_t> total_negatives;
+    atomic<uint64_t> total_rejected;
+    atomic<uint64_t> total_fallbacks;
+    atomic<uint64_t> total_unfiltered;
+
+    // Write the negatives of edge k, drawn from stream (batch_id, k), to out
+    void sample_edge(NodeType src, NodeType dst, TimeType time, uint64_t batch_id, size_t k, NodeType* out,
+                     NegativeStats& counts) const;
+    // Negatives of a whole batch; with batch, also the sources, destinations and root times
+    void sample_edges(const NodeType* src, const NodeType* dst, const TimeType* times, size_t num_edges,
+                      NodeType* negatives, LinkBatch<Types>* batch);
+
+    NegativeSamplerT(const NegativeSamplerT&) = delete;
+    NegativeSamplerT& operator=(const NegativeSamplerT&) = delete;
+
+public:
+    NegativeSamplerT(const TemporalGraphT<Types>& graph, const NegativeOptions& options = NegativeOptions());
+
+    const NegativeOptions& get_options() const { return options; }
+    void set_random_seed(uint64_t seed);
+
+    // num_edges * num_negatives negatives into negatives, those of edge k at
+    // [k * num_negatives, (k + 1) * num_negatives). Returns the elapsed time in seconds.
+    double sample_negatives(const NodeType* src, const NodeType* dst, const TimeType* times, size_t num_edges,
+                            NodeType* negatives);
+    double sample_negatives(const vector<NodeType>& src, const vector<NodeType>& dst, const vector<TimeType>& times,
+                            vector<NodeType>& negatives);
+
+    // Draw the negatives straight into the roots of batch and sample the neighbors of sources,
+    // destinations and negatives in one graph sampling call (see TemporalGraphT::sampling_into)
+    double sample_link_batch(const NodeType* src, const NodeType* dst, const TimeType* times, size_t num_edges,
+                             LinkBatch<Types>& batch, EdgeType sample_num, SampleStrategy sample_strategy);
+    double sample_link_batch(const vector<NodeType>& src, const vector<NodeType>& dst, const vector<TimeType>& times,
+                             LinkBatch<Types>& batch, EdgeType sample_num = 32, const string& sample_strategy = "recent");
+
+    NegativeStats stats() const;
+    void reset_stats();
+};
+
+typedef NegativeSamplerT<TGNGraphTypes> NegativeSampler;
+
+#endif // NEGATIVE_SAMPLER_H
@@ -0,0 +1,425 @@
+// numa_sampler.cpp - NUMA placement of the T-CSR and socket-local batch sampling
+#include "numa_sampler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <omp.h>
+
+// Rows a thread claims from a bucket at a time
+static const size_t ROUTE_CHUNK_ROWS = 64;
+
+bool parse_numa_mode(const string& name, NumaMode& mode) {
+    if (name == "none") {
+        mode = NUMA_NONE;
+    } else if (name == "interleave") {
+        mode = NUMA_INTERLEAVE;
+    } else if (name == "partition") {
+        mode = NUMA_PARTITION;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Parse a sysfs list such as "0-3,8,10-11"
+static vector<int> parse_id_list(const string& text) {
+    vector<int> ids;
+    stringstream stream(text);
+    string range;
+    while (getline(stream, range, ',')) {
+        if (range.empty() || range[0] == '\n') {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = atoi(range.c_str());
+        int last = dash == string::npos ? first : atoi(range.c_str() + dash + 1);
+        for (int id = first; id <= last; ++id) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+static bool read_id_list(const string& path, vector<int>& ids) {
+    ifstream file(path);
+    string text;
+    if (!file || !getline(file, text)) {
+        return false;
+    }
+    ids = parse_id_list(text);
+    return true;
+}
+
+NumaTopology detect_numa_topology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            CPU_SET(cpu, &allowed);
+        }
+    }
+
+    NumaTopology topology;
+    vector<int> nodes;
+    if (read_id_list("/sys/devices/system/node/online", nodes)) {
+        for (int node : nodes) {
+            vector<int> node_cpus;
+            if (!read_id_list("/sys/devices/system/node/node" + to_string(node) + "/cpulist", node_cpus)) {
+                continue;
+            }
+            vector<int> usable;
+            for (int cpu : node_cpus) {
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                    usable.push_back(cpu);
+                }
+            }
+            if (!usable.empty()) {
+                topology.nodes.push_back(node);
+                topology.cpus.push_back(usable);
+            }
+        }
+    }
+    if (topology.nodes.empty()) {
+        vector<int> usable;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                usable.push_back(cpu);
+            }
+        }
+        topology.nodes.push_back(0);
+        topology.cpus.push_back(usable);
+    }
+    return topology;
+}
+
+vector<size_t> numa_page_counts(const NumaTopology& topology, const void* data, size_t bytes, size_t max_samples) {
+    vector<size_t> counts(topology.num_nodes(), 0);
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t first = reinterpret_cast<uintptr_t>(data) / page * page;
+    size_t num_pages = bytes == 0 ? 0 : (reinterpret_cast<uintptr_t>(data) + bytes - first + page - 1) / page;
+    size_t samples = min(num_pages, max(max_samples, static_cast<size_t>(1)));
+    if (samples == 0) {
+        return counts;
+    }
+    vector<void*> pages(samples);
+    vector<int> status(samples, -1);
+    for (size_t i = 0; i < samples; ++i) {
+        pages[i] = reinterpret_cast<void*>(first + (num_pages * i / samples) * page);
+    }
+    // With no target nodes, move_pages only reports where each page is
+    if (syscall(SYS_move_pages, 0, samples, pages.data(), nullptr, status.data(), 0) != 0) {
+        return counts;
+    }
+    for (int node : status) {
+        size_t index = find(topology.nodes.begin(), topology.nodes.end(), node) - topology.nodes.begin();
+        if (index < counts.size()) {
+            counts[index]++;
+        }
+    }
+    return counts;
+}
+
+// Apply a memory policy over the nodes to the pages of [begin, end) and move the pages already
+// touched; false if the kernel refused
+static bool bind_pages(uintptr_t begin, uintptr_t end, int policy, const vector<int>& nodes) {
+    if (begin >= end) {
+        return true;
+    }
+    int max_node = *max_element(nodes.begin(), nodes.end());
+    size_t bits = sizeof(unsigned long) * 8;
+    vector<unsigned long> mask(static_cast<size_t>(max_node) / bits + 1, 0);
+    for (int node : nodes) {
+        mask[node / bits] |= 1UL << (node % bits);
+    }
+    return syscall(SYS_mbind, begin, end - begin, policy, mask.data(), mask.size() * bits + 1, MPOL_MF_MOVE) == 0;
+}
+
+/*
+Elements [first, last) of an array of count elements of elem_bytes at base. Range ends are rounded
+down to pages (the end of the array up), so adjacent ranges never claim the same page.
+*/
+static bool bind_elements(const void* base, size_t elem_bytes, size_t first, size_t last, size_t count,
+                          int policy, const vector<int>& nodes) {
+    if (base == nullptr || count == 0) {
+        return true;
+    }
+    uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t address = reinterpret_cast<uintptr_t>(base);
+    uintptr_t begin = (address + first * elem_bytes) / page * page;
+    uintptr_t end = address + last * elem_bytes;
+    end = last == count ? (end + page - 1) / page * page : end / page * page;
+    return bind_pages(begin, end, policy, nodes);
+}
+
+template <typename Types>
+NumaSamplerT<Types>::NumaSamplerT(const TemporalGraphT<Types>& graph, const NumaOptions& options)
+    : graph(graph), options(options), topology(detect_numa_topology()), socket_first_node(), worker_cpu(), worker_socket(),
+      placement_failures(0), route_order(), bucket_begin(), cursors(), random_seed(DEFAULT_RANDOM_SEED), batch_counter(0),
+      sample_params(), rows(0), local_rows(0), remote_rows(0), rows_per_socket() {
+    if (options.sockets > 0 && options.sockets < topology.num_nodes()) {
+        topology.nodes.resize(options.sockets);
+        topology.cpus.resize(options.sockets);
+    }
+    size_t num_sockets = topology.num_nodes();
+    for (size_t s = 0; s < num_sockets; ++s) {
+        size_t threads = options.threads_per_socket > 0 ? min(options.threads_per_socket, topology.cpus[s].size())
+                                                        : topology.cpus[s].size();
+        for (size_t t = 0; t < threads; ++t) {
+            worker_cpu.push_back(topology.cpus[s][t]);
+            worker_socket.push_back(s);
+        }
+    }
+    vector<BucketCursor>(num_sockets).swap(cursors);
+    vector<atomic<uint64_t>>(num_sockets).swap(rows_per_socket);
+    reset_stats();
+
+    // Node ranges balanced by edge count: socket s starts at the first node whose adjacency
+    // begins at or after s / num_sockets of the edges
+    const EdgeType* indptr = graph.get_indptr();
+    size_t num_nodes = graph.get_num_nodes();
+    socket_first_node.assign(num_sockets + 1, static_cast<NodeType>(num_nodes));
+    socket_first_node[0] = 0;
+    for (size_t s = 1; s < num_sockets && indptr != nullptr; ++s) {
+        EdgeType target = static_cast<EdgeType>(static_cast<double>(graph.get_num_edges()) * s / num_sockets);
+        socket_first_node[s] = static_cast<NodeType>(lower_bound(indptr, indptr + num_nodes, target) - indptr);
+    }
+    place();
+}
+
+template <typename Types>
+void NumaSamplerT<Types>::place() {
+    const EdgeType* indptr = graph.get_indptr();
+    size_t num_nodes = graph.get_num_nodes();
+    size_t num_edges = graph.get_num_edges();
+    if (options.mode == NUMA_NONE || indptr == nullptr) {
+        return;
+    }
+
+    if (options.mode == NUMA_INTERLEAVE) {
+        placement_failures += !bind_elements(indptr, sizeof(EdgeType), 0, num_nodes + 1, num_nodes + 1, MPOL_INTERLEAVE, topology.nodes);
+        placement_failures += !bind_elements(graph.get_indices(), sizeof(NodeType), 0, num_edges, num_edges, MPOL_INTERLEAVE, topology.nodes);
+        placement_failures += !bind_elements(graph.get_time_values(), sizeof(TimeType), 0, num_edges, num_edges, MPOL_INTERLEAVE, topology.nodes);
+        placement_failures += !bind_elements(graph.get_idx_values(), sizeof(EdgeType), 0, num_edges, num_edges, MPOL_INTERLEAVE, topology.nodes);
+        return;
+    }
+
+    // Partition: the adjacency of every node range goes to its socket. MPOL_PREFERRED rather than
+    // MPOL_BIND, so a full node spills over instead of failing.
+    for (size_t s = 0; s < num_sockets(); ++s) {
+        vector<int> node(1, topology.nodes[s]);
+        size_t first_node = static_cast<size_t>(socket_first_node[s]);
+        size_t last_node = static_cast<size_t>(socket_first_node[s + 1]);
+        size_t first_edge = static_cast<size_t>(indptr[first_node]);
+        size_t last_edge = s + 1 == num_sockets() ? num_edges : static_cast<size_t>(indptr[last_node]);
+        size_t last_ptr = s + 1 == num_sockets() ? num_nodes + 1 : last_node;
+        placement_failures += !bind_elements(indptr, sizeof(EdgeType), first_node, last_ptr, num_nodes + 1, MPOL_PREFERRED, node);
+        placement_failures += !bind_elements(graph.get_indices(), sizeof(NodeType), first_edge, last_edge, num_edges, MPOL_PREFERRED, node);
+        placement_failures += !bind_elements(graph.get_time_values(), sizeof(TimeType), first_edge, last_edge, num_edges, MPOL_PREFERRED, node);
+        placement_failures += !bind_elements(graph.get_idx_values(), sizeof(EdgeType), first_edge, last_edge, num_edges, MPOL_PREFERRED, node);
+    }
+}
+
+template <typename Types>
+size_t NumaSamplerT<Types>::socket_of(NodeType node) const {
+    return upper_bound(socket_first_node.begin() + 1, socket_first_node.end() - 1, node) - (socket_first_node.begin() + 1);
+}
+
+template <typename Types>
+void NumaSamplerT<Types>::set_random_seed(uint64_t seed) {
+    random_seed = seed;
+    batch_counter.store(0);
+}
+
+template <typename Types>
+void NumaSamplerT<Types>::set_sample_params(const SampleParams& params) {
+    sample_params = params;
+}
+
+// Binds the calling thread to one CPU for its lifetime and then restores the thread's previous
+// mask, so OpenMP threads that later run other work are not left pinned
+class ThreadPin {
+    cpu_set_t saved;
+    bool pinned;
+
+public:
+    explicit ThreadPin(int cpu) : pinned(false) {
+        if (cpu < 0 || sched_getaffinity(0, sizeof(saved), &saved) != 0) {
+            return;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pinned = sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+    ~ThreadPin() {
+        if (pinned) {
+            sched_setaffinity(0, sizeof(saved), &saved);
+        }
+    }
+    ThreadPin(const ThreadPin&) = delete;
+    ThreadPin& operator=(const ThreadPin&) = delete;
+};
+
+template <typename Types>
+template <SampleStrategy S>
+void NumaSamplerT<Types>::sample_routed(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                                        NodeType* batch_neighbors, TimeType* batch_neighbor_times, EdgeType* batch_neighbor_idx,
+                                        EdgeType* batch_counts, EdgeType sample_num, uint64_t batch_id) {
+    size_t num_sockets = this->num_sockets();
+    bool routed = options.mode == NUMA_PARTITION && num_sockets > 1;
+
+    // Bucket the rows by owning socket. Planned batches are sorted by (node, time) like
+    // sample_batch_planned, which already groups them by socket and gives each thread neighboring
+    // adjacency; otherwise a counting sort keeps input order inside a bucket. Without routing
+    // every row is in the first bucket and all threads share it.
+    bool planned = sample_params.plan_batches && batch_size >= PLAN_MIN_BATCH_SIZE;
+    BatchPlanScratch<Types>& plan = batch_plan_scratch<Types>();
+    vector<size_t>& order = planned ? plan.order : route_order;
+    bucket_begin.assign(num_sockets + 1, batch_size);
+    bucket_begin[0] = 0;
+    if (planned) {
+        sort_batch_rows(batch_node_id, batch_node_time, batch_size, plan);
+        for (size_t s = 1; routed && s < num_sockets; ++s) {
+            NodeType first = socket_first_node[s];
+            bucket_begin[s] = partition_point(order.begin(), order.end(), [&](size_t b) { return batch_node_id[b] < first; }) - order.begin();
+        }
+    } else if (routed) {
+        order.resize(batch_size);
+        fill(bucket_begin.begin(), bucket_begin.end(), 0);
+        for (size_t b = 0; b < batch_size; ++b) {
+            bucket_begin[socket_of(batch_node_id[b]) + 1]++;
+        }
+        for (size_t s = 1; s <= num_sockets; ++s) {
+            bucket_begin[s] += bucket_begin[s - 1];
+        }
+        for (size_t s = 0; s < num_sockets; ++s) {
+            cursors[s].next.store(bucket_begin[s], memory_order_relaxed);
+        }
+        for (size_t b = 0; b < batch_size; ++b) {
+            order[cursors[socket_of(batch_node_id[b])].next.fetch_add(1, memory_order_relaxed)] = b;
+        }
+    } else {
+        order.resize(batch_size);
+        for (size_t b = 0; b < batch_size; ++b) {
+            order[b] = b;
+        }
+    }
+    for (size_t s = 0; s < num_sockets; ++s) {
+        cursors[s].next.store(bucket_begin[s], memory_order_relaxed);
+    }
+
+    int num_workers = static_cast<int>(max(worker_cpu.size(), static_cast<size_t>(1)));
+    #pragma omp parallel num_threads(num_workers)
+    {
+        size_t worker = static_cast<size_t>(omp_get_thread_num());
+        size_t home = worker < worker_socket.size() ? worker_socket[worker] : 0;
+        ThreadPin pin(options.pin_threads && worker < worker_cpu.size() ? worker_cpu[worker] : -1);
+        uint64_t local = 0;
+        uint64_t remote = 0;
+        // The home bucket first, then the others', so no thread idles while rows are left
+        for (size_t k = 0; k < num_sockets; ++k) {
+            size_t s = (home + k) % num_sockets;
+            while (true) {
+                size_t begin = cursors[s].next.fetch_add(ROUTE_CHUNK_ROWS, memory_order_relaxed);
+                if (begin >= bucket_begin[s + 1]) {
+                    break;
+                }
+                size_t end = min(begin + ROUTE_CHUNK_ROWS, bucket_begin[s + 1]);
+                for (size_t i = begin; i < end; ++i) {
+                    size_t b = order[i];
+                    size_t row = b * sample_num;
+                    EdgeType count = sample_row<S>(graph, batch_node_id[b], batch_node_time[b], sample_num, sample_params, random_seed,
+                                                   row_stream(batch_id, b), batch_neighbors + row, batch_neighbor_times + row,
+                                                   batch_neighbor_idx + row);
+                    batch_counts[b] = count;
+                    pad_row(count, sample_num, batch_neighbors + row, batch_neighbor_times + row, batch_neighbor_idx + row);
+                }
+                (s == home ? local : remote) += end - begin;
+            }
+        }
+        rows_per_socket[home].fetch_add(local + remote, memory_order_relaxed);
+        if (routed) {
+            local_rows.fetch_add(local, memory_order_relaxed);
+            remote_rows.fetch_add(remote, memory_order_relaxed);
+        }
+    }
+    rows.fetch_add(batch_size, memory_order_relaxed);
+}
+
+template <typename Types>
+double NumaSamplerT<Types>::sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                                          NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                                          EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                                          EdgeType sample_num, SampleStrategy sample_strategy) {
+    double start_time = omp_get_wtime();
+    uint64_t batch_id = batch_counter.fetch_add(1);
+
+    switch (sample_strategy) {
+        case SAMPLE_RECENT:
+            sample_routed<SAMPLE_RECENT>(batch_node_id, batch_node_time, batch_size, batch_neighbors, batch_neighbor_times,
+                                         batch_neighbor_idx, batch_counts, sample_num, batch_id);
+            break;
+        case SAMPLE_RANDOM:
+            sample_routed<SAMPLE_RANDOM>(batch_node_id, batch_node_time, batch_size, batch_neighbors, batch_neighbor_times,
+                                         batch_neighbor_idx, batch_counts, sample_num, batch_id);
+            break;
+        case SAMPLE_WINDOW:
+            sample_routed<SAMPLE_WINDOW>(batch_node_id, batch_node_time, batch_size, batch_neighbors, batch_neighbor_times,
+                                         batch_neighbor_idx, batch_counts, sample_num, batch_id);
+            break;
+        case SAMPLE_DECAY:
+            sample_routed<SAMPLE_DECAY>(batch_node_id, batch_node_time, batch_size, batch_neighbors, batch_neighbor_times,
+                                        batch_neighbor_idx, batch_counts, sample_num, batch_id);
+            break;
+        case SAMPLE_INVERSE_DEGREE:
+            sample_routed<SAMPLE_INVERSE_DEGREE>(batch_node_id, batch_node_time, batch_size, batch_neighbors, batch_neighbor_times,
+                                                 batch_neighbor_idx, batch_counts, sample_num, batch_id);
+            break;
+        default:
+            sample_routed<SAMPLE_NONE>(batch_node_id, batch_node_time, batch_size, batch_neighbors, batch_neighbor_times,
+                                       batch_neighbor_idx, batch_counts, sample_num, batch_id);
+            break;
+    }
+
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+double NumaSamplerT<Types>::sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                                     SampleBuffers<Types>& buffers, EdgeType sample_num, const string& sample_strategy) {
+    buffers.resize(batch_node_id.size(), sample_num);
+    return sampling_into(batch_node_id.data(), batch_node_time.data(), batch_node_id.size(),
+                         buffers.neighbors.data(), buffers.neighbor_times.data(), buffers.neighbor_idx.data(),
+                         buffers.counts.data(), sample_num, parse_sample_strategy(sample_strategy));
+}
+
+template <typename Types>
+NumaStats NumaSamplerT<Types>::stats() const {
+    NumaStats result;
+    result.rows = rows.load(memory_order_relaxed);
+    result.local_rows = local_rows.load(memory_order_relaxed);
+    result.remote_rows = remote_rows.load(memory_order_relaxed);
+    for (const atomic<uint64_t>& count : rows_per_socket) {
+        result.rows_per_socket.push_back(count.load(memory_order_relaxed));
+    }
+    return result;
+}
+
+template <typename Types>
+void NumaSamplerT<Types>::reset_stats() {
+    rows.store(0);
+    local_rows.store(0);
+    remote_rows.store(0);
+    for (atomic<uint64_t>& count : rows_per_socket) {
+        count.store(0);
+    }
+}
+
+template class NumaSamplerT<TGNGraphTypes>;
+template class NumaSamplerT<TGLGraphTypes>;
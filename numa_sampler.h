@@ -0,0 +1,154 @@
+// numa_sampler.h - NUMA placement of the T-CSR and socket-local batch sampling
+#ifndef NUMA_SAMPLER_H
+#define NUMA_SAMPLER_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include "utils.h"
+#include "sampler_kernels.h"
+#include "TemporalGraph.h"
+
+using namespace std;
+
+/*
+Placement of the T-CSR arrays across NUMA nodes:
+  "none"       - leave the pages where they were first touched (usually by the to_csr threads)
+  "interleave" - spread the pages of every array round-robin over the nodes, so bandwidth scales
+                 with the sockets but most accesses are remote
+  "partition"  - split the node id range into one contiguous range per socket, balanced by edge
+                 count, and move the adjacency of each range (indptr, indices, time_values and
+                 idx_values) to its socket; roots are then sampled by threads of that socket
+*/
+enum NumaMode {
+    NUMA_NONE,
+    NUMA_INTERLEAVE,
+    NUMA_PARTITION
+};
+
+bool parse_numa_mode(const string& name, NumaMode& mode);
+
+// NUMA nodes with CPUs this process may run on, read from sysfs; a machine (or container) without
+// NUMA information is one node holding all allowed CPUs
+struct NumaTopology {
+    vector<int> nodes;         // kernel node ids
+    vector<vector<int>> cpus;  // allowed CPUs of each node
+
+    size_t num_nodes() const { return nodes.size(); }
+};
+
+NumaTopology detect_numa_topology();
+
+// Resident pages of [data, data + bytes) on each node of topology, from at most max_samples evenly
+// spaced pages (a move_pages query, which moves nothing)
+vector<size_t> numa_page_counts(const NumaTopology& topology, const void* data, size_t bytes, size_t max_samples = 4096);
+
+struct NumaOptions {
+    NumaMode mode = NUMA_PARTITION;
+    // Use the first sockets only (0: all), and at most threads_per_socket of their CPUs (0: all)
+    size_t sockets = 0;
+    size_t threads_per_socket = 0;
+    // Bind every sampling thread to one CPU of its socket for the duration of a sampling call
+    bool pin_threads = true;
+};
+
+// Rows sampled since the last reset. Only the partition mode routes rows, so only it counts local
+// rows (sampled on the socket owning the root's adjacency) and remote ones (taken over by another
+// socket once its own rows were done).
+struct NumaStats {
+    uint64_t rows;
+    uint64_t local_rows;
+    uint64_t remote_rows;
+    vector<uint64_t> rows_per_socket;  // by the socket of the sampling thread
+};
+
+/*
+Sampler over a TemporalGraphT whose T-CSR arrays it places across the sockets (see NumaMode).
+Each sampling call runs one OpenMP thread per selected CPU, pinned to it until the call returns,
+when every thread gets its previous affinity back. In the partition mode the roots are bucketed by
+the socket owning their adjacency, every thread works through its own socket's bucket in chunks
+first and then helps with the others, so skewed batches still use all threads. Rows draw from the
+same streams as TemporalGraphT::sampling, so with the same seed and sequence of calls the samples
+are identical, whatever the mode.
+
+Placement migrates the pages of the graph's arrays with mbind; it does not change their
+contents, but pages of a shared snapshot mapping only move if no other process maps them. The
+graph must outlive the sampler, and one sampler serves one sampling call at a time.
+*/
+template <typename Types>
+class NumaSamplerT {
+public:
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+private:
+    // Next unclaimed position of a socket's bucket, padded to its own cache line
+    struct BucketCursor {
+        atomic<size_t> next;
+        char padding[64 - sizeof(atomic<size_t>)];
+    };
+
+    const TemporalGraphT<Types>& graph;
+    NumaOptions options;
+    NumaTopology topology;
+    // Socket s owns the nodes [socket_first_node[s], socket_first_node[s + 1])
+    vector<NodeType> socket_first_node;
+    vector<int> worker_cpu;
+    vector<size_t> worker_socket;
+    size_t placement_failures;
+
+    // Routing scratch: row order grouped by socket, and each socket's bucket bounds
+    vector<size_t> route_order;
+    vector<size_t> bucket_begin;
+    vector<BucketCursor> cursors;
+
+    uint64_t random_seed;
+    atomic<uint64_t> batch_counter;
+    SampleParams sample_params;
+
+    atomic<uint64_t> rows;
+    atomic<uint64_t> local_rows;
+    atomic<uint64_t> remote_rows;
+    vector<atomic<uint64_t>> rows_per_socket;
+
+    void place();
+    template <SampleStrategy S>
+    void sample_routed(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                       NodeType* batch_neighbors, TimeType* batch_neighbor_times, EdgeType* batch_neighbor_idx,
+                       EdgeType* batch_counts, EdgeType sample_num, uint64_t batch_id);
+
+    NumaSamplerT(const NumaSamplerT&) = delete;
+    NumaSamplerT& operator=(const NumaSamplerT&) = delete;
+
+public:
+    // Places the converted (or loaded) T-CSR of graph according to options.mode
+    NumaSamplerT(const TemporalGraphT<Types>& graph, const NumaOptions& options = NumaOptions());
+
+    size_t num_sockets() const { return topology.num_nodes(); }
+    size_t num_threads() const { return worker_cpu.size(); }
+    const NumaTopology& get_topology() const { return topology; }
+    NumaMode get_mode() const { return options.mode; }
+    // Address ranges that could not be placed (e.g. a kernel without NUMA support)
+    size_t get_placement_failures() const { return placement_failures; }
+    // Socket owning the adjacency of node in the partition mode
+    size_t socket_of(NodeType node) const;
+
+    void set_random_seed(uint64_t seed);
+    void set_sample_params(const SampleParams& params);
+
+    // Same semantics as the TemporalGraphT functions of the same names
+    double sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                         NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                         EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                         EdgeType sample_num, SampleStrategy sample_strategy);
+    double sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                    SampleBuffers<Types>& buffers, EdgeType sample_num = 32, const string& sample_strategy = "recent");
+
+    NumaStats stats() const;
+    void reset_stats();
+};
+
+typedef NumaSamplerT<TGNGraphTypes> NumaSampler;
+
+#endif // NUMA_SAMPLER_H
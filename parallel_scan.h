@@ -0,0 +1,175 @@
+// parallel_scan.h - Parallel prefix sums and contention-free degree counting for T-CSR builds
+#ifndef PARALLEL_SCAN_H
+#define PARALLEL_SCAN_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <omp.h>
+
+using namespace std;
+
+// Below this many elements the scans and counts run on the calling thread
+const size_t PARALLEL_SCAN_MIN_SIZE = 1 << 16;
+// Node ranges per thread in the sparse path of parallel_count_degrees, and the smallest range
+// (2^bits nodes, so neighboring ranges rarely share a cache line of counters)
+const size_t DEGREE_RANGES_PER_THREAD = 4;
+const int DEGREE_RANGE_MIN_BITS = 4;
+
+/*
+In-place inclusive prefix sum of data[0, n); returns the total. Blocked two-pass scan: every
+thread sums its contiguous block, the per-thread sums are scanned into block offsets, and every
+thread then scans its block from its offset. Reads the data twice and writes it once.
+*/
+template <typename T>
+T parallel_inclusive_scan(T* data, size_t n) {
+    int num_threads = n < PARALLEL_SCAN_MIN_SIZE ? 1 : omp_get_max_threads();
+    if (num_threads == 1) {
+        T sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += data[i];
+            data[i] = sum;
+        }
+        return sum;
+    }
+
+    // The runtime may give the region fewer threads than requested (thread limits, nesting), so
+    // the total is read from the slot of the team size the region actually got
+    vector<T> block_offsets(static_cast<size_t>(num_threads) + 1, 0);
+    int used_threads = num_threads;
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int tid = omp_get_thread_num();
+        int nt = omp_get_num_threads();
+        #pragma omp single
+        used_threads = nt;
+        size_t begin = n * tid / nt;
+        size_t end = n * (tid + 1) / nt;
+        T sum = 0;
+        for (size_t i = begin; i < end; ++i) {
+            sum += data[i];
+        }
+        block_offsets[tid + 1] = sum;
+
+        #pragma omp barrier
+        #pragma omp single
+        for (int t = 1; t <= nt; ++t) {
+            block_offsets[t] += block_offsets[t - 1];
+        }
+
+        sum = block_offsets[tid];
+        for (size_t i = begin; i < end; ++i) {
+            sum += data[i];
+            data[i] = sum;
+        }
+    }
+    return block_offsets[used_threads];
+}
+
+/*
+Add the number of occurrences of every id of ids[0, n) to counts[id] (ids in [0, num_bins)), so
+calls accumulate (e.g. once for the sources and once for the destinations of a reversed graph).
+No counter is shared between threads while counting, and no atomics are used:
+  - when num_bins * threads is at most n, every thread counts its block into a private histogram
+    and the histograms are summed node range by node range, in parallel;
+  - otherwise (few edges per node, where private histograms would cost more than the counting)
+    the ids are split into power-of-two node ranges: every thread counts how many ids of its block
+    fall into each range, scatters them into the range's segment of a copy of the ids, and every
+    range is then counted by a single thread. This reads the ids three times and writes them once.
+*/
+template <typename Id, typename Count>
+void parallel_count_degrees(const Id* ids, size_t n, Count* counts, size_t num_bins) {
+    int num_threads = n < PARALLEL_SCAN_MIN_SIZE ? 1 : omp_get_max_threads();
+    if (num_threads == 1) {
+        for (size_t i = 0; i < n; ++i) {
+            counts[ids[i]]++;
+        }
+        return;
+    }
+
+    if (num_bins * static_cast<size_t>(num_threads) <= n) {
+        // Left uninitialized here: every thread clears (and so first touches) its own histogram
+        unique_ptr<Count[]> histograms(new Count[num_bins * static_cast<size_t>(num_threads)]);
+        int used_threads = num_threads;
+        #pragma omp parallel num_threads(num_threads)
+        {
+            int tid = omp_get_thread_num();
+            int nt = omp_get_num_threads();
+            #pragma omp single
+            used_threads = nt;
+            Count* histogram = &histograms[static_cast<size_t>(tid) * num_bins];
+            fill(histogram, histogram + num_bins, Count(0));
+            size_t begin = n * tid / nt;
+            size_t end = n * (tid + 1) / nt;
+            for (size_t i = begin; i < end; ++i) {
+                histogram[ids[i]]++;
+            }
+        }
+        #pragma omp parallel for num_threads(used_threads) schedule(static)
+        for (size_t v = 0; v < num_bins; ++v) {
+            Count sum = counts[v];
+            for (int t = 0; t < used_threads; ++t) {
+                sum += histograms[static_cast<size_t>(t) * num_bins + v];
+            }
+            counts[v] = sum;
+        }
+        return;
+    }
+
+    // Node range r is [r << shift, (r + 1) << shift); range_offsets[r * nt + t] is where the ids of
+    // range r from the block of thread t start in grouped
+    int shift = DEGREE_RANGE_MIN_BITS;
+    while ((num_bins >> shift) > static_cast<size_t>(num_threads) * DEGREE_RANGES_PER_THREAD) {
+        ++shift;
+    }
+    size_t num_ranges = ((max<size_t>(num_bins, 1) - 1) >> shift) + 1;
+    vector<size_t> range_offsets(num_ranges * static_cast<size_t>(num_threads) + 1, 0);
+    unique_ptr<Id[]> grouped(new Id[n]);
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int tid = omp_get_thread_num();
+        int nt = omp_get_num_threads();
+        size_t begin = n * tid / nt;
+        size_t end = n * (tid + 1) / nt;
+        vector<size_t> cursor(num_ranges, 0);
+        for (size_t i = begin; i < end; ++i) {
+            cursor[static_cast<size_t>(ids[i]) >> shift]++;
+        }
+        for (size_t r = 0; r < num_ranges; ++r) {
+            range_offsets[r * nt + tid] = cursor[r];
+        }
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            size_t sum = 0;
+            for (size_t k = 0; k < num_ranges * static_cast<size_t>(nt); ++k) {
+                size_t count = range_offsets[k];
+                range_offsets[k] = sum;
+                sum += count;
+            }
+            range_offsets[num_ranges * static_cast<size_t>(nt)] = sum;
+        }
+
+        for (size_t r = 0; r < num_ranges; ++r) {
+            cursor[r] = range_offsets[r * nt + tid];
+        }
+        for (size_t i = begin; i < end; ++i) {
+            Id id = ids[i];
+            grouped[cursor[static_cast<size_t>(id) >> shift]++] = id;
+        }
+
+        // Every segment of a range is complete before the range is counted
+        #pragma omp barrier
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t r = 0; r < num_ranges; ++r) {
+            for (size_t i = range_offsets[r * nt]; i < range_offsets[(r + 1) * nt]; ++i) {
+                counts[grouped[i]]++;
+            }
+        }
+    }
+}
+
+#endif // PARALLEL_SCAN_H
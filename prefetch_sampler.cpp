@@ -0,0 +1,159 @@
+// prefetch_sampler.cpp - Background sampling of upcoming minibatches for training loops
+#include "prefetch_sampler.h"
+#include <chrono>
+#include <omp.h>
+
+// Spin briefly, then give the core away: most waits last a fraction of one sampling call
+static void backoff(int& spins) {
+    ++spins;
+    if (spins < 64) {
+        return;
+    }
+    if (spins < 128) {
+        this_thread::yield();
+        return;
+    }
+    this_thread::sleep_for(chrono::microseconds(50));
+}
+
+// The counters are written by one side each, so a plain load and store is enough
+static void add_seconds(atomic<double>& total, double seconds) {
+    total.store(total.load(memory_order_relaxed) + seconds, memory_order_relaxed);
+}
+
+template <typename Types>
+PrefetchSamplerT<Types>::PrefetchSamplerT(const TemporalGraphT<Types>& graph, const BatchSource& source, EdgeType sample_num,
+                                          SampleStrategy sample_strategy, size_t depth)
+    : graph(graph), source(source), sample_num(sample_num), sample_strategy(sample_strategy),
+      batches(max(depth, static_cast<size_t>(1)) + 1), ready(batches.size()), free_batches(batches.size()), current(nullptr),
+      stopping(false), finished(false), worker(), batches_sampled(0), batches_consumed(0), max_queue_depth(0),
+      producer_stalls(0), consumer_stalls(0), producer_wait_seconds(0), consumer_wait_seconds(0), sample_seconds(0) {
+    // The last buffer starts out as the caller's, so at most depth batches are sampled ahead
+    for (size_t i = 0; i + 1 < batches.size(); ++i) {
+        free_batches.push(&batches[i]);
+    }
+    current = &batches.back();
+    worker = thread(&PrefetchSamplerT<Types>::run, this);
+}
+
+template <typename Types>
+PrefetchSamplerT<Types>::~PrefetchSamplerT() {
+    stopping.store(true, memory_order_release);
+    worker.join();
+}
+
+// Background thread: take a free buffer, sample the next batch into it and queue it
+template <typename Types>
+void PrefetchSamplerT<Types>::run() {
+    uint64_t index = 0;
+    while (!stopping.load(memory_order_acquire)) {
+        PrefetchedBatch<Types>* batch = nullptr;
+        if (!free_batches.pop(batch)) {
+            // Back-pressure: the caller has not consumed the batches sampled so far
+            producer_stalls.fetch_add(1, memory_order_relaxed);
+            double wait_start = omp_get_wtime();
+            int spins = 0;
+            while (!free_batches.pop(batch)) {
+                if (stopping.load(memory_order_acquire)) {
+                    return;
+                }
+                backoff(spins);
+            }
+            add_seconds(producer_wait_seconds, omp_get_wtime() - wait_start);
+        }
+
+        if (!source(batch->root_nodes, batch->root_times)) {
+            break;
+        }
+        batch->index = index++;
+        batch->sample_seconds = graph.sampling(batch->root_nodes, batch->root_times, batch->buffers, sample_num, sample_strategy);
+        add_seconds(sample_seconds, batch->sample_seconds);
+
+        // Never full: there are only as many batches as ring slots
+        ready.push(batch);
+        batches_sampled.fetch_add(1, memory_order_relaxed);
+        size_t depth = ready.size();
+        if (depth > max_queue_depth.load(memory_order_relaxed)) {
+            max_queue_depth.store(depth, memory_order_relaxed);
+        }
+    }
+    finished.store(true, memory_order_release);
+}
+
+template <typename Types>
+const PrefetchedBatch<Types>* PrefetchSamplerT<Types>::next() {
+    if (current) {
+        free_batches.push(current);
+        current = nullptr;
+    }
+
+    PrefetchedBatch<Types>* batch = nullptr;
+    if (!ready.pop(batch)) {
+        consumer_stalls.fetch_add(1, memory_order_relaxed);
+        double wait_start = omp_get_wtime();
+        int spins = 0;
+        while (!ready.pop(batch)) {
+            if (finished.load(memory_order_acquire)) {
+                // The last batch is queued before finished is set, so look once more after seeing it
+                if (ready.pop(batch)) {
+                    break;
+                }
+                add_seconds(consumer_wait_seconds, omp_get_wtime() - wait_start);
+                return nullptr;
+            }
+            backoff(spins);
+        }
+        add_seconds(consumer_wait_seconds, omp_get_wtime() - wait_start);
+    }
+
+    current = batch;
+    batches_consumed.fetch_add(1, memory_order_relaxed);
+    return batch;
+}
+
+template <typename Types>
+PrefetchStats PrefetchSamplerT<Types>::stats() const {
+    PrefetchStats result;
+    result.batches_sampled = batches_sampled.load(memory_order_relaxed);
+    result.batches_consumed = batches_consumed.load(memory_order_relaxed);
+    result.queue_depth = ready.size();
+    result.max_queue_depth = max_queue_depth.load(memory_order_relaxed);
+    result.producer_stalls = producer_stalls.load(memory_order_relaxed);
+    result.consumer_stalls = consumer_stalls.load(memory_order_relaxed);
+    result.producer_wait_seconds = producer_wait_seconds.load(memory_order_relaxed);
+    result.consumer_wait_seconds = consumer_wait_seconds.load(memory_order_relaxed);
+    result.sample_seconds = sample_seconds.load(memory_order_relaxed);
+    return result;
+}
+
+template <typename Types>
+typename PrefetchSamplerT<Types>::BatchSource chronological_edge_batches(const vector<typename Types::NodeType>& src_list,
+                                                                         const vector<typename Types::NodeType>& dst_list,
+                                                                         const vector<typename Types::TimeType>& time_list,
+                                                                         size_t batch_size, size_t first_edge) {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::TimeType TimeType;
+    size_t next_edge = first_edge;
+    return [&src_list, &dst_list, &time_list, batch_size, next_edge](vector<NodeType>& roots, vector<TimeType>& root_times) mutable {
+        if (batch_size == 0 || next_edge >= src_list.size()) {
+            return false;
+        }
+        size_t n = min(batch_size, src_list.size() - next_edge);
+        roots.resize(2 * n);
+        root_times.resize(2 * n);
+        for (size_t k = 0; k < n; ++k) {
+            roots[k] = src_list[next_edge + k];
+            roots[n + k] = dst_list[next_edge + k];
+            root_times[k] = root_times[n + k] = time_list[next_edge + k];
+        }
+        next_edge += n;
+        return true;
+    };
+}
+
+template class PrefetchSamplerT<TGNGraphTypes>;
+template class PrefetchSamplerT<TGLGraphTypes>;
+template PrefetchSamplerT<TGNGraphTypes>::BatchSource chronological_edge_batches<TGNGraphTypes>(
+    const vector<TGNGraphTypes::NodeType>&, const vector<TGNGraphTypes::NodeType>&, const vector<TGNGraphTypes::TimeType>&, size_t, size_t);
+template PrefetchSamplerT<TGLGraphTypes>::BatchSource chronological_edge_batches<TGLGraphTypes>(
+    const vector<TGLGraphTypes::NodeType>&, const vector<TGLGraphTypes::NodeType>&, const vector<TGLGraphTypes::TimeType>&, size_t, size_t);
@@ -0,0 +1,153 @@
+// prefetch_sampler.h - Background sampling of upcoming minibatches for training loops
+#ifndef PREFETCH_SAMPLER_H
+#define PREFETCH_SAMPLER_H
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include "utils.h"
+#include "sampler_kernels.h"
+#include "TemporalGraph.h"
+
+using namespace std;
+
+/*
+Bounded single-producer single-consumer ring. push and pop never block or lock; each index is
+only written by its own side, and the release store of an index publishes the slot it covers.
+*/
+template <typename T>
+class SpscRing {
+private:
+    vector<T> slots;
+    atomic<size_t> head;  // next slot to pop, written by the consumer
+    atomic<size_t> tail;  // next slot to push, written by the producer
+
+public:
+    explicit SpscRing(size_t capacity) : slots(capacity + 1), head(0), tail(0) {}
+
+    bool push(const T& value) {
+        size_t t = tail.load(memory_order_relaxed);
+        size_t next = t + 1 == slots.size() ? 0 : t + 1;
+        if (next == head.load(memory_order_acquire)) {
+            return false;
+        }
+        slots[t] = value;
+        tail.store(next, memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire)) {
+            return false;
+        }
+        value = slots[h];
+        head.store(h + 1 == slots.size() ? 0 : h + 1, memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        size_t h = head.load(memory_order_acquire);
+        size_t t = tail.load(memory_order_acquire);
+        return t >= h ? t - h : t + slots.size() - h;
+    }
+};
+
+// One sampled minibatch: its roots and their neighbors in the layout of SampleBuffers
+template <typename Types>
+struct PrefetchedBatch {
+    uint64_t index;  // position in the stream of batches
+    vector<typename Types::NodeType> root_nodes;
+    vector<typename Types::TimeType> root_times;
+    SampleBuffers<Types> buffers;
+    double sample_seconds;
+};
+
+// Counters of a PrefetchSamplerT; waits are in seconds
+struct PrefetchStats {
+    uint64_t batches_sampled;
+    uint64_t batches_consumed;
+    size_t queue_depth;        // sampled batches waiting for the consumer
+    size_t max_queue_depth;
+    uint64_t producer_stalls;  // back-pressure: the worker found every buffer in use
+    uint64_t consumer_stalls;  // next() found no sampled batch
+    double producer_wait_seconds;
+    double consumer_wait_seconds;
+    double sample_seconds;
+};
+
+/*
+Samples a stream of minibatches ahead of the training loop. A background thread pulls the roots
+of batch k + 1, k + 2, ... from the batch source and samples them (with the graph's OpenMP
+threads) while the caller consumes batch k, up to depth batches ahead. Sampled batches travel to
+the caller through a lock-free ring and their buffers come back through a second one, so the
+pipeline allocates nothing once the buffers have grown to the batch size. Batches are sampled one
+after the other in stream order, so random strategies give the same results as calling
+graph.sampling on the same sequence of batches.
+*/
+template <typename Types>
+class PrefetchSamplerT {
+public:
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+    // Fill in the roots of the next batch; return false at the end of the stream. Called on the
+    // background thread only.
+    typedef function<bool(vector<NodeType>&, vector<TimeType>&)> BatchSource;
+
+private:
+    const TemporalGraphT<Types>& graph;
+    BatchSource source;
+    EdgeType sample_num;
+    SampleStrategy sample_strategy;
+
+    // depth + 1 buffers: up to depth sampled ahead plus the one the caller holds
+    vector<PrefetchedBatch<Types>> batches;
+    SpscRing<PrefetchedBatch<Types>*> ready;
+    SpscRing<PrefetchedBatch<Types>*> free_batches;
+    PrefetchedBatch<Types>* current;
+
+    atomic<bool> stopping;
+    atomic<bool> finished;
+    thread worker;
+
+    atomic<uint64_t> batches_sampled;
+    atomic<uint64_t> batches_consumed;
+    atomic<size_t> max_queue_depth;
+    atomic<uint64_t> producer_stalls;
+    atomic<uint64_t> consumer_stalls;
+    atomic<double> producer_wait_seconds;
+    atomic<double> consumer_wait_seconds;
+    atomic<double> sample_seconds;
+
+    void run();
+
+public:
+    // graph must outlive the sampler and must not be modified while it runs
+    PrefetchSamplerT(const TemporalGraphT<Types>& graph, const BatchSource& source, EdgeType sample_num,
+                     SampleStrategy sample_strategy = SAMPLE_RECENT, size_t depth = 2);
+    ~PrefetchSamplerT();
+    PrefetchSamplerT(const PrefetchSamplerT&) = delete;
+    PrefetchSamplerT& operator=(const PrefetchSamplerT&) = delete;
+
+    // The next batch of the stream, waiting for it if it is not sampled yet; nullptr at the end of
+    // the stream. The batch stays valid until the next call, which hands its buffers back.
+    const PrefetchedBatch<Types>* next();
+
+    size_t queue_depth() const { return ready.size(); }
+    PrefetchStats stats() const;
+};
+
+// Batch source over a chronological edge stream: batch k holds the sources and then the
+// destinations of edges [first_edge + k * batch_size, first_edge + (k + 1) * batch_size), each
+// queried at its edge time. The lists are referenced, not copied.
+template <typename Types>
+typename PrefetchSamplerT<Types>::BatchSource chronological_edge_batches(const vector<typename Types::NodeType>& src_list,
+                                                                         const vector<typename Types::NodeType>& dst_list,
+                                                                         const vector<typename Types::TimeType>& time_list,
+                                                                         size_t batch_size, size_t first_edge = 0);
+
+typedef PrefetchSamplerT<TGNGraphTypes> PrefetchSampler;
+
+#endif // PREFETCH_SAMPLER_H
@@ -0,0 +1,143 @@
+// radix_sort.h - Parallel stable LSD radix sort of (key, value) pairs
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <omp.h>
+
+using namespace std;
+
+// Map a signed integer to an unsigned key with the same order
+template <typename T>
+inline typename enable_if<is_integral<T>::value, typename make_unsigned<T>::type>::type radix_key(T value) {
+    typedef typename make_unsigned<T>::type U;
+    return static_cast<U>(value) ^ (static_cast<U>(1) << (sizeof(T) * 8 - 1));
+}
+
+// Map a float or double to an unsigned key with the same order: positive values get the sign bit
+// set, negative values have all bits flipped
+inline uint32_t radix_key(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+inline uint64_t radix_key(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x8000000000000000ULL) ? ~bits : (bits | 0x8000000000000000ULL);
+}
+
+// Inverse of radix_key: the value of type T with the given key
+template <typename T>
+inline typename enable_if<is_integral<T>::value, T>::type radix_value(typename make_unsigned<T>::type key) {
+    typedef typename make_unsigned<T>::type U;
+    return static_cast<T>(key ^ (static_cast<U>(1) << (sizeof(T) * 8 - 1)));
+}
+
+template <typename T>
+inline typename enable_if<is_same<T, float>::value, T>::type radix_value(uint32_t key) {
+    uint32_t bits = (key & 0x80000000u) ? (key & 0x7FFFFFFFu) : ~key;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+template <typename T>
+inline typename enable_if<is_same<T, double>::value, T>::type radix_value(uint64_t key) {
+    uint64_t bits = (key & 0x8000000000000000ULL) ? (key & 0x7FFFFFFFFFFFFFFFULL) : ~key;
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/*
+Sort values by keys (both of length n), stably, with 8-bit digits. Every thread histograms its own
+contiguous block, the per-(digit, thread) offsets are scanned, and each thread scatters its block
+in order, which keeps equal keys in input order. Digits on which all keys agree are skipped, so
+small key ranges (e.g. node ids below 2^24) cost fewer passes. The scratch vectors only grow.
+*/
+template <typename Key, typename Value>
+void parallel_radix_sort(vector<Key>& keys, vector<Value>& values, vector<Key>& key_scratch, vector<Value>& value_scratch) {
+    static_assert(is_unsigned<Key>::value, "radix sort keys must be unsigned");
+    const size_t n = keys.size();
+    const int RADIX = 256;
+    if (n < 2) {
+        return;
+    }
+
+    Key max_key = 0;
+    #pragma omp parallel for reduction(|:max_key)
+    for (size_t i = 0; i < n; ++i) {
+        max_key |= keys[i];
+    }
+
+    key_scratch.resize(n);
+    value_scratch.resize(n);
+    int num_threads = omp_get_max_threads();
+    vector<size_t> histograms(static_cast<size_t>(num_threads) * RADIX);
+
+    for (int shift = 0; shift < static_cast<int>(sizeof(Key) * 8) && (max_key >> shift) != 0; shift += 8) {
+        fill(histograms.begin(), histograms.end(), 0);
+        int used_threads = num_threads;
+
+        #pragma omp parallel num_threads(num_threads)
+        {
+            int tid = omp_get_thread_num();
+            int nt = omp_get_num_threads();
+            #pragma omp single
+            used_threads = nt;
+            size_t begin = n * tid / nt;
+            size_t end = n * (tid + 1) / nt;
+            size_t* histogram = &histograms[static_cast<size_t>(tid) * RADIX];
+            for (size_t i = begin; i < end; ++i) {
+                histogram[(keys[i] >> shift) & (RADIX - 1)]++;
+            }
+        }
+
+        // Skip digits on which all keys agree
+        bool trivial = false;
+        for (int d = 0; d < RADIX && !trivial; ++d) {
+            size_t total = 0;
+            for (int t = 0; t < used_threads; ++t) {
+                total += histograms[static_cast<size_t>(t) * RADIX + d];
+            }
+            trivial = (total == n);
+        }
+        if (trivial) {
+            continue;
+        }
+
+        // Exclusive scan in (digit, thread) order
+        size_t offset = 0;
+        for (int d = 0; d < RADIX; ++d) {
+            for (int t = 0; t < used_threads; ++t) {
+                size_t count = histograms[static_cast<size_t>(t) * RADIX + d];
+                histograms[static_cast<size_t>(t) * RADIX + d] = offset;
+                offset += count;
+            }
+        }
+
+        #pragma omp parallel num_threads(used_threads)
+        {
+            int tid = omp_get_thread_num();
+            int nt = omp_get_num_threads();
+            size_t begin = n * tid / nt;
+            size_t end = n * (tid + 1) / nt;
+            size_t* position = &histograms[static_cast<size_t>(tid) * RADIX];
+            for (size_t i = begin; i < end; ++i) {
+                size_t p = position[(keys[i] >> shift) & (RADIX - 1)]++;
+                key_scratch[p] = keys[i];
+                value_scratch[p] = values[i];
+            }
+        }
+        keys.swap(key_scratch);
+        values.swap(value_scratch);
+    }
+}
+
+#endif // RADIX_SORT_H
@@ -1,5 +1,12 @@
 #include "readcsv.h"
 #include "utils.h"
+#include "csr_snapshot.h"
+#include "metrics.h"
+#include <omp.h>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
 
 void read_csv_file_tgn_format(const string& file_path, vector<GraphDataType>& edge_idx, vector<GraphDataType>& src_list, vector<GraphDataType>& dst_list, vector<GraphDataType>& time_list, bool save) {
     auto start_time = chrono::high_resolution_clock::now();
@@ -71,4 +78,340 @@ void read_csv_file_tgl_format(const string& file_path, vector<GraphDataType>& ed
     // cout << "Elapsed time: " << elapsed_time.count() / 1000.0 << " s" << endl;
 
     // The function modifies the input vectors directly, so there's no explicit "return" statement needed.
-}
\ No newline at end of file
+}
+
+// Number of chunks per thread; more chunks than threads balance lines of uneven length
+static const size_t CHUNKS_PER_THREAD = 4;
+
+// Whether p, after trailing spaces, ends a field: a comma, the end of the line, or a carriage return
+static inline bool at_field_end(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        ++p;
+    }
+    return p == end || *p == ',';
+}
+
+// Parse an integer field the way stoi/stol do: skip spaces, optional sign, then digits. A fraction
+// after the digits (e.g. the ".0" of "36.0") is truncated; anything else after them, or a field
+// without digits, is an error.
+static inline bool parse_csv_integer(const char* p, const char* end, long long& value) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+    const char* digits = p;
+    value = 0;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+        value = value * 10 + (*p - '0');
+        ++p;
+    }
+    if (p == digits) {
+        return false;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+            ++p;
+        }
+    }
+    value = negative ? -value : value;
+    return at_field_end(p, end);
+}
+
+// Parse a decimal number field (optional sign, digits, fraction and exponent) like strtod. Plain
+// numbers whose digits form an integer below 2^53 are exact after one correctly rounded division;
+// the rest go through strtod. A field strtod does not consume completely is an error.
+static inline bool parse_csv_number(const char* p, const char* end, double& value) {
+    static const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                           1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    const char* number = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int fraction_digits = 0;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+        mantissa = mantissa * 10 + (*p - '0');
+        ++digits;
+        ++p;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+            mantissa = mantissa * 10 + (*p - '0');
+            ++digits;
+            ++fraction_digits;
+            ++p;
+        }
+    }
+    if (digits > 0 && digits <= 18 && mantissa < (1ULL << 53) && !(p < end && (*p == 'e' || *p == 'E'))) {
+        value = static_cast<double>(mantissa) / POWERS_OF_TEN[fraction_digits];
+        value = negative ? -value : value;
+        return at_field_end(p, end);
+    }
+
+    // Long or exponent notation: hand a terminated copy of the field to strtod
+    char field[64];
+    size_t length = 0;
+    const char* q = number;
+    for (; q < end && length < sizeof(field) - 1 && *q != ',' && *q != '\n' && *q != '\r'; ++q) {
+        field[length++] = *q;
+    }
+    field[length] = '\0';
+    char* parsed = nullptr;
+    value = strtod(field, &parsed);
+    return parsed != field && at_field_end(parsed, field + length) && at_field_end(q, end);
+}
+
+// Store value into out and report whether it was representable exactly
+template <typename T>
+static inline bool store_integer(long long value, T& out) {
+    out = static_cast<T>(value);
+    return value >= static_cast<long long>(numeric_limits<T>::min()) && value <= static_cast<long long>(numeric_limits<T>::max());
+}
+
+// Parse the timestamp field into out; false if it is not a number, NaN included. fits tells
+// whether the value was representable exactly.
+template <typename T>
+static inline bool parse_csv_time(const char* field, const char* line_end, T& out, bool& fits) {
+    if (is_floating_point<T>::value) {
+        double value;
+        if (!parse_csv_number(field, line_end, value) || value != value) {
+            return false;
+        }
+        out = static_cast<T>(value);
+        fits = static_cast<double>(out) == value;
+        return true;
+    }
+    long long value;
+    if (!parse_csv_integer(field, line_end, value)) {
+        return false;
+    }
+    fits = store_integer(value, out);
+    return true;
+}
+
+// A line holds data unless it is empty (or only a carriage return)
+static inline bool is_data_line(const char* begin, const char* end) {
+    return end > begin && !(end - begin == 1 && *begin == '\r');
+}
+
+// Find the start of the line after position p (or end)
+static inline const char* next_line(const char* p, const char* end) {
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+/*
+Parse the data lines of [body, end) into the vectors, which are resized to the number of rows:
+the range is split into newline-aligned chunks, counted, and parsed concurrently. file_path and
+first_line, the line number of body in the file, only locate errors in messages. A row with fewer
+than four fields or a field that is not a number fails the whole range with CSV_READ_FAILED.
+*/
+template <typename Types>
+static CsvReadResult parse_csv_rows(const string& file_path, size_t first_line, const char* body, const char* end, vector<typename Types::EdgeType>& edge_idx,
+                                    vector<typename Types::NodeType>& src_list, vector<typename Types::NodeType>& dst_list,
+                                    vector<typename Types::TimeType>& time_list) {
+    typedef typename Types::EdgeType EdgeType;
+    TG_METRIC_SCOPE(METRIC_TIMER_CSV_PARSE);
+    TG_METRIC_ADD(METRIC_CSV_BYTES, end - body);
+
+    // Split the body into newline-aligned chunks
+    size_t num_chunks = static_cast<size_t>(omp_get_max_threads()) * CHUNKS_PER_THREAD;
+    size_t body_size = end - body;
+    vector<const char*> chunk_begin(num_chunks + 1, end);
+    chunk_begin[0] = body;
+    for (size_t c = 1; c < num_chunks; ++c) {
+        const char* p = body + body_size * c / num_chunks;
+        chunk_begin[c] = max(p == body ? body : next_line(p - 1, end), chunk_begin[c - 1]);
+    }
+
+    // Counting pass: number of data lines in each chunk
+    vector<size_t> chunk_rows(num_chunks + 1, 0);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long long c = 0; c < static_cast<long long>(num_chunks); ++c) {
+        size_t rows = 0;
+        for (const char* p = chunk_begin[c]; p < chunk_begin[c + 1];) {
+            const char* line_end = static_cast<const char*>(memchr(p, '\n', chunk_begin[c + 1] - p));
+            if (line_end == nullptr) {
+                line_end = chunk_begin[c + 1];
+            }
+            rows += is_data_line(p, line_end);
+            p = line_end + 1;
+        }
+        chunk_rows[c + 1] = rows;
+    }
+    for (size_t c = 1; c <= num_chunks; ++c) {
+        chunk_rows[c] += chunk_rows[c - 1];
+    }
+
+    size_t num_rows = chunk_rows[num_chunks];
+    if (num_rows > static_cast<size_t>(numeric_limits<EdgeType>::max() / 2)) {
+        cerr << file_path << " has too many edges for " << sizeof(EdgeType) * 8 << "-bit edge ids" << endl;
+        return CSV_READ_DOES_NOT_FIT;
+    }
+    TG_METRIC_ADD(METRIC_CSV_ROWS, num_rows);
+    edge_idx.resize(num_rows);
+    src_list.resize(num_rows);
+    dst_list.resize(num_rows);
+    time_list.resize(num_rows);
+
+    // Parsing pass: every chunk writes its own row range, and stops at its first malformed row
+    bool fits = true;
+    vector<const char*> chunk_error(num_chunks, nullptr);
+    #pragma omp parallel for schedule(dynamic, 1) reduction(&&:fits)
+    for (long long c = 0; c < static_cast<long long>(num_chunks); ++c) {
+        size_t row = chunk_rows[c];
+        const char* chunk_end = chunk_begin[c + 1];
+        for (const char* p = chunk_begin[c]; p < chunk_end;) {
+            const char* line_end = static_cast<const char*>(memchr(p, '\n', chunk_end - p));
+            if (line_end == nullptr) {
+                line_end = chunk_end;
+            }
+            if (is_data_line(p, line_end)) {
+                const char* fields[4];
+                const char* q = p;
+                int num_fields = 0;
+                for (int f = 0; f < 4 && q != nullptr; ++f) {
+                    fields[f] = q;
+                    ++num_fields;
+                    const char* comma = static_cast<const char*>(memchr(q, ',', line_end - q));
+                    q = comma ? comma + 1 : nullptr;
+                }
+                long long edge, src, dst;
+                bool time_fits = true;
+                if (num_fields < 4 || !parse_csv_integer(fields[0], line_end, edge) || !parse_csv_integer(fields[1], line_end, src) ||
+                    !parse_csv_integer(fields[2], line_end, dst) || !parse_csv_time(fields[3], line_end, time_list[row], time_fits)) {
+                    chunk_error[c] = p;
+                    break;
+                }
+                bool row_fits = store_integer(edge + 1, edge_idx[row]);
+                row_fits = store_integer(src, src_list[row]) && row_fits;
+                row_fits = store_integer(dst, dst_list[row]) && row_fits;
+                fits = fits && row_fits && time_fits;
+                ++row;
+            }
+            p = line_end + 1;
+        }
+    }
+
+    // Report the first malformed row by its line number, counted only on this path
+    for (size_t c = 0; c < num_chunks; ++c) {
+        if (chunk_error[c] != nullptr) {
+            size_t line = first_line + static_cast<size_t>(count(body, chunk_error[c], '\n'));
+            const char* line_end = static_cast<const char*>(memchr(chunk_error[c], '\n', end - chunk_error[c]));
+            cerr << file_path << ":" << line << ": expected four numeric fields, got \""
+                 << string(chunk_error[c], line_end ? line_end : end) << "\"" << endl;
+            return CSV_READ_FAILED;
+        }
+    }
+
+    if (!fits) {
+        cerr << file_path << " has ids or timestamps that do not fit " << sizeof(typename Types::NodeType) * 8
+             << "-bit node ids, " << sizeof(EdgeType) * 8 << "-bit edge ids and " << sizeof(typename Types::TimeType) * 8
+             << "-bit timestamps" << endl;
+        return CSV_READ_DOES_NOT_FIT;
+    }
+    return CSV_READ_OK;
+}
+
+template <typename Types>
+CsvReadResult read_csv_file_parallel(const string& file_path, vector<typename Types::EdgeType>& edge_idx,
+                                     vector<typename Types::NodeType>& src_list, vector<typename Types::NodeType>& dst_list,
+                                     vector<typename Types::TimeType>& time_list) {
+    double start_time = omp_get_wtime();
+
+    MappedFile file;
+    if (!file.open(file_path)) {
+        return CSV_READ_FAILED;
+    }
+    const char* data = file.data();
+    const char* end = data + file.size();
+
+    // Assuming the first line is a header and skipping it
+    const char* body = data ? next_line(data, end) : end;
+    // Line 1 is the header
+    CsvReadResult result = parse_csv_rows<Types>(file_path, 2, body, end, edge_idx, src_list, dst_list, time_list);
+    if (result != CSV_READ_OK) {
+        return result;
+    }
+
+    size_t num_rows = edge_idx.size();
+    double elapsed_time = omp_get_wtime() - start_time;
+    cout << "edge_nums: " << num_rows << endl;
+    cout << "Parsed " << num_rows << " rows in " << elapsed_time << " s ("
+         << (elapsed_time > 0 ? num_rows / elapsed_time : 0) << " rows/s)" << endl;
+    return CSV_READ_OK;
+}
+
+template <typename Types>
+CsvChunkReader<Types>::CsvChunkReader() : file(), file_path(), position(nullptr), end(nullptr), line(0) {
+}
+
+template <typename Types>
+bool CsvChunkReader<Types>::open(const string& file_path) {
+    this->file_path = file_path;
+    if (!file.open(file_path)) {
+        return false;
+    }
+    const char* data = file.data();
+    end = data + file.size();
+    // Assuming the first line is a header and skipping it
+    position = data ? next_line(data, end) : end;
+    line = 2;
+    return true;
+}
+
+template <typename Types>
+CsvReadResult CsvChunkReader<Types>::next(size_t max_rows, vector<EdgeType>& edge_idx, vector<NodeType>& src_list,
+                                          vector<NodeType>& dst_list, vector<TimeType>& time_list) {
+    // Find the end of the next max_rows data lines
+    const char* chunk_end = position;
+    size_t rows = 0;
+    size_t lines = 0;
+    while (chunk_end < end && rows < max_rows) {
+        const char* line_end = static_cast<const char*>(memchr(chunk_end, '\n', end - chunk_end));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+        rows += is_data_line(chunk_end, line_end);
+        ++lines;
+        chunk_end = line_end < end ? line_end + 1 : end;
+    }
+
+    CsvReadResult result = parse_csv_rows<Types>(file_path, line, position, chunk_end, edge_idx, src_list, dst_list, time_list);
+    line += lines;
+    // The parsed part of the mapping is not needed again
+    file.release(static_cast<size_t>(position - file.data()), static_cast<size_t>(chunk_end - position));
+    position = chunk_end;
+    return result;
+}
+
+template CsvReadResult read_csv_file_parallel<TGNGraphTypes>(const string&, vector<TGNGraphTypes::EdgeType>&, vector<TGNGraphTypes::NodeType>&,
+                                                             vector<TGNGraphTypes::NodeType>&, vector<TGNGraphTypes::TimeType>&);
+template CsvReadResult read_csv_file_parallel<TGLGraphTypes>(const string&, vector<TGLGraphTypes::EdgeType>&, vector<TGLGraphTypes::NodeType>&,
+                                                             vector<TGLGraphTypes::NodeType>&, vector<TGLGraphTypes::TimeType>&);
+template class CsvChunkReader<TGNGraphTypes>;
+template class CsvChunkReader<TGLGraphTypes>;
+
+// The untyped readers parse everything, timestamps included, as GraphDataType
+typedef GraphTypes<GraphDataType, GraphDataType, GraphDataType> UntypedGraphTypes;
+
+bool read_csv_file_tgn_format_parallel(const string& file_path, vector<GraphDataType>& edge_idx, vector<GraphDataType>& src_list, vector<GraphDataType>& dst_list, vector<GraphDataType>& time_list) {
+    return read_csv_file_parallel<UntypedGraphTypes>(file_path, edge_idx, src_list, dst_list, time_list) == CSV_READ_OK;
+}
+
+bool read_csv_file_tgl_format_parallel(const string& file_path, vector<GraphDataType>& edge_idx, vector<GraphDataType>& src_list, vector<GraphDataType>& dst_list, vector<GraphDataType>& time_list) {
+    // Both layouts share the column order; only the integer width of the old readers differed
+    return read_csv_file_parallel<UntypedGraphTypes>(file_path, edge_idx, src_list, dst_list, time_list) == CSV_READ_OK;
+}
@@ -8,6 +8,7 @@
 #include <string>
 #include <chrono>
 #include "utils.h"
+#include "csr_snapshot.h"
 using namespace std;
 /*
 read_csv_file_tgn_format - for the tgn graph data type with million-scale edges;
@@ -17,4 +18,62 @@ read_csv_file_tgl_format - for the tgl graph data type with billion-scale edges.
 void read_csv_file_tgn_format(const string& file_path, vector<GraphDataType>& edge_idx, vector<GraphDataType>& src_list, vector<GraphDataType>& dst_list, vector<GraphDataType>& time_list, bool save = false);
 void read_csv_file_tgl_format(const string& file_path, vector<GraphDataType>& edge_idx, vector<GraphDataType>& src_list, vector<GraphDataType>& dst_list, vector<GraphDataType>& time_list, bool save = false);
 
+/*
+Parallel drop-in replacements of the readers above: the file is mapped into memory, split into
+newline-aligned chunks, counted, and parsed concurrently straight into pre-sized vectors.
+They produce exactly the same vectors as the line-by-line readers.
+*/
+bool read_csv_file_tgn_format_parallel(const string& file_path, vector<GraphDataType>& edge_idx, vector<GraphDataType>& src_list, vector<GraphDataType>& dst_list, vector<GraphDataType>& time_list);
+bool read_csv_file_tgl_format_parallel(const string& file_path, vector<GraphDataType>& edge_idx, vector<GraphDataType>& src_list, vector<GraphDataType>& dst_list, vector<GraphDataType>& time_list);
+
+// Outcome of the typed parallel reader
+enum CsvReadResult {
+    CSV_READ_OK,
+    CSV_READ_FAILED,
+    CSV_READ_DOES_NOT_FIT
+};
+
+/*
+Typed variant of the parallel readers that parses straight into the vectors of a GraphTypes
+configuration (see utils.h). Floating point TimeTypes keep fractional timestamps, integral ones
+truncate them like the readers above. CSV_READ_FAILED is returned when the file cannot be read, or
+(naming the line) when a row has fewer than four fields or a field that is not a number.
+CSV_READ_DOES_NOT_FIT is returned when an id or timestamp cannot be represented exactly in Types,
+or when twice the number of edges (the reverse T-CSR) exceeds EdgeType, so the caller can load the
+dataset with a wider configuration instead.
+Instantiated for TGNGraphTypes and TGLGraphTypes.
+*/
+template <typename Types>
+CsvReadResult read_csv_file_parallel(const string& file_path, vector<typename Types::EdgeType>& edge_idx,
+                                     vector<typename Types::NodeType>& src_list, vector<typename Types::NodeType>& dst_list,
+                                     vector<typename Types::TimeType>& time_list);
+
+/*
+Reads a CSV in consecutive pieces of at most max_rows rows, each parsed like read_csv_file_parallel,
+for builds that never hold the whole edge list (see external_csr.h). Parsed pages of the mapping
+are released, so the file does not stay resident either.
+*/
+template <typename Types>
+class CsvChunkReader {
+public:
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+private:
+    MappedFile file;
+    string file_path;
+    const char* position;
+    const char* end;
+    size_t line;  // line number of position, for messages
+
+public:
+    CsvChunkReader();
+    bool open(const string& file_path);
+    // Parse the next rows into the (resized) vectors; they come back empty at the end of the file
+    CsvReadResult next(size_t max_rows, vector<EdgeType>& edge_idx, vector<NodeType>& src_list,
+                       vector<NodeType>& dst_list, vector<TimeType>& time_list);
+    size_t size() const { return file.size(); }
+};
+
 #endif // GRAPH_CSV_READER_H
@@ -0,0 +1,559 @@
+// sampler_kernels.h - Strategy kernels shared by the T-CSR based samplers
+#ifndef SAMPLER_KERNELS_H
+#define SAMPLER_KERNELS_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <string>
+#include <omp.h>
+#include "utils.h"
+#include "simd_kernels.h"
+#include "metrics.h"
+#include "radix_sort.h"
+
+using namespace std;
+
+// Value written to the unused tail of a row in the flat sampling buffers
+const GraphDataType SAMPLE_PADDING = -1;
+
+/*
+Sampling strategies:
+  "recent"          - the sample_num most recent neighbors before time
+  "random"/"uniform"- uniformly without replacement from all neighbors before time
+  "window"          - uniformly without replacement from neighbors in [time - time_window, time)
+  "decay"           - weighted without replacement, weight exp(-decay_rate * (time - edge time))
+  "inverse_degree"  - weighted without replacement, weight 1 / degree of the neighbor
+All strategies return the sampled neighbors in time order.
+*/
+enum SampleStrategy {
+    SAMPLE_NONE,
+    SAMPLE_RECENT,
+    SAMPLE_RANDOM,
+    SAMPLE_WINDOW,
+    SAMPLE_DECAY,
+    SAMPLE_INVERSE_DEGREE
+};
+
+// Parameters of the strategies that need more than sample_num, and of the batch loop
+struct SampleParams {
+    double time_window = 0;
+    double decay_rate = 0;
+    // Run batches through the planner of sample_batch_planned rather than in input order
+    bool plan_batches = true;
+};
+
+SampleStrategy parse_sample_strategy(const string& sample_strategy);
+
+// One adjacency entry of the packed layout, so a sampled neighbor is gathered from one cache line
+template <typename Types>
+struct PackedEdge {
+    typename Types::NodeType node;
+    typename Types::TimeType time;
+    typename Types::EdgeType idx;
+};
+
+// Nodes with at least this many edges get a time index in the packed layout
+const int TIME_INDEX_MIN_DEGREE = 256;
+
+// Every time_index_stride-th time value of a hub node is copied into its time index, i.e. one
+// sample per cache line of time_values
+template <typename TimeType>
+inline int time_index_stride() {
+    return static_cast<int>(64 / sizeof(TimeType));
+}
+
+/*
+The time-ordered adjacency of one node: entry i is the edge to indices[i] at time_values[i] with
+id idx_values[i]. Sources with the packed layout also set packed (the same entries interleaved)
+and, for hub nodes, time_index (time_values[j * time_index_stride] for j < time_index_length).
+*/
+template <typename Types>
+struct NeighborSlice {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+    const NodeType* indices;
+    const TimeType* time_values;
+    const EdgeType* idx_values;
+    EdgeType length;
+    const PackedEdge<Types>* packed;
+    const TimeType* time_index;
+    EdgeType time_index_length;
+};
+
+// Position one past the last edge of the slice that happened strictly before time
+template <typename Types>
+inline typename Types::EdgeType slice_cutoff(const NeighborSlice<Types>& slice, typename Types::TimeType time) {
+    typedef typename Types::EdgeType EdgeType;
+    if (slice.time_index_length > 0) {
+        // If sample j is the last one before time, the cutoff lies in (j * stride, (j + 1) * stride],
+        // which leaves one stride of time_values to count
+        EdgeType samples = simd_lower_bound(slice.time_index, slice.time_index_length, time);
+        if (samples == 0) {
+            return 0;
+        }
+        EdgeType first = (samples - 1) * time_index_stride<typename Types::TimeType>() + 1;
+        EdgeType last = min(samples * time_index_stride<typename Types::TimeType>(), slice.length);
+        return first + static_cast<EdgeType>(simd_count_less(slice.time_values + first, static_cast<size_t>(last - first), time));
+    }
+    return simd_lower_bound(slice.time_values, slice.length, time);
+}
+
+// Write count distinct positions drawn uniformly from [start, start + n) to positions, in ascending
+// (i.e. time) order. Dense draws scan the range once (selection sampling), sparse draws use
+// Floyd's algorithm on a sorted array, so neither needs extra memory or rejection loops.
+template <typename EdgeType>
+inline void sample_positions(CounterRng& rng, EdgeType start, EdgeType n, EdgeType count, EdgeType* positions) {
+    if (count >= n) {
+        for (EdgeType i = 0; i < n; ++i) {
+            positions[i] = start + i;
+        }
+        return;
+    }
+
+    if (n <= 4 * static_cast<int64_t>(count)) {
+        // Knuth's Algorithm S: keep position i with probability needed / remaining
+        EdgeType needed = count;
+        for (EdgeType i = 0; needed > 0; ++i) {
+            if (rng.bounded(n - i) < static_cast<uint64_t>(needed)) {
+                positions[count - needed] = start + i;
+                --needed;
+            }
+        }
+        return;
+    }
+
+    // Floyd's algorithm: for j in [n - count, n) add a random t <= j, or j itself if t is taken
+    EdgeType sampled = 0;
+    for (EdgeType j = n - count; j < n; ++j) {
+        EdgeType t = start + static_cast<EdgeType>(rng.bounded(static_cast<uint64_t>(j) + 1));
+        EdgeType* slot = lower_bound(positions, positions + sampled, t);
+        if (slot != positions + sampled && *slot == t) {
+            // j is larger than every position drawn so far, so it goes to the end
+            positions[sampled++] = start + j;
+        } else {
+            copy_backward(slot, positions + sampled, positions + sampled + 1);
+            *slot = t;
+            ++sampled;
+        }
+    }
+}
+
+// Weighted sampling without replacement with exponential jumps (Efraimidis-Spirakis A-ExpJ).
+// Candidates are visited from last - 1 down to first; weight(i) must be non-negative. Random numbers
+// and logarithms are only spent on reservoir replacements, O(count * log(n / count)) of them.
+// Keys are kept as log(u) / w. When the weights never increase towards first (monotone), the scan
+// stops as soon as the remaining weight cannot reach the next jump, which keeps the result exact.
+// The positions are written in ascending (time) order; the heap is per-thread scratch that only grows.
+template <bool monotone, typename EdgeType, typename Weight>
+inline void sample_weighted_positions(CounterRng& rng, EdgeType first, EdgeType last, EdgeType count,
+                                      Weight weight, EdgeType* positions) {
+    typedef pair<double, EdgeType> Entry;
+    static thread_local vector<Entry> heap;
+    heap.clear();
+    greater<Entry> min_heap;
+
+    EdgeType i = last - 1;
+    for (; i >= first && heap.size() < static_cast<size_t>(count); --i) {
+        heap.push_back(Entry(log(1.0 - rng.uniform()) / weight(i), i));
+        push_heap(heap.begin(), heap.end(), min_heap);
+    }
+
+    double threshold = heap.front().first;
+    double jump = log(1.0 - rng.uniform()) / threshold;
+    for (; i >= first; --i) {
+        double w = weight(i);
+        if (monotone && jump > w * static_cast<double>(i - first + 1)) {
+            break;
+        }
+        jump -= w;
+        if (jump > 0) {
+            continue;
+        }
+        // Item i enters the reservoir with a key drawn from (threshold, 0]
+        double t_w = exp(w * threshold);
+        double key = log(t_w + (1.0 - t_w) * rng.uniform()) / w;
+        pop_heap(heap.begin(), heap.end(), min_heap);
+        heap.back() = Entry(key, i);
+        push_heap(heap.begin(), heap.end(), min_heap);
+        threshold = heap.front().first;
+        jump = log(1.0 - rng.uniform()) / threshold;
+    }
+
+    for (EdgeType j = 0; j < count; ++j) {
+        positions[j] = heap[j].second;
+    }
+    sort(positions, positions + count);
+}
+
+// sample_slice with the cutoff of time (see slice_cutoff) already known
+template <SampleStrategy S, typename Types, typename Degree>
+inline typename Types::EdgeType sample_slice_before(const NeighborSlice<Types>& slice, typename Types::EdgeType cutoff,
+                                                    typename Types::TimeType time, typename Types::EdgeType sample_num,
+                                                    const SampleParams& params, CounterRng& rng, Degree degree,
+                                                    typename Types::NodeType* neighbors, typename Types::TimeType* neighbor_times,
+                                                    typename Types::EdgeType* neighbor_idx) {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+    EdgeType start = 0;
+
+    if (S == SAMPLE_WINDOW) {
+        // Only edges in [time - time_window, time) are candidates
+        start = lower_bound(slice.time_values, slice.time_values + cutoff, time - params.time_window) - slice.time_values;
+    }
+
+    // If the first edge with time greater than the given time is the first edge of the node, then there is no neighbor
+    EdgeType available = cutoff - start;
+    if (S == SAMPLE_NONE || available <= 0 || sample_num <= 0) {
+        return 0;
+    }
+    EdgeType count = min(sample_num, available);
+
+    if (S == SAMPLE_RECENT || count == available) {
+        // Get the most recent neighbors
+        EdgeType first = cutoff - count;
+        copy(slice.indices + first, slice.indices + cutoff, neighbors);
+        copy(slice.time_values + first, slice.time_values + cutoff, neighbor_times);
+        copy(slice.idx_values + first, slice.idx_values + cutoff, neighbor_idx);
+        return count;
+    }
+
+    // The remaining strategies pick positions into the neighbor_idx row and gather afterwards
+    EdgeType* positions = neighbor_idx;
+    if (S == SAMPLE_RANDOM || S == SAMPLE_WINDOW) {
+        sample_positions(rng, start, available, count, positions);
+    } else if (S == SAMPLE_DECAY) {
+        // weight exp(-decay_rate * (time - t_i)), scaled so the most recent candidate has weight 1
+        double decay_rate = params.decay_rate;
+        const TimeType* time_values = slice.time_values;
+        TimeType latest = time_values[cutoff - 1];
+        sample_weighted_positions<true>(rng, start, cutoff, count, [=](EdgeType i) {
+            return exp(-decay_rate * static_cast<double>(latest - time_values[i]));
+        }, positions);
+    } else if (S == SAMPLE_INVERSE_DEGREE) {
+        // weight 1 / degree of the neighbor
+        const NodeType* indices = slice.indices;
+        sample_weighted_positions<false>(rng, start, cutoff, count, [&](EdgeType i) {
+            return 1.0 / max(degree(indices[i]), static_cast<EdgeType>(1));
+        }, positions);
+    }
+
+    // Copy the chosen entries into the row (positions alias neighbor_idx, so read before writing)
+    if (slice.packed) {
+        for (EdgeType i = 0; i < count; ++i) {
+            const PackedEdge<Types>& entry = slice.packed[positions[i]];
+            neighbors[i] = entry.node;
+            neighbor_times[i] = entry.time;
+            neighbor_idx[i] = entry.idx;
+        }
+        return count;
+    }
+    simd_gather(slice.indices, positions, count, neighbors);
+    simd_gather(slice.time_values, positions, count, neighbor_times);
+    simd_gather(slice.idx_values, positions, count, neighbor_idx);
+    return count;
+}
+
+/*
+Sample up to sample_num neighbors from the part of slice before time with strategy S into the
+given row buffers and return how many were written. Only the selected entries of the slice are
+read. degree(node) is only used by SAMPLE_INVERSE_DEGREE. rng must be the row's own stream so
+results do not depend on thread scheduling.
+*/
+template <SampleStrategy S, typename Types, typename Degree>
+inline typename Types::EdgeType sample_slice(const NeighborSlice<Types>& slice, typename Types::TimeType time,
+                                             typename Types::EdgeType sample_num, const SampleParams& params,
+                                             CounterRng& rng, Degree degree, typename Types::NodeType* neighbors,
+                                             typename Types::TimeType* neighbor_times, typename Types::EdgeType* neighbor_idx) {
+    TG_METRIC_ROW_START(clock);
+    typename Types::EdgeType cutoff = slice_cutoff(slice, time);
+    TG_METRIC_ROW_LAP(METRIC_TIMER_SAMPLE_SEARCH, clock);
+    typename Types::EdgeType count = sample_slice_before<S>(slice, cutoff, time, sample_num, params, rng, degree,
+                                                            neighbors, neighbor_times, neighbor_idx);
+    TG_METRIC_ROW_LAP(METRIC_TIMER_SAMPLE_GATHER, clock);
+    TG_METRIC_SAMPLED_ROW(slice.length, count);
+    return count;
+}
+
+// Rows of one sampling call draw from stream (batch id, row)
+inline uint64_t row_stream(uint64_t batch_id, uint64_t row) {
+    return mix64(batch_id) ^ row;
+}
+
+/*
+A neighbor source is any adjacency that exports its GraphTypes as TypeConfig (plus the NodeType,
+EdgeType and TimeType typedefs) and provides, for a node id,
+  NeighborSlice<TypeConfig> neighbor_slice(NodeType node) const;
+  EdgeType degree(NodeType node) const;
+The functions below run a strategy on one row or on a whole batch of any such source.
+*/
+template <SampleStrategy S, typename Source>
+inline typename Source::EdgeType sample_row(const Source& source, typename Source::NodeType node, typename Source::TimeType time,
+                                            typename Source::EdgeType sample_num, const SampleParams& params, uint64_t seed,
+                                            uint64_t stream, typename Source::NodeType* neighbors,
+                                            typename Source::TimeType* neighbor_times, typename Source::EdgeType* neighbor_idx) {
+    typedef typename Source::NodeType NodeType;
+    NeighborSlice<typename Source::TypeConfig> slice = source.neighbor_slice(node);
+    CounterRng rng(seed, stream);
+    return sample_slice<S>(slice, time, sample_num, params, rng, [&](NodeType v) { return source.degree(v); },
+                           neighbors, neighbor_times, neighbor_idx);
+}
+
+template <typename Source>
+inline typename Source::EdgeType sample_row(SampleStrategy strategy, const Source& source, typename Source::NodeType node,
+                                            typename Source::TimeType time, typename Source::EdgeType sample_num,
+                                            const SampleParams& params, uint64_t seed, uint64_t stream,
+                                            typename Source::NodeType* neighbors, typename Source::TimeType* neighbor_times,
+                                            typename Source::EdgeType* neighbor_idx) {
+    switch (strategy) {
+        case SAMPLE_RECENT:
+            return sample_row<SAMPLE_RECENT>(source, node, time, sample_num, params, seed, stream, neighbors, neighbor_times, neighbor_idx);
+        case SAMPLE_RANDOM:
+            return sample_row<SAMPLE_RANDOM>(source, node, time, sample_num, params, seed, stream, neighbors, neighbor_times, neighbor_idx);
+        case SAMPLE_WINDOW:
+            return sample_row<SAMPLE_WINDOW>(source, node, time, sample_num, params, seed, stream, neighbors, neighbor_times, neighbor_idx);
+        case SAMPLE_DECAY:
+            return sample_row<SAMPLE_DECAY>(source, node, time, sample_num, params, seed, stream, neighbors, neighbor_times, neighbor_idx);
+        case SAMPLE_INVERSE_DEGREE:
+            return sample_row<SAMPLE_INVERSE_DEGREE>(source, node, time, sample_num, params, seed, stream, neighbors, neighbor_times, neighbor_idx);
+        default:
+            return 0;
+    }
+}
+
+// Pad the rest of a row so the block can be handed over as a dense tensor
+template <typename NodeType, typename TimeType, typename EdgeType>
+inline void pad_row(EdgeType count, EdgeType sample_num, NodeType* neighbors, TimeType* neighbor_times, EdgeType* neighbor_idx) {
+    fill(neighbors + count, neighbors + sample_num, static_cast<NodeType>(SAMPLE_PADDING));
+    fill(neighbor_times + count, neighbor_times + sample_num, static_cast<TimeType>(SAMPLE_PADDING));
+    fill(neighbor_idx + count, neighbor_idx + sample_num, static_cast<EdgeType>(SAMPLE_PADDING));
+}
+
+// Chunks of planned work per thread, so dynamic scheduling can even out hub-heavy chunks
+const int PLAN_CHUNKS_PER_THREAD = 8;
+// Smaller batches are sampled in input order, as sorting them costs more than it saves
+const size_t PLAN_MIN_BATCH_SIZE = 1024;
+
+// Planner scratch of the calling thread, kept across sampling calls so planning does not allocate
+template <typename Types>
+struct BatchPlanScratch {
+    typedef decltype(radix_key(typename Types::NodeType())) NodeKey;
+    typedef decltype(radix_key(typename Types::TimeType())) TimeKey;
+    vector<NodeKey> node_keys;
+    vector<NodeKey> node_key_scratch;
+    vector<TimeKey> time_keys;
+    vector<TimeKey> time_key_scratch;
+    vector<size_t> order;
+    vector<size_t> order_scratch;
+    vector<size_t> costs;
+    vector<size_t> chunks;
+};
+
+template <typename Types>
+inline BatchPlanScratch<Types>& batch_plan_scratch() {
+    static thread_local BatchPlanScratch<Types> scratch;
+    return scratch;
+}
+
+// Sort the rows of a batch into (node, time, row) order in plan.order: a stable sort by time,
+// then a stable sort by node
+template <typename Types>
+inline void sort_batch_rows(const typename Types::NodeType* batch_node_id, const typename Types::TimeType* batch_node_time,
+                            size_t batch_size, BatchPlanScratch<Types>& plan) {
+    vector<size_t>& order = plan.order;
+    order.resize(batch_size);
+    plan.time_keys.resize(batch_size);
+    for (size_t b = 0; b < batch_size; ++b) {
+        order[b] = b;
+        plan.time_keys[b] = radix_key(batch_node_time[b]);
+    }
+    parallel_radix_sort(plan.time_keys, order, plan.time_key_scratch, plan.order_scratch);
+    plan.node_keys.resize(batch_size);
+    for (size_t i = 0; i < batch_size; ++i) {
+        plan.node_keys[i] = radix_key(batch_node_id[order[i]]);
+    }
+    parallel_radix_sort(plan.node_keys, order, plan.node_key_scratch, plan.order_scratch);
+}
+
+/*
+Batch loop of strategy S in input order, writing the padded flat layout of SampleBuffers. Every
+row draws from its own stream (batch id, row).
+*/
+template <SampleStrategy S, typename Source>
+inline void sample_batch_in_order(const Source& source, const typename Source::NodeType* batch_node_id,
+                                  const typename Source::TimeType* batch_node_time, size_t batch_size,
+                                  typename Source::EdgeType sample_num, const SampleParams& params, uint64_t seed, uint64_t batch_id,
+                                  typename Source::NodeType* batch_neighbors, typename Source::TimeType* batch_neighbor_times,
+                                  typename Source::EdgeType* batch_neighbor_idx, typename Source::EdgeType* batch_counts) {
+    typedef typename Source::EdgeType EdgeType;
+    #pragma omp parallel for
+    for (size_t b = 0; b < batch_size; ++b) {
+        size_t row = b * sample_num;
+        EdgeType count = sample_row<S>(source, batch_node_id[b], batch_node_time[b], sample_num, params, seed,
+                                       row_stream(batch_id, b), batch_neighbors + row, batch_neighbor_times + row,
+                                       batch_neighbor_idx + row);
+        batch_counts[b] = count;
+        pad_row(count, sample_num, batch_neighbors + row, batch_neighbor_times + row, batch_neighbor_idx + row);
+    }
+}
+
+/*
+The same batch as sample_batch_in_order, with identical output, planned for locality:
+  - rows are radix sorted by (node, time), which is CSR offset order, so consecutive rows read
+    neighboring adjacency and each node's slice is fetched once per chunk;
+  - within a node the cutoffs only grow, so after the first search every row gallops from the
+    previous cutoff, and repeated (node, time) queries reuse it (and, for "recent", copy the
+    earlier row instead of sampling again);
+  - the sorted rows are cut into chunks of about equal cost (rows of the weighted strategies
+    weighted by degree) that threads take dynamically, so hub nodes do not stall one thread.
+Rows still draw from their own streams and are written in place, so the result is independent
+of the planning.
+*/
+template <SampleStrategy S, typename Source>
+inline void sample_batch_planned(const Source& source, const typename Source::NodeType* batch_node_id,
+                                 const typename Source::TimeType* batch_node_time, size_t batch_size,
+                                 typename Source::EdgeType sample_num, const SampleParams& params, uint64_t seed, uint64_t batch_id,
+                                 typename Source::NodeType* batch_neighbors, typename Source::TimeType* batch_neighbor_times,
+                                 typename Source::EdgeType* batch_neighbor_idx, typename Source::EdgeType* batch_counts) {
+    typedef typename Source::NodeType NodeType;
+    typedef typename Source::EdgeType EdgeType;
+    typedef typename Source::TimeType TimeType;
+    BatchPlanScratch<typename Source::TypeConfig>& plan = batch_plan_scratch<typename Source::TypeConfig>();
+    vector<size_t>& order = plan.order;
+    sort_batch_rows(batch_node_id, batch_node_time, batch_size, plan);
+
+    // Cost of a row: the entries it reads. The weighted strategies read all candidates, so their
+    // rows are weighted by degree; the others read at most sample_num entries after the search.
+    const bool weighted = S == SAMPLE_DECAY || S == SAMPLE_INVERSE_DEGREE;
+    vector<size_t>& costs = plan.costs;
+    costs.resize(batch_size);
+    size_t total_cost = 0;
+    EdgeType degree = 0;
+    for (size_t i = 0; i < batch_size; ++i) {
+        if (weighted) {
+            NodeType node = batch_node_id[order[i]];
+            if (i == 0 || node != batch_node_id[order[i - 1]]) {
+                degree = source.degree(node);
+            }
+            costs[i] = 1 + static_cast<size_t>(degree);
+        } else {
+            costs[i] = 1 + static_cast<size_t>(sample_num);
+        }
+        total_cost += costs[i];
+    }
+    size_t chunk_cost = total_cost / (static_cast<size_t>(omp_get_max_threads()) * PLAN_CHUNKS_PER_THREAD) + 1;
+    vector<size_t>& chunks = plan.chunks;
+    chunks.assign(1, 0);
+    size_t cost = 0;
+    for (size_t i = 0; i + 1 < batch_size; ++i) {
+        cost += costs[i];
+        if (cost >= chunk_cost) {
+            chunks.push_back(i + 1);
+            cost = 0;
+        }
+    }
+    chunks.push_back(batch_size);
+
+    size_t num_chunks = chunks.size() - 1;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t c = 0; c < num_chunks; ++c) {
+        NeighborSlice<typename Source::TypeConfig> slice = {nullptr, nullptr, nullptr, 0, nullptr, nullptr, 0};
+        EdgeType cutoff = 0;
+        for (size_t i = chunks[c]; i < chunks[c + 1]; ++i) {
+            size_t b = order[i];
+            NodeType node = batch_node_id[b];
+            TimeType time = batch_node_time[b];
+            size_t row = b * sample_num;
+            size_t previous = i > chunks[c] ? order[i - 1] : batch_size;
+            TG_METRIC_ROW_START(clock);
+            if (previous == batch_size || batch_node_id[previous] != node) {
+                slice = source.neighbor_slice(node);
+                cutoff = slice_cutoff(slice, time);
+            } else if (batch_node_time[previous] < time) {
+                cutoff = gallop_lower_bound(slice.time_values, cutoff, slice.length, time);
+            } else if (!(batch_node_time[previous] == time)) {
+                // NaN on either side: no order to gallop in or query to repeat, so search afresh
+                cutoff = slice_cutoff(slice, time);
+            } else if (S == SAMPLE_RECENT || S == SAMPLE_NONE) {
+                // A repeated query of a deterministic strategy has the same row
+                size_t previous_row = previous * sample_num;
+                copy(batch_neighbors + previous_row, batch_neighbors + previous_row + sample_num, batch_neighbors + row);
+                copy(batch_neighbor_times + previous_row, batch_neighbor_times + previous_row + sample_num, batch_neighbor_times + row);
+                copy(batch_neighbor_idx + previous_row, batch_neighbor_idx + previous_row + sample_num, batch_neighbor_idx + row);
+                batch_counts[b] = batch_counts[previous];
+                TG_METRIC_ROW_LAP(METRIC_TIMER_SAMPLE_GATHER, clock);
+                TG_METRIC_SAMPLED_ROW(slice.length, batch_counts[b]);
+                continue;
+            }
+            TG_METRIC_ROW_LAP(METRIC_TIMER_SAMPLE_SEARCH, clock);
+
+            CounterRng rng(seed, row_stream(batch_id, b));
+            EdgeType count = sample_slice_before<S>(slice, cutoff, time, sample_num, params, rng,
+                                                    [&](NodeType v) { return source.degree(v); },
+                                                    batch_neighbors + row, batch_neighbor_times + row, batch_neighbor_idx + row);
+            TG_METRIC_ROW_LAP(METRIC_TIMER_SAMPLE_GATHER, clock);
+            TG_METRIC_SAMPLED_ROW(slice.length, count);
+            batch_counts[b] = count;
+            pad_row(count, sample_num, batch_neighbors + row, batch_neighbor_times + row, batch_neighbor_idx + row);
+        }
+    }
+}
+
+// Batch loop specialized for strategy S, planned unless params.plan_batches is off or the batch is small
+template <SampleStrategy S, typename Source>
+inline void sample_batch(const Source& source, const typename Source::NodeType* batch_node_id,
+                         const typename Source::TimeType* batch_node_time, size_t batch_size,
+                         typename Source::EdgeType sample_num, const SampleParams& params, uint64_t seed, uint64_t batch_id,
+                         typename Source::NodeType* batch_neighbors, typename Source::TimeType* batch_neighbor_times,
+                         typename Source::EdgeType* batch_neighbor_idx, typename Source::EdgeType* batch_counts) {
+    TG_METRIC_SCOPE(METRIC_TIMER_SAMPLE_BATCH);
+    TG_METRIC_ADD(METRIC_SAMPLE_BATCHES, 1);
+    if (params.plan_batches && batch_size >= PLAN_MIN_BATCH_SIZE) {
+        sample_batch_planned<S>(source, batch_node_id, batch_node_time, batch_size, sample_num, params, seed, batch_id,
+                                batch_neighbors, batch_neighbor_times, batch_neighbor_idx, batch_counts);
+    } else {
+        sample_batch_in_order<S>(source, batch_node_id, batch_node_time, batch_size, sample_num, params, seed, batch_id,
+                                 batch_neighbors, batch_neighbor_times, batch_neighbor_idx, batch_counts);
+    }
+}
+
+// Resolve the strategy once and run the batch loop compiled for it
+template <typename Source>
+inline void sample_batch(SampleStrategy strategy, const Source& source, const typename Source::NodeType* batch_node_id,
+                         const typename Source::TimeType* batch_node_time, size_t batch_size,
+                         typename Source::EdgeType sample_num, const SampleParams& params, uint64_t seed, uint64_t batch_id,
+                         typename Source::NodeType* batch_neighbors, typename Source::TimeType* batch_neighbor_times,
+                         typename Source::EdgeType* batch_neighbor_idx, typename Source::EdgeType* batch_counts) {
+    switch (strategy) {
+        case SAMPLE_RECENT:
+            sample_batch<SAMPLE_RECENT>(source, batch_node_id, batch_node_time, batch_size, sample_num, params, seed, batch_id,
+                                        batch_neighbors, batch_neighbor_times, batch_neighbor_idx, batch_counts);
+            break;
+        case SAMPLE_RANDOM:
+            sample_batch<SAMPLE_RANDOM>(source, batch_node_id, batch_node_time, batch_size, sample_num, params, seed, batch_id,
+                                        batch_neighbors, batch_neighbor_times, batch_neighbor_idx, batch_counts);
+            break;
+        case SAMPLE_WINDOW:
+            sample_batch<SAMPLE_WINDOW>(source, batch_node_id, batch_node_time, batch_size, sample_num, params, seed, batch_id,
+                                        batch_neighbors, batch_neighbor_times, batch_neighbor_idx, batch_counts);
+            break;
+        case SAMPLE_DECAY:
+            sample_batch<SAMPLE_DECAY>(source, batch_node_id, batch_node_time, batch_size, sample_num, params, seed, batch_id,
+                                       batch_neighbors, batch_neighbor_times, batch_neighbor_idx, batch_counts);
+            break;
+        case SAMPLE_INVERSE_DEGREE:
+            sample_batch<SAMPLE_INVERSE_DEGREE>(source, batch_node_id, batch_node_time, batch_size, sample_num, params, seed, batch_id,
+                                                batch_neighbors, batch_neighbor_times, batch_neighbor_idx, batch_counts);
+            break;
+        default:
+            sample_batch<SAMPLE_NONE>(source, batch_node_id, batch_node_time, batch_size, sample_num, params, seed, batch_id,
+                                      batch_neighbors, batch_neighbor_times, batch_neighbor_idx, batch_counts);
+            break;
+    }
+}
+
+#endif // SAMPLER_KERNELS_H
@@ -0,0 +1,883 @@
+// sharded_graph.cpp - Node-partitioned T-CSR shards served by separate processes
+#include "sharded_graph.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <omp.h>
+
+extern char** environ;
+
+bool parse_shard_mode(const string& name, ShardMode& mode) {
+    if (name == "range") {
+        mode = SHARD_RANGE;
+    } else if (name == "modulo") {
+        mode = SHARD_MODULO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* shard_mode_name(ShardMode mode) {
+    return mode == SHARD_MODULO ? "modulo" : "range";
+}
+
+size_t ShardManifest::shard_of(uint64_t node) const {
+    if (mode == SHARD_MODULO) {
+        return static_cast<size_t>(node % shards.size());
+    }
+    // The last shard whose range starts at or before node
+    size_t low = 0;
+    size_t high = shards.size();
+    while (high - low > 1) {
+        size_t middle = (low + high) / 2;
+        if (shards[middle].first_node <= node) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+string shard_file_path(const string& manifest_path, const string& file) {
+    if (!file.empty() && file[0] == '/') {
+        return file;
+    }
+    size_t slash = manifest_path.rfind('/');
+    return slash == string::npos ? file : manifest_path.substr(0, slash + 1) + file;
+}
+
+static string file_name(const string& path) {
+    size_t slash = path.rfind('/');
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+bool read_shard_manifest(const string& manifest_path, ShardManifest& manifest) {
+    ifstream file(manifest_path);
+    if (!file) {
+        cerr << "Failed to open " << manifest_path << endl;
+        return false;
+    }
+    manifest = ShardManifest();
+    manifest.mode = SHARD_RANGE;
+    string key;
+    int version = 0;
+    bool ok = static_cast<bool>(file >> key >> version) && key == "tgshards" && version == 1;
+    while (ok && file >> key) {
+        if (key == "mode") {
+            string mode;
+            ok = static_cast<bool>(file >> mode) && parse_shard_mode(mode, manifest.mode);
+        } else if (key == "nodes") {
+            ok = static_cast<bool>(file >> manifest.num_nodes);
+        } else if (key == "edges") {
+            ok = static_cast<bool>(file >> manifest.num_edges);
+        } else if (key == "reverse") {
+            ok = static_cast<bool>(file >> manifest.reverse);
+        } else if (key == "widths") {
+            ok = static_cast<bool>(file >> manifest.node_width >> manifest.edge_width >> manifest.time_width >> manifest.float_time);
+        } else if (key == "degrees") {
+            ok = static_cast<bool>(file >> manifest.degrees_file);
+        } else if (key == "shard") {
+            size_t index = 0;
+            ShardInfo shard;
+            ok = static_cast<bool>(file >> index >> shard.first_node >> shard.local_nodes >> shard.num_edges >> shard.file) &&
+                 index == manifest.shards.size();
+            manifest.shards.push_back(shard);
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok || manifest.shards.empty() || manifest.degrees_file.empty()) {
+        cerr << "Invalid shard manifest " << manifest_path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool write_shard_manifest(const string& manifest_path, const ShardManifest& manifest) {
+    ofstream file(manifest_path, ios::trunc);
+    file << "tgshards 1\n"
+         << "mode " << shard_mode_name(manifest.mode) << "\n"
+         << "nodes " << manifest.num_nodes << "\n"
+         << "edges " << manifest.num_edges << "\n"
+         << "reverse " << (manifest.reverse ? 1 : 0) << "\n"
+         << "widths " << manifest.node_width << " " << manifest.edge_width << " " << manifest.time_width << " "
+         << (manifest.float_time ? 1 : 0) << "\n"
+         << "degrees " << manifest.degrees_file << "\n";
+    for (size_t s = 0; s < manifest.shards.size(); ++s) {
+        const ShardInfo& shard = manifest.shards[s];
+        file << "shard " << s << " " << shard.first_node << " " << shard.local_nodes << " " << shard.num_edges << " " << shard.file << "\n";
+    }
+    file.close();
+    if (!file) {
+        cerr << "Failed to write " << manifest_path << endl;
+        return false;
+    }
+    return true;
+}
+
+// Partitioning
+
+// Append data to a section of the file being written, and to the section's checksum
+static void write_piece(ofstream& file, SnapshotChecksum& checksum, const void* data, size_t bytes) {
+    checksum.update(data, bytes);
+    file.write(static_cast<const char*>(data), static_cast<streamsize>(bytes));
+}
+
+// Entries [indptr[v], indptr[v + 1]) of values for the local nodes of a shard; with stride 1
+// they are one contiguous run
+template <typename T, typename EdgeType>
+static void write_edge_section(ofstream& file, SnapshotChecksum& checksum, const T* values, const EdgeType* indptr,
+                               uint64_t first_node, uint64_t stride, uint64_t local_nodes) {
+    if (stride == 1) {
+        EdgeType begin = indptr[first_node];
+        EdgeType end = indptr[first_node + local_nodes];
+        write_piece(file, checksum, values + begin, static_cast<size_t>(end - begin) * sizeof(T));
+        return;
+    }
+    for (uint64_t i = 0; i < local_nodes; ++i) {
+        uint64_t v = first_node + i * stride;
+        write_piece(file, checksum, values + indptr[v], static_cast<size_t>(indptr[v + 1] - indptr[v]) * sizeof(T));
+    }
+}
+
+// Write the snapshot of one shard, streamed section by section, under its name once complete
+template <typename Types>
+static bool write_shard_snapshot(const TemporalGraphT<Types>& graph, const string& path, const ShardInfo& shard, uint64_t stride) {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+    const EdgeType* indptr = graph.get_indptr();
+
+    CsrSnapshotHeader header;
+    init_csr_snapshot_header(header);
+    header.node_width = sizeof(NodeType);
+    header.edge_width = sizeof(EdgeType);
+    header.time_width = sizeof(TimeType);
+    header.flags = (graph.is_reverse() ? CSR_FLAG_REVERSE : 0) | (is_floating_point<TimeType>::value ? CSR_FLAG_FLOAT_TIME : 0);
+    header.num_nodes = shard.local_nodes;
+    header.num_edges = shard.num_edges;
+    const uint64_t entries[CSR_NUM_SECTIONS] = {shard.local_nodes + 1, shard.num_edges, shard.num_edges, shard.num_edges};
+    const uint64_t widths[CSR_NUM_SECTIONS] = {sizeof(EdgeType), sizeof(NodeType), sizeof(TimeType), sizeof(EdgeType)};
+    uint64_t offset = sizeof(CsrSnapshotHeader);
+    for (int s = 0; s < CSR_NUM_SECTIONS; ++s) {
+        header.section_offset[s] = csr_snapshot_section_offset(offset, 0);
+        header.section_bytes[s] = entries[s] * widths[s];
+        offset = header.section_offset[s] + header.section_bytes[s];
+    }
+
+    string partial_path = path + ".partial";
+    ofstream file(partial_path, ios::binary | ios::trunc);
+    if (!file) {
+        cerr << "Failed to open " << partial_path << " for writing" << endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[CSR_SNAPSHOT_ALIGNMENT] = {0};
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < CSR_NUM_SECTIONS; ++s) {
+        file.write(padding, static_cast<streamsize>(header.section_offset[s] - written));
+        SnapshotChecksum checksum;
+        if (s == CSR_SECTION_INDPTR) {
+            // Local offsets, rebuilt from the degrees of the shard's nodes in blocks
+            vector<EdgeType> block;
+            block.reserve(1 << 16);
+            EdgeType total = 0;
+            block.push_back(total);
+            for (uint64_t i = 0; i < shard.local_nodes; ++i) {
+                uint64_t v = shard.first_node + i * stride;
+                total += indptr[v + 1] - indptr[v];
+                block.push_back(total);
+                if (block.size() == block.capacity()) {
+                    write_piece(file, checksum, block.data(), block.size() * sizeof(EdgeType));
+                    block.clear();
+                }
+            }
+            write_piece(file, checksum, block.data(), block.size() * sizeof(EdgeType));
+        } else if (s == CSR_SECTION_INDICES) {
+            write_edge_section(file, checksum, graph.get_indices(), indptr, shard.first_node, stride, shard.local_nodes);
+        } else if (s == CSR_SECTION_TIME_VALUES) {
+            write_edge_section(file, checksum, graph.get_time_values(), indptr, shard.first_node, stride, shard.local_nodes);
+        } else {
+            write_edge_section(file, checksum, graph.get_idx_values(), indptr, shard.first_node, stride, shard.local_nodes);
+        }
+        header.section_checksum[s] = checksum.finish();
+        written = header.section_offset[s] + header.section_bytes[s];
+    }
+    header.header_checksum = snapshot_checksum(&header, offsetof(CsrSnapshotHeader, header_checksum));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    if (!file || rename(partial_path.c_str(), path.c_str()) != 0) {
+        cerr << "Failed to write " << path << endl;
+        remove(partial_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+template <typename Types>
+bool partition_temporal_graph(const TemporalGraphT<Types>& graph, const string& manifest_path, size_t num_shards, ShardMode mode) {
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+    double start_time = omp_get_wtime();
+    const EdgeType* indptr = graph.get_indptr();
+    uint64_t num_nodes = graph.get_num_nodes();
+    if (indptr == nullptr || num_shards == 0) {
+        cerr << "Failed to partition: the graph has no T-CSR, or no shards were asked for" << endl;
+        return false;
+    }
+
+    ShardManifest manifest;
+    manifest.mode = mode;
+    manifest.num_nodes = num_nodes;
+    manifest.num_edges = graph.get_num_edges();
+    manifest.reverse = graph.is_reverse();
+    manifest.node_width = sizeof(typename Types::NodeType);
+    manifest.edge_width = sizeof(EdgeType);
+    manifest.time_width = sizeof(TimeType);
+    manifest.float_time = is_floating_point<TimeType>::value;
+    manifest.degrees_file = file_name(manifest_path) + ".degrees";
+    manifest.shards.resize(num_shards);
+
+    // Range shards start at the first node whose adjacency begins at or after s / num_shards of
+    // the edges, like the NUMA partition; modulo shard s holds s, s + num_shards, ...
+    vector<uint64_t> first(num_shards + 1, num_nodes);
+    first[0] = 0;
+    for (size_t s = 1; s < num_shards && mode == SHARD_RANGE; ++s) {
+        EdgeType target = static_cast<EdgeType>(static_cast<double>(manifest.num_edges) * s / num_shards);
+        first[s] = static_cast<uint64_t>(lower_bound(indptr, indptr + num_nodes, target) - indptr);
+    }
+    for (size_t s = 0; s < num_shards; ++s) {
+        ShardInfo& shard = manifest.shards[s];
+        shard.file = file_name(manifest_path) + ".shard" + to_string(s);
+        if (mode == SHARD_RANGE) {
+            shard.first_node = first[s];
+            shard.local_nodes = first[s + 1] - first[s];
+            shard.num_edges = static_cast<uint64_t>(indptr[first[s + 1]] - indptr[first[s]]);
+        } else {
+            shard.first_node = s;
+            shard.local_nodes = num_nodes > s ? (num_nodes - s + num_shards - 1) / num_shards : 0;
+            shard.num_edges = 0;
+            for (uint64_t v = s; v < num_nodes; v += num_shards) {
+                shard.num_edges += static_cast<uint64_t>(indptr[v + 1] - indptr[v]);
+            }
+        }
+        if (!write_shard_snapshot(graph, shard_file_path(manifest_path, shard.file), shard, manifest.stride())) {
+            return false;
+        }
+    }
+
+    // Global degrees, for the degree-weighted strategies of every shard
+    string degrees_path = shard_file_path(manifest_path, manifest.degrees_file);
+    ofstream degrees(degrees_path, ios::binary | ios::trunc);
+    vector<EdgeType> block;
+    for (uint64_t v = 0; v < num_nodes && degrees; v += 1 << 16) {
+        uint64_t end = min(num_nodes, v + (1 << 16));
+        block.resize(end - v);
+        for (uint64_t u = v; u < end; ++u) {
+            block[u - v] = indptr[u + 1] - indptr[u];
+        }
+        degrees.write(reinterpret_cast<const char*>(block.data()), static_cast<streamsize>(block.size() * sizeof(EdgeType)));
+    }
+    degrees.close();
+    if (!degrees) {
+        cerr << "Failed to write " << degrees_path << endl;
+        return false;
+    }
+    if (!write_shard_manifest(manifest_path, manifest)) {
+        return false;
+    }
+
+    double end_time = omp_get_wtime();
+    cout << "Partitioned " << num_nodes << " nodes and " << manifest.num_edges << " edges into " << num_shards << " "
+         << shard_mode_name(mode) << " shards in " << end_time - start_time << " s" << endl;
+    return true;
+}
+
+// Shard source
+
+template <typename Types>
+ShardSourceT<Types>::ShardSourceT()
+    : graph(), degrees_file(), degrees(nullptr), num_nodes(0), first_node(0), stride(1) {}
+
+template <typename Types>
+bool ShardSourceT<Types>::open(const string& manifest_path, const ShardManifest& manifest, size_t shard, bool verify_checksums) {
+    if (!shard_manifest_matches<Types>(manifest) || shard >= manifest.num_shards()) {
+        cerr << "Shard " << shard << " of " << manifest_path << " does not match the requested type configuration" << endl;
+        return false;
+    }
+    const ShardInfo& info = manifest.shards[shard];
+    if (!graph.load_csr_binary(shard_file_path(manifest_path, info.file), verify_checksums)) {
+        return false;
+    }
+    string degrees_path = shard_file_path(manifest_path, manifest.degrees_file);
+    if (graph.get_num_nodes() != info.local_nodes || graph.get_num_edges() != info.num_edges || !degrees_file.open(degrees_path) ||
+        degrees_file.size() != manifest.num_nodes * sizeof(EdgeType)) {
+        cerr << "Shard " << shard << " of " << manifest_path << " does not match its manifest" << endl;
+        return false;
+    }
+    degrees = reinterpret_cast<const EdgeType*>(degrees_file.data());
+    num_nodes = manifest.num_nodes;
+    first_node = info.first_node;
+    stride = manifest.stride();
+    return true;
+}
+
+template <typename Types>
+bool ShardSourceT<Types>::owns(NodeType node) const {
+    if (node < 0 || static_cast<uint64_t>(node) >= num_nodes || static_cast<uint64_t>(node) < first_node) {
+        return false;
+    }
+    uint64_t offset = static_cast<uint64_t>(node) - first_node;
+    return offset % stride == 0 && offset / stride < local_nodes();
+}
+
+// Wire protocol over a Unix stream socket, in native byte order. A request is a ShardRequest,
+// followed for SHARD_OP_SAMPLE by nodes[rows], times[rows] and the rows' indices in the batch
+// (uint64_t[rows]). A reply is a ShardReply, followed for a sample by counts[rows] and the
+// neighbors, times and edge ids of rows * sample_num slots.
+
+static const uint32_t SHARD_PROTOCOL_MAGIC = 0x48534754;  // "TGSH"
+// Upper bound of rows * sample_num in one request
+static const uint64_t SHARD_MAX_SLOTS = static_cast<uint64_t>(1) << 32;
+
+enum ShardOp {
+    SHARD_OP_INFO = 1,
+    SHARD_OP_SAMPLE = 2,
+    SHARD_OP_SHUTDOWN = 3
+};
+
+struct ShardRequest {
+    uint32_t magic;
+    uint32_t op;
+    uint64_t rows;
+    uint64_t batch_id;
+    uint64_t seed;
+    int64_t sample_num;
+    int32_t strategy;
+    uint32_t reserved;
+    double time_window;
+    double decay_rate;
+};
+
+struct ShardReply {
+    uint32_t magic;
+    uint32_t status;  // 0 on success
+    uint64_t shard;
+    uint64_t rows;
+    uint64_t local_nodes;
+    uint64_t local_edges;
+};
+
+static bool send_all(int fd, const void* data, size_t bytes) {
+    const char* position = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = send(fd, position, bytes, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        position += n;
+        bytes -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool recv_all(int fd, void* data, size_t bytes) {
+    char* position = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t n = recv(fd, position, bytes, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        position += n;
+        bytes -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+template <typename T>
+static bool send_vector(int fd, const vector<T>& values, size_t count) {
+    return send_all(fd, values.data(), count * sizeof(T));
+}
+
+template <typename T>
+static bool recv_vector(int fd, vector<T>& values, size_t count) {
+    values.resize(count);
+    return recv_all(fd, values.data(), count * sizeof(T));
+}
+
+static bool make_socket_address(const string& socket_path, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        cerr << "Socket path too long: " << socket_path << endl;
+        return false;
+    }
+    memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return true;
+}
+
+// A connected socket to socket_path, or -1
+static int connect_socket(const string& socket_path) {
+    sockaddr_un address;
+    if (!make_socket_address(socket_path, address)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Server
+
+// Answer the requests of one connection; false once a client asked the server to shut down
+template <typename Types>
+static bool serve_connection(int fd, const ShardSourceT<Types>& source, size_t shard) {
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+    vector<NodeType> nodes;
+    vector<TimeType> times;
+    vector<uint64_t> rows;
+    SampleBuffers<Types> samples;
+
+    ShardRequest request;
+    while (recv_all(fd, &request, sizeof(request)) && request.magic == SHARD_PROTOCOL_MAGIC) {
+        ShardReply reply = {SHARD_PROTOCOL_MAGIC, 0, shard, 0, source.local_nodes(), source.local_edges()};
+        if (request.op == SHARD_OP_SHUTDOWN) {
+            return false;
+        }
+        if (request.op == SHARD_OP_INFO) {
+            if (!send_all(fd, &reply, sizeof(reply))) {
+                break;
+            }
+            continue;
+        }
+        uint64_t slots = request.rows * static_cast<uint64_t>(max<int64_t>(request.sample_num, 0));
+        if (request.op != SHARD_OP_SAMPLE || request.sample_num < 0 || request.rows > SHARD_MAX_SLOTS || slots > SHARD_MAX_SLOTS ||
+            !recv_vector(fd, nodes, request.rows) || !recv_vector(fd, times, request.rows) || !recv_vector(fd, rows, request.rows)) {
+            break;
+        }
+
+        EdgeType sample_num = static_cast<EdgeType>(request.sample_num);
+        SampleStrategy strategy = static_cast<SampleStrategy>(request.strategy);
+        SampleParams params;
+        params.time_window = request.time_window;
+        params.decay_rate = request.decay_rate;
+        size_t num_rows = static_cast<size_t>(request.rows);
+        samples.resize(num_rows, sample_num);
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (size_t i = 0; i < num_rows; ++i) {
+            size_t row = i * static_cast<size_t>(sample_num);
+            EdgeType count = 0;
+            if (source.owns(nodes[i])) {
+                count = sample_row(strategy, source, nodes[i], times[i], sample_num, params, request.seed,
+                                   row_stream(request.batch_id, rows[i]), samples.neighbors.data() + row,
+                                   samples.neighbor_times.data() + row, samples.neighbor_idx.data() + row);
+            }
+            samples.counts[i] = count;
+            pad_row(count, sample_num, samples.neighbors.data() + row, samples.neighbor_times.data() + row,
+                    samples.neighbor_idx.data() + row);
+        }
+
+        reply.rows = request.rows;
+        size_t num_slots = static_cast<size_t>(slots);
+        if (!send_all(fd, &reply, sizeof(reply)) || !send_vector(fd, samples.counts, num_rows) ||
+            !send_vector(fd, samples.neighbors, num_slots) || !send_vector(fd, samples.neighbor_times, num_slots) ||
+            !send_vector(fd, samples.neighbor_idx, num_slots)) {
+            break;
+        }
+    }
+    return true;
+}
+
+template <typename Types>
+static int serve_shard_typed(const string& manifest_path, const ShardManifest& manifest, size_t shard, const string& socket_path) {
+    ShardSourceT<Types> source;
+    if (!source.open(manifest_path, manifest, shard)) {
+        return 1;
+    }
+    sockaddr_un address;
+    if (!make_socket_address(socket_path, address)) {
+        return 1;
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path.c_str());
+    if (listener < 0 || ::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 4) != 0) {
+        cerr << "Failed to listen on " << socket_path << ": " << strerror(errno) << endl;
+        if (listener >= 0) {
+            close(listener);
+        }
+        return 1;
+    }
+    cout << "Shard " << shard << " serving " << source.local_nodes() << " nodes and " << source.local_edges() << " edges on "
+         << socket_path << endl;
+
+    bool running = true;
+    while (running) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        running = serve_connection(fd, source, shard);
+        close(fd);
+    }
+    close(listener);
+    unlink(socket_path.c_str());
+    return 0;
+}
+
+int serve_shard(const string& manifest_path, size_t shard, const string& socket_path) {
+    ShardManifest manifest;
+    if (!read_shard_manifest(manifest_path, manifest)) {
+        return 1;
+    }
+    if (shard_manifest_matches<TGNGraphTypes>(manifest)) {
+        return serve_shard_typed<TGNGraphTypes>(manifest_path, manifest, shard, socket_path);
+    }
+    if (shard_manifest_matches<TGLGraphTypes>(manifest)) {
+        return serve_shard_typed<TGLGraphTypes>(manifest_path, manifest, shard, socket_path);
+    }
+    cerr << "Shards of " << manifest_path << " have no supported type configuration" << endl;
+    return 1;
+}
+
+// Local processes
+
+// Servers load their shard before they listen; give up on one after this long
+static const int SHARD_START_TIMEOUT_MS = 120000;
+static const int SHARD_STOP_TIMEOUT_MS = 5000;
+
+LocalShardProcesses::LocalShardProcesses() : pids(), socket_paths() {}
+
+LocalShardProcesses::~LocalShardProcesses() {
+    stop();
+}
+
+bool LocalShardProcesses::launch(const string& manifest_path, const string& socket_dir, size_t threads_per_shard,
+                                 const string& executable) {
+    stop();
+    ShardManifest manifest;
+    if (!read_shard_manifest(manifest_path, manifest)) {
+        return false;
+    }
+
+    // Everything the children need is built before forking; between fork and exec they only exec
+    vector<string> environment;
+    for (char** entry = environ; *entry != nullptr; ++entry) {
+        if (threads_per_shard == 0 || strncmp(*entry, "OMP_NUM_THREADS=", 16) != 0) {
+            environment.push_back(*entry);
+        }
+    }
+    if (threads_per_shard > 0) {
+        environment.push_back("OMP_NUM_THREADS=" + to_string(threads_per_shard));
+    }
+    vector<char*> envp;
+    for (string& entry : environment) {
+        envp.push_back(&entry[0]);
+    }
+    envp.push_back(nullptr);
+
+    string command = "serve-shard";
+    for (size_t s = 0; s < manifest.num_shards(); ++s) {
+        string shard = to_string(s);
+        string socket_path = socket_dir + "/tgshard_" + to_string(static_cast<long long>(getpid())) + "_" + shard + ".sock";
+        vector<char*> argv = {const_cast<char*>(executable.c_str()), &command[0], const_cast<char*>(manifest_path.c_str()),
+                              &shard[0], &socket_path[0], nullptr};
+        unlink(socket_path.c_str());
+        pid_t pid = fork();
+        if (pid == 0) {
+            execve(executable.c_str(), argv.data(), envp.data());
+            _exit(127);
+        }
+        if (pid < 0) {
+            cerr << "Failed to start shard " << s << ": " << strerror(errno) << endl;
+            stop();
+            return false;
+        }
+        pids.push_back(pid);
+        socket_paths.push_back(socket_path);
+    }
+
+    // Ready once every socket accepts a connection
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(SHARD_START_TIMEOUT_MS);
+    for (size_t s = 0; s < pids.size(); ++s) {
+        while (true) {
+            int fd = connect_socket(socket_paths[s]);
+            if (fd >= 0) {
+                close(fd);
+                break;
+            }
+            int status = 0;
+            if (waitpid(pids[s], &status, WNOHANG) == pids[s] || chrono::steady_clock::now() > deadline) {
+                cerr << "Shard " << s << " did not start" << endl;
+                pids[s] = -1;
+                stop();
+                return false;
+            }
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    }
+    return true;
+}
+
+void LocalShardProcesses::stop() {
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(SHARD_STOP_TIMEOUT_MS);
+    for (pid_t pid : pids) {
+        if (pid <= 0) {
+            continue;
+        }
+        int status = 0;
+        while (waitpid(pid, &status, WNOHANG) == 0) {
+            if (chrono::steady_clock::now() > deadline) {
+                kill(pid, SIGTERM);
+                waitpid(pid, &status, 0);
+                break;
+            }
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    }
+    for (const string& socket_path : socket_paths) {
+        unlink(socket_path.c_str());
+    }
+    pids.clear();
+    socket_paths.clear();
+}
+
+// Front-end
+
+template <typename Types>
+ShardedSamplerT<Types>::ShardedSamplerT()
+    : manifest(), sockets(), random_seed(DEFAULT_RANDOM_SEED), batch_counter(0), sample_params(), shard_batches(), batches(0),
+      rows(0), bytes_sent(0), bytes_received(0), rows_per_shard() {}
+
+template <typename Types>
+ShardedSamplerT<Types>::~ShardedSamplerT() {
+    disconnect();
+}
+
+template <typename Types>
+bool ShardedSamplerT<Types>::connect(const string& manifest_path, const vector<string>& socket_paths) {
+    disconnect();
+    if (!read_shard_manifest(manifest_path, manifest)) {
+        return false;
+    }
+    if (!shard_manifest_matches<Types>(manifest) || socket_paths.size() != manifest.num_shards()) {
+        cerr << "The shards of " << manifest_path << " do not match the sampler's type configuration or socket count" << endl;
+        return false;
+    }
+    for (size_t s = 0; s < socket_paths.size(); ++s) {
+        int fd = connect_socket(socket_paths[s]);
+        ShardRequest request = {SHARD_PROTOCOL_MAGIC, SHARD_OP_INFO, 0, 0, 0, 0, 0, 0, 0, 0};
+        ShardReply reply;
+        bool ok = fd >= 0 && send_all(fd, &request, sizeof(request)) && recv_all(fd, &reply, sizeof(reply)) &&
+                  reply.magic == SHARD_PROTOCOL_MAGIC && reply.shard == s && reply.local_nodes == manifest.shards[s].local_nodes &&
+                  reply.local_edges == manifest.shards[s].num_edges;
+        if (fd >= 0) {
+            sockets.push_back(fd);
+        }
+        if (!ok) {
+            cerr << "Failed to connect to shard " << s << " at " << socket_paths[s] << endl;
+            disconnect();
+            return false;
+        }
+    }
+    vector<ShardBatch>(manifest.num_shards()).swap(shard_batches);
+    vector<atomic<uint64_t>>(manifest.num_shards()).swap(rows_per_shard);
+    reset_stats();
+    return true;
+}
+
+template <typename Types>
+void ShardedSamplerT<Types>::disconnect() {
+    for (int fd : sockets) {
+        close(fd);
+    }
+    sockets.clear();
+}
+
+template <typename Types>
+void ShardedSamplerT<Types>::shutdown() {
+    ShardRequest request = {SHARD_PROTOCOL_MAGIC, SHARD_OP_SHUTDOWN, 0, 0, 0, 0, 0, 0, 0, 0};
+    for (int fd : sockets) {
+        send_all(fd, &request, sizeof(request));
+    }
+    disconnect();
+}
+
+template <typename Types>
+void ShardedSamplerT<Types>::set_random_seed(uint64_t seed) {
+    random_seed = seed;
+    batch_counter.store(0);
+}
+
+template <typename Types>
+void ShardedSamplerT<Types>::set_sample_params(const SampleParams& params) {
+    sample_params = params;
+}
+
+template <typename Types>
+double ShardedSamplerT<Types>::sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                                             NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                                             EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                                             EdgeType sample_num, SampleStrategy sample_strategy) {
+    double start_time = omp_get_wtime();
+    uint64_t batch_id = batch_counter.fetch_add(1);
+    size_t num_shards = sockets.size();
+    if (num_shards == 0) {
+        return -1;
+    }
+
+    // Route the rows, in (node, time) order for planned batches so every shard gets its rows
+    // sorted; rows of unknown roots are answered here, empty
+    bool planned = sample_params.plan_batches && batch_size >= PLAN_MIN_BATCH_SIZE;
+    BatchPlanScratch<Types>& plan = batch_plan_scratch<Types>();
+    if (planned) {
+        sort_batch_rows(batch_node_id, batch_node_time, batch_size, plan);
+    }
+    for (ShardBatch& shard : shard_batches) {
+        shard.nodes.clear();
+        shard.times.clear();
+        shard.rows.clear();
+    }
+    for (size_t i = 0; i < batch_size; ++i) {
+        size_t b = planned ? plan.order[i] : i;
+        NodeType node = batch_node_id[b];
+        if (node < 0 || static_cast<uint64_t>(node) >= manifest.num_nodes) {
+            size_t row = b * static_cast<size_t>(sample_num);
+            batch_counts[b] = 0;
+            pad_row(static_cast<EdgeType>(0), sample_num, batch_neighbors + row, batch_neighbor_times + row, batch_neighbor_idx + row);
+            continue;
+        }
+        ShardBatch& shard = shard_batches[manifest.shard_of(static_cast<uint64_t>(node))];
+        shard.nodes.push_back(node);
+        shard.times.push_back(batch_node_time[b]);
+        shard.rows.push_back(b);
+    }
+
+    // Send every request before reading any reply
+    bool ok = true;
+    uint64_t sent = 0;
+    for (size_t s = 0; s < num_shards && ok; ++s) {
+        ShardBatch& shard = shard_batches[s];
+        if (shard.rows.empty()) {
+            continue;
+        }
+        ShardRequest request = {SHARD_PROTOCOL_MAGIC, SHARD_OP_SAMPLE, shard.rows.size(), batch_id, random_seed,
+                                static_cast<int64_t>(sample_num), static_cast<int32_t>(sample_strategy), 0,
+                                sample_params.time_window, sample_params.decay_rate};
+        ok = send_all(sockets[s], &request, sizeof(request)) && send_vector(sockets[s], shard.nodes, shard.rows.size()) &&
+             send_vector(sockets[s], shard.times, shard.rows.size()) && send_vector(sockets[s], shard.rows, shard.rows.size());
+        sent += sizeof(request) + shard.rows.size() * (sizeof(NodeType) + sizeof(TimeType) + sizeof(uint64_t));
+    }
+
+    uint64_t received = 0;
+    for (size_t s = 0; s < num_shards && ok; ++s) {
+        ShardBatch& shard = shard_batches[s];
+        size_t num_rows = shard.rows.size();
+        if (num_rows == 0) {
+            continue;
+        }
+        size_t slots = num_rows * static_cast<size_t>(sample_num);
+        ShardReply reply;
+        SampleBuffers<Types>& samples = shard.reply;
+        ok = recv_all(sockets[s], &reply, sizeof(reply)) && reply.magic == SHARD_PROTOCOL_MAGIC && reply.status == 0 &&
+             reply.rows == num_rows && recv_vector(sockets[s], samples.counts, num_rows) &&
+             recv_vector(sockets[s], samples.neighbors, slots) && recv_vector(sockets[s], samples.neighbor_times, slots) &&
+             recv_vector(sockets[s], samples.neighbor_idx, slots);
+        received += sizeof(reply) + num_rows * sizeof(EdgeType) + slots * (sizeof(NodeType) + sizeof(TimeType) + sizeof(EdgeType));
+        if (!ok) {
+            cerr << "Shard " << s << " failed to answer a sampling request" << endl;
+            break;
+        }
+
+        // Scatter the shard's rows back to their places in the batch
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < num_rows; ++i) {
+            size_t from = i * static_cast<size_t>(sample_num);
+            size_t to = static_cast<size_t>(shard.rows[i]) * static_cast<size_t>(sample_num);
+            batch_counts[shard.rows[i]] = samples.counts[i];
+            copy(samples.neighbors.begin() + from, samples.neighbors.begin() + from + sample_num, batch_neighbors + to);
+            copy(samples.neighbor_times.begin() + from, samples.neighbor_times.begin() + from + sample_num, batch_neighbor_times + to);
+            copy(samples.neighbor_idx.begin() + from, samples.neighbor_idx.begin() + from + sample_num, batch_neighbor_idx + to);
+        }
+        rows_per_shard[s].fetch_add(num_rows, memory_order_relaxed);
+    }
+    if (!ok) {
+        // A connection in an unknown state cannot serve further requests
+        disconnect();
+        return -1;
+    }
+
+    batches.fetch_add(1, memory_order_relaxed);
+    rows.fetch_add(batch_size, memory_order_relaxed);
+    bytes_sent.fetch_add(sent, memory_order_relaxed);
+    bytes_received.fetch_add(received, memory_order_relaxed);
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+double ShardedSamplerT<Types>::sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                                        SampleBuffers<Types>& buffers, EdgeType sample_num, const string& sample_strategy) {
+    buffers.resize(batch_node_id.size(), sample_num);
+    return sampling_into(batch_node_id.data(), batch_node_time.data(), batch_node_id.size(),
+                         buffers.neighbors.data(), buffers.neighbor_times.data(), buffers.neighbor_idx.data(),
+                         buffers.counts.data(), sample_num, parse_sample_strategy(sample_strategy));
+}
+
+template <typename Types>
+ShardedStats ShardedSamplerT<Types>::stats() const {
+    ShardedStats result;
+    result.batches = batches.load(memory_order_relaxed);
+    result.rows = rows.load(memory_order_relaxed);
+    result.bytes_sent = bytes_sent.load(memory_order_relaxed);
+    result.bytes_received = bytes_received.load(memory_order_relaxed);
+    for (const atomic<uint64_t>& count : rows_per_shard) {
+        result.rows_per_shard.push_back(count.load(memory_order_relaxed));
+    }
+    return result;
+}
+
+template <typename Types>
+void ShardedSamplerT<Types>::reset_stats() {
+    batches.store(0);
+    rows.store(0);
+    bytes_sent.store(0);
+    bytes_received.store(0);
+    for (atomic<uint64_t>& count : rows_per_shard) {
+        count.store(0);
+    }
+}
+
+template bool partition_temporal_graph<TGNGraphTypes>(const TemporalGraphT<TGNGraphTypes>&, const string&, size_t, ShardMode);
+template bool partition_temporal_graph<TGLGraphTypes>(const TemporalGraphT<TGLGraphTypes>&, const string&, size_t, ShardMode);
+template class ShardSourceT<TGNGraphTypes>;
+template class ShardSourceT<TGLGraphTypes>;
+template class ShardedSamplerT<TGNGraphTypes>;
+template class ShardedSamplerT<TGLGraphTypes>;
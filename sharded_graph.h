@@ -0,0 +1,254 @@
+// sharded_graph.h - Node-partitioned T-CSR shards served by separate processes
+#ifndef SHARDED_GRAPH_H
+#define SHARDED_GRAPH_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <sys/types.h>
+#include "utils.h"
+#include "csr_snapshot.h"
+#include "sampler_kernels.h"
+#include "TemporalGraph.h"
+
+using namespace std;
+
+/*
+How the node ids are split into shards:
+  "range"  - one contiguous range per shard, balanced by edge count (the ranges of the NUMA
+             partition mode), so a batch of nearby ids stays on few shards
+  "modulo" - node v goes to shard v mod num_shards, which spreads the hubs of any id range
+Shard s holds the adjacency of its nodes only; its local node i is the global node
+first_node + i * stride (stride 1 for range, num_shards for modulo).
+*/
+enum ShardMode {
+    SHARD_RANGE,
+    SHARD_MODULO
+};
+
+bool parse_shard_mode(const string& name, ShardMode& mode);
+const char* shard_mode_name(ShardMode mode);
+
+/*
+Text manifest of a partitioned graph, next to its files:
+  tgshards 1
+  mode range|modulo
+  nodes <num_nodes>
+  edges <num_edges>
+  reverse 0|1
+  widths <node_width> <edge_width> <time_width> <float_time>
+  degrees <file>
+  shard <index> <first_node> <local_nodes> <edges> <file>    (one line per shard)
+Every shard file is a binary T-CSR snapshot over the shard's local node ids whose indices keep the
+global neighbor ids; the degrees file holds the global degree of every node (num_nodes EdgeType
+entries), which the degree-weighted strategies need for neighbors owned by other shards.
+*/
+struct ShardInfo {
+    uint64_t first_node;
+    uint64_t local_nodes;
+    uint64_t num_edges;
+    string file;
+};
+
+struct ShardManifest {
+    ShardMode mode;
+    uint64_t num_nodes;
+    uint64_t num_edges;
+    bool reverse;
+    uint32_t node_width;
+    uint32_t edge_width;
+    uint32_t time_width;
+    bool float_time;
+    string degrees_file;
+    vector<ShardInfo> shards;
+
+    size_t num_shards() const { return shards.size(); }
+    uint64_t stride() const { return mode == SHARD_MODULO ? shards.size() : 1; }
+    // Shard owning node, for node < num_nodes
+    size_t shard_of(uint64_t node) const;
+};
+
+// File paths of the manifest are resolved relative to its directory
+bool read_shard_manifest(const string& manifest_path, ShardManifest& manifest);
+bool write_shard_manifest(const string& manifest_path, const ShardManifest& manifest);
+string shard_file_path(const string& manifest_path, const string& file);
+
+template <typename Types>
+inline bool shard_manifest_matches(const ShardManifest& manifest) {
+    return manifest.node_width == sizeof(typename Types::NodeType) && manifest.edge_width == sizeof(typename Types::EdgeType) &&
+           manifest.time_width == sizeof(typename Types::TimeType) && manifest.float_time == is_floating_point<typename Types::TimeType>::value;
+}
+
+/*
+Split the T-CSR of graph (converted in memory or a mapped snapshot) into num_shards shard
+snapshots, a degrees file and a manifest at manifest_path; shard files are named after the
+manifest (<manifest>.shard<s>, <manifest>.degrees). Every shard is streamed to disk node by node,
+so a mapped input is partitioned without loading it.
+*/
+template <typename Types>
+bool partition_temporal_graph(const TemporalGraphT<Types>& graph, const string& manifest_path, size_t num_shards, ShardMode mode);
+
+/*
+One shard as a neighbor source over global node ids (see sampler_kernels.h): slices come from the
+shard's snapshot and degrees from the global degrees file. Only nodes the shard owns may be
+sampled.
+*/
+template <typename Types>
+class ShardSourceT {
+public:
+    typedef Types TypeConfig;
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+private:
+    TemporalGraphT<Types> graph;
+    MappedFile degrees_file;
+    const EdgeType* degrees;
+    uint64_t num_nodes;
+    uint64_t first_node;
+    uint64_t stride;
+
+    ShardSourceT(const ShardSourceT&) = delete;
+    ShardSourceT& operator=(const ShardSourceT&) = delete;
+
+public:
+    ShardSourceT();
+
+    bool open(const string& manifest_path, const ShardManifest& manifest, size_t shard, bool verify_checksums = false);
+
+    size_t local_nodes() const { return graph.get_num_nodes(); }
+    size_t local_edges() const { return graph.get_num_edges(); }
+    // Whether the shard owns node
+    bool owns(NodeType node) const;
+
+    NeighborSlice<Types> neighbor_slice(NodeType node) const {
+        return graph.neighbor_slice(static_cast<NodeType>((static_cast<uint64_t>(node) - first_node) / stride));
+    }
+    EdgeType degree(NodeType node) const { return degrees[node]; }
+};
+
+/*
+Run shard s of the manifest as a server on a Unix socket at socket_path: load the shard, then
+answer the requests of one ShardedSamplerT connection after another until one asks it to shut
+down. Dispatches on the type configuration of the manifest. Returns the process exit status.
+*/
+int serve_shard(const string& manifest_path, size_t shard, const string& socket_path);
+
+/*
+Shard servers as local child processes, for running a sharded graph on one machine. Each child
+runs `executable serve-shard <manifest> <shard> <socket>` (tgtool and benchmark both implement
+the command; the default executable is the running binary). Children are started with fork and
+exec, never by forking the OpenMP runtime of the parent.
+*/
+class LocalShardProcesses {
+private:
+    vector<pid_t> pids;
+    vector<string> socket_paths;
+
+    LocalShardProcesses(const LocalShardProcesses&) = delete;
+    LocalShardProcesses& operator=(const LocalShardProcesses&) = delete;
+
+public:
+    LocalShardProcesses();
+    ~LocalShardProcesses();
+
+    // Start one server per shard with its socket in socket_dir, each with threads_per_shard OpenMP
+    // threads (0: the default), and wait until all accept connections
+    bool launch(const string& manifest_path, const string& socket_dir, size_t threads_per_shard = 0,
+                const string& executable = "/proc/self/exe");
+    // Wait for the servers to exit (after ShardedSamplerT::shutdown) and kill any that do not
+    void stop();
+
+    const vector<string>& get_socket_paths() const { return socket_paths; }
+};
+
+// Rows and traffic since the last reset
+struct ShardedStats {
+    uint64_t batches;
+    uint64_t rows;
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    vector<uint64_t> rows_per_shard;
+};
+
+/*
+Sampling front-end of a partitioned graph. Every batch is split by owning shard, each shard's
+rows go to its server in one request (all requests are sent before any reply is read, so the
+shards sample concurrently), and the replies are scattered back to the rows' positions in the
+flat output layout of TemporalGraphT::sampling_into. Requests carry every row's index in the
+batch, and rows draw from the same streams as TemporalGraphT::sampling, so with the same seed and
+sequence of calls the samples are identical to sampling the whole graph. Large batches are sorted
+by (node, time) before they are split, so every server reads its adjacency in order.
+
+Rows of roots outside [0, num_nodes) come back empty. One sampler serves one sampling call at a
+time.
+*/
+template <typename Types>
+class ShardedSamplerT {
+public:
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+private:
+    // Rows of one batch routed to a shard: the request (roots and their rows in the batch) and
+    // the shard's reply
+    struct ShardBatch {
+        vector<NodeType> nodes;
+        vector<TimeType> times;
+        vector<uint64_t> rows;
+        SampleBuffers<Types> reply;
+    };
+
+    ShardManifest manifest;
+    vector<int> sockets;
+
+    uint64_t random_seed;
+    atomic<uint64_t> batch_counter;
+    SampleParams sample_params;
+
+    vector<ShardBatch> shard_batches;
+
+    atomic<uint64_t> batches;
+    atomic<uint64_t> rows;
+    atomic<uint64_t> bytes_sent;
+    atomic<uint64_t> bytes_received;
+    vector<atomic<uint64_t>> rows_per_shard;
+
+    ShardedSamplerT(const ShardedSamplerT&) = delete;
+    ShardedSamplerT& operator=(const ShardedSamplerT&) = delete;
+
+public:
+    ShardedSamplerT();
+    ~ShardedSamplerT();
+
+    // Read the manifest and connect to one server per shard, in shard order
+    bool connect(const string& manifest_path, const vector<string>& socket_paths);
+    void disconnect();
+    // Ask every server to exit, then disconnect
+    void shutdown();
+
+    const ShardManifest& get_manifest() const { return manifest; }
+    size_t num_shards() const { return manifest.num_shards(); }
+
+    void set_random_seed(uint64_t seed);
+    void set_sample_params(const SampleParams& params);
+
+    // Same semantics as the TemporalGraphT functions of the same names; a negative result means a
+    // shard failed
+    double sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                         NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                         EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                         EdgeType sample_num, SampleStrategy sample_strategy);
+    double sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                    SampleBuffers<Types>& buffers, EdgeType sample_num = 32, const string& sample_strategy = "recent");
+
+    ShardedStats stats() const;
+    void reset_stats();
+};
+
+typedef ShardedSamplerT<TGNGraphTypes> ShardedSampler;
+
+#endif // SHARDED_GRAPH_H
@@ -0,0 +1,231 @@
+// simd_kernels.cpp - AVX2 and AVX-512 versions of the search and gather kernels
+#include "simd_kernels.h"
+#include <immintrin.h>
+
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#define TARGET_AVX512 __attribute__((target("avx512f,popcnt")))
+
+SimdLevel detected_simd_level() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    return SIMD_SCALAR;
+}
+
+// Level of the dispatched kernels; change it only while no sampling is running
+static SimdLevel simd_level = detected_simd_level();
+
+SimdLevel get_simd_level() {
+    return simd_level;
+}
+
+SimdLevel set_simd_level(SimdLevel level) {
+    SimdLevel detected = detected_simd_level();
+    simd_level = level < detected ? level : detected;
+    return simd_level;
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX512:
+            return "avx512";
+        case SIMD_AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+bool parse_simd_level(const string& name, SimdLevel& level) {
+    if (name == "scalar") {
+        level = SIMD_SCALAR;
+    } else if (name == "avx2") {
+        level = SIMD_AVX2;
+    } else if (name == "avx512") {
+        level = SIMD_AVX512;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Compare and popcount
+
+template <typename T>
+static size_t count_less_scalar(const T* values, size_t n, T time) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += values[i] < time;
+    }
+    return count;
+}
+
+TARGET_AVX2 static size_t count_less_avx2(const float* values, size_t n, float time) {
+    __m256 key = _mm256_set1_ps(time);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 less = _mm256_cmp_ps(_mm256_loadu_ps(values + i), key, _CMP_LT_OQ);
+        count += __builtin_popcount(_mm256_movemask_ps(less));
+    }
+    for (; i < n; ++i) {
+        count += values[i] < time;
+    }
+    return count;
+}
+
+TARGET_AVX2 static size_t count_less_avx2(const double* values, size_t n, double time) {
+    __m256d key = _mm256_set1_pd(time);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d less = _mm256_cmp_pd(_mm256_loadu_pd(values + i), key, _CMP_LT_OQ);
+        count += __builtin_popcount(_mm256_movemask_pd(less));
+    }
+    for (; i < n; ++i) {
+        count += values[i] < time;
+    }
+    return count;
+}
+
+// The tail is a masked load, which does not touch memory past values + n
+TARGET_AVX512 static size_t count_less_avx512(const float* values, size_t n, float time) {
+    __m512 key = _mm512_set1_ps(time);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        count += __builtin_popcount(_mm512_cmp_ps_mask(_mm512_loadu_ps(values + i), key, _CMP_LT_OQ));
+    }
+    if (i < n) {
+        __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+        count += __builtin_popcount(_mm512_mask_cmp_ps_mask(tail, _mm512_maskz_loadu_ps(tail, values + i), key, _CMP_LT_OQ));
+    }
+    return count;
+}
+
+TARGET_AVX512 static size_t count_less_avx512(const double* values, size_t n, double time) {
+    __m512d key = _mm512_set1_pd(time);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        count += __builtin_popcount(_mm512_cmp_pd_mask(_mm512_loadu_pd(values + i), key, _CMP_LT_OQ));
+    }
+    if (i < n) {
+        __mmask8 tail = static_cast<__mmask8>((1u << (n - i)) - 1);
+        count += __builtin_popcount(_mm512_mask_cmp_pd_mask(tail, _mm512_maskz_loadu_pd(tail, values + i), key, _CMP_LT_OQ));
+    }
+    return count;
+}
+
+size_t simd_count_less(const float* values, size_t n, float time) {
+    switch (simd_level) {
+        case SIMD_AVX512:
+            return count_less_avx512(values, n, time);
+        case SIMD_AVX2:
+            return count_less_avx2(values, n, time);
+        default:
+            return count_less_scalar(values, n, time);
+    }
+}
+
+size_t simd_count_less(const double* values, size_t n, double time) {
+    switch (simd_level) {
+        case SIMD_AVX512:
+            return count_less_avx512(values, n, time);
+        case SIMD_AVX2:
+            return count_less_avx2(values, n, time);
+        default:
+            return count_less_scalar(values, n, time);
+    }
+}
+
+// Gather. Every vector of positions is loaded before the gathered entries are stored over it,
+// so dst may alias positions.
+
+template <typename T, typename Position>
+static void gather_scalar(const T* src, const Position* positions, size_t n, T* dst) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = src[positions[i]];
+    }
+}
+
+TARGET_AVX2 static void gather32_avx2(const int32_t* src, const int32_t* positions, size_t n, int32_t* dst) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(positions + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_i32gather_epi32(src, index, 4));
+    }
+    gather_scalar(src, positions + i, n - i, dst + i);
+}
+
+TARGET_AVX2 static void gather64_avx2(const int64_t* src, const int64_t* positions, size_t n, int64_t* dst) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(positions + i));
+        __m256i gathered = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(src), index, 8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), gathered);
+    }
+    gather_scalar(src, positions + i, n - i, dst + i);
+}
+
+TARGET_AVX512 static void gather32_avx512(const int32_t* src, const int32_t* positions, size_t n, int32_t* dst) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i index = _mm512_loadu_si512(positions + i);
+        _mm512_storeu_si512(dst + i, _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, index, src, 4));
+    }
+    if (i < n) {
+        __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+        __m512i index = _mm512_maskz_loadu_epi32(tail, positions + i);
+        __m512i gathered = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), tail, index, src, 4);
+        _mm512_mask_storeu_epi32(dst + i, tail, gathered);
+    }
+}
+
+TARGET_AVX512 static void gather64_avx512(const int64_t* src, const int64_t* positions, size_t n, int64_t* dst) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i index = _mm512_loadu_si512(positions + i);
+        _mm512_storeu_si512(dst + i, _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xFF, index, src, 8));
+    }
+    if (i < n) {
+        __mmask8 tail = static_cast<__mmask8>((1u << (n - i)) - 1);
+        __m512i index = _mm512_maskz_loadu_epi64(tail, positions + i);
+        __m512i gathered = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), tail, index, src, 8);
+        _mm512_mask_storeu_epi64(dst + i, tail, gathered);
+    }
+}
+
+void simd_gather32(const void* src, const int32_t* positions, size_t n, void* dst) {
+    const int32_t* from = static_cast<const int32_t*>(src);
+    int32_t* to = static_cast<int32_t*>(dst);
+    switch (simd_level) {
+        case SIMD_AVX512:
+            gather32_avx512(from, positions, n, to);
+            break;
+        case SIMD_AVX2:
+            gather32_avx2(from, positions, n, to);
+            break;
+        default:
+            gather_scalar(from, positions, n, to);
+    }
+}
+
+void simd_gather64(const void* src, const int64_t* positions, size_t n, void* dst) {
+    const int64_t* from = static_cast<const int64_t*>(src);
+    int64_t* to = static_cast<int64_t*>(dst);
+    switch (simd_level) {
+        case SIMD_AVX512:
+            gather64_avx512(from, positions, n, to);
+            break;
+        case SIMD_AVX2:
+            gather64_avx2(from, positions, n, to);
+            break;
+        default:
+            gather_scalar(from, positions, n, to);
+    }
+}
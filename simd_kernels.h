@@ -0,0 +1,100 @@
+// simd_kernels.h - Vectorized time search and gather kernels with runtime CPU dispatch
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+/*
+Instruction sets of the kernels below. The kernels are compiled for every level with function
+target attributes, so the binary needs no -m flags, and the best level the CPU supports is picked
+at startup. set_simd_level lowers it (e.g. to compare against the scalar kernels).
+*/
+enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+SimdLevel detected_simd_level();
+SimdLevel get_simd_level();
+// Use level, or the best supported level below it; returns the level in use
+SimdLevel set_simd_level(SimdLevel level);
+const char* simd_level_name(SimdLevel level);
+bool parse_simd_level(const string& name, SimdLevel& level);
+
+// Number of values[i] < time for i < n
+size_t simd_count_less(const float* values, size_t n, float time);
+size_t simd_count_less(const double* values, size_t n, double time);
+
+template <typename T>
+inline size_t simd_count_less(const T* values, size_t n, T time) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += values[i] < time;
+    }
+    return count;
+}
+
+// Searches stop halving at this many elements and count the rest with one compare-and-popcount
+const int SIMD_SEARCH_BLOCK = 32;
+
+/*
+Number of elements of the sorted values that are < time (std::lower_bound). The halving steps
+are branchless, since the outcome of every comparison is unpredictable, with both candidate
+probes of the next step prefetched (the loads a predicted branch would issue speculatively), and
+the last block is counted with vector compares instead of finishing the search one element at a
+time.
+*/
+template <typename T, typename Size>
+inline Size simd_lower_bound(const T* values, Size n, T time) {
+    const T* base = values;
+    while (n > SIMD_SEARCH_BLOCK) {
+        Size half = n / 2;
+        // Both possible probes of the next step, so the dependent loads overlap
+        __builtin_prefetch(base + (n - half) / 2);
+        __builtin_prefetch(base + half + (n - half) / 2);
+        base = base[half] < time ? base + half : base;
+        n -= half;
+    }
+    return static_cast<Size>(base - values) + static_cast<Size>(simd_count_less(base, static_cast<size_t>(n), time));
+}
+
+// Number of elements of the sorted values[0, n) that are < time, when the first begin of them
+// are known to be. Gallops from begin, so nearby answers (e.g. for increasing times) are cheap.
+template <typename T, typename Size>
+inline Size gallop_lower_bound(const T* values, Size begin, Size n, T time) {
+    Size bound = begin;
+    Size step = 1;
+    while (bound < n && values[bound] < time) {
+        begin = bound + 1;
+        bound += step;
+        step *= 2;
+    }
+    return begin + simd_lower_bound(values + begin, min(bound, n) - begin, time);
+}
+
+// dst[i] = src[positions[i]] for i < n, for 4-byte entries with 4-byte positions and 8-byte
+// entries with 8-byte positions. dst may be positions itself.
+void simd_gather32(const void* src, const int32_t* positions, size_t n, void* dst);
+void simd_gather64(const void* src, const int64_t* positions, size_t n, void* dst);
+
+template <typename T, typename Position>
+inline void simd_gather(const T* src, const Position* positions, size_t n, T* dst) {
+    bool vectorized = get_simd_level() != SIMD_SCALAR;
+    if (vectorized && sizeof(T) == 4 && sizeof(Position) == 4) {
+        simd_gather32(src, reinterpret_cast<const int32_t*>(positions), n, dst);
+    } else if (vectorized && sizeof(T) == 8 && sizeof(Position) == 8) {
+        simd_gather64(src, reinterpret_cast<const int64_t*>(positions), n, dst);
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            dst[i] = src[positions[i]];
+        }
+    }
+}
+
+#endif // SIMD_KERNELS_H
@@ -0,0 +1,306 @@
+// streaming_graph.cpp - Incremental T-CSR updates for continuously arriving edges
+#include "streaming_graph.h"
+#include <omp.h>
+#include "parallel_scan.h"
+
+// Smallest capacity of a new append buffer
+static const size_t MIN_BUFFER_CAPACITY = 16;
+
+template <typename Types>
+NodeAppendBuffer<Types>::NodeAppendBuffer(size_t capacity)
+    : capacity(capacity), size(0), indices(new typename Types::NodeType[capacity]),
+      time_values(new typename Types::TimeType[capacity]), idx_values(new typename Types::EdgeType[capacity]) {
+}
+
+template <typename Types>
+TemporalGraphSnapshotT<Types>::TemporalGraphSnapshotT(const shared_ptr<const TemporalGraphT<Types>>& base,
+                                                      const SampleParams& sample_params, uint64_t random_seed,
+                                                      const shared_ptr<atomic<uint64_t>>& batch_counter)
+    : base(base), overlay(), overlaid(), num_nodes(static_cast<NodeType>(base->get_num_nodes())), num_edges(base->get_num_edges()),
+      sample_params(sample_params), random_seed(random_seed), batch_counter(batch_counter) {
+}
+
+template <typename Types>
+NeighborSlice<Types> TemporalGraphSnapshotT<Types>::neighbor_slice(NodeType node) const {
+    // Nodes past the flags are new since the base and always looked up
+    size_t index = static_cast<size_t>(node);
+    if (overlay && node >= 0 && (index >= overlaid->size() || (*overlaid)[index].load(memory_order_relaxed))) {
+        for (const OverlayDelta<Types>* delta = overlay.get(); delta != nullptr; delta = delta->parent.get()) {
+            auto it = delta->entries.find(node);
+            if (it != delta->entries.end()) {
+                const NodeAppendBuffer<Types>& buffer = *it->second.buffer;
+                NeighborSlice<Types> slice = {buffer.indices.get(), buffer.time_values.get(), buffer.idx_values.get(), it->second.length,
+                                              nullptr, nullptr, 0};
+                return slice;
+            }
+        }
+    }
+    // Ids outside the base have an empty slice there
+    return base->neighbor_slice(node);
+}
+
+template <typename Types>
+typename TemporalGraphSnapshotT<Types>::EdgeType TemporalGraphSnapshotT<Types>::degree(NodeType node) const {
+    return neighbor_slice(node).length;
+}
+
+template <typename Types>
+double TemporalGraphSnapshotT<Types>::sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                                                    NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                                                    EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                                                    EdgeType sample_num, SampleStrategy sample_strategy) const {
+    double start_time = omp_get_wtime();
+    uint64_t batch_id = batch_counter->fetch_add(1);
+    sample_batch(sample_strategy, *this, batch_node_id, batch_node_time, batch_size, sample_num, sample_params, random_seed,
+                 batch_id, batch_neighbors, batch_neighbor_times, batch_neighbor_idx, batch_counts);
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+double TemporalGraphSnapshotT<Types>::sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                                               SampleBuffers<Types>& buffers, EdgeType sample_num, const string& sample_strategy) const {
+    buffers.resize(batch_node_id.size(), sample_num);
+    return sampling_into(batch_node_id.data(), batch_node_time.data(), batch_node_id.size(),
+                         buffers.neighbors.data(), buffers.neighbor_times.data(), buffers.neighbor_idx.data(),
+                         buffers.counts.data(), sample_num, parse_sample_strategy(sample_strategy));
+}
+
+template <typename Types>
+StreamingTemporalGraphT<Types>::StreamingTemporalGraphT(const shared_ptr<const TemporalGraphT<Types>>& base, double compaction_ratio)
+    : base(base), reverse(base->is_reverse()), buffers(), overlay(), unpublished(),
+      overlaid(make_shared<vector<atomic<uint8_t>>>(base->get_num_nodes())), num_nodes(static_cast<NodeType>(base->get_num_nodes())),
+      pending_edges(0), compaction_ratio(compaction_ratio), sample_params(), random_seed(DEFAULT_RANDOM_SEED),
+      batch_counter(make_shared<atomic<uint64_t>>(0)), compacting(false), appended_while_compacting(), edges_while_compacting(0),
+      compaction_thread(), current() {
+    publish();
+}
+
+template <typename Types>
+StreamingTemporalGraphT<Types>::~StreamingTemporalGraphT() {
+    if (compaction_thread.joinable()) {
+        compaction_thread.join();
+    }
+}
+
+template <typename Types>
+void StreamingTemporalGraphT<Types>::set_sample_params(const SampleParams& params) {
+    lock_guard<mutex> lock(writer_mutex);
+    sample_params = params;
+    publish();
+}
+
+template <typename Types>
+void StreamingTemporalGraphT<Types>::set_random_seed(uint64_t seed) {
+    lock_guard<mutex> lock(writer_mutex);
+    random_seed = seed;
+    batch_counter = make_shared<atomic<uint64_t>>(0);
+    publish();
+}
+
+// Append one adjacency entry to node, moving the node to a larger (or first) buffer when needed
+template <typename Types>
+void StreamingTemporalGraphT<Types>::append_entry(NodeType node, NodeType neighbor, TimeType time, EdgeType idx) {
+    shared_ptr<NodeAppendBuffer<Types>>& buffer = buffers[node];
+    NeighborSlice<Types> old_slice = {nullptr, nullptr, nullptr, 0, nullptr, nullptr, 0};
+    if (buffer) {
+        NeighborSlice<Types> slice = {buffer->indices.get(), buffer->time_values.get(), buffer->idx_values.get(),
+                                      static_cast<EdgeType>(buffer->size), nullptr, nullptr, 0};
+        old_slice = slice;
+    } else if (static_cast<size_t>(node) < base->get_num_nodes()) {
+        old_slice = base->neighbor_slice(node);
+    }
+    bool in_order = old_slice.length == 0 || old_slice.time_values[old_slice.length - 1] <= time;
+
+    if (!buffer || buffer->size == buffer->capacity || !in_order) {
+        // Published entries must stay untouched, so grow (or reorder) into a new buffer
+        size_t capacity = max(MIN_BUFFER_CAPACITY, 2 * (static_cast<size_t>(old_slice.length) + 1));
+        shared_ptr<NodeAppendBuffer<Types>> grown = make_shared<NodeAppendBuffer<Types>>(capacity);
+        copy(old_slice.indices, old_slice.indices + old_slice.length, grown->indices.get());
+        copy(old_slice.time_values, old_slice.time_values + old_slice.length, grown->time_values.get());
+        copy(old_slice.idx_values, old_slice.idx_values + old_slice.length, grown->idx_values.get());
+        grown->size = old_slice.length;
+        buffer = grown;
+    }
+
+    // Insert after all entries with time <= time (the end, for in-order arrivals)
+    size_t pos = buffer->size;
+    if (!in_order) {
+        pos = upper_bound(buffer->time_values.get(), buffer->time_values.get() + buffer->size, time) - buffer->time_values.get();
+        copy_backward(buffer->indices.get() + pos, buffer->indices.get() + buffer->size, buffer->indices.get() + buffer->size + 1);
+        copy_backward(buffer->time_values.get() + pos, buffer->time_values.get() + buffer->size, buffer->time_values.get() + buffer->size + 1);
+        copy_backward(buffer->idx_values.get() + pos, buffer->idx_values.get() + buffer->size, buffer->idx_values.get() + buffer->size + 1);
+    }
+    buffer->indices[pos] = neighbor;
+    buffer->time_values[pos] = time;
+    buffer->idx_values[pos] = idx;
+    buffer->size++;
+
+    unpublished.insert(node);
+    if (compacting) {
+        appended_while_compacting.insert(node);
+    }
+    if (node >= 0 && static_cast<size_t>(node) < overlaid->size()) {
+        (*overlaid)[node].store(1, memory_order_relaxed);
+    }
+}
+
+// Make everything appended so far visible through a new snapshot. Only the nodes appended to since
+// the last publish are copied into a new overlay delta.
+template <typename Types>
+void StreamingTemporalGraphT<Types>::publish() {
+    if (!unpublished.empty()) {
+        shared_ptr<OverlayDelta<Types>> delta = make_shared<OverlayDelta<Types>>();
+        delta->entries.reserve(unpublished.size());
+        for (NodeType node : unpublished) {
+            const shared_ptr<NodeAppendBuffer<Types>>& buffer = buffers[node];
+            OverlayEntry<Types> entry = {buffer, static_cast<EdgeType>(buffer->size)};
+            delta->entries.emplace(node, entry);
+        }
+        unpublished.clear();
+        // Absorb parents up to twice the delta's size; insert keeps the newer entry of a node
+        shared_ptr<const OverlayDelta<Types>> parent = overlay;
+        while (parent && parent->entries.size() <= 2 * delta->entries.size()) {
+            delta->entries.insert(parent->entries.begin(), parent->entries.end());
+            parent = parent->parent;
+        }
+        delta->parent = parent;
+        overlay = delta;
+    }
+
+    shared_ptr<TemporalGraphSnapshotT<Types>> next = make_shared<TemporalGraphSnapshotT<Types>>(base, sample_params, random_seed, batch_counter);
+    next->overlay = overlay;
+    next->overlaid = overlaid;
+    next->num_nodes = num_nodes;
+    next->num_edges = base->get_num_edges() + pending_edges;
+    atomic_store(&current, shared_ptr<const TemporalGraphSnapshotT<Types>>(next));
+}
+
+template <typename Types>
+double StreamingTemporalGraphT<Types>::append_edges(const vector<EdgeType>& edge_idx, const vector<NodeType>& src_list,
+                                                    const vector<NodeType>& dst_list, const vector<TimeType>& time_list) {
+    double start_time = omp_get_wtime();
+    lock_guard<mutex> lock(writer_mutex);
+
+    for (size_t i = 0; i < src_list.size(); ++i) {
+        NodeType src = src_list[i];
+        NodeType dst = dst_list[i];
+        append_entry(src, dst, time_list[i], edge_idx[i]);
+        if (reverse) {
+            append_entry(dst, src, time_list[i], edge_idx[i]);
+        }
+        num_nodes = max(num_nodes, static_cast<NodeType>(max(src, dst) + 1));
+    }
+    size_t appended = reverse ? 2 * src_list.size() : src_list.size();
+    pending_edges += appended;
+    edges_while_compacting += compacting ? appended : 0;
+    publish();
+
+    if (!compacting && pending_edges > compaction_ratio * base->get_num_edges()) {
+        // The previous compaction has installed its base under this lock and only has to exit
+        if (compaction_thread.joinable()) {
+            compaction_thread.join();
+        }
+        shared_ptr<const TemporalGraphSnapshotT<Types>> view = begin_compaction();
+        compaction_thread = thread([this, view]() {
+            shared_ptr<const TemporalGraphT<Types>> merged = merge_snapshot(*view);
+            lock_guard<mutex> lock(writer_mutex);
+            install_base(merged);
+        });
+    }
+
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+double StreamingTemporalGraphT<Types>::compact() {
+    double start_time = omp_get_wtime();
+    unique_lock<mutex> lock(writer_mutex);
+    compaction_done.wait(lock, [this]() { return !compacting; });
+    shared_ptr<const TemporalGraphSnapshotT<Types>> view = begin_compaction();
+    install_base(merge_snapshot(*view));
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+template <typename Types>
+void StreamingTemporalGraphT<Types>::wait_for_compaction() {
+    unique_lock<mutex> lock(writer_mutex);
+    compaction_done.wait(lock, [this]() { return !compacting; });
+}
+
+template <typename Types>
+shared_ptr<const TemporalGraphSnapshotT<Types>> StreamingTemporalGraphT<Types>::begin_compaction() {
+    publish();
+    compacting = true;
+    appended_while_compacting.clear();
+    edges_while_compacting = 0;
+    return current;
+}
+
+// Build a new base T-CSR from a snapshot; touches no writer state, so it runs without the lock
+template <typename Types>
+shared_ptr<const TemporalGraphT<Types>> StreamingTemporalGraphT<Types>::merge_snapshot(const TemporalGraphSnapshotT<Types>& view) const {
+    NodeType num_nodes = view.get_num_nodes();
+    vector<EdgeType> indptr(num_nodes + 1, 0);
+    #pragma omp parallel for
+    for (NodeType v = 0; v < num_nodes; ++v) {
+        indptr[v + 1] = view.degree(v);
+    }
+    parallel_inclusive_scan(indptr.data() + 1, static_cast<size_t>(num_nodes));
+
+    size_t total_edges = indptr[num_nodes];
+    vector<EdgeType> idx_values(total_edges);
+    vector<TimeType> time_values(total_edges);
+    vector<NodeType> indices(total_edges);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (NodeType v = 0; v < num_nodes; ++v) {
+        NeighborSlice<Types> slice = view.neighbor_slice(v);
+        copy(slice.indices, slice.indices + slice.length, indices.begin() + indptr[v]);
+        copy(slice.time_values, slice.time_values + slice.length, time_values.begin() + indptr[v]);
+        copy(slice.idx_values, slice.idx_values + slice.length, idx_values.begin() + indptr[v]);
+    }
+
+    shared_ptr<TemporalGraphT<Types>> merged = make_shared<TemporalGraphT<Types>>(reverse);
+    merged->assign_csr(std::move(idx_values), std::move(time_values), std::move(indices), std::move(indptr), reverse);
+    merged->set_layout(view.base->get_layout());
+    return merged;
+}
+
+// Replace the base by a merged snapshot. Nodes appended to since the snapshot was taken hold their
+// whole adjacency in their buffers, so they stay overlaid; every other buffer is dropped.
+template <typename Types>
+void StreamingTemporalGraphT<Types>::install_base(const shared_ptr<const TemporalGraphT<Types>>& merged) {
+    base = merged;
+    for (auto it = buffers.begin(); it != buffers.end();) {
+        it = appended_while_compacting.count(it->first) ? next(it) : buffers.erase(it);
+    }
+    overlaid = make_shared<vector<atomic<uint8_t>>>(base->get_num_nodes());
+    overlay.reset();
+    unpublished.clear();
+    for (const auto& entry : buffers) {
+        unpublished.insert(entry.first);
+        if (static_cast<size_t>(entry.first) < overlaid->size()) {
+            (*overlaid)[entry.first].store(1, memory_order_relaxed);
+        }
+    }
+    pending_edges = edges_while_compacting;
+    compacting = false;
+    appended_while_compacting.clear();
+    edges_while_compacting = 0;
+    publish();
+    compaction_done.notify_all();
+}
+
+template <typename Types>
+shared_ptr<const TemporalGraphSnapshotT<Types>> StreamingTemporalGraphT<Types>::snapshot() const {
+    return atomic_load(&current);
+}
+
+template struct NodeAppendBuffer<TGNGraphTypes>;
+template struct NodeAppendBuffer<TGLGraphTypes>;
+template class TemporalGraphSnapshotT<TGNGraphTypes>;
+template class TemporalGraphSnapshotT<TGLGraphTypes>;
+template class StreamingTemporalGraphT<TGNGraphTypes>;
+template class StreamingTemporalGraphT<TGLGraphTypes>;
@@ -0,0 +1,178 @@
+// streaming_graph.h - Incremental T-CSR updates for continuously arriving edges
+#ifndef STREAMING_GRAPH_H
+#define STREAMING_GRAPH_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include "utils.h"
+#include "sampler_kernels.h"
+#include "TemporalGraph.h"
+
+using namespace std;
+
+/*
+Time-ordered adjacency of one node that received edges since the last compaction: a copy of its
+slice in the base T-CSR followed by the appended edges. Entries below a published length are
+never modified; the writer only appends behind them or moves the node to a new buffer, so readers
+of older snapshots keep reading the buffer they captured.
+*/
+template <typename Types>
+struct NodeAppendBuffer {
+    size_t capacity;
+    size_t size;
+    unique_ptr<typename Types::NodeType[]> indices;
+    unique_ptr<typename Types::TimeType[]> time_values;
+    unique_ptr<typename Types::EdgeType[]> idx_values;
+
+    explicit NodeAppendBuffer(size_t capacity);
+};
+
+// Visible prefix of one node's append buffer
+template <typename Types>
+struct OverlayEntry {
+    shared_ptr<const NodeAppendBuffer<Types>> buffer;
+    typename Types::EdgeType length;
+};
+
+/*
+Immutable set of overlay entries shared by consecutive snapshots: the nodes appended to by one
+publish, over the delta of the earlier publishes. A node's newest entry wins. A publish merges its
+delta with parents no more than twice its size, so the chain stays logarithmic in the number of
+overlaid nodes and every entry is copied a logarithmic number of times.
+*/
+template <typename Types>
+struct OverlayDelta {
+    unordered_map<typename Types::NodeType, OverlayEntry<Types>> entries;
+    shared_ptr<const OverlayDelta> parent;
+};
+
+// Immutable view of the graph at one point of the stream: the base T-CSR plus the visible prefix of
+// every append buffer. Any number of threads may sample a snapshot while the writer moves on.
+template <typename Types>
+class TemporalGraphSnapshotT {
+public:
+    typedef Types TypeConfig;
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+private:
+    shared_ptr<const TemporalGraphT<Types>> base;
+    shared_ptr<const OverlayDelta<Types>> overlay;
+    // One flag per base node, set once the node has an append buffer over this base; nodes without
+    // it skip the overlay. The writer only sets flags, so a newer flag just costs a lookup.
+    shared_ptr<const vector<atomic<uint8_t>>> overlaid;
+    NodeType num_nodes;
+    size_t num_edges;
+    SampleParams sample_params;
+    uint64_t random_seed;
+    // Shared with the streaming graph and its other snapshots, so batch ids continue across snapshots
+    shared_ptr<atomic<uint64_t>> batch_counter;
+
+    template <typename> friend class StreamingTemporalGraphT;
+
+public:
+    TemporalGraphSnapshotT(const shared_ptr<const TemporalGraphT<Types>>& base, const SampleParams& sample_params, uint64_t random_seed,
+                           const shared_ptr<atomic<uint64_t>>& batch_counter);
+
+    NodeType get_num_nodes() const { return num_nodes; }
+    size_t get_num_edges() const { return num_edges; }
+
+    // Neighbor source interface of the sampler kernels (see sampler_kernels.h)
+    NeighborSlice<Types> neighbor_slice(NodeType node) const;
+    EdgeType degree(NodeType node) const;
+
+    // Same layout and semantics as TemporalGraphT::sampling_into / sampling. Batch ids come from the
+    // streaming graph, so sampling successive snapshots continues one stream of batches.
+    double sampling_into(const NodeType* batch_node_id, const TimeType* batch_node_time, size_t batch_size,
+                         NodeType* batch_neighbors, TimeType* batch_neighbor_times,
+                         EdgeType* batch_neighbor_idx, EdgeType* batch_counts,
+                         EdgeType sample_num, SampleStrategy sample_strategy) const;
+    double sampling(const vector<NodeType>& batch_node_id, const vector<TimeType>& batch_node_time,
+                    SampleBuffers<Types>& buffers, EdgeType sample_num = 32, const string& sample_strategy = "recent") const;
+};
+
+/*
+Single-writer incremental T-CSR. Appended edge batches go to per-node append buffers and become
+visible through a new snapshot as soon as append_edges returns; readers take snapshot() and
+sample it without locks. When the appended edges exceed compaction_ratio times the base edges,
+a background thread merges the latest snapshot into a fresh T-CSR while appends continue; nodes
+appended to meanwhile keep their buffers over the new base. Readers are never disturbed.
+*/
+template <typename Types>
+class StreamingTemporalGraphT {
+public:
+    typedef typename Types::NodeType NodeType;
+    typedef typename Types::EdgeType EdgeType;
+    typedef typename Types::TimeType TimeType;
+
+private:
+    shared_ptr<const TemporalGraphT<Types>> base;
+    bool reverse;
+    unordered_map<NodeType, shared_ptr<NodeAppendBuffer<Types>>> buffers;
+    // Overlay of the last publish, nodes appended to since, and the flags of base nodes with buffers
+    shared_ptr<const OverlayDelta<Types>> overlay;
+    unordered_set<NodeType> unpublished;
+    shared_ptr<vector<atomic<uint8_t>>> overlaid;
+    NodeType num_nodes;
+    size_t pending_edges;
+    double compaction_ratio;
+    SampleParams sample_params;
+    uint64_t random_seed;
+    shared_ptr<atomic<uint64_t>> batch_counter;
+
+    // Background compaction: nodes and entries appended since it took its snapshot
+    bool compacting;
+    unordered_set<NodeType> appended_while_compacting;
+    size_t edges_while_compacting;
+    thread compaction_thread;
+    condition_variable compaction_done;
+
+    shared_ptr<const TemporalGraphSnapshotT<Types>> current;
+    mutex writer_mutex;
+
+    void append_entry(NodeType node, NodeType neighbor, TimeType time, EdgeType idx);
+    void publish();
+    // Publish and take the snapshot to merge; the caller holds writer_mutex
+    shared_ptr<const TemporalGraphSnapshotT<Types>> begin_compaction();
+    shared_ptr<const TemporalGraphT<Types>> merge_snapshot(const TemporalGraphSnapshotT<Types>& view) const;
+    void install_base(const shared_ptr<const TemporalGraphT<Types>>& merged);
+
+    StreamingTemporalGraphT(const StreamingTemporalGraphT&) = delete;
+    StreamingTemporalGraphT& operator=(const StreamingTemporalGraphT&) = delete;
+
+public:
+    // base must already be converted with to_csr() (or loaded); its reverse flag is kept
+    StreamingTemporalGraphT(const shared_ptr<const TemporalGraphT<Types>>& base, double compaction_ratio = 0.1);
+    // Waits for a running compaction
+    ~StreamingTemporalGraphT();
+
+    void set_sample_params(const SampleParams& params);
+    // Also restarts the batch ids of later sampling calls at 0
+    void set_random_seed(uint64_t seed);
+
+    // Append a batch of edges; edges should arrive in time order, late edges are inserted at their
+    // time position at the cost of copying the node's buffer. May start a background compaction.
+    // Returns the elapsed time in seconds.
+    double append_edges(const vector<EdgeType>& edge_idx, const vector<NodeType>& src_list,
+                        const vector<NodeType>& dst_list, const vector<TimeType>& time_list);
+    // Merge all append buffers into a new base T-CSR now, after any running compaction. Returns the
+    // elapsed time in seconds.
+    double compact();
+    // Block until a running background compaction has installed its base
+    void wait_for_compaction();
+
+    shared_ptr<const TemporalGraphSnapshotT<Types>> snapshot() const;
+    size_t get_pending_edges() const { return pending_edges; }
+};
+
+typedef TemporalGraphSnapshotT<TGNGraphTypes> TemporalGraphSnapshot;
+typedef StreamingTemporalGraphT<TGNGraphTypes> StreamingTemporalGraph;
+
+#endif // STREAMING_GRAPH_H
@@ -0,0 +1,270 @@
+// tgtool.cpp - Command line tools for temporal graph datasets
+// g++ -O3 -fopenmp -std=c++11 tgtool.cpp TemporalGraph.cpp readcsv.cpp utils.cpp csr_snapshot.cpp simd_kernels.cpp generator.cpp external_csr.cpp feature_store.cpp sharded_graph.cpp csr_validator.cpp metrics.cpp -o tgtool
+#include "TemporalGraph.h"
+#include "generator.h"
+#include "external_csr.h"
+#include "feature_store.h"
+#include "sharded_graph.h"
+#include "csr_validator.h"
+#include "utils.h"
+
+// Generate a synthetic graph straight into a T-CSR and save it as a binary snapshot
+template <typename Types>
+static bool generate_snapshot(const GeneratorOptions& options, bool reverse, const string& file_path) {
+    TemporalGraphT<Types> tg(reverse);
+    if (!generate_temporal_graph(options, tg)) {
+        return false;
+    }
+    tg.to_csr();
+    return tg.save_csr_binary(file_path);
+}
+
+static int run_generate(int argc, char* argv[]) {
+    if (argc < 3) {
+        return -1;
+    }
+    string output = argv[2];
+    GeneratorOptions options;
+    string format = "tgn";
+    bool csr = false;
+    bool reverse = false;
+    for (int i = 3; i < argc; ++i) {
+        string key = argv[i];
+        if (key == "--fractional-times") {
+            options.integer_times = false;
+        } else if (key == "--csr") {
+            csr = true;
+        } else if (key == "--reverse") {
+            reverse = true;
+        } else if (i + 1 < argc && key == "--format") {
+            format = argv[++i];
+        } else if (i + 1 >= argc || !parse_generator_option(key, argv[i + 1], options)) {
+            cerr << "Unknown option " << key << endl;
+            return -1;
+        } else {
+            ++i;
+        }
+    }
+
+    if (!csr) {
+        return write_temporal_edges_csv(options, output, format) ? 0 : 1;
+    }
+    // The TGN types hold the graph unless its size or timestamps need the TGL ones
+    bool saved = generator_fits_types<TGNGraphTypes>(options) ? generate_snapshot<TGNGraphTypes>(options, reverse, output)
+                                                               : generate_snapshot<TGLGraphTypes>(options, reverse, output);
+    return saved ? 0 : 1;
+}
+
+static int run_build(int argc, char* argv[]) {
+    if (argc < 4) {
+        return -1;
+    }
+    string csv_path = argv[2];
+    string output = argv[3];
+    ExternalBuildOptions options;
+    for (int i = 4; i < argc; ++i) {
+        string key = argv[i];
+        if (key == "--reverse") {
+            options.reverse = true;
+        } else if (i + 1 < argc && key == "--memory-mb") {
+            options.memory_budget = static_cast<size_t>(stoull(argv[++i])) << 20;
+        } else if (i + 1 < argc && key == "--temp-dir") {
+            options.temp_dir = argv[++i];
+        } else {
+            cerr << "Unknown option " << key << endl;
+            return -1;
+        }
+    }
+
+    // Built with the TGN types unless its ids, timestamps or size need the TGL ones
+    CsvReadResult result = build_csr_snapshot_external<TGNGraphTypes>(csv_path, output, options);
+    if (result == CSV_READ_DOES_NOT_FIT) {
+        cout << "Building " << output << " with the TGL graph types" << endl;
+        result = build_csr_snapshot_external<TGLGraphTypes>(csv_path, output, options);
+    }
+    return result == CSV_READ_OK ? 0 : 1;
+}
+
+static int run_features(int argc, char* argv[]) {
+    if (argc < 4) {
+        return -1;
+    }
+    string npy_path = argv[2];
+    string output = argv[3];
+    FeatureDType dtype = FEATURE_FLOAT32;
+    for (int i = 4; i < argc; ++i) {
+        string key = argv[i];
+        if (i + 1 < argc && key == "--dtype" && parse_feature_dtype(argv[i + 1], dtype)) {
+            ++i;
+        } else {
+            cerr << "Unknown option " << key << endl;
+            return -1;
+        }
+    }
+
+    vector<float> values;
+    size_t rows = 0;
+    size_t dim = 0;
+    if (!read_npy_matrix(npy_path, values, rows, dim)) {
+        return 1;
+    }
+    FeatureMatrix matrix;
+    matrix.assign(values.data(), rows, dim, dtype);
+    if (!matrix.save(output)) {
+        return 1;
+    }
+    cout << "Wrote " << rows << " x " << dim << " " << feature_dtype_name(dtype) << " features (" << matrix.bytes() / 1e6
+         << " MB) to " << output << endl;
+    return 0;
+}
+
+// Map the snapshot and split it into shards
+template <typename Types>
+static bool partition_snapshot(const string& snapshot_path, const string& manifest_path, size_t num_shards, ShardMode mode) {
+    TemporalGraphT<Types> tg;
+    return tg.load_csr_binary(snapshot_path) && partition_temporal_graph(tg, manifest_path, num_shards, mode);
+}
+
+static int run_partition(int argc, char* argv[]) {
+    if (argc < 4) {
+        return -1;
+    }
+    string snapshot_path = argv[2];
+    string manifest_path = argv[3];
+    size_t num_shards = 2;
+    ShardMode mode = SHARD_RANGE;
+    for (int i = 4; i < argc; ++i) {
+        string key = argv[i];
+        if (i + 1 < argc && key == "--shards") {
+            num_shards = static_cast<size_t>(stoull(argv[++i]));
+        } else if (i + 1 < argc && key == "--mode" && parse_shard_mode(argv[i + 1], mode)) {
+            ++i;
+        } else {
+            cerr << "Unknown option " << key << endl;
+            return -1;
+        }
+    }
+
+    CsrSnapshotHeader header;
+    if (!read_csr_snapshot_header(snapshot_path, header)) {
+        return 1;
+    }
+    bool partitioned = false;
+    if (csr_snapshot_matches<TGNGraphTypes>(header)) {
+        partitioned = partition_snapshot<TGNGraphTypes>(snapshot_path, manifest_path, num_shards, mode);
+    } else if (csr_snapshot_matches<TGLGraphTypes>(header)) {
+        partitioned = partition_snapshot<TGLGraphTypes>(snapshot_path, manifest_path, num_shards, mode);
+    } else {
+        cerr << snapshot_path << " has no supported type configuration" << endl;
+    }
+    return partitioned ? 0 : 1;
+}
+
+// Load a binary snapshot (text: the four files of save_csr) and print its report
+template <typename Types>
+static int validate_csr(const vector<string>& paths, bool text, bool reverse, bool verify_checksums, const ValidateOptions& options) {
+    TemporalGraphT<Types> tg(reverse);
+    bool loaded = text ? tg.read_csr(paths[0], paths[1], paths[2], paths[3]) : tg.load_csr_binary(paths[0], verify_checksums);
+    if (!loaded) {
+        return 1;
+    }
+    CsrReport report;
+    bool valid = validate_temporal_graph(tg, options, report);
+    print_csr_report(cout, report);
+    return valid ? 0 : 1;
+}
+
+static int run_validate(int argc, char* argv[]) {
+    vector<string> paths;
+    bool text = false;
+    bool reverse = false;
+    bool tgl = false;
+    bool verify_checksums = false;
+    ValidateOptions options;
+    for (int i = 2; i < argc; ++i) {
+        string key = argv[i];
+        if (key == "--text") {
+            text = true;
+        } else if (key == "--reverse") {
+            reverse = true;
+        } else if (key == "--tgl") {
+            tgl = true;
+        } else if (key == "--verify-checksums") {
+            verify_checksums = true;
+        } else if (key == "--no-edge-ids") {
+            options.check_edge_ids = false;
+        } else if (key == "--no-symmetry") {
+            options.check_symmetry = false;
+        } else if (i + 1 < argc && key == "--hubs") {
+            options.num_hubs = static_cast<size_t>(stoull(argv[++i]));
+        } else if (key.compare(0, 2, "--") == 0) {
+            cerr << "Unknown option " << key << endl;
+            return -1;
+        } else {
+            paths.push_back(key);
+        }
+    }
+    if (paths.size() != (text ? 4u : 1u)) {
+        return -1;
+    }
+    if (text) {
+        return tgl ? validate_csr<TGLGraphTypes>(paths, true, reverse, false, options)
+                   : validate_csr<TGNGraphTypes>(paths, true, reverse, false, options);
+    }
+
+    // A snapshot records its type configuration and direction
+    CsrSnapshotHeader header;
+    if (!read_csr_snapshot_header(paths[0], header)) {
+        return 1;
+    }
+    if (csr_snapshot_matches<TGNGraphTypes>(header)) {
+        return validate_csr<TGNGraphTypes>(paths, false, false, verify_checksums, options);
+    }
+    if (csr_snapshot_matches<TGLGraphTypes>(header)) {
+        return validate_csr<TGLGraphTypes>(paths, false, false, verify_checksums, options);
+    }
+    cerr << paths[0] << " has no supported type configuration" << endl;
+    return 1;
+}
+
+static void print_usage(const char* program) {
+    cerr << "Usage: " << program << " generate <output> [--edges n] [--nodes n] [--skew s] [--burstiness b]\n"
+         << "              [--time-distribution uniform|growth] [--time-span t] [--fractional-times] [--seed n]\n"
+         << "              [--format tgn|tgl] [--csr [--reverse]]\n"
+         << "  Writes a synthetic temporal edge stream as CSV, or with --csr as a binary T-CSR snapshot.\n"
+         << "       " << program << " build <csv_file> <output> [--reverse] [--memory-mb n] [--temp-dir dir]\n"
+         << "  Builds the binary T-CSR snapshot of a CSV edge list within a memory budget (default 1024 MB).\n"
+         << "       " << program << " features <npy_file> <output> [--dtype float32|float16|bfloat16|int8]\n"
+         << "  Converts a 2-D float .npy matrix (edge or node features) into a feature file for FeatureStore.\n"
+         << "       " << program << " partition <snapshot> <manifest> [--shards k] [--mode range|modulo]\n"
+         << "  Splits a binary T-CSR snapshot into k shard snapshots (default 2) described by a manifest.\n"
+         << "       " << program << " serve-shard <manifest> <shard> <socket>\n"
+         << "  Serves one shard to ShardedSampler over a Unix socket until it is asked to shut down.\n"
+         << "       " << program << " validate <snapshot> [--verify-checksums] [--hubs k] [--no-edge-ids] [--no-symmetry]\n"
+         << "       " << program << " validate --text <idx_values> <time_values> <indices> <indptr> [--reverse] [--tgl] [...]\n"
+         << "  Checks a binary or text T-CSR (offsets, neighbor ids, time order, edge ids, reverse mirrors) and\n"
+         << "  prints degree and inter-event time statistics; exits with 1 if it is invalid.\n";
+}
+
+int main(int argc, char* argv[]) {
+    string command = argc > 1 ? argv[1] : "";
+    int status = -1;
+    if (command == "generate") {
+        status = run_generate(argc, argv);
+    } else if (command == "build") {
+        status = run_build(argc, argv);
+    } else if (command == "features") {
+        status = run_features(argc, argv);
+    } else if (command == "partition") {
+        status = run_partition(argc, argv);
+    } else if (command == "validate") {
+        status = run_validate(argc, argv);
+    } else if (command == "serve-shard" && argc == 5) {
+        status = serve_shard(argv[2], static_cast<size_t>(stoull(argv[3])), argv[4]);
+    }
+    if (status < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    return status;
+}
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include <sys/resource.h>
 
 bool createDirectory(const std::string& path) {
     // Attempt to create the directory.
@@ -35,4 +36,13 @@ string extractSecondLastFolder(const string &filePath) {
     string folder = filePath.substr(secondLastSlashPos + 1, lastSlashPos - secondLastSlashPos - 1);
 
     return folder;
-}
\ No newline at end of file
+}
+
+size_t get_peak_rss_bytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // ru_maxrss is reported in kilobytes on Linux
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <cstdint>
 #include <sys/stat.h>
 using namespace std;
 
@@ -14,7 +15,55 @@ long - for the tgl graph data type with billion-scale edges.
 
 typedef int GraphDataType; // Define the data type for graph data
 
+/*
+Type configurations of the templated graph classes (TemporalGraphT and friends), with separate
+types for node ids, for edge ids and CSR offsets, and for timestamps:
+TGNGraphTypes - 32-bit ids and offsets and float time for million-scale TGN datasets;
+TGLGraphTypes - 64-bit ids and offsets and double time for billion-scale TGL datasets.
+Both are compiled into every binary; the loaders pick the narrowest one a dataset fits in.
+*/
+template <typename Node, typename Edge, typename Time>
+struct GraphTypes {
+    typedef Node NodeType;
+    typedef Edge EdgeType;
+    typedef Time TimeType;
+};
+
+typedef GraphTypes<int32_t, int32_t, float> TGNGraphTypes;
+typedef GraphTypes<int64_t, int64_t, double> TGLGraphTypes;
+
+/*
+Counter-based random stream (SplitMix64). A stream is fully determined by (seed, stream id),
+so work items can draw reproducible numbers regardless of which thread runs them.
+*/
+inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+struct CounterRng {
+    uint64_t state;
+
+    CounterRng(uint64_t seed, uint64_t stream) : state(mix64(seed ^ mix64(stream + 0x9E3779B97F4A7C15ULL))) {}
+
+    uint64_t next() {
+        state += 0x9E3779B97F4A7C15ULL;
+        return mix64(state);
+    }
+    // Uniform integer in [0, n) (Lemire's multiply-shift, bias below 2^-32 for n < 2^32)
+    uint64_t bounded(uint64_t n) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(next()) * n) >> 64);
+    }
+    // Uniform double in [0, 1)
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
 bool createDirectory(const std::string& path);
 string extractSecondLastFolder(const string &filePath);
+// Peak resident set size of this process so far, in bytes
+size_t get_peak_rss_bytes();
 
 #endif // UTILS_H
\ No newline at end of file